@@ -40,6 +40,9 @@ struct _kms_request_t {
    kms_request_str_t *date;
    kms_kv_list_t *query_params;
    kms_kv_list_t *header_fields;
+   /* reused to build the canonical request and string to sign */
+   kms_request_str_t *canonical;
+   kms_request_str_t *string_to_sign;
    /* turn off for tests only, not in public kms_request_opt_t API */
    bool auto_content_length;
    _kms_crypto_t crypto;
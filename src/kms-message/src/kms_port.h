@@ -29,4 +29,19 @@ kms_strndup (const char *src, size_t len);
 #define kms_strcasecmp strcasecmp
 #endif
 
+/* statically initialized, so they need no kms_message_init call. */
+#if defined(_WIN32)
+#include <windows.h>
+typedef SRWLOCK kms_mutex_t;
+#define KMS_MUTEX_INITIALIZER SRWLOCK_INIT
+#define kms_mutex_lock AcquireSRWLockExclusive
+#define kms_mutex_unlock ReleaseSRWLockExclusive
+#else
+#include <pthread.h>
+typedef pthread_mutex_t kms_mutex_t;
+#define KMS_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define kms_mutex_lock pthread_mutex_lock
+#define kms_mutex_unlock pthread_mutex_unlock
+#endif
+
 #endif /* KMS_PORT_H */
\ No newline at end of file
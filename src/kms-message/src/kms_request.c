@@ -21,6 +21,32 @@
 #include "kms_request_opt_private.h"
 #include "kms_port.h"
 
+/* docs.aws.amazon.com/general/latest/gr/sigv4-calculate-signature.html
+ *
+ * A signing key only depends on the secret key, date, region, and service, so
+ * requests signed the same day for the same service share it. */
+#define SIGNING_KEY_CACHE_SIZE 8
+
+typedef struct {
+   bool set;
+   /* SHA-256 of the secret key, date, region, and service */
+   unsigned char id[32];
+   /* the crypto hooks that derived the key */
+   bool (*sha256_hmac) (void *ctx,
+                        const char *key_input,
+                        size_t key_len,
+                        const char *input,
+                        size_t len,
+                        unsigned char *hash_out);
+   void *ctx;
+   unsigned char key[32];
+} signing_key_cache_entry_t;
+
+static signing_key_cache_entry_t signing_key_cache[SIGNING_KEY_CACHE_SIZE];
+/* the entry to replace next */
+static size_t signing_key_cache_next;
+static kms_mutex_t signing_key_cache_mutex = KMS_MUTEX_INITIALIZER;
+
 static kms_kv_list_t *
 parse_query_params (kms_request_str_t *q)
 {
@@ -91,6 +117,8 @@ kms_request_new (const char *method,
    request->datetime = kms_request_str_new ();
    request->method = kms_request_str_new_from_chars (method, -1);
    request->header_fields = kms_kv_list_new ();
+   request->canonical = kms_request_str_new ();
+   request->string_to_sign = kms_request_str_new ();
    request->auto_content_length = true;
 
    if (!kms_request_set_date (request, NULL)) {
@@ -128,6 +156,8 @@ kms_request_destroy (kms_request_t *request)
    kms_request_str_destroy (request->date);
    kms_kv_list_destroy (request->query_params);
    kms_kv_list_destroy (request->header_fields);
+   kms_request_str_destroy (request->canonical);
+   kms_request_str_destroy (request->string_to_sign);
    free (request);
 }
 
@@ -437,22 +467,14 @@ canonical_headers (const kms_request_t *request)
    return lst;
 }
 
-char *
-kms_request_get_canonical (kms_request_t *request)
+/* "lst" is the list of canonical headers */
+static bool
+append_canonical_request (kms_request_t *request,
+                          kms_kv_list_t *lst,
+                          kms_request_str_t *canonical)
 {
-   kms_request_str_t *canonical;
    kms_request_str_t *normalized;
-   kms_kv_list_t *lst;
 
-   if (request->failed) {
-      return NULL;
-   }
-
-   if (!finalize (request)) {
-      return NULL;
-   }
-
-   canonical = kms_request_str_new ();
    kms_request_str_append (canonical, request->method);
    kms_request_str_append_newline (canonical);
    normalized = kms_request_str_path_normalized (request->path);
@@ -461,19 +483,41 @@ kms_request_get_canonical (kms_request_t *request)
    kms_request_str_append_newline (canonical);
    append_canonical_query (request, canonical);
    kms_request_str_append_newline (canonical);
-   lst = canonical_headers (request);
    append_canonical_headers (lst, canonical);
    kms_request_str_append_newline (canonical);
    append_signed_headers (lst, canonical);
-   kms_kv_list_destroy (lst);
    kms_request_str_append_newline (canonical);
    if (!kms_request_str_append_hashed (
           &request->crypto, canonical, request->payload)) {
       KMS_ERROR (request, "could not generate hash");
-      kms_request_str_destroy (canonical);
+      return false;
+   }
+
+   return true;
+}
+
+char *
+kms_request_get_canonical (kms_request_t *request)
+{
+   kms_request_str_t *canonical;
+   kms_kv_list_t *lst;
+
+   if (request->failed) {
       return NULL;
    }
 
+   if (!finalize (request)) {
+      return NULL;
+   }
+
+   canonical = kms_request_str_new ();
+   lst = canonical_headers (request);
+   if (!append_canonical_request (request, lst, canonical)) {
+      kms_request_str_destroy (canonical);
+      canonical = NULL;
+   }
+
+   kms_kv_list_destroy (lst);
    return kms_request_str_detach (canonical);
 }
 
@@ -498,23 +542,20 @@ kms_request_get_canonical_header (kms_request_t *request, const char *header)
    return value->value->str;
 }
 
-char *
-kms_request_get_string_to_sign (kms_request_t *request)
+/* Build the string to sign in request->string_to_sign, using
+ * request->canonical for the canonical request. "lst" is the list of
+ * canonical headers. */
+static bool
+build_string_to_sign (kms_request_t *request, kms_kv_list_t *lst)
 {
-   bool success = false;
-   kms_request_str_t *sts;
-   kms_request_str_t *creq = NULL; /* canonical request */
-
-   if (request->failed) {
-      return NULL;
-   }
+   kms_request_str_t *sts = request->string_to_sign;
 
-   if (!finalize (request)) {
-      return NULL;
+   kms_request_str_set_chars (request->canonical, "", 0);
+   if (!append_canonical_request (request, lst, request->canonical)) {
+      return false;
    }
 
-   sts = kms_request_str_new ();
-   kms_request_str_append_chars (sts, "AWS4-HMAC-SHA256\n", -1);
+   kms_request_str_set_chars (sts, "AWS4-HMAC-SHA256\n", -1);
    kms_request_str_append (sts, request->datetime);
    kms_request_str_append_newline (sts);
 
@@ -526,24 +567,32 @@ kms_request_get_string_to_sign (kms_request_t *request)
    kms_request_str_append (sts, request->service);
    kms_request_str_append_chars (sts, "/aws4_request\n", -1);
 
-   creq = kms_request_str_wrap (kms_request_get_canonical (request), -1);
-   if (!creq) {
-      goto done;
+   return kms_request_str_append_hashed (
+      &request->crypto, sts, request->canonical);
+}
+
+char *
+kms_request_get_string_to_sign (kms_request_t *request)
+{
+   kms_kv_list_t *lst;
+   char *sts = NULL;
+
+   if (request->failed) {
+      return NULL;
    }
 
-   if (!kms_request_str_append_hashed (&request->crypto, sts, creq)) {
-      goto done;
+   if (!finalize (request)) {
+      return NULL;
    }
 
-   success = true;
-done:
-   kms_request_str_destroy (creq);
-   if (!success) {
-      kms_request_str_destroy (sts);
-      sts = NULL;
+   lst = canonical_headers (request);
+   if (build_string_to_sign (request, lst)) {
+      sts = kms_request_str_detach (
+         kms_request_str_dup (request->string_to_sign));
    }
 
-   return kms_request_str_detach (sts);
+   kms_kv_list_destroy (lst);
+   return sts;
 }
 
 static bool
@@ -566,12 +615,80 @@ kms_request_hmac_again (_kms_crypto_t *crypto,
       crypto->ctx, (const char *) in, 32, data->str, data->len, out);
 }
 
+/* Identify the signing key for the request's secret key, date, region, and
+ * service, without keeping the secret key */
+static bool
+signing_key_id (kms_request_t *request, unsigned char *id)
+{
+   kms_request_str_t *scope;
+   bool ret;
+
+   scope = kms_request_str_dup (request->secret_key);
+   kms_request_str_append_char (scope, '\0');
+   kms_request_str_append (scope, request->date);
+   kms_request_str_append_char (scope, '\0');
+   kms_request_str_append (scope, request->region);
+   kms_request_str_append_char (scope, '\0');
+   kms_request_str_append (scope, request->service);
+   ret = request->crypto.sha256 (
+      request->crypto.ctx, scope->str, scope->len, id);
+   memset (scope->str, 0, scope->len);
+   kms_request_str_destroy (scope);
+   return ret;
+}
+
+static bool
+signing_key_cache_get (kms_request_t *request,
+                       const unsigned char *id,
+                       unsigned char *key)
+{
+   signing_key_cache_entry_t *entry;
+   bool found = false;
+   size_t i;
+
+   kms_mutex_lock (&signing_key_cache_mutex);
+   for (i = 0; i < SIGNING_KEY_CACHE_SIZE; i++) {
+      entry = &signing_key_cache[i];
+      if (entry->set && entry->sha256_hmac == request->crypto.sha256_hmac &&
+          entry->ctx == request->crypto.ctx &&
+          0 == memcmp (entry->id, id, sizeof (entry->id))) {
+         memcpy (key, entry->key, sizeof (entry->key));
+         found = true;
+         break;
+      }
+   }
+
+   kms_mutex_unlock (&signing_key_cache_mutex);
+   return found;
+}
+
+static void
+signing_key_cache_put (kms_request_t *request,
+                       const unsigned char *id,
+                       const unsigned char *key)
+{
+   signing_key_cache_entry_t *entry;
+
+   kms_mutex_lock (&signing_key_cache_mutex);
+   entry = &signing_key_cache[signing_key_cache_next];
+   signing_key_cache_next =
+      (signing_key_cache_next + 1) % SIGNING_KEY_CACHE_SIZE;
+   entry->set = true;
+   memcpy (entry->id, id, sizeof (entry->id));
+   entry->sha256_hmac = request->crypto.sha256_hmac;
+   entry->ctx = request->crypto.ctx;
+   memcpy (entry->key, key, sizeof (entry->key));
+   kms_mutex_unlock (&signing_key_cache_mutex);
+}
+
 bool
 kms_request_get_signing_key (kms_request_t *request, unsigned char *key)
 {
    bool success = false;
    kms_request_str_t *aws4_plus_secret = NULL;
    kms_request_str_t *aws4_request = NULL;
+   unsigned char id[32];
+   bool has_id;
    unsigned char k_date[32];
    unsigned char k_region[32];
    unsigned char k_service[32];
@@ -580,6 +697,11 @@ kms_request_get_signing_key (kms_request_t *request, unsigned char *key)
       return false;
    }
 
+   has_id = signing_key_id (request, id);
+   if (has_id && signing_key_cache_get (request, id, key)) {
+      return true;
+   }
+
    /* docs.aws.amazon.com/general/latest/gr/sigv4-calculate-signature.html
     * Pseudocode for deriving a signing key
     *
@@ -605,8 +727,13 @@ kms_request_get_signing_key (kms_request_t *request, unsigned char *key)
       goto done;
    }
 
+   if (has_id) {
+      signing_key_cache_put (request, id, key);
+   }
+
    success = true;
 done:
+   memset (aws4_plus_secret->str, 0, aws4_plus_secret->len);
    kms_request_str_destroy (aws4_plus_secret);
    kms_request_str_destroy (aws4_request);
 
@@ -619,7 +746,6 @@ kms_request_get_signature (kms_request_t *request)
    bool success = false;
    kms_kv_list_t *lst = NULL;
    kms_request_str_t *sig = NULL;
-   kms_request_str_t *sts = NULL;
    unsigned char signing_key[32];
    unsigned char signature[32];
 
@@ -627,8 +753,13 @@ kms_request_get_signature (kms_request_t *request)
       return NULL;
    }
 
-   sts = kms_request_str_wrap (kms_request_get_string_to_sign (request), -1);
-   if (!sts) {
+   if (!finalize (request)) {
+      return NULL;
+   }
+
+   /* sort the headers once for the canonical request and signed headers */
+   lst = canonical_headers (request);
+   if (!build_string_to_sign (request, lst)) {
       goto done;
    }
 
@@ -642,12 +773,13 @@ kms_request_get_signature (kms_request_t *request)
    kms_request_str_append_char (sig, '/');
    kms_request_str_append (sig, request->service);
    kms_request_str_append_chars (sig, "/aws4_request, SignedHeaders=", -1);
-   lst = canonical_headers (request);
    append_signed_headers (lst, sig);
    kms_request_str_append_chars (sig, ", Signature=", -1);
    if (!(kms_request_get_signing_key (request, signing_key) &&
-         kms_request_hmac_again (
-            &request->crypto, signature, signing_key, sts))) {
+         kms_request_hmac_again (&request->crypto,
+                                 signature,
+                                 signing_key,
+                                 request->string_to_sign))) {
       goto done;
    }
 
@@ -655,7 +787,6 @@ kms_request_get_signature (kms_request_t *request)
    success = true;
 done:
    kms_kv_list_destroy (lst);
-   kms_request_str_destroy (sts);
 
    if (!success) {
       kms_request_str_destroy (sig);
@@ -993,6 +993,75 @@ kms_request_validate_test (void)
    kms_request_destroy (request);
 }
 
+static int hmac_calls;
+
+static bool
+counting_sha256_hmac (void *ctx,
+                      const char *key_input,
+                      size_t key_len,
+                      const char *input,
+                      size_t len,
+                      unsigned char *hash_out)
+{
+   hmac_calls++;
+   return kms_sha256_hmac (ctx, key_input, key_len, input, len, hash_out);
+}
+
+static char *
+signature_with_counting_hooks (const char *secret_key, const char *region)
+{
+   kms_request_opt_t *opt;
+   kms_request_t *request;
+   char *sig;
+
+   opt = kms_request_opt_new ();
+   kms_request_opt_set_crypto_hooks (
+      opt, kms_sha256, counting_sha256_hmac, &hmac_calls);
+   request = kms_request_new ("GET", "/", opt);
+   set_test_date (request);
+   kms_request_set_region (request, region);
+   kms_request_set_service (request, "service");
+   kms_request_set_access_key_id (request, "AKIDEXAMPLE");
+   kms_request_set_secret_key (request, secret_key);
+   sig = kms_request_get_signature (request);
+   KMS_ASSERT (sig);
+   kms_request_destroy (request);
+   kms_request_opt_destroy (opt);
+   return sig;
+}
+
+/* the four-step signing key derivation is only done once per scope */
+void
+signing_key_cache_test (void)
+{
+   char *first;
+   char *second;
+
+   hmac_calls = 0;
+   first = signature_with_counting_hooks ("secret", "us-east-1");
+   KMS_ASSERT (hmac_calls == 5);
+
+   hmac_calls = 0;
+   second = signature_with_counting_hooks ("secret", "us-east-1");
+   KMS_ASSERT (hmac_calls == 1);
+   ASSERT_CMPSTR (first, second);
+   free (second);
+
+   /* a different secret key or region needs another signing key */
+   hmac_calls = 0;
+   second = signature_with_counting_hooks ("other secret", "us-east-1");
+   KMS_ASSERT (hmac_calls == 5);
+   KMS_ASSERT (0 != strcmp (first, second));
+   free (second);
+
+   hmac_calls = 0;
+   second = signature_with_counting_hooks ("secret", "us-west-2");
+   KMS_ASSERT (hmac_calls == 5);
+   free (second);
+
+   free (first);
+}
+
 #define RUN_TEST(_func)                                          \
    do {                                                          \
       if (!selector || 0 == kms_strcasecmp (#_func, selector)) { \
@@ -1025,6 +1094,7 @@ main (int argc, char *argv[])
    }
 
    RUN_TEST (example_signature_test);
+   RUN_TEST (signing_key_cache_test);
    RUN_TEST (path_normalization_test);
    RUN_TEST (host_test);
    RUN_TEST (content_length_test);
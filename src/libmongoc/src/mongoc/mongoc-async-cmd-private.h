@@ -25,6 +25,7 @@
 #include "mongoc-async-private.h"
 #include "mongoc-array-private.h"
 #include "mongoc-buffer-private.h"
+#include "mongoc-cmd-private.h"
 #include "mongoc-rpc-private.h"
 #include "mongoc-stream.h"
 
@@ -57,6 +58,10 @@ typedef struct _mongoc_async_cmd {
    int64_t cmd_started;
    int64_t timeout_msec;
    bson_t cmd;
+   /* OP_MSG payload type 1, e.g. the documents of an insert */
+   char *payload_identifier;
+   uint8_t *payload;
+   int32_t payload_size;
    mongoc_buffer_t buffer;
    mongoc_array_t array;
    mongoc_iovec_t *iovec;
@@ -88,6 +93,23 @@ mongoc_async_cmd_new (mongoc_async_t *async,
                       void *cb_data,
                       int64_t timeout_msec);
 
+mongoc_async_cmd_t *
+mongoc_async_cmd_new_opmsg (mongoc_async_t *async,
+                            mongoc_stream_t *stream,
+                            const char *dbname,
+                            const bson_t *cmd,
+                            mongoc_async_cmd_cb_t cb,
+                            void *cb_data,
+                            int64_t timeout_msec);
+
+mongoc_async_cmd_t *
+mongoc_async_cmd_new_from_cmd (mongoc_async_t *async,
+                               mongoc_stream_t *stream,
+                               const mongoc_cmd_t *cmd,
+                               mongoc_async_cmd_cb_t cb,
+                               void *cb_data,
+                               int64_t timeout_msec);
+
 void
 mongoc_async_cmd_destroy (mongoc_async_cmd_t *acmd);
 
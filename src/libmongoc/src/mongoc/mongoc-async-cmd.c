@@ -134,22 +134,48 @@ mongoc_async_cmd_run (mongoc_async_cmd_t *acmd)
 }
 
 void
-_mongoc_async_cmd_init_send (mongoc_async_cmd_t *acmd, const char *dbname)
+_mongoc_async_cmd_init_send (mongoc_async_cmd_t *acmd,
+                             int32_t opcode,
+                             const char *dbname)
 {
-   acmd->ns = bson_strdup_printf ("%s.$cmd", dbname);
-
    acmd->rpc.header.msg_len = 0;
    acmd->rpc.header.request_id = ++acmd->async->request_id;
    acmd->rpc.header.response_to = 0;
-   acmd->rpc.header.opcode = MONGOC_OPCODE_QUERY;
-   acmd->rpc.query.flags = MONGOC_QUERY_SLAVE_OK;
-   acmd->rpc.query.collection = acmd->ns;
-   acmd->rpc.query.skip = 0;
-   acmd->rpc.query.n_return = -1;
-   acmd->rpc.query.query = bson_get_data (&acmd->cmd);
-   acmd->rpc.query.fields = NULL;
-
-   /* This will always be isMaster, which are not allowed to be compressed */
+   acmd->rpc.header.opcode = opcode;
+
+   if (opcode == MONGOC_OPCODE_MSG) {
+      if (!bson_has_field (&acmd->cmd, "$db")) {
+         BSON_APPEND_UTF8 (&acmd->cmd, "$db", dbname);
+      }
+      acmd->rpc.msg.flags = 0;
+      acmd->rpc.msg.n_sections = 1;
+      acmd->rpc.msg.sections[0].payload_type = 0;
+      acmd->rpc.msg.sections[0].payload.bson_document =
+         bson_get_data (&acmd->cmd);
+
+      if (acmd->payload) {
+         acmd->rpc.msg.sections[1].payload_type = 1;
+         acmd->rpc.msg.sections[1].payload.sequence.size =
+            acmd->payload_size + (int32_t) strlen (acmd->payload_identifier) +
+            1 + (int32_t) sizeof (int32_t);
+         acmd->rpc.msg.sections[1].payload.sequence.identifier =
+            acmd->payload_identifier;
+         acmd->rpc.msg.sections[1].payload.sequence.bson_documents =
+            acmd->payload;
+         acmd->rpc.msg.n_sections++;
+      }
+   } else {
+      acmd->ns = bson_strdup_printf ("%s.$cmd", dbname);
+      acmd->rpc.query.flags = MONGOC_QUERY_SLAVE_OK;
+      acmd->rpc.query.collection = acmd->ns;
+      acmd->rpc.query.skip = 0;
+      acmd->rpc.query.n_return = -1;
+      acmd->rpc.query.query = bson_get_data (&acmd->cmd);
+      acmd->rpc.query.fields = NULL;
+   }
+
+   /* isMaster is not allowed to be compressed, and other commands run on a
+    * connection that is already set up are sent uncompressed for simplicity */
    _mongoc_rpc_gather (&acmd->rpc, &acmd->array);
    acmd->iovec = (mongoc_iovec_t *) acmd->array.data;
    acmd->niovec = acmd->array.len;
@@ -171,20 +197,22 @@ _mongoc_async_cmd_state_start (mongoc_async_cmd_t *acmd, bool is_setup_done)
    acmd->events = POLLOUT;
 }
 
-mongoc_async_cmd_t *
-mongoc_async_cmd_new (mongoc_async_t *async,
-                      mongoc_stream_t *stream,
-                      bool is_setup_done,
-                      struct addrinfo *dns_result,
-                      mongoc_async_cmd_initiate_t initiator,
-                      int64_t initiate_delay_ms,
-                      mongoc_async_cmd_setup_t setup,
-                      void *setup_ctx,
-                      const char *dbname,
-                      const bson_t *cmd,
-                      mongoc_async_cmd_cb_t cb,
-                      void *cb_data,
-                      int64_t timeout_msec)
+static mongoc_async_cmd_t *
+_mongoc_async_cmd_new (mongoc_async_t *async,
+                       mongoc_stream_t *stream,
+                       bool is_setup_done,
+                       struct addrinfo *dns_result,
+                       mongoc_async_cmd_initiate_t initiator,
+                       int64_t initiate_delay_ms,
+                       mongoc_async_cmd_setup_t setup,
+                       void *setup_ctx,
+                       const char *dbname,
+                       const bson_t *cmd,
+                       const mongoc_cmd_t *parts_cmd,
+                       mongoc_async_cmd_cb_t cb,
+                       void *cb_data,
+                       int64_t timeout_msec,
+                       int32_t opcode)
 {
    mongoc_async_cmd_t *acmd;
 
@@ -205,10 +233,17 @@ mongoc_async_cmd_new (mongoc_async_t *async,
    acmd->connect_started = bson_get_monotonic_time ();
    bson_copy_to (cmd, &acmd->cmd);
 
+   if (parts_cmd && parts_cmd->payload) {
+      acmd->payload_identifier = bson_strdup (parts_cmd->payload_identifier);
+      acmd->payload = bson_malloc ((size_t) parts_cmd->payload_size);
+      memcpy (acmd->payload, parts_cmd->payload, parts_cmd->payload_size);
+      acmd->payload_size = parts_cmd->payload_size;
+   }
+
    _mongoc_array_init (&acmd->array, sizeof (mongoc_iovec_t));
    _mongoc_buffer_init (&acmd->buffer, NULL, 0, NULL, NULL);
 
-   _mongoc_async_cmd_init_send (acmd, dbname);
+   _mongoc_async_cmd_init_send (acmd, opcode, dbname);
 
    _mongoc_async_cmd_state_start (acmd, is_setup_done);
 
@@ -219,6 +254,121 @@ mongoc_async_cmd_new (mongoc_async_t *async,
 }
 
 
+mongoc_async_cmd_t *
+mongoc_async_cmd_new (mongoc_async_t *async,
+                      mongoc_stream_t *stream,
+                      bool is_setup_done,
+                      struct addrinfo *dns_result,
+                      mongoc_async_cmd_initiate_t initiator,
+                      int64_t initiate_delay_ms,
+                      mongoc_async_cmd_setup_t setup,
+                      void *setup_ctx,
+                      const char *dbname,
+                      const bson_t *cmd,
+                      mongoc_async_cmd_cb_t cb,
+                      void *cb_data,
+                      int64_t timeout_msec)
+{
+   return _mongoc_async_cmd_new (async,
+                                 stream,
+                                 is_setup_done,
+                                 dns_result,
+                                 initiator,
+                                 initiate_delay_ms,
+                                 setup,
+                                 setup_ctx,
+                                 dbname,
+                                 cmd,
+                                 NULL /* parts cmd */,
+                                 cb,
+                                 cb_data,
+                                 timeout_msec,
+                                 MONGOC_OPCODE_QUERY);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_async_cmd_new_opmsg --
+ *
+ *       Queue @cmd as an OP_MSG on a @stream that is already connected,
+ *       handshaked and authenticated, e.g. one checked out of a cluster.
+ *       The stream is not owned by the command. @cb is called with the
+ *       server reply once it arrives, or with an error or timeout.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+mongoc_async_cmd_t *
+mongoc_async_cmd_new_opmsg (mongoc_async_t *async,
+                            mongoc_stream_t *stream,
+                            const char *dbname,
+                            const bson_t *cmd,
+                            mongoc_async_cmd_cb_t cb,
+                            void *cb_data,
+                            int64_t timeout_msec)
+{
+   BSON_ASSERT (stream);
+
+   return _mongoc_async_cmd_new (async,
+                                 stream,
+                                 true /* is setup done */,
+                                 NULL /* dns result */,
+                                 NULL /* initiator */,
+                                 0 /* initiate delay */,
+                                 NULL /* setup */,
+                                 NULL /* setup ctx */,
+                                 dbname,
+                                 cmd,
+                                 NULL /* parts cmd */,
+                                 cb,
+                                 cb_data,
+                                 timeout_msec,
+                                 MONGOC_OPCODE_MSG);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_async_cmd_new_from_cmd --
+ *
+ *       Like mongoc_async_cmd_new_opmsg, for a command assembled by
+ *       mongoc_cmd_parts_assemble. A write command's documents are sent
+ *       as an OP_MSG document sequence. The command and its documents are
+ *       copied.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+mongoc_async_cmd_t *
+mongoc_async_cmd_new_from_cmd (mongoc_async_t *async,
+                               mongoc_stream_t *stream,
+                               const mongoc_cmd_t *cmd,
+                               mongoc_async_cmd_cb_t cb,
+                               void *cb_data,
+                               int64_t timeout_msec)
+{
+   BSON_ASSERT (stream);
+
+   return _mongoc_async_cmd_new (async,
+                                 stream,
+                                 true /* is setup done */,
+                                 NULL /* dns result */,
+                                 NULL /* initiator */,
+                                 0 /* initiate delay */,
+                                 NULL /* setup */,
+                                 NULL /* setup ctx */,
+                                 cmd->db_name,
+                                 cmd->command,
+                                 cmd,
+                                 cb,
+                                 cb_data,
+                                 timeout_msec,
+                                 MONGOC_OPCODE_MSG);
+}
+
 void
 mongoc_async_cmd_destroy (mongoc_async_cmd_t *acmd)
 {
@@ -236,6 +386,8 @@ mongoc_async_cmd_destroy (mongoc_async_cmd_t *acmd)
    _mongoc_array_destroy (&acmd->array);
    _mongoc_buffer_destroy (&acmd->buffer);
 
+   bson_free (acmd->payload_identifier);
+   bson_free (acmd->payload);
    bson_free (acmd->ns);
    bson_free (acmd);
 }
@@ -412,7 +564,10 @@ _mongoc_async_cmd_phase_recv_len (mongoc_async_cmd_t *acmd)
 mongoc_async_cmd_result_t
 _mongoc_async_cmd_phase_recv_rpc (mongoc_async_cmd_t *acmd)
 {
-   ssize_t bytes = _mongoc_buffer_try_append_from_stream (
+   ssize_t bytes;
+
+again:
+   bytes = _mongoc_buffer_try_append_from_stream (
       &acmd->buffer, acmd->stream, acmd->bytes_to_read, 0);
 
    if (bytes <= 0 && mongoc_stream_should_retry (acmd->stream)) {
@@ -482,5 +637,7 @@ _mongoc_async_cmd_phase_recv_rpc (mongoc_async_cmd_t *acmd)
       return MONGOC_ASYNC_CMD_SUCCESS;
    }
 
-   return MONGOC_ASYNC_CMD_IN_PROGRESS;
+   /* read on until the stream would block: a TLS stream may hold decrypted
+    * bytes that will never make its socket readable again */
+   goto again;
 }
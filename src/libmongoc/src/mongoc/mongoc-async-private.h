@@ -20,6 +20,7 @@
 #define MONGOC_ASYNC_PRIVATE_H
 
 #include <bson/bson.h>
+#include "mongoc-socket.h"
 #include "mongoc-stream.h"
 
 BSON_BEGIN_DECLS
@@ -30,6 +31,13 @@ typedef struct _mongoc_async {
    struct _mongoc_async_cmd *cmds;
    size_t ncmds;
    uint32_t request_id;
+
+   /* the streams to wait on, filled by mongoc_async_prepare and reused
+    * between iterations so a long-lived reactor doesn't reallocate. */
+   mongoc_stream_poll_t *poller;
+   struct _mongoc_async_cmd **acmds_polled;
+   size_t npolled;
+   size_t poll_size;
 } mongoc_async_t;
 
 typedef enum {
@@ -64,6 +72,18 @@ mongoc_async_destroy (mongoc_async_t *async);
 void
 mongoc_async_run (mongoc_async_t *async);
 
+size_t
+mongoc_async_prepare (mongoc_async_t *async, int64_t *timeout_msec);
+
+mongoc_socket_t *
+mongoc_async_get_socket (mongoc_async_t *async, size_t i);
+
+void
+mongoc_async_dispatch (mongoc_async_t *async, ssize_t nactive);
+
+size_t
+mongoc_async_step (mongoc_async_t *async, int64_t max_wait_msec);
+
 BSON_END_DECLS
 
 #endif /* MONGOC_ASYNC_PRIVATE_H */
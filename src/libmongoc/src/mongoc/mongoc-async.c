@@ -22,6 +22,7 @@
 #include "utlist.h"
 #include "mongoc.h"
 #include "mongoc-socket-private.h"
+#include "mongoc-stream-private.h"
 #include "mongoc-util-private.h"
 
 #undef MONGOC_LOG_DOMAIN
@@ -46,160 +47,275 @@ mongoc_async_destroy (mongoc_async_t *async)
       mongoc_async_cmd_destroy (acmd);
    }
 
+   bson_free (async->poller);
+   bson_free (async->acmds_polled);
    bson_free (async);
 }
 
-void
-mongoc_async_run (mongoc_async_t *async)
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_async_prepare --
+ *
+ *       Initiate any commands whose delay has elapsed and collect the
+ *       streams that have I/O pending into async->poller.
+ *
+ *       An external event loop waits on these streams (see
+ *       mongoc_async_get_socket) for at most @timeout_msec, stores the
+ *       ready events in async->poller[i].revents, then calls
+ *       mongoc_async_dispatch.
+ *
+ * Returns:
+ *       The number of streams to wait on.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+size_t
+mongoc_async_prepare (mongoc_async_t *async, int64_t *timeout_msec)
 {
    mongoc_async_cmd_t *acmd, *tmp;
-   mongoc_async_cmd_t **acmds_polled = NULL;
-   mongoc_stream_poll_t *poller = NULL;
-   int nstreams, i;
-   ssize_t nactive = 0;
    int64_t now;
    int64_t expire_at;
-   int64_t poll_timeout_msec;
-   size_t poll_size;
 
    now = bson_get_monotonic_time ();
-   poll_size = 0;
+   expire_at = INT64_MAX;
 
-   /* CDRIVER-1571 reset start times in case a stream initiator was slow */
-   DL_FOREACH (async->cmds, acmd)
-   {
-      acmd->connect_started = now;
+   /* ncmds grows if we discover a replica & start calling ismaster on it */
+   if (async->poll_size < async->ncmds) {
+      async->poller = (mongoc_stream_poll_t *) bson_realloc (
+         async->poller, sizeof (*async->poller) * async->ncmds);
+      async->acmds_polled = (mongoc_async_cmd_t **) bson_realloc (
+         async->acmds_polled, sizeof (*async->acmds_polled) * async->ncmds);
+      async->poll_size = async->ncmds;
    }
 
-   while (async->ncmds) {
-      /* ncmds grows if we discover a replica & start calling ismaster on it */
-      if (poll_size < async->ncmds) {
-         poller = (mongoc_stream_poll_t *) bson_realloc (
-            poller, sizeof (*poller) * async->ncmds);
-         acmds_polled = (mongoc_async_cmd_t **) bson_realloc (
-            acmds_polled, sizeof (*acmds_polled) * async->ncmds);
-         poll_size = async->ncmds;
-      }
+   async->npolled = 0;
 
-      expire_at = INT64_MAX;
-      nstreams = 0;
-
-      /* check if any cmds are ready to be initiated. */
-      DL_FOREACH_SAFE (async->cmds, acmd, tmp)
-      {
-         if (acmd->state == MONGOC_ASYNC_CMD_INITIATE) {
-            BSON_ASSERT (!acmd->stream);
-            if (now >= acmd->initiate_delay_ms * 1000 + acmd->connect_started) {
-               /* time to initiate. */
-               if (mongoc_async_cmd_run (acmd)) {
-                  BSON_ASSERT (acmd->stream);
-               } else {
-                  /* this command was removed. */
-                  continue;
-               }
+   /* check if any cmds are ready to be initiated. */
+   DL_FOREACH_SAFE (async->cmds, acmd, tmp)
+   {
+      if (acmd->state == MONGOC_ASYNC_CMD_INITIATE) {
+         BSON_ASSERT (!acmd->stream);
+         if (now >= acmd->initiate_delay_ms * 1000 + acmd->connect_started) {
+            /* time to initiate. */
+            if (mongoc_async_cmd_run (acmd)) {
+               BSON_ASSERT (acmd->stream);
             } else {
-               /* don't poll longer than the earliest cmd ready to init. */
-               expire_at = BSON_MIN (
-                  expire_at, acmd->connect_started + acmd->initiate_delay_ms);
+               /* this command was removed. */
+               continue;
             }
-         }
-
-         if (acmd->stream) {
-            acmds_polled[nstreams] = acmd;
-            poller[nstreams].stream = acmd->stream;
-            poller[nstreams].events = acmd->events;
-            poller[nstreams].revents = 0;
+         } else {
+            /* don't poll longer than the earliest cmd ready to init. */
             expire_at = BSON_MIN (
-               expire_at, acmd->connect_started + acmd->timeout_msec * 1000);
-            ++nstreams;
+               expire_at, acmd->connect_started + acmd->initiate_delay_ms);
          }
       }
 
-      if (async->ncmds == 0) {
-         /* all cmds failed to initiate and removed themselves. */
-         break;
+      if (acmd->stream) {
+         async->acmds_polled[async->npolled] = acmd;
+         async->poller[async->npolled].stream = acmd->stream;
+         async->poller[async->npolled].events = acmd->events;
+         async->poller[async->npolled].revents = 0;
+         expire_at = BSON_MIN (
+            expire_at, acmd->connect_started + acmd->timeout_msec * 1000);
+         ++async->npolled;
       }
+   }
 
-      poll_timeout_msec = BSON_MAX (0, (expire_at - now) / 1000);
-      BSON_ASSERT (poll_timeout_msec < INT32_MAX);
-
-      if (nstreams > 0) {
-         /* we need at least one stream to poll. */
-         nactive =
-            mongoc_stream_poll (poller, nstreams, (int32_t) poll_timeout_msec);
-      } else {
-         /* currently this does not get hit. we always have at least one command
-          * initialized with a stream. */
-         _mongoc_usleep (poll_timeout_msec * 1000);
-      }
+   *timeout_msec = BSON_MAX (0, (expire_at - now) / 1000);
 
-      if (nactive > 0) {
-         for (i = 0; i < nstreams; i++) {
-            mongoc_async_cmd_t *iter = acmds_polled[i];
-            if (poller[i].revents & (POLLERR | POLLHUP)) {
-               int hup = poller[i].revents & POLLHUP;
-               if (iter->state == MONGOC_ASYNC_CMD_SEND) {
-                  bson_set_error (&iter->error,
-                                  MONGOC_ERROR_STREAM,
-                                  MONGOC_ERROR_STREAM_CONNECT,
-                                  hup ? "connection refused"
-                                      : "unknown connection error");
-               } else {
-                  bson_set_error (&iter->error,
-                                  MONGOC_ERROR_STREAM,
-                                  MONGOC_ERROR_STREAM_SOCKET,
-                                  hup ? "connection closed"
-                                      : "unknown socket error");
-               }
-
-               iter->state = MONGOC_ASYNC_CMD_ERROR_STATE;
-            }
+   return async->npolled;
+}
 
-            if ((poller[i].revents & poller[i].events) ||
-                iter->state == MONGOC_ASYNC_CMD_ERROR_STATE) {
-               (void) mongoc_async_cmd_run (iter);
-               nactive--;
-            }
 
-            if (!nactive) {
-               break;
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_async_get_socket --
+ *
+ *       Get the socket beneath the @i'th stream collected by
+ *       mongoc_async_prepare, so an event loop such as epoll can watch
+ *       its file descriptor.
+ *
+ * Returns:
+ *       A socket owned by the stream, or NULL if the stream is not backed
+ *       by a socket.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+mongoc_socket_t *
+mongoc_async_get_socket (mongoc_async_t *async, size_t i)
+{
+   mongoc_stream_t *root;
+
+   BSON_ASSERT (i < async->npolled);
+
+   root = mongoc_stream_get_root_stream (async->poller[i].stream);
+   if (!root || root->type != MONGOC_STREAM_SOCKET) {
+      return NULL;
+   }
+
+   return mongoc_stream_socket_get_socket ((mongoc_stream_socket_t *) root);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_async_dispatch --
+ *
+ *       Advance the commands whose streams have events in
+ *       async->poller[i].revents, then time out or remove commands that
+ *       are finished. @nactive is the number of streams with events, as
+ *       returned by mongoc_stream_poll.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+mongoc_async_dispatch (mongoc_async_t *async, ssize_t nactive)
+{
+   mongoc_async_cmd_t *acmd, *tmp;
+   mongoc_stream_poll_t *poller = async->poller;
+   int64_t now;
+   size_t i;
+
+   now = bson_get_monotonic_time ();
+
+   if (nactive > 0) {
+      for (i = 0; i < async->npolled; i++) {
+         mongoc_async_cmd_t *iter = async->acmds_polled[i];
+         if (poller[i].revents & (POLLERR | POLLHUP)) {
+            int hup = poller[i].revents & POLLHUP;
+            if (iter->state == MONGOC_ASYNC_CMD_SEND) {
+               bson_set_error (&iter->error,
+                               MONGOC_ERROR_STREAM,
+                               MONGOC_ERROR_STREAM_CONNECT,
+                               hup ? "connection refused"
+                                   : "unknown connection error");
+            } else {
+               bson_set_error (&iter->error,
+                               MONGOC_ERROR_STREAM,
+                               MONGOC_ERROR_STREAM_SOCKET,
+                               hup ? "connection closed"
+                                   : "unknown socket error");
             }
-         }
-      }
 
-      DL_FOREACH_SAFE (async->cmds, acmd, tmp)
-      {
-         bool remove_cmd = false;
-         mongoc_async_cmd_result_t result;
-
-         /* check if an initiated cmd has passed the connection timeout.  */
-         if (acmd->state != MONGOC_ASYNC_CMD_INITIATE &&
-             now > acmd->connect_started + acmd->timeout_msec * 1000) {
-            bson_set_error (&acmd->error,
-                            MONGOC_ERROR_STREAM,
-                            MONGOC_ERROR_STREAM_CONNECT,
-                            acmd->state == MONGOC_ASYNC_CMD_SEND
-                               ? "connection timeout"
-                               : "socket timeout");
-
-            remove_cmd = true;
-            result = MONGOC_ASYNC_CMD_TIMEOUT;
-         } else if (acmd->state == MONGOC_ASYNC_CMD_CANCELED_STATE) {
-            remove_cmd = true;
-            result = MONGOC_ASYNC_CMD_ERROR;
+            iter->state = MONGOC_ASYNC_CMD_ERROR_STATE;
          }
 
-         if (remove_cmd) {
-            acmd->cb (acmd, result, NULL, (now - acmd->connect_started) / 1000);
+         if ((poller[i].revents & poller[i].events) ||
+             iter->state == MONGOC_ASYNC_CMD_ERROR_STATE) {
+            (void) mongoc_async_cmd_run (iter);
+            nactive--;
+         }
 
-            /* Remove acmd from the async->cmds doubly-linked list */
-            mongoc_async_cmd_destroy (acmd);
+         if (!nactive) {
+            break;
          }
       }
+   }
+
+   /* commands may have been destroyed, the poller is stale now */
+   async->npolled = 0;
+
+   DL_FOREACH_SAFE (async->cmds, acmd, tmp)
+   {
+      bool remove_cmd = false;
+      mongoc_async_cmd_result_t result;
+
+      /* check if an initiated cmd has passed the connection timeout.  */
+      if (acmd->state != MONGOC_ASYNC_CMD_INITIATE &&
+          now > acmd->connect_started + acmd->timeout_msec * 1000) {
+         bson_set_error (&acmd->error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_CONNECT,
+                         acmd->state == MONGOC_ASYNC_CMD_SEND
+                            ? "connection timeout"
+                            : "socket timeout");
+
+         remove_cmd = true;
+         result = MONGOC_ASYNC_CMD_TIMEOUT;
+      } else if (acmd->state == MONGOC_ASYNC_CMD_CANCELED_STATE) {
+         remove_cmd = true;
+         result = MONGOC_ASYNC_CMD_ERROR;
+      }
 
-      now = bson_get_monotonic_time ();
+      if (remove_cmd) {
+         acmd->cb (acmd, result, NULL, (now - acmd->connect_started) / 1000);
+
+         /* Remove acmd from the async->cmds doubly-linked list */
+         mongoc_async_cmd_destroy (acmd);
+      }
    }
+}
+
 
-   bson_free (poller);
-   bson_free (acmds_polled);
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_async_step --
+ *
+ *       Run one iteration of the event loop, waiting at most
+ *       @max_wait_msec for I/O. Lets a caller interleave many commands
+ *       with its own work instead of blocking in mongoc_async_run.
+ *
+ * Returns:
+ *       The number of commands still in progress.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+size_t
+mongoc_async_step (mongoc_async_t *async, int64_t max_wait_msec)
+{
+   size_t nstreams;
+   ssize_t nactive = 0;
+   int64_t poll_timeout_msec;
+
+   nstreams = mongoc_async_prepare (async, &poll_timeout_msec);
+   if (async->ncmds == 0) {
+      /* all cmds failed to initiate and removed themselves. */
+      return 0;
+   }
+
+   poll_timeout_msec = BSON_MIN (poll_timeout_msec, max_wait_msec);
+   BSON_ASSERT (poll_timeout_msec < INT32_MAX);
+
+   if (nstreams > 0) {
+      /* we need at least one stream to poll. */
+      nactive = mongoc_stream_poll (
+         async->poller, nstreams, (int32_t) poll_timeout_msec);
+   } else {
+      /* currently this does not get hit. we always have at least one command
+       * initialized with a stream. */
+      _mongoc_usleep (poll_timeout_msec * 1000);
+   }
+
+   mongoc_async_dispatch (async, nactive);
+
+   return async->ncmds;
+}
+
+
+void
+mongoc_async_run (mongoc_async_t *async)
+{
+   mongoc_async_cmd_t *acmd;
+   int64_t now;
+
+   now = bson_get_monotonic_time ();
+
+   /* CDRIVER-1571 reset start times in case a stream initiator was slow */
+   DL_FOREACH (async->cmds, acmd)
+   {
+      acmd->connect_started = now;
+   }
+
+   while (async->ncmds) {
+      (void) mongoc_async_step (async, INT32_MAX - 1);
+   }
 }
@@ -707,7 +707,9 @@ mongoc_bulk_operation_execute (mongoc_bulk_operation_t *bulk, /* IN */
 {
    mongoc_cluster_t *cluster;
    mongoc_write_command_t *command;
-   mongoc_server_stream_t *server_stream;
+   mongoc_server_stream_t *server_stream = NULL;
+   bool unacknowledged;
+   bson_error_t flush_error;
    bool ret;
    uint32_t offset = 0;
    int i;
@@ -767,23 +769,34 @@ mongoc_bulk_operation_execute (mongoc_bulk_operation_t *bulk, /* IN */
       GOTO (err);
    }
 
-   for (i = 0; i < bulk->commands.len; i++) {
-      if (bulk->server_id) {
-         server_stream =
-            mongoc_cluster_stream_for_server (cluster,
-                                              bulk->server_id,
-                                              true /* reconnect_ok */,
-                                              bulk->session,
-                                              reply,
-                                              error);
-      } else {
-         server_stream = mongoc_cluster_stream_for_writes (
-            cluster, bulk->session, reply, error);
-      }
+   /* unacknowledged writes are sent on one stream, so the commands can be
+    * coalesced into as few socket writes as possible */
+   unacknowledged = !mongoc_write_concern_is_acknowledged (bulk->write_concern);
 
+   for (i = 0; i < bulk->commands.len; i++) {
       if (!server_stream) {
-         /* stream_for_server and stream_for_writes initialize reply on error */
-         RETURN (false);
+         if (bulk->server_id) {
+            server_stream =
+               mongoc_cluster_stream_for_server (cluster,
+                                                 bulk->server_id,
+                                                 true /* reconnect_ok */,
+                                                 bulk->session,
+                                                 reply,
+                                                 error);
+         } else {
+            server_stream = mongoc_cluster_stream_for_writes (
+               cluster, bulk->session, reply, error);
+         }
+
+         if (!server_stream) {
+            /* stream_for_server and stream_for_writes initialize reply on
+             * error */
+            RETURN (false);
+         }
+
+         if (unacknowledged) {
+            mongoc_cluster_begin_unacknowledged_batch (cluster, server_stream);
+         }
       }
 
       command =
@@ -806,17 +819,41 @@ mongoc_bulk_operation_execute (mongoc_bulk_operation_t *bulk, /* IN */
          bulk->server_id = bulk->result.retry_server_id;
       }
 
+      if (unacknowledged && !bulk->flags.ordered && bulk->result.must_stop &&
+          !mongoc_cluster_stream_valid (cluster, server_stream)) {
+         /* the connection failed while writing the batch: select a new
+          * stream and batch for the remaining commands */
+         mongoc_cluster_end_unacknowledged_batch (cluster, &flush_error);
+         mongoc_server_stream_cleanup (server_stream);
+         server_stream = NULL;
+         bulk->result.must_stop = false;
+      }
+
       if (bulk->result.failed &&
           (bulk->flags.ordered || bulk->result.must_stop)) {
-         mongoc_server_stream_cleanup (server_stream);
          GOTO (cleanup);
       }
 
       offset += command->n_documents;
-      mongoc_server_stream_cleanup (server_stream);
+
+      if (!unacknowledged) {
+         mongoc_server_stream_cleanup (server_stream);
+         server_stream = NULL;
+      }
    }
 
 cleanup:
+   if (server_stream) {
+      if (unacknowledged &&
+          !mongoc_cluster_end_unacknowledged_batch (cluster, &flush_error) &&
+          !bulk->result.failed) {
+         bulk->result.failed = true;
+         memcpy (&bulk->result.error, &flush_error, sizeof (bson_error_t));
+      }
+
+      mongoc_server_stream_cleanup (server_stream);
+   }
+
    _mongoc_bson_init_if_set (reply);
    ret = MONGOC_WRITE_RESULT_COMPLETE (&bulk->result,
                                        bulk->client->error_api_version,
@@ -32,15 +32,45 @@
 #include "mongoc-ssl-private.h"
 #endif
 
-struct _mongoc_client_pool_t {
+/* Idle clients are spread over several independently locked free lists so
+ * that threads popping and pushing clients do not all contend on one mutex.
+ * Each thread has a home shard, chosen by hashing its thread id: it pushes
+ * clients there and pops from there first, so a thread that repeatedly pops
+ * and pushes usually gets back the client it used last. */
+#define MONGOC_CLIENT_POOL_SHARD_BITS 4
+#define MONGOC_CLIENT_POOL_SHARDS (1 << MONGOC_CLIENT_POOL_SHARD_BITS)
+
+/* the shortest time pool maintenance sleeps between passes */
+#define MONGOC_POOL_MAINTENANCE_MIN_MS 100
+
+typedef struct {
    bson_mutex_t mutex;
-   mongoc_cond_t cond;
    mongoc_queue_t queue;
+} mongoc_client_pool_shard_t;
+
+/* A thread blocked in mongoc_client_pool_pop. Waiters are queued in arrival
+ * order and pushed clients are handed directly to the oldest one. */
+typedef struct _mongoc_client_pool_waiter_t {
+   mongoc_cond_t cond;
+   mongoc_client_t *client;
+   struct _mongoc_client_pool_waiter_t *next;
+} mongoc_client_pool_waiter_t;
+
+struct _mongoc_client_pool_t {
+   bson_mutex_t mutex;
+   mongoc_client_pool_shard_t shards[MONGOC_CLIENT_POOL_SHARDS];
+   volatile int32_t n_idle;
+   /* waiters are protected by mutex, n_waiters is read without it. */
+   mongoc_client_pool_waiter_t *waiters_head;
+   mongoc_client_pool_waiter_t *waiters_tail;
+   volatile int32_t n_waiters;
    mongoc_topology_t *topology;
    mongoc_uri_t *uri;
    uint32_t min_pool_size;
    uint32_t max_pool_size;
    uint32_t size;
+   /* close connections idle longer than this, or 0 */
+   int32_t max_idle_time_ms;
 #ifdef MONGOC_ENABLE_SSL
    bool ssl_opts_set;
    mongoc_ssl_opt_t ssl_opts;
@@ -50,6 +80,12 @@ struct _mongoc_client_pool_t {
    void *apm_context;
    int32_t error_api_version;
    bool error_api_set;
+   /* keeps minPoolSize idle connections open to each selectable server, and
+    * closes those idle longer than maxIdleTimeMS */
+   bson_thread_t maintenance_thread;
+   bool maintenance_started;
+   /* protected by the topology mutex */
+   bool maintenance_shutdown;
 };
 
 
@@ -68,6 +104,8 @@ mongoc_client_pool_set_ssl_opts (mongoc_client_pool_t *pool,
    if (opts) {
       _mongoc_ssl_opts_copy_to (
          opts, &pool->ssl_opts, false /* don't overwrite internal opts. */);
+      _mongoc_ssl_opts_share_ctx (
+         &pool->ssl_opts, &pool->ssl_opts, true /* client */);
       pool->ssl_opts_set = true;
    }
 
@@ -86,9 +124,9 @@ _mongoc_client_pool_set_internal_tls_opts (
       bson_mutex_unlock (&pool->mutex);
       return;
    }
-   pool->ssl_opts.internal = bson_malloc (sizeof (_mongoc_internal_tls_opts_t));
-   memcpy (
-      pool->ssl_opts.internal, internal, sizeof (_mongoc_internal_tls_opts_t));
+   _mongoc_ssl_opts_set_internal (&pool->ssl_opts, internal);
+   _mongoc_ssl_opts_share_ctx (
+      &pool->ssl_opts, &pool->ssl_opts, true /* client */);
    bson_mutex_unlock (&pool->mutex);
 }
 #endif
@@ -102,6 +140,7 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
    const bson_t *b;
    bson_iter_t iter;
    const char *appname;
+   int i;
 
 
    ENTRY;
@@ -118,8 +157,10 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
 
    pool = (mongoc_client_pool_t *) bson_malloc0 (sizeof *pool);
    bson_mutex_init (&pool->mutex);
-   mongoc_cond_init (&pool->cond);
-   _mongoc_queue_init (&pool->queue);
+   for (i = 0; i < MONGOC_CLIENT_POOL_SHARDS; i++) {
+      bson_mutex_init (&pool->shards[i].mutex);
+      _mongoc_queue_init (&pool->shards[i].queue);
+   }
    pool->uri = mongoc_uri_copy (uri);
    pool->min_pool_size = 0;
    pool->max_pool_size = 100;
@@ -148,6 +189,9 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
       }
    }
 
+   pool->max_idle_time_ms = BSON_MAX (
+      0, mongoc_uri_get_option_as_int32 (uri, MONGOC_URI_MAXIDLETIMEMS, 0));
+
    appname =
       mongoc_uri_get_option_as_utf8 (pool->uri, MONGOC_URI_APPNAME, NULL);
    if (appname) {
@@ -176,6 +220,7 @@ void
 mongoc_client_pool_destroy (mongoc_client_pool_t *pool)
 {
    mongoc_client_t *client;
+   int i;
 
    ENTRY;
 
@@ -183,22 +228,36 @@ mongoc_client_pool_destroy (mongoc_client_pool_t *pool)
       EXIT;
    }
 
-   if (pool->topology->session_pool) {
+   if (!_mongoc_server_session_pool_is_empty (
+          &pool->topology->session_pool)) {
       client = mongoc_client_pool_pop (pool);
       _mongoc_client_end_sessions (client);
       mongoc_client_pool_push (pool, client);
    }
 
-   while (
-      (client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
-      mongoc_client_destroy (client);
+   BSON_ASSERT (!pool->waiters_head);
+
+   if (pool->maintenance_started) {
+      bson_mutex_lock (&pool->topology->mutex);
+      pool->maintenance_shutdown = true;
+      mongoc_cond_broadcast (&pool->topology->cond_client);
+      bson_mutex_unlock (&pool->topology->mutex);
+      COMMON_PREFIX (thread_join) (pool->maintenance_thread);
+   }
+
+   for (i = 0; i < MONGOC_CLIENT_POOL_SHARDS; i++) {
+      while ((client = (mongoc_client_t *) _mongoc_queue_pop_head (
+                 &pool->shards[i].queue))) {
+         mongoc_client_destroy (client);
+      }
+
+      bson_mutex_destroy (&pool->shards[i].mutex);
    }
 
    mongoc_topology_destroy (pool->topology);
 
    mongoc_uri_destroy (pool->uri);
    bson_mutex_destroy (&pool->mutex);
-   mongoc_cond_destroy (&pool->cond);
 
 #ifdef MONGOC_ENABLE_SSL
    _mongoc_ssl_opts_cleanup (&pool->ssl_opts, true);
@@ -243,60 +302,480 @@ _initialize_new_client (mongoc_client_pool_t *pool, mongoc_client_t *client)
 
 #ifdef MONGOC_ENABLE_SSL
    if (pool->ssl_opts_set) {
-      mongoc_client_set_ssl_opts (client, &pool->ssl_opts);
+      _mongoc_client_set_ssl_opts_from_pool (client, &pool->ssl_opts);
    }
 #endif
 }
 
+/*
+ * Collect the ids of servers that operations may be sent to.
+ *
+ * This function assumes the topology's mutex is locked
+ */
+static void
+_mongoc_client_pool_selectable_servers (mongoc_client_pool_t *pool,
+                                        mongoc_array_t *server_ids)
+{
+   mongoc_set_t *servers = pool->topology->description.servers;
+   mongoc_server_description_t *sd;
+   size_t i;
+
+   server_ids->len = 0;
+
+   for (i = 0; i < servers->items_len; i++) {
+      sd = (mongoc_server_description_t *) mongoc_set_get_item (servers, i);
+      switch (sd->type) {
+      case MONGOC_SERVER_STANDALONE:
+      case MONGOC_SERVER_MONGOS:
+      case MONGOC_SERVER_RS_PRIMARY:
+      case MONGOC_SERVER_RS_SECONDARY:
+         _mongoc_array_append_val (server_ids, sd->id);
+         break;
+      case MONGOC_SERVER_UNKNOWN:
+      case MONGOC_SERVER_POSSIBLE_PRIMARY:
+      case MONGOC_SERVER_RS_ARBITER:
+      case MONGOC_SERVER_RS_OTHER:
+      case MONGOC_SERVER_RS_GHOST:
+      case MONGOC_SERVER_DESCRIPTION_TYPES:
+      default:
+         break;
+      }
+   }
+}
+
+/*
+ * Set @server_ids to the ids of all servers in the topology description.
+ *
+ * This function assumes the topology's mutex is locked
+ */
+static void
+_mongoc_client_pool_known_servers (mongoc_client_pool_t *pool,
+                                   mongoc_array_t *server_ids)
+{
+   mongoc_set_t *servers = pool->topology->description.servers;
+   uint32_t id;
+   size_t i;
+
+   server_ids->len = 0;
+
+   for (i = 0; i < servers->items_len; i++) {
+      mongoc_set_get_item_and_id (servers, (int) i, &id);
+      _mongoc_array_append_val (server_ids, id);
+   }
+}
+
+/*
+ * True once every server has been checked at least once.
+ *
+ * This function assumes the topology's mutex is locked
+ */
+static bool
+_mongoc_client_pool_servers_checked (mongoc_client_pool_t *pool)
+{
+   mongoc_set_t *servers = pool->topology->description.servers;
+   mongoc_server_description_t *sd;
+   size_t i;
+
+   for (i = 0; i < servers->items_len; i++) {
+      sd = (mongoc_server_description_t *) mongoc_set_get_item (servers, i);
+      if (sd->type == MONGOC_SERVER_UNKNOWN && !sd->error.code) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/* Open connections until each server in @server_ids has @n_idle idle. */
+static bool
+_mongoc_client_pool_warm_servers (mongoc_client_t *client,
+                                  const mongoc_array_t *server_ids,
+                                  size_t n_idle,
+                                  bson_error_t *error)
+{
+   bool ret = true;
+   size_t i;
+
+   for (i = 0; i < server_ids->len; i++) {
+      if (!mongoc_cluster_warm_up_server (
+             &client->cluster,
+             _mongoc_array_index (server_ids, uint32_t, i),
+             n_idle,
+             error)) {
+         /* keep warming the other servers */
+         ret = false;
+      }
+   }
+
+   return ret;
+}
+
+/* A client that is not handed out, for opening connections in the
+ * background. It is not counted toward maxPoolSize. */
+static mongoc_client_t *
+_mongoc_client_pool_internal_client (mongoc_client_pool_t *pool)
+{
+   mongoc_client_t *client;
+
+   bson_mutex_lock (&pool->mutex);
+   client = _mongoc_client_new_from_uri (pool->topology);
+   _initialize_new_client (pool, client);
+   bson_mutex_unlock (&pool->mutex);
+
+   return client;
+}
+
+/*
+ * Background pool maintenance: whenever the topology changes, for instance
+ * when a server becomes selectable after startup or a failover, or when its
+ * pool is cleared, reopen connections until each selectable server has
+ * minPoolSize idle connections. Application threads then find connections
+ * ready instead of all handshaking and authenticating at once.
+ *
+ * With maxIdleTimeMS, also close connections that have been idle too long,
+ * before a load balancer or firewall silently drops them and the next
+ * operation on them times out. Warming up then replaces those among the
+ * minPoolSize, so the connections kept warm are always fresh enough to use.
+ *
+ * Each pass also destroys server sessions that timed out in the session pool
+ * and replenishes the "prewarmedSessions", off the application threads'
+ * path, and closes idle connections to servers removed from the topology.
+ * Sockets are closed after unlocking the topology mutex, since closing a TLS
+ * connection may block.
+ */
+static BSON_THREAD_FUN (_mongoc_client_pool_maintain, pool_void)
+{
+   mongoc_client_pool_t *pool = (mongoc_client_pool_t *) pool_void;
+   mongoc_topology_t *topology = pool->topology;
+   mongoc_client_t *client;
+   mongoc_array_t server_ids;
+   mongoc_array_t known_ids;
+   bson_error_t error;
+   int64_t interval_ms;
+
+   client = _mongoc_client_pool_internal_client (pool);
+   _mongoc_array_init (&server_ids, sizeof (uint32_t));
+   _mongoc_array_init (&known_ids, sizeof (uint32_t));
+
+   bson_mutex_lock (&topology->mutex);
+   while (!pool->maintenance_shutdown) {
+      _mongoc_client_pool_selectable_servers (pool, &server_ids);
+      _mongoc_client_pool_known_servers (pool, &known_ids);
+      bson_mutex_unlock (&topology->mutex);
+
+      mongoc_connection_pool_purge_removed (topology->connection_pool,
+                                            (uint32_t *) known_ids.data,
+                                            known_ids.len);
+
+      if (pool->max_idle_time_ms) {
+         mongoc_connection_pool_reap (topology->connection_pool,
+                                      pool->max_idle_time_ms * 1000);
+      }
+
+      _mongoc_topology_prune_server_sessions (topology);
+
+      if (pool->min_pool_size &&
+          !_mongoc_client_pool_warm_servers (
+             client, &server_ids, pool->min_pool_size, &error)) {
+         MONGOC_DEBUG ("could not open connection for pool: %s",
+                       error.message);
+      }
+
+      bson_mutex_lock (&topology->mutex);
+      if (pool->maintenance_shutdown) {
+         break;
+      }
+
+      /* woken by each server check */
+      interval_ms = topology->description.heartbeat_msec;
+      if (pool->max_idle_time_ms) {
+         interval_ms = BSON_MIN (interval_ms, pool->max_idle_time_ms);
+      }
+
+      /* don't spin if maxIdleTimeMS is tiny */
+      interval_ms = BSON_MAX (interval_ms, MONGOC_POOL_MAINTENANCE_MIN_MS);
+
+      mongoc_cond_timedwait (
+         &topology->cond_client, &topology->mutex, interval_ms);
+   }
+   bson_mutex_unlock (&topology->mutex);
+
+   _mongoc_array_destroy (&known_ids);
+   _mongoc_array_destroy (&server_ids);
+   mongoc_client_destroy (client);
+
+   BSON_THREAD_RETURN;
+}
+
+/*
+ * Start background pool maintenance if it is not running.
+ *
+ * This function assumes the pool's mutex is locked
+ */
+static void
+_start_maintenance_if_needed (mongoc_client_pool_t *pool)
+{
+   if (pool->maintenance_started) {
+      return;
+   }
+
+   if (COMMON_PREFIX (thread_create) (
+          &pool->maintenance_thread, _mongoc_client_pool_maintain, pool)) {
+      MONGOC_ERROR ("Failed to start pool maintenance thread");
+      return;
+   }
+
+   pool->maintenance_started = true;
+}
+
+/*
+ * Create a new client if the pool is below its max size, or return NULL.
+ *
+ * Monitoring only needs starting once, before the first client is handed
+ * out, so clients recycled through the free lists skip the topology mutex.
+ *
+ * This function assumes the pool's mutex is locked
+ */
+static mongoc_client_t *
+_mongoc_client_pool_new_client (mongoc_client_pool_t *pool)
+{
+   mongoc_client_t *client;
+
+   if (pool->size >= pool->max_pool_size) {
+      return NULL;
+   }
+
+   client = _mongoc_client_new_from_uri (pool->topology);
+   _initialize_new_client (pool, client);
+   pool->size++;
+   _start_scanner_if_needed (pool);
+   _start_maintenance_if_needed (pool);
+
+   return client;
+}
+
+/* Map the calling thread to its home shard. */
+static int
+_mongoc_client_pool_home_shard (void)
+{
+   return _mongoc_thread_home_shard (MONGOC_CLIENT_POOL_SHARD_BITS);
+}
+
+static mongoc_client_t *
+_mongoc_client_pool_shard_pop (mongoc_client_pool_t *pool, int i)
+{
+   mongoc_client_pool_shard_t *shard = &pool->shards[i];
+   mongoc_client_t *client;
+
+   bson_mutex_lock (&shard->mutex);
+   client = (mongoc_client_t *) _mongoc_queue_pop_head (&shard->queue);
+   if (client) {
+      bson_atomic_int_add (&pool->n_idle, -1);
+   }
+   bson_mutex_unlock (&shard->mutex);
+
+   return client;
+}
+
+/* Take an idle client, trying the home shard first and then stealing from
+ * the others. */
+static mongoc_client_t *
+_mongoc_client_pool_take_idle (mongoc_client_pool_t *pool, int home)
+{
+   mongoc_client_t *client;
+   int i;
+
+   for (i = 0; i < MONGOC_CLIENT_POOL_SHARDS; i++) {
+      client = _mongoc_client_pool_shard_pop (
+         pool, (home + i) % MONGOC_CLIENT_POOL_SHARDS);
+      if (client) {
+         return client;
+      }
+   }
+
+   return NULL;
+}
+
+/* Remove and return the least recently pushed client of the home shard, or
+ * of the first non-empty shard after it. */
+static mongoc_client_t *
+_mongoc_client_pool_take_oldest (mongoc_client_pool_t *pool, int home)
+{
+   mongoc_client_pool_shard_t *shard;
+   mongoc_client_t *client;
+   int i;
+
+   for (i = 0; i < MONGOC_CLIENT_POOL_SHARDS; i++) {
+      shard = &pool->shards[(home + i) % MONGOC_CLIENT_POOL_SHARDS];
+      bson_mutex_lock (&shard->mutex);
+      client = (mongoc_client_t *) _mongoc_queue_pop_tail (&shard->queue);
+      if (client) {
+         bson_atomic_int_add (&pool->n_idle, -1);
+      }
+      bson_mutex_unlock (&shard->mutex);
+
+      if (client) {
+         return client;
+      }
+   }
+
+   return NULL;
+}
+
+/*
+ * Return the oldest waiter that has not been handed a client yet, or NULL.
+ *
+ * This function assumes the pool's mutex is locked
+ */
+static mongoc_client_pool_waiter_t *
+_mongoc_client_pool_next_waiter (mongoc_client_pool_t *pool)
+{
+   mongoc_client_pool_waiter_t *waiter;
+
+   for (waiter = pool->waiters_head; waiter; waiter = waiter->next) {
+      if (!waiter->client) {
+         return waiter;
+      }
+   }
+
+   return NULL;
+}
+
+static void
+_mongoc_client_pool_remove_waiter (mongoc_client_pool_t *pool,
+                                   mongoc_client_pool_waiter_t *waiter)
+{
+   mongoc_client_pool_waiter_t *prev = NULL;
+   mongoc_client_pool_waiter_t *iter;
+
+   for (iter = pool->waiters_head; iter; prev = iter, iter = iter->next) {
+      if (iter == waiter) {
+         if (prev) {
+            prev->next = waiter->next;
+         } else {
+            pool->waiters_head = waiter->next;
+         }
+
+         if (pool->waiters_tail == waiter) {
+            pool->waiters_tail = prev;
+         }
+
+         break;
+      }
+   }
+
+   bson_atomic_int_add (&pool->n_waiters, -1);
+}
+
+/*
+ * Block until a client is pushed, or the pool has room for a new client, or
+ * expire_at_ms passes. Pass -1 to wait indefinitely.
+ */
+static mongoc_client_t *
+_mongoc_client_pool_wait (mongoc_client_pool_t *pool,
+                          int home,
+                          int64_t expire_at_ms)
+{
+   mongoc_client_pool_waiter_t waiter = {0};
+   int64_t now_ms;
+
+   mongoc_cond_init (&waiter.cond);
+
+   bson_mutex_lock (&pool->mutex);
+
+   if (pool->waiters_tail) {
+      pool->waiters_tail->next = &waiter;
+   } else {
+      pool->waiters_head = &waiter;
+   }
+   pool->waiters_tail = &waiter;
+
+   /* a full barrier: after this, any thread pushing a client either sees
+    * n_waiters > 0 and hands the client to a waiter, or pushed it before we
+    * scan the shards below */
+   bson_atomic_int_add (&pool->n_waiters, 1);
+
+   while (!waiter.client) {
+      waiter.client = _mongoc_client_pool_take_idle (pool, home);
+      if (waiter.client) {
+         break;
+      }
+
+      waiter.client = _mongoc_client_pool_new_client (pool);
+      if (waiter.client) {
+         break;
+      }
+
+      if (expire_at_ms < 0) {
+         mongoc_cond_wait (&waiter.cond, &pool->mutex);
+         continue;
+      }
+
+      now_ms = bson_get_monotonic_time () / 1000;
+      if (now_ms >= expire_at_ms) {
+         break;
+      }
+
+      mongoc_cond_timedwait (
+         &waiter.cond, &pool->mutex, expire_at_ms - now_ms);
+   }
+
+   _mongoc_client_pool_remove_waiter (pool, &waiter);
+   bson_mutex_unlock (&pool->mutex);
+
+   mongoc_cond_destroy (&waiter.cond);
+
+   return waiter.client;
+}
+
+/*
+ * Give the oldest waiter a client. Returns false if no thread is waiting.
+ *
+ * This function assumes the pool's mutex is locked
+ */
+static bool
+_mongoc_client_pool_hand_off (mongoc_client_pool_t *pool,
+                              mongoc_client_t *client)
+{
+   mongoc_client_pool_waiter_t *waiter;
+
+   waiter = _mongoc_client_pool_next_waiter (pool);
+   if (!waiter) {
+      return false;
+   }
+
+   waiter->client = client;
+   mongoc_cond_signal (&waiter->cond);
+
+   return true;
+}
+
 mongoc_client_t *
 mongoc_client_pool_pop (mongoc_client_pool_t *pool)
 {
    mongoc_client_t *client;
    int32_t wait_queue_timeout_ms;
    int64_t expire_at_ms = -1;
-   int64_t now_ms;
-   int r;
+   int home;
 
    ENTRY;
 
    BSON_ASSERT (pool);
 
+   home = _mongoc_client_pool_home_shard ();
+   client = _mongoc_client_pool_take_idle (pool, home);
+   if (client) {
+      RETURN (client);
+   }
+
    wait_queue_timeout_ms = mongoc_uri_get_option_as_int32 (
       pool->uri, MONGOC_URI_WAITQUEUETIMEOUTMS, -1);
    if (wait_queue_timeout_ms > 0) {
       expire_at_ms =
          (bson_get_monotonic_time () / 1000) + wait_queue_timeout_ms;
    }
-   bson_mutex_lock (&pool->mutex);
-
-again:
-   if (!(client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
-      if (pool->size < pool->max_pool_size) {
-         client = _mongoc_client_new_from_uri (pool->topology);
-         _initialize_new_client (pool, client);
-         pool->size++;
-      } else {
-         if (wait_queue_timeout_ms > 0) {
-            now_ms = bson_get_monotonic_time () / 1000;
-            if (now_ms < expire_at_ms) {
-               r = mongoc_cond_timedwait (
-                  &pool->cond, &pool->mutex, expire_at_ms - now_ms);
-               if (mongo_cond_ret_is_timedout (r)) {
-                  GOTO (done);
-               }
-            } else {
-               GOTO (done);
-            }
-         } else {
-            mongoc_cond_wait (&pool->cond, &pool->mutex);
-         }
-         GOTO (again);
-      }
-   }
 
-   _start_scanner_if_needed (pool);
-done:
-   bson_mutex_unlock (&pool->mutex);
+   client = _mongoc_client_pool_wait (pool, home, expire_at_ms);
 
    RETURN (client);
 }
@@ -311,21 +790,15 @@ mongoc_client_pool_try_pop (mongoc_client_pool_t *pool)
 
    BSON_ASSERT (pool);
 
-   bson_mutex_lock (&pool->mutex);
+   client =
+      _mongoc_client_pool_take_idle (pool, _mongoc_client_pool_home_shard ());
 
-   if (!(client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
-      if (pool->size < pool->max_pool_size) {
-         client = _mongoc_client_new_from_uri (pool->topology);
-         _initialize_new_client (pool, client);
-         pool->size++;
-      }
+   if (!client) {
+      bson_mutex_lock (&pool->mutex);
+      client = _mongoc_client_pool_new_client (pool);
+      bson_mutex_unlock (&pool->mutex);
    }
 
-   if (client) {
-      _start_scanner_if_needed (pool);
-   }
-   bson_mutex_unlock (&pool->mutex);
-
    RETURN (client);
 }
 
@@ -333,30 +806,130 @@ mongoc_client_pool_try_pop (mongoc_client_pool_t *pool)
 void
 mongoc_client_pool_push (mongoc_client_pool_t *pool, mongoc_client_t *client)
 {
+   mongoc_client_pool_shard_t *shard;
+   mongoc_client_t *old_client;
+   uint32_t min_pool_size;
+   int home;
+
    ENTRY;
 
    BSON_ASSERT (pool);
    BSON_ASSERT (client);
 
-   bson_mutex_lock (&pool->mutex);
-   _mongoc_queue_push_head (&pool->queue, client);
+   if (pool->n_waiters > 0) {
+      bool handed_off;
+
+      bson_mutex_lock (&pool->mutex);
+      handed_off = _mongoc_client_pool_hand_off (pool, client);
+      bson_mutex_unlock (&pool->mutex);
+
+      if (handed_off) {
+         EXIT;
+      }
+   }
 
-   if (pool->min_pool_size &&
-       _mongoc_queue_get_length (&pool->queue) > pool->min_pool_size) {
-      mongoc_client_t *old_client;
-      old_client = (mongoc_client_t *) _mongoc_queue_pop_tail (&pool->queue);
+   home = _mongoc_client_pool_home_shard ();
+   shard = &pool->shards[home];
+
+   bson_mutex_lock (&shard->mutex);
+   _mongoc_queue_push_head (&shard->queue, client);
+   bson_mutex_unlock (&shard->mutex);
+
+   bson_atomic_int_add (&pool->n_idle, 1);
+
+   min_pool_size = pool->min_pool_size;
+   if (min_pool_size && (uint32_t) pool->n_idle > min_pool_size) {
+      old_client = _mongoc_client_pool_take_oldest (pool, home);
       if (old_client) {
          mongoc_client_destroy (old_client);
+         bson_mutex_lock (&pool->mutex);
          pool->size--;
+         bson_mutex_unlock (&pool->mutex);
       }
    }
 
-   mongoc_cond_signal (&pool->cond);
-   bson_mutex_unlock (&pool->mutex);
+   /* a thread may have started waiting after we checked n_waiters above,
+    * but before we pushed; it scans the shards after announcing itself, so
+    * re-check now that our client is visible and hand idle clients over */
+   bson_memory_barrier ();
+   if (pool->n_waiters > 0) {
+      bson_mutex_lock (&pool->mutex);
+      while (_mongoc_client_pool_next_waiter (pool)) {
+         client = _mongoc_client_pool_take_idle (pool, home);
+         if (!client) {
+            break;
+         }
+
+         _mongoc_client_pool_hand_off (pool, client);
+      }
+      bson_mutex_unlock (&pool->mutex);
+   }
 
    EXIT;
 }
 
+bool
+mongoc_client_pool_warm_up (mongoc_client_pool_t *pool,
+                            int64_t timeout_msec,
+                            bson_error_t *error)
+{
+   mongoc_topology_t *topology;
+   mongoc_client_t *client;
+   mongoc_array_t server_ids;
+   int64_t expire_at_ms;
+   int64_t now_ms;
+   bool ret = false;
+
+   ENTRY;
+
+   BSON_ASSERT (pool);
+
+   topology = pool->topology;
+   expire_at_ms = bson_get_monotonic_time () / 1000 + timeout_msec;
+
+   bson_mutex_lock (&pool->mutex);
+   _start_scanner_if_needed (pool);
+   _start_maintenance_if_needed (pool);
+   bson_mutex_unlock (&pool->mutex);
+
+   _mongoc_array_init (&server_ids, sizeof (uint32_t));
+
+   /* wait for monitoring to check every server */
+   bson_mutex_lock (&topology->mutex);
+   while (!_mongoc_client_pool_servers_checked (pool)) {
+      now_ms = bson_get_monotonic_time () / 1000;
+      if (now_ms >= expire_at_ms) {
+         break;
+      }
+
+      mongoc_cond_timedwait (
+         &topology->cond_client, &topology->mutex, expire_at_ms - now_ms);
+   }
+
+   _mongoc_client_pool_selectable_servers (pool, &server_ids);
+   bson_mutex_unlock (&topology->mutex);
+
+   if (!server_ids.len) {
+      bson_set_error (error,
+                      MONGOC_ERROR_SERVER_SELECTION,
+                      MONGOC_ERROR_SERVER_SELECTION_FAILURE,
+                      "No suitable servers found to warm up within %" PRId64
+                      " ms",
+                      timeout_msec);
+      GOTO (done);
+   }
+
+   client = _mongoc_client_pool_internal_client (pool);
+   ret = _mongoc_client_pool_warm_servers (
+      client, &server_ids, BSON_MAX (pool->min_pool_size, 1), error);
+   mongoc_client_destroy (client);
+
+done:
+   _mongoc_array_destroy (&server_ids);
+
+   RETURN (ret);
+}
+
 /* for tests */
 void
 _mongoc_client_pool_set_stream_initiator (mongoc_client_pool_t *pool,
@@ -390,9 +963,7 @@ mongoc_client_pool_num_pushed (mongoc_client_pool_t *pool)
 
    ENTRY;
 
-   bson_mutex_lock (&pool->mutex);
-   num_pushed = pool->queue.length;
-   bson_mutex_unlock (&pool->mutex);
+   num_pushed = (size_t) bson_atomic_int_add (&pool->n_idle, 0);
 
    RETURN (num_pushed);
 }
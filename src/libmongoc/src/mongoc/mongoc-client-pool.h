@@ -68,6 +68,10 @@ MONGOC_EXPORT (bool)
 mongoc_client_pool_set_appname (mongoc_client_pool_t *pool,
                                 const char *appname);
 MONGOC_EXPORT (bool)
+mongoc_client_pool_warm_up (mongoc_client_pool_t *pool,
+                            int64_t timeout_msec,
+                            bson_error_t *error);
+MONGOC_EXPORT (bool)
 mongoc_client_pool_enable_auto_encryption (mongoc_client_pool_t *pool,
                                            mongoc_auto_encryption_opts_t *opts,
                                            bson_error_t *error);
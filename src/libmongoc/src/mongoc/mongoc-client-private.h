@@ -97,6 +97,8 @@ struct _mongoc_client_t {
    mongoc_uri_t *uri;
    mongoc_cluster_t cluster;
    bool in_exhaust;
+   /* a cursor whose prefetched getMore reply is still unread */
+   mongoc_cursor_t *prefetching;
 
    mongoc_stream_initiator_t initiator;
    void *initiator_data;
@@ -171,6 +173,12 @@ _mongoc_client_set_apm_callbacks_private (mongoc_client_t *client,
                                           mongoc_apm_callbacks_t *callbacks,
                                           void *context);
 
+#ifdef MONGOC_ENABLE_SSL
+void
+_mongoc_client_set_ssl_opts_from_pool (mongoc_client_t *client,
+                                       const mongoc_ssl_opt_t *opts);
+#endif
+
 mongoc_stream_t *
 mongoc_client_default_stream_initiator (const mongoc_uri_t *uri,
                                         const mongoc_host_list_t *host,
@@ -189,6 +197,9 @@ _mongoc_client_recv (mongoc_client_t *client,
                      mongoc_server_stream_t *server_stream,
                      bson_error_t *error);
 
+void
+_mongoc_client_read_prefetched (mongoc_client_t *client);
+
 void
 _mongoc_client_kill_cursor (mongoc_client_t *client,
                             uint32_t server_id,
@@ -484,6 +484,35 @@ mongoc_client_encryption_decrypt (mongoc_client_encryption_t *client_encryption,
    return _disabled_error (error);
 }
 
+bool
+mongoc_client_encryption_encrypt_many (
+   mongoc_client_encryption_t *client_encryption,
+   const bson_value_t *values,
+   mongoc_client_encryption_encrypt_opts_t **opts,
+   size_t n_values,
+   bson_value_t *ciphertexts,
+   bson_error_t *error)
+{
+   if (ciphertexts) {
+      memset (ciphertexts, 0, n_values * sizeof (*ciphertexts));
+   }
+   return _disabled_error (error);
+}
+
+bool
+mongoc_client_encryption_decrypt_many (
+   mongoc_client_encryption_t *client_encryption,
+   const bson_value_t *ciphertexts,
+   size_t n_values,
+   bson_value_t *values,
+   bson_error_t *error)
+{
+   if (values) {
+      memset (values, 0, n_values * sizeof (*values));
+   }
+   return _disabled_error (error);
+}
+
 bool
 _mongoc_cse_is_enabled (mongoc_client_t *client)
 {
@@ -1655,6 +1684,142 @@ fail:
    RETURN (ret);
 }
 
+bool
+mongoc_client_encryption_encrypt_many (
+   mongoc_client_encryption_t *client_encryption,
+   const bson_value_t *values,
+   mongoc_client_encryption_encrypt_opts_t **opts,
+   size_t n_values,
+   bson_value_t *ciphertexts,
+   bson_error_t *error)
+{
+   _mongoc_crypt_encrypt_opts_t *crypt_opts = NULL;
+   size_t i;
+   bool ret = false;
+
+   ENTRY;
+
+   BSON_ASSERT (client_encryption);
+
+   if (!ciphertexts) {
+      bson_set_error (error,
+                      MONGOC_ERROR_CLIENT,
+                      MONGOC_ERROR_CLIENT_INVALID_ENCRYPTION_ARG,
+                      "required 'ciphertexts' unset");
+      GOTO (fail);
+   }
+   /* reset, so it is safe for caller to call bson_value_destroy on error or
+    * success. */
+   for (i = 0; i < n_values; i++) {
+      ciphertexts[i].value_type = BSON_TYPE_EOD;
+   }
+
+   if (!opts) {
+      bson_set_error (error,
+                      MONGOC_ERROR_CLIENT,
+                      MONGOC_ERROR_CLIENT_INVALID_ENCRYPTION_ARG,
+                      "required 'opts' unset");
+      GOTO (fail);
+   }
+
+   if (n_values == 0) {
+      GOTO (done);
+   }
+
+   crypt_opts = bson_malloc0 (n_values * sizeof (_mongoc_crypt_encrypt_opts_t));
+   for (i = 0; i < n_values; i++) {
+      if (!opts[i]) {
+         bson_set_error (error,
+                         MONGOC_ERROR_CLIENT,
+                         MONGOC_ERROR_CLIENT_INVALID_ENCRYPTION_ARG,
+                         "required 'opts' unset for value %" PRIu64,
+                         (uint64_t) i);
+         GOTO (fail);
+      }
+
+      crypt_opts[i].algorithm = opts[i]->algorithm;
+      crypt_opts[i].keyid = &opts[i]->keyid;
+      crypt_opts[i].keyaltname = opts[i]->keyaltname;
+   }
+
+   if (!_mongoc_crypt_explicit_encrypt_many (client_encryption->crypt,
+                                             client_encryption->keyvault_coll,
+                                             crypt_opts,
+                                             values,
+                                             n_values,
+                                             ciphertexts,
+                                             error)) {
+      GOTO (fail);
+   }
+
+done:
+   ret = true;
+fail:
+   bson_free (crypt_opts);
+   RETURN (ret);
+}
+
+bool
+mongoc_client_encryption_decrypt_many (
+   mongoc_client_encryption_t *client_encryption,
+   const bson_value_t *ciphertexts,
+   size_t n_values,
+   bson_value_t *values,
+   bson_error_t *error)
+{
+   size_t i;
+   bool ret = false;
+
+   ENTRY;
+
+   BSON_ASSERT (client_encryption);
+
+   if (!values) {
+      bson_set_error (error,
+                      MONGOC_ERROR_CLIENT,
+                      MONGOC_ERROR_CLIENT_INVALID_ENCRYPTION_ARG,
+                      "required 'values' unset");
+      GOTO (fail);
+   }
+
+   /* reset, so it is safe for caller to call bson_value_destroy on error or
+    * success. */
+   for (i = 0; i < n_values; i++) {
+      values[i].value_type = BSON_TYPE_EOD;
+   }
+
+   if (n_values == 0) {
+      GOTO (done);
+   }
+
+   for (i = 0; i < n_values; i++) {
+      if (ciphertexts[i].value_type != BSON_TYPE_BINARY ||
+          ciphertexts[i].value.v_binary.subtype != BSON_SUBTYPE_ENCRYPTED) {
+         bson_set_error (error,
+                         MONGOC_ERROR_CLIENT,
+                         MONGOC_ERROR_CLIENT_INVALID_ENCRYPTION_ARG,
+                         "ciphertext %" PRIu64
+                         " must be BSON binary subtype 6",
+                         (uint64_t) i);
+         GOTO (fail);
+      }
+   }
+
+   if (!_mongoc_crypt_explicit_decrypt_many (client_encryption->crypt,
+                                             client_encryption->keyvault_coll,
+                                             ciphertexts,
+                                             n_values,
+                                             values,
+                                             error)) {
+      GOTO (fail);
+   }
+
+done:
+   ret = true;
+fail:
+   RETURN (ret);
+}
+
 bool
 _mongoc_cse_is_enabled (mongoc_client_t *client)
 {
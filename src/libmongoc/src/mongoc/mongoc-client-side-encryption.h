@@ -121,6 +121,23 @@ mongoc_client_encryption_decrypt (mongoc_client_encryption_t *client_encryption,
                                   bson_value_t *value,
                                   bson_error_t *error);
 
+MONGOC_EXPORT (bool)
+mongoc_client_encryption_encrypt_many (
+   mongoc_client_encryption_t *client_encryption,
+   const bson_value_t *values,
+   mongoc_client_encryption_encrypt_opts_t **opts,
+   size_t n_values,
+   bson_value_t *ciphertexts,
+   bson_error_t *error);
+
+MONGOC_EXPORT (bool)
+mongoc_client_encryption_decrypt_many (
+   mongoc_client_encryption_t *client_encryption,
+   const bson_value_t *ciphertexts,
+   size_t n_values,
+   bson_value_t *values,
+   bson_error_t *error);
+
 MONGOC_EXPORT (mongoc_client_encryption_encrypt_opts_t *)
 mongoc_client_encryption_encrypt_opts_new (void);
 
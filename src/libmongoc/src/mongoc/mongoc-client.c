@@ -40,12 +40,13 @@
 #include "mongoc-collection-private.h"
 #include "mongoc-counters-private.h"
 #include "mongoc-database-private.h"
+#include "mongoc-dns-cache-private.h"
 #include "mongoc-gridfs-private.h"
 #include "mongoc-error.h"
 #include "mongoc-error-private.h"
 #include "mongoc-log.h"
 #include "mongoc-queue-private.h"
-#include "mongoc-socket.h"
+#include "mongoc-socket-private.h"
 #include "mongoc-stream-buffered.h"
 #include "mongoc-stream-socket.h"
 #include "mongoc-thread-private.h"
@@ -609,7 +610,9 @@ _mongoc_client_get_rr (const char *service,
  *       Connect to a host using a TCP socket.
  *
  *       This will be performed synchronously and return a mongoc_stream_t
- *       that can be used to connect with the remote host.
+ *       that can be used to connect with the remote host. Like the topology
+ *       scanner, uses cached DNS results and races connection attempts to
+ *       the host's addresses.
  *
  * Returns:
  *       A newly allocated mongoc_stream_t if successful; otherwise
@@ -627,76 +630,39 @@ mongoc_client_connect_tcp (int32_t connecttimeoutms,
                            bson_error_t *error)
 {
    mongoc_socket_t *sock = NULL;
-   struct addrinfo hints;
-   struct addrinfo *result, *rp;
+   mongoc_dns_result_t *dns_result;
    int64_t expire_at;
-   char portstr[8];
-   int s;
 
    ENTRY;
 
    BSON_ASSERT (connecttimeoutms);
    BSON_ASSERT (host);
 
-   bson_snprintf (portstr, sizeof portstr, "%hu", host->port);
-
-   memset (&hints, 0, sizeof hints);
-   hints.ai_family = host->family;
-   hints.ai_socktype = SOCK_STREAM;
-   hints.ai_flags = 0;
-   hints.ai_protocol = 0;
-
-   TRACE ("DNS lookup for %s", host->host);
-   s = getaddrinfo (host->host, portstr, &hints, &result);
-
-   if (s != 0) {
-      mongoc_counter_dns_failure_inc ();
-      TRACE ("Failed to resolve %s", host->host);
-      bson_set_error (error,
-                      MONGOC_ERROR_STREAM,
-                      MONGOC_ERROR_STREAM_NAME_RESOLUTION,
-                      "Failed to resolve %s",
-                      host->host);
+   /* share DNS results with the topology scanner and other connections, so a
+    * burst of reconnects does not query the resolver for each one. */
+   dns_result =
+      _mongoc_dns_cache_resolve (host, MONGOC_DNS_CACHE_TIMEOUT_MS, error);
+   if (!dns_result) {
       RETURN (NULL);
    }
 
-   mongoc_counter_dns_success_inc ();
-
-   for (rp = result; rp; rp = rp->ai_next) {
-      /*
-       * Create a new non-blocking socket.
-       */
-      if (!(sock = mongoc_socket_new (
-               rp->ai_family, rp->ai_socktype, rp->ai_protocol))) {
-         continue;
-      }
-
-      /*
-       * Try to connect to the peer.
-       */
-      expire_at = bson_get_monotonic_time () + (connecttimeoutms * 1000L);
-      if (0 !=
-          mongoc_socket_connect (
-             sock, rp->ai_addr, (mongoc_socklen_t) rp->ai_addrlen, expire_at)) {
-         mongoc_socket_destroy (sock);
-         sock = NULL;
-         continue;
-      }
-
-      break;
-   }
+   expire_at = bson_get_monotonic_time () + (connecttimeoutms * 1000L);
+   sock = mongoc_socket_connect_any (
+      dns_result->addrs, MONGOC_HAPPY_EYEBALLS_DELAY_MS, expire_at);
 
    if (!sock) {
+      /* the addresses may be stale, look them up again next time. */
+      _mongoc_dns_cache_invalidate (host, dns_result);
+      _mongoc_dns_result_release (dns_result);
       bson_set_error (error,
                       MONGOC_ERROR_STREAM,
                       MONGOC_ERROR_STREAM_CONNECT,
                       "Failed to connect to target host: %s",
                       host->host_and_port);
-      freeaddrinfo (result);
       RETURN (NULL);
    }
 
-   freeaddrinfo (result);
+   _mongoc_dns_result_release (dns_result);
 
    return mongoc_stream_socket_new (sock);
 }
@@ -1037,16 +1003,19 @@ _mongoc_client_set_internal_tls_opts (mongoc_client_t *client,
    if (!client->use_ssl) {
       return;
    }
-   client->ssl_opts.internal =
-      bson_malloc (sizeof (_mongoc_internal_tls_opts_t));
-   memcpy (client->ssl_opts.internal,
-           internal,
-           sizeof (_mongoc_internal_tls_opts_t));
+   _mongoc_ssl_opts_set_internal (&client->ssl_opts, internal);
+   if (client->topology->single_threaded) {
+      /* pooled clients share the pool's TLS context instead, see
+       * _mongoc_client_set_ssl_opts_from_pool */
+      _mongoc_ssl_opts_share_ctx (
+         &client->ssl_opts, &client->ssl_opts, true /* client */);
+   }
 }
 
-void
-mongoc_client_set_ssl_opts (mongoc_client_t *client,
-                            const mongoc_ssl_opt_t *opts)
+static void
+_mongoc_client_set_ssl_opts (mongoc_client_t *client,
+                             const mongoc_ssl_opt_t *opts,
+                             bool from_pool)
 {
    BSON_ASSERT (client);
    BSON_ASSERT (opts);
@@ -1057,12 +1026,33 @@ mongoc_client_set_ssl_opts (mongoc_client_t *client,
    client->use_ssl = true;
    _mongoc_ssl_opts_copy_to (
       opts, &client->ssl_opts, false /* don't overwrite internal opts */);
+   /* the user's opts may have garbage in their internal field, only a pool's
+    * internal opts are trusted to hold a TLS context. */
+   _mongoc_ssl_opts_share_ctx (from_pool ? opts : &client->ssl_opts,
+                               &client->ssl_opts,
+                               true /* client */);
 
    if (client->topology->single_threaded) {
       mongoc_topology_scanner_set_ssl_opts (client->topology->scanner,
                                             &client->ssl_opts);
    }
 }
+
+/* Only called internally. Set a pooled client's TLS options to the pool's and
+ * share the pool's TLS context. */
+void
+_mongoc_client_set_ssl_opts_from_pool (mongoc_client_t *client,
+                                       const mongoc_ssl_opt_t *opts)
+{
+   _mongoc_client_set_ssl_opts (client, opts, true);
+}
+
+void
+mongoc_client_set_ssl_opts (mongoc_client_t *client,
+                            const mongoc_ssl_opt_t *opts)
+{
+   _mongoc_client_set_ssl_opts (client, opts, false);
+}
 #endif
 
 
@@ -1755,8 +1745,8 @@ _mongoc_client_retryable_read_command_with_stream (
    BSON_ASSERT (parts->is_retryable_read);
 
 retry:
-   ret = mongoc_cluster_run_command_monitored (
-      &client->cluster, &parts->assembled, reply, error);
+   ret = mongoc_cluster_run_command_hedged (
+      &client->cluster, &parts->assembled, parts->read_prefs, reply, error);
 
    /* If a retryable error is encountered and the read is retryable, select
     * a new readable stream and retry. If server selection fails or the selected
@@ -1829,6 +1819,11 @@ _mongoc_client_command_with_stream (mongoc_client_t *client,
          client, parts, server_stream, reply, error));
    }
 
+   if (parts->is_read_command && !parts->is_write_command) {
+      RETURN (mongoc_cluster_run_command_hedged (
+         &client->cluster, &parts->assembled, parts->read_prefs, reply, error));
+   }
+
    RETURN (mongoc_cluster_run_command_monitored (
       &client->cluster, &parts->assembled, reply, error));
 }
@@ -2250,6 +2245,28 @@ mongoc_client_command_simple_with_server_id (
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_client_read_prefetched --
+ *
+ *       If a cursor sent a getMore ahead of time (mongoc_cursor_set_prefetch)
+ *       read its reply now, before another operation uses the connection.
+ *       The cursor keeps the reply for its next batch.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+_mongoc_client_read_prefetched (mongoc_client_t *client)
+{
+   if (client->prefetching &&
+       client->prefetching->prefetch.state == PREFETCH_SENT) {
+      _mongoc_cursor_prefetch_read (client->prefetching);
+   }
+}
+
+
 static void
 _mongoc_client_prepare_killcursors_command (int64_t cursor_id,
                                             const char *collection,
@@ -2835,6 +2852,9 @@ mongoc_client_select_server (mongoc_client_t *client,
       return NULL;
    }
 
+   /* a single-threaded client may scan on the connection */
+   _mongoc_client_read_prefetched (client);
+
    sd = mongoc_topology_select (client->topology, optype, prefs, error);
    if (!sd) {
       return NULL;
@@ -2980,7 +3000,7 @@ _mongoc_client_end_sessions (mongoc_client_t *client)
    mongoc_cluster_t *cluster = &client->cluster;
    bool r;
 
-   if (t->session_pool) {
+   if (!_mongoc_server_session_pool_is_empty (&t->session_pool)) {
       prefs = mongoc_read_prefs_new (MONGOC_READ_PRIMARY_PREFERRED);
       server_id =
          mongoc_topology_select_server_id (t, MONGOC_SS_READ, prefs, &error);
@@ -3043,6 +3063,9 @@ mongoc_client_reset (mongoc_client_t *client)
 
    client->generation++;
 
+   /* a prefetched reply belongs to the old generation's cursors */
+   client->prefetching = NULL;
+
    /* Client sessions are owned and destroyed by the user, but we keep
       local pointers to them for reference. On reset, clear our local
       set without destroying the sessions or calling endSessions.
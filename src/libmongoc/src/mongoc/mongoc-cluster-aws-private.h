@@ -44,6 +44,22 @@ _mongoc_aws_credentials_obtain (mongoc_uri_t *uri,
 void
 _mongoc_aws_credentials_cleanup (_mongoc_aws_credentials_t *creds);
 
+/* Cached credentials are refreshed when they expire in less than this. */
+#define MONGOC_AWS_CREDENTIALS_REFRESH_MS (5 * 60 * 1000)
+
+void
+_mongoc_aws_credentials_cache_init (void);
+
+void
+_mongoc_aws_credentials_cache_clear (void);
+
+void
+_mongoc_aws_credentials_cache_cleanup (void);
+
+/* Query a different ECS metadata server, for testing. */
+void
+_mongoc_aws_set_ecs_endpoint (const char *host, int port);
+
 bool
 _mongoc_validate_and_derive_region (char *sts_fqdn,
                                     uint32_t sts_fqdn_len,
@@ -22,6 +22,7 @@
 #include "mongoc-host-list-private.h"
 #include "mongoc-rand-private.h"
 #include "mongoc-stream-private.h"
+#include "mongoc-thread-private.h"
 #include "mongoc-trace-private.h"
 #include "mongoc-uri-private.h"
 #include "mongoc-util-private.h"
@@ -43,6 +44,23 @@
 #ifdef MONGOC_ENABLE_MONGODB_AWS_AUTH
 #include "kms_message/kms_message.h"
 
+/* Temporary credentials from the ECS or EC2 metadata service, shared by all
+ * clients in the process. */
+static struct {
+   bson_mutex_t mutex;
+   /* signaled when a refresh finishes. */
+   mongoc_cond_t cond;
+   /* empty if no credentials are cached. */
+   _mongoc_aws_credentials_t creds;
+   /* milliseconds since the epoch. */
+   int64_t expiration_ms;
+   /* a thread is fetching credentials. */
+   bool refreshing;
+} creds_cache;
+
+static const char *ecs_host = "169.254.170.2";
+static int ecs_port = 80;
+
 /*
  * Run a single command on a stream.
  *
@@ -186,6 +204,152 @@ _creds_empty (_mongoc_aws_credentials_t *creds)
           creds->session_token == NULL;
 }
 
+static void
+_creds_copy (_mongoc_aws_credentials_t *dst,
+             const _mongoc_aws_credentials_t *src)
+{
+   dst->access_key_id = bson_strdup (src->access_key_id);
+   dst->secret_access_key = bson_strdup (src->secret_access_key);
+   dst->session_token = bson_strdup (src->session_token);
+}
+
+static int64_t
+_now_ms (void)
+{
+   struct timeval tv;
+
+   bson_gettimeofday (&tv);
+   return (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*
+ * Parse the "Expiration" of temporary credentials from the metadata service,
+ * like "2020-01-01T00:00:00Z".
+ *
+ * Returns milliseconds since the epoch, or 0 if it is missing or invalid.
+ */
+static int64_t
+_parse_expiration (const bson_t *response_json)
+{
+   bson_iter_t iter;
+   const char *expiration;
+   char *json;
+   bson_t *doc;
+   int64_t ret = 0;
+
+   if (!bson_iter_init_find_case (&iter, response_json, "Expiration") ||
+       !BSON_ITER_HOLDS_UTF8 (&iter)) {
+      return 0;
+   }
+
+   expiration = bson_iter_utf8 (&iter, NULL);
+   if (strpbrk (expiration, "\"\\")) {
+      return 0;
+   }
+
+   /* let the extended JSON parser read the ISO-8601 date. */
+   json = bson_strdup_printf ("{\"e\": {\"$date\": \"%s\"}}", expiration);
+   doc = bson_new_from_json ((const uint8_t *) json, -1, NULL);
+   if (doc && bson_iter_init_find (&iter, doc, "e") &&
+       BSON_ITER_HOLDS_DATE_TIME (&iter)) {
+      ret = bson_iter_date_time (&iter);
+   }
+
+   bson_destroy (doc);
+   bson_free (json);
+   return ret;
+}
+
+/*
+ * Copy cached credentials that are not about to expire.
+ *
+ * Returns true if creds were set. Otherwise the caller must fetch credentials
+ * and pass them to _creds_cache_refreshed. Once cached credentials are within
+ * MONGOC_AWS_CREDENTIALS_REFRESH_MS of expiring, the first caller refreshes
+ * them and the others keep using them until they expire.
+ */
+static bool
+_creds_cache_get (_mongoc_aws_credentials_t *creds)
+{
+   bool found = false;
+   bool cached;
+   int64_t now;
+
+   bson_mutex_lock (&creds_cache.mutex);
+   for (;;) {
+      now = _now_ms ();
+      cached = !_creds_empty (&creds_cache.creds) &&
+               now < creds_cache.expiration_ms;
+      if (cached && (creds_cache.refreshing ||
+                     now < creds_cache.expiration_ms -
+                              MONGOC_AWS_CREDENTIALS_REFRESH_MS)) {
+         _creds_copy (creds, &creds_cache.creds);
+         found = true;
+         break;
+      }
+
+      if (!creds_cache.refreshing) {
+         creds_cache.refreshing = true;
+         break;
+      }
+
+      /* wait for another thread's refresh instead of querying again. */
+      mongoc_cond_wait (&creds_cache.cond, &creds_cache.mutex);
+   }
+
+   bson_mutex_unlock (&creds_cache.mutex);
+   return found;
+}
+
+/* Finish a refresh started by _creds_cache_get. creds is NULL on failure. */
+static void
+_creds_cache_refreshed (const _mongoc_aws_credentials_t *creds,
+                        int64_t expiration_ms)
+{
+   bson_mutex_lock (&creds_cache.mutex);
+   creds_cache.refreshing = false;
+   if (creds && expiration_ms) {
+      _mongoc_aws_credentials_cleanup (&creds_cache.creds);
+      _creds_copy (&creds_cache.creds, creds);
+      creds_cache.expiration_ms = expiration_ms;
+   }
+
+   mongoc_cond_broadcast (&creds_cache.cond);
+   bson_mutex_unlock (&creds_cache.mutex);
+}
+
+void
+_mongoc_aws_credentials_cache_init (void)
+{
+   bson_mutex_init (&creds_cache.mutex);
+   mongoc_cond_init (&creds_cache.cond);
+}
+
+void
+_mongoc_aws_credentials_cache_clear (void)
+{
+   bson_mutex_lock (&creds_cache.mutex);
+   _mongoc_aws_credentials_cleanup (&creds_cache.creds);
+   memset (&creds_cache.creds, 0, sizeof (creds_cache.creds));
+   creds_cache.expiration_ms = 0;
+   bson_mutex_unlock (&creds_cache.mutex);
+}
+
+void
+_mongoc_aws_credentials_cache_cleanup (void)
+{
+   _mongoc_aws_credentials_cache_clear ();
+   mongoc_cond_destroy (&creds_cache.cond);
+   bson_mutex_destroy (&creds_cache.mutex);
+}
+
+void
+_mongoc_aws_set_ecs_endpoint (const char *host, int port)
+{
+   ecs_host = host;
+   ecs_port = port;
+}
+
 /*
  * Helper to validate and possibly set credentials.
  *
@@ -300,7 +464,9 @@ fail:
 }
 
 static bool
-_obtain_creds_from_ecs (_mongoc_aws_credentials_t *creds, bson_error_t *error)
+_obtain_creds_from_ecs (_mongoc_aws_credentials_t *creds,
+                        int64_t *expiration_ms,
+                        bson_error_t *error)
 {
    bool ret = false;
    char *http_response_headers = NULL;
@@ -319,8 +485,8 @@ _obtain_creds_from_ecs (_mongoc_aws_credentials_t *creds, bson_error_t *error)
       return true;
    }
 
-   if (!_send_http_request ("169.254.170.2",
-                            80,
+   if (!_send_http_request (ecs_host,
+                            ecs_port,
                             "GET",
                             relative_ecs_uri,
                             "",
@@ -361,6 +527,8 @@ _obtain_creds_from_ecs (_mongoc_aws_credentials_t *creds, bson_error_t *error)
       goto fail;
    }
 
+   *expiration_ms = _parse_expiration (response_json);
+
 
    ret = true;
 fail:
@@ -372,7 +540,9 @@ fail:
 }
 
 static bool
-_obtain_creds_from_ec2 (_mongoc_aws_credentials_t *creds, bson_error_t *error)
+_obtain_creds_from_ec2 (_mongoc_aws_credentials_t *creds,
+                        int64_t *expiration_ms,
+                        bson_error_t *error)
 {
    bool ret = false;
    char *http_response_headers = NULL;
@@ -480,6 +650,8 @@ _obtain_creds_from_ec2 (_mongoc_aws_credentials_t *creds, bson_error_t *error)
       goto fail;
    }
 
+   *expiration_ms = _parse_expiration (response_json);
+
    ret = true;
 fail:
    bson_destroy (response_json);
@@ -502,6 +674,8 @@ fail:
  * 3. From querying the ECS local HTTP server.
  * 4. From querying the EC2 local HTTP server.
  *
+ * Temporary credentials from 3. or 4. are cached until they expire.
+ *
  * On success, returns true.
  * On failure, returns false and sets error.
  */
@@ -511,6 +685,8 @@ _mongoc_aws_credentials_obtain (mongoc_uri_t *uri,
                                 bson_error_t *error)
 {
    bool ret = false;
+   bool refreshing = false;
+   int64_t expiration_ms = 0;
 
    creds->access_key_id = NULL;
    creds->secret_access_key = NULL;
@@ -532,8 +708,15 @@ _mongoc_aws_credentials_obtain (mongoc_uri_t *uri,
       goto succeed;
    }
 
+   TRACE ("%s", "checking cached credentials");
+   if (_creds_cache_get (creds)) {
+      goto succeed;
+   }
+
+   refreshing = true;
+
    TRACE ("%s", "checking ECS metadata for credentials");
-   if (!_obtain_creds_from_ecs (creds, error)) {
+   if (!_obtain_creds_from_ecs (creds, &expiration_ms, error)) {
       goto fail;
    }
    if (!_creds_empty (creds)) {
@@ -541,7 +724,7 @@ _mongoc_aws_credentials_obtain (mongoc_uri_t *uri,
    }
 
    TRACE ("%s", "checking EC2 metadata for credentials");
-   if (!_obtain_creds_from_ec2 (creds, error)) {
+   if (!_obtain_creds_from_ec2 (creds, &expiration_ms, error)) {
       goto fail;
    }
    if (!_creds_empty (creds)) {
@@ -553,6 +736,10 @@ _mongoc_aws_credentials_obtain (mongoc_uri_t *uri,
 succeed:
    ret = true;
 fail:
+   if (refreshing) {
+      _creds_cache_refreshed (ret ? creds : NULL, expiration_ms);
+   }
+
    return ret;
 }
 
@@ -1006,6 +1193,18 @@ _mongoc_aws_credentials_cleanup (_mongoc_aws_credentials_t *creds)
    return;
 }
 
+void
+_mongoc_aws_credentials_cache_clear (void)
+{
+   return;
+}
+
+void
+_mongoc_aws_set_ecs_endpoint (const char *host, int port)
+{
+   return;
+}
+
 bool
 _mongoc_validate_and_derive_region (char *sts_fqdn,
                                     uint32_t sts_fqdn_len,
@@ -41,11 +41,35 @@
 BSON_BEGIN_DECLS
 
 
+/* a hedged read whose reply was left unread on a pooled connection, see
+ * mongoc_cluster_run_command_hedged. the reply is read and discarded before
+ * the connection is used again */
+typedef struct {
+   char *command_name;
+   char *db_name;
+   uint32_t request_id;
+   int64_t operation_id;
+   int64_t started;
+   /* the read's session id, if any, to kill a cursor the reply opened */
+   bson_t lsid;
+} mongoc_cluster_hedge_drain_t;
+
+
 typedef struct _mongoc_cluster_node_t {
    mongoc_stream_t *stream;
    char *connection_address;
    uint32_t generation;
 
+   /* pooled mode: the number of server streams using this node. when the
+    * last is cleaned up the node is checked in to the topology's connection
+    * pool, where it is linked by next. */
+   int in_use;
+   struct _mongoc_cluster_node_t *next;
+   /* when the node was last checked in */
+   int64_t last_used_usec;
+   /* set while the reply to a discarded hedged read is unread */
+   mongoc_cluster_hedge_drain_t *hedge_drain;
+
    /* TODO CDRIVER-3653, these fields are unused. */
    int32_t max_wire_version;
    int32_t min_wire_version;
@@ -54,6 +78,15 @@ typedef struct _mongoc_cluster_node_t {
    int32_t max_msg_size;
 } mongoc_cluster_node_t;
 
+/* the APM succeeded or failed event of a batched unacknowledged write,
+ * published once the batch is written */
+typedef struct {
+   char *command_name;
+   uint32_t request_id;
+   int64_t operation_id;
+   int64_t started;
+} mongoc_cluster_unack_event_t;
+
 typedef struct _mongoc_cluster_t {
    int64_t operation_id;
    uint32_t request_id;
@@ -68,6 +101,14 @@ typedef struct _mongoc_cluster_t {
    mongoc_array_t iov;
 
    mongoc_scram_cache_t *scram_cache;
+
+   /* unacknowledged OP_MSGs to unack_batch_stream are coalesced here while
+    * unack_batch_depth > 0, see mongoc_cluster_begin_unacknowledged_batch */
+   mongoc_server_stream_t *unack_batch_stream;
+   int unack_batch_depth;
+   mongoc_buffer_t unack_batch;
+   /* mongoc_cluster_unack_event_t for each OP_MSG in unack_batch */
+   mongoc_array_t unack_batch_events;
 } mongoc_cluster_t;
 
 
@@ -82,6 +123,44 @@ mongoc_cluster_destroy (mongoc_cluster_t *cluster);
 void
 mongoc_cluster_disconnect_node (mongoc_cluster_t *cluster, uint32_t id);
 
+void
+_mongoc_cluster_node_destroy (mongoc_cluster_node_t *node);
+
+void
+mongoc_cluster_release_stream (mongoc_cluster_t *cluster,
+                               mongoc_server_stream_t *server_stream);
+
+mongoc_cluster_node_t *
+mongoc_cluster_detach_node (mongoc_cluster_t *cluster,
+                            const mongoc_server_stream_t *server_stream,
+                            bson_error_t *error);
+
+uint32_t
+mongoc_cluster_detached_started (mongoc_cluster_t *cluster,
+                                 mongoc_cmd_t *cmd);
+
+bool
+mongoc_cluster_detached_reply (mongoc_cluster_t *cluster,
+                               mongoc_cmd_t *cmd,
+                               uint32_t request_id,
+                               int64_t started_usec,
+                               const bson_t *reply,
+                               bson_t *reply_out,
+                               bson_error_t *error);
+
+void
+mongoc_cluster_release_detached (mongoc_cluster_t *cluster,
+                                 mongoc_server_stream_t *server_stream,
+                                 mongoc_cluster_node_t *cluster_node,
+                                 const bson_error_t *why,
+                                 bool timed_out);
+
+bool
+mongoc_cluster_warm_up_server (mongoc_cluster_t *cluster,
+                               uint32_t server_id,
+                               size_t n_idle,
+                               bson_error_t *error);
+
 int32_t
 mongoc_cluster_get_max_bson_obj_size (mongoc_cluster_t *cluster);
 
@@ -132,6 +211,14 @@ mongoc_cluster_stream_for_server (mongoc_cluster_t *cluster,
                                   bson_t *reply,
                                   bson_error_t *error);
 
+void
+mongoc_cluster_begin_unacknowledged_batch (
+   mongoc_cluster_t *cluster, mongoc_server_stream_t *server_stream);
+
+bool
+mongoc_cluster_end_unacknowledged_batch (mongoc_cluster_t *cluster,
+                                         bson_error_t *error);
+
 bool
 mongoc_cluster_stream_valid (mongoc_cluster_t *cluster,
                              mongoc_server_stream_t *server_stream);
@@ -142,6 +229,13 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
                                       bson_t *reply,
                                       bson_error_t *error);
 
+bool
+mongoc_cluster_run_command_hedged (mongoc_cluster_t *cluster,
+                                   mongoc_cmd_t *cmd,
+                                   const mongoc_read_prefs_t *read_prefs,
+                                   bson_t *reply,
+                                   bson_error_t *error);
+
 bool
 mongoc_cluster_run_command_parts (mongoc_cluster_t *cluster,
                                   mongoc_server_stream_t *server_stream,
@@ -70,6 +70,44 @@ mongoc_cluster_fetch_stream_single (mongoc_cluster_t *cluster,
                                     bool reconnect_ok,
                                     bson_error_t *error);
 
+static int32_t
+_mongoc_cluster_max_connecting (mongoc_cluster_t *cluster)
+{
+   return mongoc_uri_get_option_as_int32 (
+      cluster->uri, MONGOC_URI_MAXCONNECTING, MONGOC_DEFAULT_MAX_CONNECTING);
+}
+
+
+/* a thread waited serverSelectionTimeoutMS for one of the maxConnecting
+ * connections being established to @host */
+static void
+_mongoc_cluster_max_connecting_error (mongoc_topology_t *topology,
+                                      const char *host,
+                                      bson_error_t *error)
+{
+   bson_set_error (error,
+                   MONGOC_ERROR_STREAM,
+                   MONGOC_ERROR_STREAM_CONNECT,
+                   "Timed out after %" PRId64 "ms waiting for a connection "
+                   "to %s: maxConnecting connections are being established",
+                   topology->server_selection_timeout_msec,
+                   host);
+}
+
+
+/* maxIdleTimeMS in microseconds, or 0 if pooled connections never expire */
+static int64_t
+_mongoc_cluster_max_idle_usec (mongoc_cluster_t *cluster)
+{
+   int32_t max_idle_ms;
+
+   max_idle_ms = mongoc_uri_get_option_as_int32 (
+      cluster->uri, MONGOC_URI_MAXIDLETIMEMS, 0);
+
+   return 1000 * (int64_t) BSON_MAX (max_idle_ms, 0);
+}
+
+
 static mongoc_server_stream_t *
 mongoc_cluster_fetch_stream_pooled (mongoc_cluster_t *cluster,
                                     uint32_t server_id,
@@ -467,6 +505,123 @@ _handle_txn_error_labels (bool cmd_ret,
       cmd_ret, cmd_err, reply, cmd->server_stream->sd->max_wire_version);
 }
 
+/* remember the APM event of an unacknowledged write about to be added to
+ * the batch, so it is published when the batch is written. */
+static void
+_mongoc_cluster_defer_unacknowledged_event (mongoc_cluster_t *cluster,
+                                            const mongoc_cmd_t *cmd,
+                                            uint32_t request_id,
+                                            int64_t started)
+{
+   mongoc_cluster_unack_event_t event;
+
+   event.command_name = bson_strdup (cmd->command_name);
+   event.request_id = request_id;
+   event.operation_id = cmd->operation_id;
+   event.started = started;
+
+   _mongoc_array_append_val (&cluster->unack_batch_events, event);
+}
+
+
+/* if the event for @request_id is still waiting for the batch to be
+ * written, forget it and return true. */
+static bool
+_mongoc_cluster_take_unacknowledged_event (mongoc_cluster_t *cluster,
+                                           uint32_t request_id)
+{
+   mongoc_cluster_unack_event_t *event;
+   mongoc_array_t *events = &cluster->unack_batch_events;
+
+   if (!events->len) {
+      return false;
+   }
+
+   event = &_mongoc_array_index (
+      events, mongoc_cluster_unack_event_t, events->len - 1);
+   if (event->request_id != request_id) {
+      return false;
+   }
+
+   bson_free (event->command_name);
+   events->len--;
+
+   return true;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_cluster_publish_unacknowledged_events --
+ *
+ *       Publish the APM events of the writes in the unacknowledged batch
+ *       once it is written to @server_stream: a succeeded event with an
+ *       {ok: 1} reply for each if @error is NULL, otherwise a failed event
+ *       with @error. If @server_stream is NULL the events are dropped.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static void
+_mongoc_cluster_publish_unacknowledged_events (
+   mongoc_cluster_t *cluster,
+   const mongoc_server_stream_t *server_stream,
+   const bson_error_t *error)
+{
+   mongoc_apm_callbacks_t *callbacks = &cluster->client->apm_callbacks;
+   mongoc_apm_command_succeeded_t succeeded_event;
+   mongoc_apm_command_failed_t failed_event;
+   mongoc_cluster_unack_event_t *event;
+   bson_t fake_reply = BSON_INITIALIZER;
+   int64_t now = bson_get_monotonic_time ();
+   size_t i;
+
+   /* Unacknowledged writes must provide a CommandSucceededEvent with an
+    * {ok: 1} reply */
+   bson_append_int32 (&fake_reply, "ok", 2, 1);
+
+   for (i = 0; i < cluster->unack_batch_events.len; i++) {
+      event = &_mongoc_array_index (
+         &cluster->unack_batch_events, mongoc_cluster_unack_event_t, i);
+
+      if (server_stream && !error && callbacks->succeeded) {
+         mongoc_apm_command_succeeded_init (&succeeded_event,
+                                            now - event->started,
+                                            &fake_reply,
+                                            event->command_name,
+                                            event->request_id,
+                                            event->operation_id,
+                                            &server_stream->sd->host,
+                                            server_stream->sd->id,
+                                            cluster->client->apm_context);
+
+         callbacks->succeeded (&succeeded_event);
+         mongoc_apm_command_succeeded_cleanup (&succeeded_event);
+      } else if (server_stream && error && callbacks->failed) {
+         mongoc_apm_command_failed_init (&failed_event,
+                                         now - event->started,
+                                         event->command_name,
+                                         error,
+                                         &fake_reply,
+                                         event->request_id,
+                                         event->operation_id,
+                                         &server_stream->sd->host,
+                                         server_stream->sd->id,
+                                         cluster->client->apm_context);
+
+         callbacks->failed (&failed_event);
+         mongoc_apm_command_failed_cleanup (&failed_event);
+      }
+
+      bson_free (event->command_name);
+   }
+
+   _mongoc_array_clear (&cluster->unack_batch_events);
+   bson_destroy (&fake_reply);
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -492,6 +647,8 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
                                       bson_error_t *error)
 {
    bool retval;
+   bool batched;
+   bool publish;
    uint32_t request_id = ++cluster->request_id;
    uint32_t server_id;
    mongoc_apm_callbacks_t *callbacks;
@@ -532,7 +689,17 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
       }
    }
 
-   if (callbacks->started) {
+   if (cmd->defer_reply) {
+      cmd->deferred_request_id = request_id;
+      cmd->deferred_started = started;
+   } else if (cmd->reply_pending && cmd->deferred_started) {
+      /* "started" was published when the request was sent */
+      request_id = cmd->deferred_request_id;
+      started = cmd->deferred_started;
+   }
+
+   if (callbacks->started &&
+       !(cmd->reply_pending && cmd->deferred_started)) {
       mongoc_apm_command_started_init_with_cmd (
          &started_event, cmd, request_id, cluster->client->apm_context);
 
@@ -540,6 +707,17 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
       mongoc_apm_command_started_cleanup (&started_event);
    }
 
+   /* an unacknowledged write joining a batch has not been sent when
+    * run_opmsg returns, the batch publishes its event once it is written */
+   batched = server_stream->sd->max_wire_version >= WIRE_VERSION_OP_MSG &&
+             !cmd->is_acknowledged && cluster->unack_batch_depth > 0 &&
+             cluster->unack_batch_stream == server_stream &&
+             (callbacks->succeeded || callbacks->failed);
+   if (batched) {
+      _mongoc_cluster_defer_unacknowledged_event (
+         cluster, cmd, request_id, started);
+   }
+
    if (server_stream->sd->max_wire_version >= WIRE_VERSION_OP_MSG) {
       retval = mongoc_cluster_run_opmsg (cluster, cmd, reply, error);
    } else {
@@ -547,6 +725,11 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
          cluster, cmd, compressor_id, reply, error);
    }
 
+   /* publish here only if the write failed before it joined the batch */
+   publish = !batched ||
+             (!retval &&
+              _mongoc_cluster_take_unacknowledged_event (cluster, request_id));
+
    if (_mongoc_cse_is_enabled (cluster->client)) {
       bson_destroy (&decrypted);
       retval = _mongoc_cse_auto_decrypt (
@@ -559,7 +742,7 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
       }
    }
 
-   if (retval && callbacks->succeeded) {
+   if (retval && callbacks->succeeded && !cmd->defer_reply && publish) {
       bson_t fake_reply = BSON_INITIALIZER;
       /*
        * Unacknowledged writes must provide a CommandSucceededEvent with an
@@ -584,7 +767,7 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
       mongoc_apm_command_succeeded_cleanup (&succeeded_event);
       bson_destroy (&fake_reply);
    }
-   if (!retval && callbacks->failed) {
+   if (!retval && callbacks->failed && publish) {
       mongoc_apm_command_failed_init (&failed_event,
                                       bson_get_monotonic_time () - started,
                                       cmd->command_name,
@@ -631,6 +814,447 @@ fail_no_events:
 }
 
 
+/* a read that takes longer than this percentile of recent operations on its
+ * server is hedged */
+#define MONGOC_HEDGE_DELAY_PERCENTILE 90
+
+/* a getMore must run on the server that holds its cursor */
+static const char *const hedge_excluded_cmds[] = {"getMore", NULL};
+
+
+/* the connection in @server_stream is used by no other server stream, so its
+ * reply can be left unread while the other hedged read's reply is awaited */
+static bool
+_mongoc_cluster_stream_is_exclusive (
+   mongoc_cluster_t *cluster, const mongoc_server_stream_t *server_stream)
+{
+   mongoc_cluster_node_t *node;
+
+   node = (mongoc_cluster_node_t *) mongoc_set_get (cluster->nodes,
+                                                    server_stream->sd->id);
+
+   return node && node->stream == server_stream->stream && node->in_use == 1;
+}
+
+
+/* kill the cursor, if any, that the discarded reply of a hedged find or
+ * aggregate opened on @server_stream's server */
+static void
+_mongoc_cluster_kill_hedge_cursor (mongoc_cluster_t *cluster,
+                                   mongoc_server_stream_t *server_stream,
+                                   const mongoc_cluster_hedge_drain_t *drain,
+                                   const bson_t *reply)
+{
+   bson_iter_t iter;
+   bson_iter_t child;
+   int64_t cursor_id = 0;
+   const char *ns = NULL;
+   const char *dot;
+   char *db;
+   bson_t command = BSON_INITIALIZER;
+   bson_t cursors;
+   mongoc_cmd_parts_t parts;
+
+   if (!bson_iter_init_find (&iter, reply, "cursor") ||
+       !BSON_ITER_HOLDS_DOCUMENT (&iter) ||
+       !bson_iter_recurse (&iter, &child)) {
+      return;
+   }
+
+   while (bson_iter_next (&child)) {
+      if (!strcmp (bson_iter_key (&child), "id") &&
+          BSON_ITER_HOLDS_INT (&child)) {
+         cursor_id = bson_iter_as_int64 (&child);
+      } else if (!strcmp (bson_iter_key (&child), "ns") &&
+                 BSON_ITER_HOLDS_UTF8 (&child)) {
+         ns = bson_iter_utf8 (&child, NULL);
+      }
+   }
+
+   if (!cursor_id || !ns || !(dot = strchr (ns, '.'))) {
+      return;
+   }
+
+   /* the cursor belongs to the read's session, which may be gone */
+   db = bson_strndup (ns, (size_t) (dot - ns));
+   bson_append_utf8 (&command, "killCursors", 11, dot + 1, -1);
+   bson_append_array_begin (&command, "cursors", 7, &cursors);
+   bson_append_int64 (&cursors, "0", 1, cursor_id);
+   bson_append_array_end (&command, &cursors);
+   if (!bson_empty (&drain->lsid)) {
+      bson_append_document (&command, "lsid", 4, &drain->lsid);
+   }
+
+   mongoc_cmd_parts_init (
+      &parts, cluster->client, db, MONGOC_QUERY_SLAVE_OK, &command);
+   parts.prohibit_lsid = true;
+   parts.assembled.operation_id = drain->operation_id;
+   if (mongoc_cmd_parts_assemble (&parts, server_stream, NULL)) {
+      /* the result of killCursors may be safely ignored */
+      (void) mongoc_cluster_run_command_monitored (
+         cluster, &parts.assembled, NULL, NULL);
+   }
+
+   mongoc_cmd_parts_cleanup (&parts);
+   bson_destroy (&command);
+   bson_free (db);
+}
+
+
+static void
+_mongoc_cluster_hedge_drain_destroy (mongoc_cluster_hedge_drain_t *drain)
+{
+   if (drain) {
+      bson_free (drain->command_name);
+      bson_free (drain->db_name);
+      bson_destroy (&drain->lsid);
+      bson_free (drain);
+   }
+}
+
+
+/* leave the reply to @cmd, a hedged read that lost, to be read before its
+ * connection is used again. its server's latency is recorded then */
+static void
+_mongoc_cluster_defer_hedge_drain (mongoc_cluster_t *cluster,
+                                   const mongoc_cmd_t *cmd)
+{
+   mongoc_cluster_node_t *node;
+   mongoc_cluster_hedge_drain_t *drain;
+
+   node = (mongoc_cluster_node_t *) mongoc_set_get (
+      cluster->nodes, cmd->server_stream->sd->id);
+   if (!node || node->stream != cmd->server_stream->stream) {
+      /* a network error closed the connection */
+      return;
+   }
+
+   drain = bson_malloc0 (sizeof (mongoc_cluster_hedge_drain_t));
+   drain->command_name = bson_strdup (cmd->command_name);
+   drain->db_name = bson_strdup (cmd->db_name);
+   drain->request_id = cmd->deferred_request_id;
+   drain->operation_id = cmd->operation_id;
+   drain->started = cmd->deferred_started;
+   if (cmd->session) {
+      bson_copy_to (mongoc_client_session_get_lsid (cmd->session),
+                    &drain->lsid);
+   } else {
+      bson_init (&drain->lsid);
+   }
+
+   BSON_ASSERT (!node->hedge_drain);
+   node->hedge_drain = drain;
+   cmd->server_stream->start_usec = 0;
+}
+
+
+/* true if the reply a pooled connection owes a hedged read has arrived */
+static bool
+_mongoc_cluster_hedge_drain_ready (mongoc_cluster_node_t *node)
+{
+   mongoc_stream_poll_t poller;
+
+   poller.stream = node->stream;
+   poller.events = POLLIN;
+   poller.revents = 0;
+
+   return mongoc_stream_poll (&poller, 1, 0) != 0;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_cluster_drain_hedge --
+ *
+ *       Read and discard the reply to a hedged read that lost, which the
+ *       connection in @server_stream owes, and kill a cursor it opened.
+ *       Publishes the read's completion event and records its latency.
+ *
+ * Returns:
+ *       false if reading the reply failed, which closed the connection.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_mongoc_cluster_drain_hedge (mongoc_cluster_t *cluster,
+                             mongoc_server_stream_t *server_stream,
+                             mongoc_cluster_node_t *node)
+{
+   mongoc_cluster_hedge_drain_t *drain = node->hedge_drain;
+   mongoc_cmd_t cmd = {0};
+   bson_t empty = BSON_INITIALIZER;
+   bson_t reply;
+   bool ret;
+
+   node->hedge_drain = NULL;
+
+   cmd.db_name = drain->db_name;
+   cmd.command = &empty;
+   cmd.command_name = drain->command_name;
+   cmd.server_stream = server_stream;
+   cmd.operation_id = drain->operation_id;
+   cmd.is_acknowledged = true;
+   cmd.reply_pending = true;
+   cmd.deferred_request_id = drain->request_id;
+   cmd.deferred_started = drain->started;
+
+   ret = mongoc_cluster_run_command_monitored (cluster, &cmd, &reply, NULL);
+   if (server_stream->sd->load) {
+      _mongoc_server_load_add (server_stream->sd->load,
+                               bson_get_monotonic_time () - drain->started);
+   }
+
+   if (ret) {
+      _mongoc_cluster_kill_hedge_cursor (cluster, server_stream, drain, &reply);
+   }
+
+   bson_destroy (&reply);
+   bson_destroy (&empty);
+   _mongoc_cluster_hedge_drain_destroy (drain);
+
+   /* an error reply leaves the connection usable */
+   node = (mongoc_cluster_node_t *) mongoc_set_get (cluster->nodes,
+                                                    server_stream->sd->id);
+   return ret || (node && node->stream == server_stream->stream);
+}
+
+
+/* exchange the servers and connections of two server streams, leaving each
+ * its own cluster time */
+static void
+_mongoc_cluster_swap_server_streams (mongoc_server_stream_t *a,
+                                     mongoc_server_stream_t *b)
+{
+   mongoc_server_stream_t tmp;
+
+   tmp.topology_type = a->topology_type;
+   tmp.sd = a->sd;
+   tmp.stream = a->stream;
+   tmp.cluster = a->cluster;
+   tmp.snapshot = a->snapshot;
+   tmp.start_usec = a->start_usec;
+
+   a->topology_type = b->topology_type;
+   a->sd = b->sd;
+   a->stream = b->stream;
+   a->cluster = b->cluster;
+   a->snapshot = b->snapshot;
+   a->start_usec = b->start_usec;
+
+   b->topology_type = tmp.topology_type;
+   b->sd = tmp.sd;
+   b->stream = tmp.stream;
+   b->cluster = tmp.cluster;
+   b->snapshot = tmp.snapshot;
+   b->start_usec = tmp.start_usec;
+}
+
+
+static bool
+_mongoc_cluster_should_hedge (mongoc_cluster_t *cluster,
+                              const mongoc_cmd_t *cmd,
+                              const mongoc_read_prefs_t *read_prefs)
+{
+   const mongoc_server_stream_t *server_stream = cmd->server_stream;
+   bson_iter_t iter;
+   int i;
+
+   if (cluster->client->topology->single_threaded || !read_prefs ||
+       mongoc_read_prefs_get_mode (read_prefs) == MONGOC_READ_PRIMARY) {
+      return false;
+   }
+
+   if (!bson_iter_init_find (
+          &iter, mongoc_read_prefs_get_hedge (read_prefs), "enabled") ||
+       !bson_iter_as_bool (&iter)) {
+      return false;
+   }
+
+   /* mongos hedges reads itself */
+   if (server_stream->topology_type != MONGOC_TOPOLOGY_RS_NO_PRIMARY &&
+       server_stream->topology_type != MONGOC_TOPOLOGY_RS_WITH_PRIMARY) {
+      return false;
+   }
+
+   if (server_stream->sd->max_wire_version < WIRE_VERSION_OP_MSG ||
+       !server_stream->sd->load) {
+      return false;
+   }
+
+   if (!cmd->command_name || !cmd->is_acknowledged || cmd->defer_reply ||
+       cmd->reply_pending || cmd->exhaust_allowed ||
+       cluster->client->in_exhaust || cluster->client->prefetching ||
+       _mongoc_client_session_in_txn (cmd->session) ||
+       _mongoc_cse_is_enabled (cluster->client)) {
+      return false;
+   }
+
+   for (i = 0; hedge_excluded_cmds[i]; i++) {
+      if (!strcmp (cmd->command_name, hedge_excluded_cmds[i])) {
+         return false;
+      }
+   }
+
+   return _mongoc_cluster_stream_is_exclusive (cluster, server_stream);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_run_command_hedged --
+ *
+ *       Run a read command like mongoc_cluster_run_command_monitored. In a
+ *       client pool connected to a replica set, if @read_prefs is not
+ *       primary and enables hedged reads, and the server has not replied
+ *       within the 90th percentile of its recent operations' latencies,
+ *       send the same command to another server suitable for @read_prefs.
+ *
+ *       The first reply wins. The other reply is read and discarded, and a
+ *       cursor it opened is killed, before its connection is used again:
+ *       here if it has arrived, otherwise when the connection is next
+ *       checked out of the pool. The connection is closed only if reading
+ *       the reply fails. A getMore is never hedged.
+ *
+ * Returns:
+ *       true if successful; otherwise false and @error is set.
+ *
+ * Side effects:
+ *       @reply is set and should ALWAYS be released with bson_destroy().
+ *       If the hedged read wins, @cmd's server stream is switched to the
+ *       server and connection that replied, so a cursor in @reply is used
+ *       on the server that holds it.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+mongoc_cluster_run_command_hedged (mongoc_cluster_t *cluster,
+                                   mongoc_cmd_t *cmd,
+                                   const mongoc_read_prefs_t *read_prefs,
+                                   bson_t *reply,
+                                   bson_error_t *error)
+{
+   mongoc_server_stream_t *server_stream = cmd->server_stream;
+   mongoc_server_stream_t *hedge_stream = NULL;
+   mongoc_stream_poll_t poller[2];
+   mongoc_cmd_t hedge_cmd;
+   mongoc_cmd_t *winner = cmd;
+   mongoc_cmd_t *loser = NULL;
+   mongoc_cluster_node_t *node;
+   uint32_t hedge_id;
+   int64_t delay_usec;
+   int32_t timeout_msec;
+   bson_error_t hedge_error;
+   bool ret;
+
+   ENTRY;
+
+   if (!_mongoc_cluster_should_hedge (cluster, cmd, read_prefs)) {
+      RETURN (
+         mongoc_cluster_run_command_monitored (cluster, cmd, reply, error));
+   }
+
+   delay_usec = _mongoc_server_load_latency_percentile (
+      server_stream->sd->load, MONGOC_HEDGE_DELAY_PERCENTILE);
+   if (delay_usec < 0) {
+      /* no recent operation to base the delay on */
+      RETURN (
+         mongoc_cluster_run_command_monitored (cluster, cmd, reply, error));
+   }
+
+   cmd->defer_reply = true;
+   ret = mongoc_cluster_run_command_monitored (cluster, cmd, reply, error);
+   cmd->defer_reply = false;
+   if (!ret) {
+      RETURN (false);
+   }
+
+   if (reply) {
+      bson_destroy (reply);
+   }
+
+   poller[0].stream = server_stream->stream;
+   poller[0].events = POLLIN;
+   poller[0].revents = 0;
+   timeout_msec = (int32_t) BSON_MIN (BSON_MAX ((delay_usec + 999) / 1000, 1),
+                                      (int64_t) INT32_MAX);
+   if (mongoc_stream_poll (poller, 1, timeout_msec) != 0) {
+      /* the reply arrived in time, or reading it reports the error */
+      GOTO (read_reply);
+   }
+
+   hedge_id = _mongoc_topology_select_hedge_server_id (
+      cluster->client->topology, read_prefs, server_stream->sd->id);
+   if (!hedge_id) {
+      GOTO (read_reply);
+   }
+
+   hedge_stream = mongoc_cluster_stream_for_server (cluster,
+                                                    hedge_id,
+                                                    true /* reconnect ok */,
+                                                    cmd->session,
+                                                    NULL,
+                                                    &hedge_error);
+   if (!hedge_stream ||
+       hedge_stream->sd->max_wire_version < WIRE_VERSION_OP_MSG ||
+       !_mongoc_cluster_stream_is_exclusive (cluster, hedge_stream)) {
+      GOTO (read_reply);
+   }
+
+   hedge_cmd = *cmd;
+   hedge_cmd.server_stream = hedge_stream;
+   hedge_cmd.defer_reply = true;
+   if (!mongoc_cluster_run_command_monitored (
+          cluster, &hedge_cmd, NULL, &hedge_error)) {
+      /* the failed write closed the connection */
+      GOTO (read_reply);
+   }
+
+   hedge_cmd.defer_reply = false;
+
+   poller[0].revents = 0;
+   poller[1].stream = hedge_stream->stream;
+   poller[1].events = POLLIN;
+   poller[1].revents = 0;
+   timeout_msec = cluster->sockettimeoutms
+                     ? (int32_t) BSON_MIN (cluster->sockettimeoutms, INT32_MAX)
+                     : -1;
+   if (mongoc_stream_poll (poller, 2, timeout_msec) > 0 &&
+       !poller[0].revents && poller[1].revents) {
+      winner = &hedge_cmd;
+   }
+
+   loser = winner == cmd ? &hedge_cmd : cmd;
+
+read_reply:
+   winner->reply_pending = true;
+   ret = mongoc_cluster_run_command_monitored (cluster, winner, reply, error);
+   winner->reply_pending = false;
+
+   if (loser) {
+      _mongoc_cluster_defer_hedge_drain (cluster, loser);
+      node = (mongoc_cluster_node_t *) mongoc_set_get (
+         cluster->nodes, loser->server_stream->sd->id);
+      if (node && node->hedge_drain &&
+          _mongoc_cluster_hedge_drain_ready (node)) {
+         (void) _mongoc_cluster_drain_hedge (
+            cluster, loser->server_stream, node);
+      }
+   }
+
+   if (winner == &hedge_cmd) {
+      _mongoc_cluster_swap_server_streams (server_stream, hedge_stream);
+   }
+
+   mongoc_server_stream_cleanup (hedge_stream);
+
+   RETURN (ret);
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -1653,13 +2277,13 @@ _mongoc_cluster_auth_scram_continue (mongoc_cluster_t *cluster,
                                             sizeof buf,
                                             &buflen,
                                             error)) {
-      return false;
+      goto failure;
    }
 
    for (;;) {
       if (!_mongoc_scram_step (
              scram, buf, buflen, buf, sizeof buf, &buflen, error)) {
-         return false;
+         goto failure;
       }
 
       if (done && (scram->step >= 3)) {
@@ -1677,7 +2301,7 @@ _mongoc_cluster_auth_scram_continue (mongoc_cluster_t *cluster,
       if (!_mongoc_cluster_run_scram_command (
              cluster, stream, server_id, &cmd, &reply_local, error)) {
          bson_destroy (&cmd);
-         return false;
+         goto failure;
       }
 
       bson_destroy (&cmd);
@@ -1691,7 +2315,7 @@ _mongoc_cluster_auth_scram_continue (mongoc_cluster_t *cluster,
                                                &buflen,
                                                error)) {
          bson_destroy (&reply_local);
-         return false;
+         goto failure;
       }
 
       bson_destroy (&reply_local);
@@ -1711,6 +2335,18 @@ _mongoc_cluster_auth_scram_continue (mongoc_cluster_t *cluster,
    cluster->scram_cache = _mongoc_scram_get_cache (scram);
 
    return true;
+
+failure:
+   if (!error || error->domain != MONGOC_ERROR_STREAM) {
+      /* the cached keys may be stale, e.g. the password was changed. */
+      _mongoc_scram_invalidate_cache (scram);
+      if (cluster->scram_cache) {
+         _mongoc_scram_cache_destroy (cluster->scram_cache);
+         cluster->scram_cache = NULL;
+      }
+   }
+
+   return false;
 }
 
 /*
@@ -1897,7 +2533,8 @@ _mongoc_cluster_auth_node (
  *
  * Called when a network error occurs, or to close connection tied to an exhaust
  * cursor.
- * If the cluster is pooled, removes the node from cluster's set of nodes.
+ * If the cluster is pooled, removes the node from cluster's set of nodes, and
+ * closes the shared pool's idle connections to the server.
  * WARNING: pointers to a disconnected mongoc_cluster_node_t or its stream are
  * now invalid, be careful of dangling pointers.
  */
@@ -1921,17 +2558,19 @@ mongoc_cluster_disconnect_node (mongoc_cluster_t *cluster, uint32_t server_id)
       }
    } else {
       mongoc_set_rm (cluster->nodes, server_id);
+      mongoc_connection_pool_purge (topology->connection_pool, server_id);
    }
 
    EXIT;
 }
 
-static void
+void
 _mongoc_cluster_node_destroy (mongoc_cluster_node_t *node)
 {
    /* Failure, or Replica Set reconfigure without this node */
    mongoc_stream_failed (node->stream);
    bson_free (node->connection_address);
+   _mongoc_cluster_hedge_drain_destroy (node->hedge_drain);
 
    bson_free (node);
 }
@@ -2300,6 +2939,9 @@ mongoc_cluster_stream_for_server (mongoc_cluster_t *cluster,
 
    BSON_ASSERT (cluster);
 
+   /* the connection must not carry another reply we have not read */
+   _mongoc_client_read_prefetched (cluster->client);
+
    if (cs && cs->server_id && cs->server_id != server_id) {
       _mongoc_bson_init_if_set (reply);
       bson_set_error (error,
@@ -2527,31 +3169,94 @@ _mongoc_cluster_create_server_stream (mongoc_topology_t *topology,
 }
 
 
+/* a server stream for @cluster_node, which stays in cluster->nodes until the
+ * stream is cleaned up, see mongoc_cluster_release_stream. the stream takes
+ * the caller's reference to @snapshot and its @cluster_time, or releases them
+ * on error */
 static mongoc_server_stream_t *
-mongoc_cluster_fetch_stream_pooled (mongoc_cluster_t *cluster,
+_mongoc_cluster_node_server_stream (mongoc_cluster_t *cluster,
+                                    mongoc_topology_snapshot_t *snapshot,
+                                    bson_t *cluster_time,
                                     uint32_t server_id,
-                                    bool reconnect_ok,
+                                    mongoc_cluster_node_t *cluster_node,
                                     bson_error_t *error /* OUT */)
 {
-   mongoc_topology_t *topology;
-   mongoc_stream_t *stream;
-   mongoc_cluster_node_t *cluster_node;
+   mongoc_server_stream_t *server_stream;
    mongoc_server_description_t *sd;
-   bool has_server_description = false;
-   uint32_t generation = 0;
 
-   cluster_node =
-      (mongoc_cluster_node_t *) mongoc_set_get (cluster->nodes, server_id);
+   BSON_ASSERT (snapshot);
 
-   topology = cluster->client->topology;
-   bson_mutex_lock (&topology->mutex);
    sd = mongoc_topology_description_server_by_id (
-      &topology->description, server_id, error);
+      &snapshot->description, server_id, error);
+   if (!sd) {
+      _mongoc_topology_snapshot_release (snapshot);
+      bson_destroy (cluster_time);
+      return NULL;
+   }
+
+   server_stream = mongoc_server_stream_new_from_snapshot (
+      snapshot, sd, cluster_time, cluster_node->stream);
+   server_stream->cluster = cluster;
+   cluster_node->in_use++;
+
+   return server_stream;
+}
+
+
+/* check connections set aside by mongoc_cluster_fetch_stream_pooled back in
+ * to the connection pool */
+static void
+_mongoc_cluster_checkin_awaiting (mongoc_connection_pool_t *pool,
+                                  uint32_t server_id,
+                                  mongoc_cluster_node_t *nodes)
+{
+   mongoc_cluster_node_t *next;
+
+   while (nodes) {
+      next = nodes->next;
+      mongoc_connection_pool_checkin (pool, server_id, nodes);
+      nodes = next;
+   }
+}
+
+
+static mongoc_server_stream_t *
+mongoc_cluster_fetch_stream_pooled (mongoc_cluster_t *cluster,
+                                    uint32_t server_id,
+                                    bool reconnect_ok,
+                                    bson_error_t *error /* OUT */)
+{
+   mongoc_topology_t *topology;
+   mongoc_topology_snapshot_t *snapshot;
+   bson_t cluster_time;
+   mongoc_stream_t *stream;
+   mongoc_cluster_node_t *cluster_node;
+   mongoc_cluster_node_t *awaiting = NULL;
+   mongoc_server_stream_t *server_stream;
+   mongoc_server_description_t *sd = NULL;
+   bool has_server_description = false;
+   bool reserved = false;
+   uint32_t generation = 0;
+   int64_t max_idle_usec;
+
+   cluster_node =
+      (mongoc_cluster_node_t *) mongoc_set_get (cluster->nodes, server_id);
+
+   /* read the server's description and generation from one snapshot, and
+    * have the server stream share it, instead of locking the topology */
+   topology = cluster->client->topology;
+   snapshot = _mongoc_topology_snapshot_acquire (topology, &cluster_time);
+   if (snapshot) {
+      sd = mongoc_topology_description_server_by_id (
+         &snapshot->description, server_id, error);
+   } else {
+      node_not_found (topology, server_id, error);
+   }
+
    if (sd) {
       has_server_description = true;
       generation = sd->generation;
    }
-   bson_mutex_unlock (&topology->mutex);
 
    if (cluster_node) {
       BSON_ASSERT (cluster_node->stream);
@@ -2567,11 +3272,87 @@ mongoc_cluster_fetch_stream_pooled (mongoc_cluster_t *cluster,
           */
          mongoc_cluster_disconnect_node (cluster, server_id);
       } else {
-         return _mongoc_cluster_create_server_stream (
-            topology, server_id, cluster_node->stream, error);
+         return _mongoc_cluster_node_server_stream (
+            cluster, snapshot, &cluster_time, server_id, cluster_node, error);
+      }
+   }
+
+   max_idle_usec = _mongoc_cluster_max_idle_usec (cluster);
+
+   /* reuse a connection another client of the pool is done with. if there
+    * is none and we may connect, wait until fewer than maxConnecting
+    * connections to the server are being established */
+   while (has_server_description) {
+      if (reconnect_ok) {
+         if (!mongoc_connection_pool_checkout_or_reserve (
+                topology->connection_pool,
+                server_id,
+                _mongoc_cluster_max_connecting (cluster),
+                topology->server_selection_timeout_msec,
+                &cluster_node)) {
+            _mongoc_cluster_max_connecting_error (
+               topology, sd->host.host_and_port, error);
+            _mongoc_cluster_checkin_awaiting (
+               topology->connection_pool, server_id, awaiting);
+            _mongoc_topology_snapshot_release (snapshot);
+            bson_destroy (&cluster_time);
+            return NULL;
+         }
+
+         reserved = !cluster_node;
+      } else {
+         cluster_node = mongoc_connection_pool_checkout (
+            topology->connection_pool, server_id);
+      }
+
+      if (!cluster_node) {
+         break;
+      }
+
+      if (cluster_node->generation < generation) {
+         /* the pool was cleared while the connection was idle */
+         _mongoc_cluster_node_destroy (cluster_node);
+         continue;
       }
+
+      if (max_idle_usec &&
+          bson_get_monotonic_time () - cluster_node->last_used_usec >
+             max_idle_usec) {
+         /* idle too long, the reaper has not closed it yet */
+         _mongoc_cluster_node_destroy (cluster_node);
+         continue;
+      }
+
+      if (cluster_node->hedge_drain &&
+          !_mongoc_cluster_hedge_drain_ready (cluster_node)) {
+         /* still owes the reply to a hedged read, try another connection */
+         cluster_node->next = awaiting;
+         awaiting = cluster_node;
+         continue;
+      }
+
+      mongoc_set_add (cluster->nodes, server_id, cluster_node);
+      server_stream = _mongoc_cluster_node_server_stream (
+         cluster, snapshot, &cluster_time, server_id, cluster_node, error);
+      _mongoc_cluster_checkin_awaiting (
+         topology->connection_pool, server_id, awaiting);
+
+      if (server_stream && cluster_node->hedge_drain &&
+          !_mongoc_cluster_drain_hedge (cluster, server_stream, cluster_node)) {
+         /* reading the reply closed the connection */
+         mongoc_server_stream_cleanup (server_stream);
+         return mongoc_cluster_fetch_stream_pooled (
+            cluster, server_id, reconnect_ok, error);
+      }
+
+      return server_stream;
    }
 
+   _mongoc_cluster_checkin_awaiting (
+      topology->connection_pool, server_id, awaiting);
+   _mongoc_topology_snapshot_release (snapshot);
+   bson_destroy (&cluster_time);
+
    /* no node, or out of date */
    if (!reconnect_ok) {
       node_not_found (topology, server_id, error);
@@ -2579,12 +3360,154 @@ mongoc_cluster_fetch_stream_pooled (mongoc_cluster_t *cluster,
    }
 
    stream = _mongoc_cluster_add_node (cluster, generation, server_id, error);
-   if (stream) {
-      return _mongoc_cluster_create_server_stream (
-         topology, server_id, stream, error);
-   } else {
+   if (reserved) {
+      mongoc_connection_pool_end_connect (topology->connection_pool,
+                                          server_id);
+   }
+
+   if (!stream) {
       return NULL;
    }
+
+   /* the handshake published a newer snapshot */
+   snapshot = _mongoc_topology_snapshot_acquire (topology, &cluster_time);
+   cluster_node =
+      (mongoc_cluster_node_t *) mongoc_set_get (cluster->nodes, server_id);
+   return _mongoc_cluster_node_server_stream (
+      cluster, snapshot, &cluster_time, server_id, cluster_node, error);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_warm_up_server --
+ *
+ *       Open and authenticate connections to @server_id and check them
+ *       into the topology's connection pool, until the pool has @n_idle
+ *       idle connections to the server. Idle connections from before the
+ *       server's pool was last cleared are closed first. Connections are
+ *       opened one at a time, subject to maxConnecting.
+ *
+ * Returns:
+ *       True if the pool has @n_idle idle connections to the server.
+ *
+ * Side effects:
+ *       Sets @error and returns false if a connection fails.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+mongoc_cluster_warm_up_server (mongoc_cluster_t *cluster,
+                               uint32_t server_id,
+                               size_t n_idle,
+                               bson_error_t *error)
+{
+   mongoc_topology_t *topology = cluster->client->topology;
+   mongoc_connection_pool_t *pool = topology->connection_pool;
+   mongoc_server_description_t *sd;
+   mongoc_cluster_node_t *cluster_node;
+   mongoc_stream_t *stream;
+   uint32_t generation;
+   char host[BSON_HOST_NAME_MAX + 7];
+   bool reserved;
+
+   BSON_ASSERT (!topology->single_threaded);
+   /* this cluster's own node for the server would be replaced below */
+   BSON_ASSERT (!mongoc_set_get (cluster->nodes, server_id));
+
+   bson_mutex_lock (&topology->mutex);
+   sd = mongoc_topology_description_server_by_id (
+      &topology->description, server_id, error);
+   if (sd) {
+      generation = sd->generation;
+      bson_strncpy (host, sd->host.host_and_port, sizeof host);
+   }
+   bson_mutex_unlock (&topology->mutex);
+
+   if (!sd) {
+      return false;
+   }
+
+   mongoc_connection_pool_prune (pool, server_id, generation);
+
+   for (;;) {
+      if (!mongoc_connection_pool_reserve_warm (
+             pool,
+             server_id,
+             n_idle,
+             _mongoc_cluster_max_connecting (cluster),
+             topology->server_selection_timeout_msec,
+             &reserved)) {
+         _mongoc_cluster_max_connecting_error (topology, host, error);
+         return false;
+      }
+
+      if (!reserved) {
+         break;
+      }
+
+      stream = _mongoc_cluster_add_node (cluster, generation, server_id, error);
+      if (stream) {
+         cluster_node = (mongoc_cluster_node_t *) mongoc_set_steal (
+            cluster->nodes, server_id);
+         mongoc_connection_pool_checkin (pool, server_id, cluster_node);
+      }
+
+      mongoc_connection_pool_end_connect (pool, server_id);
+
+      if (!stream) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_release_stream --
+ *
+ *       Called when a server stream returned by
+ *       mongoc_cluster_fetch_stream_pooled is cleaned up. Once no server
+ *       stream uses its node, the node goes back to the topology's
+ *       connection pool for any client to use, unless the connection
+ *       still carries replies this client must read: those of an exhaust
+ *       cursor, or a prefetched getMore.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+mongoc_cluster_release_stream (mongoc_cluster_t *cluster,
+                               mongoc_server_stream_t *server_stream)
+{
+   mongoc_cluster_node_t *cluster_node;
+   uint32_t server_id = server_stream->sd->id;
+
+   cluster_node =
+      (mongoc_cluster_node_t *) mongoc_set_get (cluster->nodes, server_id);
+
+   if (!cluster_node || cluster_node->stream != server_stream->stream) {
+      /* disconnected while the server stream was in use */
+      return;
+   }
+
+   BSON_ASSERT (cluster_node->in_use > 0);
+   if (--cluster_node->in_use > 0) {
+      return;
+   }
+
+   if (cluster->client->in_exhaust || cluster->client->prefetching) {
+      return;
+   }
+
+   BSON_ASSERT (mongoc_set_steal (cluster->nodes, server_id) == cluster_node);
+   mongoc_connection_pool_checkin (
+      cluster->client->topology->connection_pool, server_id, cluster_node);
 }
 
 /*
@@ -2635,6 +3558,9 @@ mongoc_cluster_init (mongoc_cluster_t *cluster,
    cluster->nodes = mongoc_set_new (8, _mongoc_cluster_node_dtor, NULL);
 
    _mongoc_array_init (&cluster->iov, sizeof (mongoc_iovec_t));
+   _mongoc_buffer_init (&cluster->unack_batch, NULL, 0, NULL, NULL);
+   _mongoc_array_init (&cluster->unack_batch_events,
+                       sizeof (mongoc_cluster_unack_event_t));
 
    cluster->operation_id = rand ();
 
@@ -2670,6 +3596,9 @@ mongoc_cluster_destroy (mongoc_cluster_t *cluster) /* INOUT */
    mongoc_set_destroy (cluster->nodes);
 
    _mongoc_array_destroy (&cluster->iov);
+   _mongoc_buffer_destroy (&cluster->unack_batch);
+   _mongoc_cluster_publish_unacknowledged_events (cluster, NULL, NULL);
+   _mongoc_array_destroy (&cluster->unack_batch_events);
 
 #ifdef MONGOC_ENABLE_CRYPTO
    if (cluster->scram_cache) {
@@ -2746,6 +3675,9 @@ _mongoc_cluster_stream_for_optype (mongoc_cluster_t *cluster,
 
    BSON_ASSERT (cluster);
 
+   /* the connection must not carry another reply we have not read */
+   _mongoc_client_read_prefetched (cluster->client);
+
    server_id = _mongoc_cluster_select_server_id (
       cs, topology, optype, read_prefs, error);
 
@@ -3291,6 +4223,157 @@ mongoc_cluster_try_recv (mongoc_cluster_t *cluster,
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_cluster_flush_unacknowledged --
+ *
+ *       Write all OP_MSGs held by the current unacknowledged batch in a
+ *       single call.
+ *
+ * Returns:
+ *       true if successful or nothing was pending; otherwise false and
+ *       @error is set.
+ *
+ * Side effects:
+ *       On a network error the cluster disconnects from the server and
+ *       the batch's server stream is invalidated.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_mongoc_cluster_flush_unacknowledged (mongoc_cluster_t *cluster,
+                                      bson_error_t *error)
+{
+   mongoc_server_stream_t *server_stream = cluster->unack_batch_stream;
+   mongoc_iovec_t iov;
+   bool ok;
+
+   if (!cluster->unack_batch.len) {
+      return true;
+   }
+
+   BSON_ASSERT (server_stream);
+
+   if (!server_stream->stream) {
+      bson_set_error (error,
+                      MONGOC_ERROR_STREAM,
+                      MONGOC_ERROR_STREAM_NOT_ESTABLISHED,
+                      "Failed to send unacknowledged writes: connection "
+                      "was closed");
+      _mongoc_buffer_clear (&cluster->unack_batch, false);
+      _mongoc_cluster_publish_unacknowledged_events (
+         cluster, server_stream, error);
+      return false;
+   }
+
+   iov.iov_base = (void *) cluster->unack_batch.data;
+   iov.iov_len = cluster->unack_batch.len;
+
+   ok = _mongoc_stream_writev_full (
+      server_stream->stream, &iov, 1, cluster->sockettimeoutms, error);
+
+   _mongoc_buffer_clear (&cluster->unack_batch, false);
+
+   if (!ok) {
+      _handle_network_error (
+         cluster, server_stream, true /* handshake complete */, error);
+      server_stream->stream = NULL;
+   }
+
+   _mongoc_cluster_publish_unacknowledged_events (
+      cluster, server_stream, ok ? NULL : error);
+
+   return ok;
+}
+
+
+/* copy the OP_MSG gathered in cluster->iov into the unacknowledged batch,
+ * writing the batch out once it reaches the server's max message size. */
+static bool
+_mongoc_cluster_append_unacknowledged (mongoc_cluster_t *cluster,
+                                       bson_error_t *error)
+{
+   mongoc_iovec_t *iov = (mongoc_iovec_t *) cluster->iov.data;
+   size_t i;
+
+   for (i = 0; i < cluster->iov.len; i++) {
+      _mongoc_buffer_append (
+         &cluster->unack_batch, (uint8_t *) iov[i].iov_base, iov[i].iov_len);
+   }
+
+   if (cluster->unack_batch.len >=
+       (size_t) cluster->unack_batch_stream->sd->max_msg_size) {
+      return _mongoc_cluster_flush_unacknowledged (cluster, error);
+   }
+
+   return true;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_begin_unacknowledged_batch --
+ *
+ *       Start coalescing unacknowledged OP_MSGs sent on @server_stream, so
+ *       a run of w:0 writes goes out in as few socket writes as possible
+ *       instead of one per command. Batches nest; only the outermost
+ *       mongoc_cluster_end_unacknowledged_batch writes the messages.
+ *
+ *       The caller must not select or fetch other server streams on
+ *       @cluster until the batch ends: that may close @server_stream.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+mongoc_cluster_begin_unacknowledged_batch (
+   mongoc_cluster_t *cluster, mongoc_server_stream_t *server_stream)
+{
+   BSON_ASSERT (cluster);
+   BSON_ASSERT (server_stream);
+
+   if (cluster->unack_batch_depth++ == 0) {
+      cluster->unack_batch_stream = server_stream;
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_end_unacknowledged_batch --
+ *
+ *       End a batch started with mongoc_cluster_begin_unacknowledged_batch.
+ *
+ * Returns:
+ *       true if successful; otherwise false and @error is set.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+mongoc_cluster_end_unacknowledged_batch (mongoc_cluster_t *cluster,
+                                         bson_error_t *error)
+{
+   bool ok;
+
+   BSON_ASSERT (cluster);
+   BSON_ASSERT (cluster->unack_batch_depth > 0);
+
+   if (--cluster->unack_batch_depth > 0) {
+      return true;
+   }
+
+   ok = _mongoc_cluster_flush_unacknowledged (cluster, error);
+   cluster->unack_batch_stream = NULL;
+
+   return ok;
+}
+
+
 static void
 network_error_reply (bson_t *reply, mongoc_cmd_t *cmd)
 {
@@ -3344,9 +4427,15 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
    mongoc_rpc_t rpc;
    int32_t msg_len;
    bool ok;
+   bool batched;
+   bool recv_only;
    mongoc_server_stream_t *server_stream;
 
    server_stream = cmd->server_stream;
+   /* read the reply to an earlier request, e.g. the next exhaust reply */
+   recv_only = cmd->reply_pending;
+   cmd->more_to_come = false;
+
    if (!cmd->command_name) {
       bson_set_error (error,
                       MONGOC_ERROR_COMMAND,
@@ -3355,7 +4444,7 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
       _mongoc_bson_init_if_set (reply);
       return false;
    }
-   if (cluster->client->in_exhaust) {
+   if (cluster->client->in_exhaust && !recv_only) {
       bson_set_error (error,
                       MONGOC_ERROR_CLIENT,
                       MONGOC_ERROR_CLIENT_IN_EXHAUST,
@@ -3378,6 +4467,10 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
       rpc.msg.flags = MONGOC_MSG_MORE_TO_COME;
    }
 
+   if (cmd->exhaust_allowed) {
+      rpc.msg.flags |= MONGOC_MSG_EXHAUST_ALLOWED;
+   }
+
    rpc.msg.n_sections = 1;
 
    section[0].payload_type = 0;
@@ -3398,7 +4491,7 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
    _mongoc_rpc_gather (&rpc, &cluster->iov);
    _mongoc_rpc_swab_to_le (&rpc);
 
-   if (mongoc_cmd_is_compressible (cmd)) {
+   if (!recv_only && mongoc_cmd_is_compressible (cmd)) {
       int32_t compressor_id =
          mongoc_server_description_compressor_id (server_stream->sd);
 
@@ -3413,11 +4506,38 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
          }
       }
    }
-   ok = _mongoc_stream_writev_full (server_stream->stream,
-                                    (mongoc_iovec_t *) cluster->iov.data,
-                                    cluster->iov.len,
-                                    cluster->sockettimeoutms,
-                                    error);
+
+   batched = !cmd->is_acknowledged && cluster->unack_batch_depth > 0 &&
+             cluster->unack_batch_stream == server_stream;
+
+   if (recv_only) {
+      /* nothing to send, only read the next reply */
+      ok = true;
+   } else if (batched) {
+      /* no reply is expected, hold the message until the batch is flushed */
+      ok = _mongoc_cluster_append_unacknowledged (cluster, error);
+   } else {
+      /* keep messages in order with anything batched before this one */
+      ok = _mongoc_cluster_flush_unacknowledged (cluster, error);
+   }
+
+   if (!ok) {
+      /* a failed flush already handled the network error */
+      RUN_CMD_ERR_DECORATE;
+      bson_free (output);
+      network_error_reply (reply, cmd);
+      _mongoc_buffer_destroy (&buffer);
+      return false;
+   }
+
+   if (!batched && !recv_only) {
+      ok = _mongoc_stream_writev_full (server_stream->stream,
+                                       (mongoc_iovec_t *) cluster->iov.data,
+                                       cluster->iov.len,
+                                       cluster->sockettimeoutms,
+                                       error);
+   }
+
    if (!ok) {
       /* add info about the command to writev_full's error message */
       RUN_CMD_ERR_DECORATE;
@@ -3431,7 +4551,7 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
    }
 
    /* If acknowledged, wait for a server response. Otherwise, exit early */
-   if (cmd->is_acknowledged) {
+   if (cmd->is_acknowledged && !cmd->defer_reply) {
       ok = _mongoc_buffer_append_from_stream (
          &buffer, server_stream->stream, 4, cluster->sockettimeoutms, error);
       if (!ok) {
@@ -3520,6 +4640,10 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
       ok = _mongoc_cmd_check_ok (
          &reply_local, cluster->client->error_api_version, error);
 
+      if (ok && cmd->exhaust_allowed) {
+         cmd->more_to_come = (rpc.msg.flags & MONGOC_MSG_MORE_TO_COME) != 0;
+      }
+
       if (cmd->session) {
          _mongoc_client_session_handle_reply (
             cmd->session, cmd->is_acknowledged, &reply_local);
@@ -3537,3 +4661,237 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
 
    return ok;
 }
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_detach_node --
+ *
+ *       Take the connection @server_stream uses out of @cluster, so that a
+ *       command can await its reply on the connection while the client
+ *       runs other commands on other connections. See mongoc_reactor_t.
+ *       Only a pooled client can detach connections.
+ *
+ * Returns:
+ *       The node, owned by the caller until it is passed to
+ *       mongoc_cluster_release_detached. NULL if another server stream
+ *       of the client uses the connection, and @error is set.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+mongoc_cluster_node_t *
+mongoc_cluster_detach_node (mongoc_cluster_t *cluster,
+                            const mongoc_server_stream_t *server_stream,
+                            bson_error_t *error)
+{
+   mongoc_cluster_node_t *cluster_node;
+   uint32_t server_id = server_stream->sd->id;
+
+   BSON_ASSERT (!cluster->client->topology->single_threaded);
+
+   if (cluster->client->in_exhaust) {
+      bson_set_error (error,
+                      MONGOC_ERROR_CLIENT,
+                      MONGOC_ERROR_CLIENT_IN_EXHAUST,
+                      "A cursor derived from this client is in exhaust.");
+      return NULL;
+   }
+
+   if (cluster->client->prefetching ||
+       !_mongoc_cluster_stream_is_exclusive (cluster, server_stream)) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "The connection to %s is in use by another operation",
+                      server_stream->sd->host.host_and_port);
+      return NULL;
+   }
+
+   cluster_node =
+      (mongoc_cluster_node_t *) mongoc_set_steal (cluster->nodes, server_id);
+   /* mongoc_cluster_release_stream ignores the server stream from now on */
+   cluster_node->in_use = 0;
+
+   return cluster_node;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_detached_started --
+ *
+ *       Publish the "started" event of @cmd, which is about to be sent on
+ *       a detached connection.
+ *
+ * Returns:
+ *       The request id to pass to mongoc_cluster_detached_reply.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+uint32_t
+mongoc_cluster_detached_started (mongoc_cluster_t *cluster,
+                                 mongoc_cmd_t *cmd)
+{
+   mongoc_apm_command_started_t started_event;
+   uint32_t request_id = ++cluster->request_id;
+
+   if (cluster->client->apm_callbacks.started) {
+      mongoc_apm_command_started_init_with_cmd (
+         &started_event, cmd, request_id, cluster->client->apm_context);
+
+      cluster->client->apm_callbacks.started (&started_event);
+      mongoc_apm_command_started_cleanup (&started_event);
+   }
+
+   return request_id;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_detached_reply --
+ *
+ *       Handle the @reply to @cmd, sent on a detached connection at
+ *       @started_usec: gossip its $clusterTime, update the session,
+ *       publish the "succeeded" or "failed" event and handle "not
+ *       primary" errors, like mongoc_cluster_run_command_monitored does.
+ *       @reply is NULL if the connection failed with @error.
+ *
+ * Returns:
+ *       True if the command succeeded, otherwise false and @error is set.
+ *
+ * Side effects:
+ *       @reply_out is always initialized and must be destroyed.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+mongoc_cluster_detached_reply (mongoc_cluster_t *cluster,
+                               mongoc_cmd_t *cmd,
+                               uint32_t request_id,
+                               int64_t started_usec,
+                               const bson_t *reply,
+                               bson_t *reply_out,
+                               bson_error_t *error /* IN/OUT */)
+{
+   mongoc_apm_callbacks_t *callbacks = &cluster->client->apm_callbacks;
+   const mongoc_server_stream_t *server_stream = cmd->server_stream;
+   mongoc_apm_command_succeeded_t succeeded_event;
+   mongoc_apm_command_failed_t failed_event;
+   bool ok;
+
+   if (reply) {
+      bson_copy_to (reply, reply_out);
+      _mongoc_topology_update_cluster_time (cluster->client->topology,
+                                            reply_out);
+      ok = _mongoc_cmd_check_ok (
+         reply_out, cluster->client->error_api_version, error);
+
+      if (cmd->session) {
+         _mongoc_client_session_handle_reply (
+            cmd->session, cmd->is_acknowledged, reply_out);
+      }
+   } else {
+      network_error_reply (reply_out, cmd);
+      ok = false;
+   }
+
+   if (ok && callbacks->succeeded) {
+      mongoc_apm_command_succeeded_init (&succeeded_event,
+                                         bson_get_monotonic_time () -
+                                            started_usec,
+                                         reply_out,
+                                         cmd->command_name,
+                                         request_id,
+                                         cmd->operation_id,
+                                         &server_stream->sd->host,
+                                         server_stream->sd->id,
+                                         cluster->client->apm_context);
+
+      callbacks->succeeded (&succeeded_event);
+      mongoc_apm_command_succeeded_cleanup (&succeeded_event);
+   }
+
+   if (!ok && callbacks->failed) {
+      mongoc_apm_command_failed_init (&failed_event,
+                                      bson_get_monotonic_time () -
+                                         started_usec,
+                                      cmd->command_name,
+                                      error,
+                                      reply_out,
+                                      request_id,
+                                      cmd->operation_id,
+                                      &server_stream->sd->host,
+                                      server_stream->sd->id,
+                                      cluster->client->apm_context);
+
+      callbacks->failed (&failed_event);
+      mongoc_apm_command_failed_cleanup (&failed_event);
+   }
+
+   if (reply) {
+      _handle_not_master_error (cluster, server_stream, reply_out);
+   }
+
+   _handle_txn_error_labels (ok, error, cmd, reply_out);
+   _mongoc_topology_update_last_used (cluster->client->topology,
+                                      server_stream->sd->id);
+
+   return ok;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_release_detached --
+ *
+ *       Clean up @server_stream and return @cluster_node, taken from it by
+ *       mongoc_cluster_detach_node, to the topology's connection pool. If
+ *       the connection failed with @why, close it instead and mark the
+ *       server Unknown, unless the error was a timeout.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+mongoc_cluster_release_detached (mongoc_cluster_t *cluster,
+                                 mongoc_server_stream_t *server_stream,
+                                 mongoc_cluster_node_t *cluster_node,
+                                 const bson_error_t *why,
+                                 bool timed_out)
+{
+   mongoc_topology_t *topology = cluster->client->topology;
+   uint32_t server_id = server_stream->sd->id;
+
+   if (why) {
+      bson_mutex_lock (&topology->mutex);
+      _mongoc_topology_handle_app_error (
+         topology,
+         server_id,
+         true /* handshake complete */,
+         timed_out ? MONGOC_SDAM_APP_ERROR_TIMEOUT
+                   : MONGOC_SDAM_APP_ERROR_NETWORK,
+         NULL,
+         why,
+         server_stream->sd->max_wire_version,
+         server_stream->sd->generation);
+      bson_mutex_unlock (&topology->mutex);
+   }
+
+   /* before the node is freed, so no other node can reuse its address */
+   mongoc_server_stream_cleanup (server_stream);
+
+   if (why) {
+      _mongoc_cluster_node_destroy (cluster_node);
+   } else {
+      mongoc_connection_pool_checkin (
+         topology->connection_pool, server_id, cluster_node);
+   }
+}
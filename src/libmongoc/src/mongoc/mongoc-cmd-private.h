@@ -63,6 +63,19 @@ typedef struct _mongoc_cmd_t {
    mongoc_client_session_t *session;
    bool is_acknowledged;
    bool is_txn_finish;
+   /* OP_MSG only, for a reply read by a later call: defer_reply sends the
+    * request without reading its reply, reply_pending reads the next reply
+    * without sending anything. With exhaust_allowed the server may stream
+    * several replies, more_to_come is set on return if another follows. */
+   bool defer_reply;
+   bool reply_pending;
+   bool exhaust_allowed;
+   bool more_to_come;
+   /* the APM request id and start time of a deferred request, set when it is
+    * sent. Pass them back with reply_pending so the reply's event matches
+    * the "started" event published when the request was sent. */
+   uint32_t deferred_request_id;
+   int64_t deferred_started;
 } mongoc_cmd_t;
 
 
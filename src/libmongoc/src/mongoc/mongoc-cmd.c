@@ -56,6 +56,12 @@ mongoc_cmd_parts_init (mongoc_cmd_parts_t *parts,
    parts->assembled.session = NULL;
    parts->assembled.is_acknowledged = true;
    parts->assembled.is_txn_finish = false;
+   parts->assembled.defer_reply = false;
+   parts->assembled.reply_pending = false;
+   parts->assembled.exhaust_allowed = false;
+   parts->assembled.more_to_come = false;
+   parts->assembled.deferred_request_id = 0;
+   parts->assembled.deferred_started = 0;
 }
 
 
@@ -181,7 +187,10 @@ mongoc_cmd_parts_append_opts (mongoc_cmd_parts_t *parts,
          parts->assembled.session = cs;
          continue;
       } else if (BSON_ITER_IS_KEY (iter, "serverId") ||
-                 BSON_ITER_IS_KEY (iter, "maxAwaitTimeMS")) {
+                 BSON_ITER_IS_KEY (iter, "maxAwaitTimeMS") ||
+                 BSON_ITER_IS_KEY (iter, "exhaust") ||
+                 BSON_ITER_IS_KEY (iter, "prefetch") ||
+                 BSON_ITER_IS_KEY (iter, "adaptiveBatchSize")) {
          continue;
       }
 
@@ -374,10 +383,26 @@ mongoc_cmd_parts_append_read_write (mongoc_cmd_parts_t *parts,
 
 #undef OPTS_ERR
 
+/* Room for the fields appended after the body is copied, such as lsid,
+ * $clusterTime and txnNumber. */
+#define MONGOC_CMD_PARTS_RESERVE 512
+
+
 static void
 _mongoc_cmd_parts_ensure_copied (mongoc_cmd_parts_t *parts)
 {
+   size_t size;
+
    if (parts->assembled.command == parts->body) {
+      /* size the buffer up front so the body is copied exactly once, not
+       * again each time an appended field outgrows the buffer */
+      size = (size_t) parts->body->len + parts->extra.len +
+             parts->read_concern_document.len +
+             parts->write_concern_document.len + MONGOC_CMD_PARTS_RESERVE;
+      size = BSON_MIN (size, BSON_MAX_SIZE);
+      bson_destroy (&parts->assembled_body);
+      BSON_ASSERT (
+         bson_steal (&parts->assembled_body, bson_sized_new (size)));
       bson_concat (&parts->assembled_body, parts->body);
       bson_concat (&parts->assembled_body, &parts->extra);
       parts->assembled.command = &parts->assembled_body;
@@ -403,32 +428,8 @@ static void
 _mongoc_cmd_parts_add_read_prefs (bson_t *query,
                                   const mongoc_read_prefs_t *prefs)
 {
-   bson_t child;
-   const char *mode_str;
-   const bson_t *tags;
-   int64_t stale;
-   const bson_t *hedge;
-
-   mode_str = _mongoc_read_mode_as_str (mongoc_read_prefs_get_mode (prefs));
-   tags = mongoc_read_prefs_get_tags (prefs);
-   stale = mongoc_read_prefs_get_max_staleness_seconds (prefs);
-   hedge = mongoc_read_prefs_get_hedge (prefs);
-
-   bson_append_document_begin (query, "$readPreference", 15, &child);
-   bson_append_utf8 (&child, "mode", 4, mode_str, -1);
-   if (!bson_empty0 (tags)) {
-      bson_append_array (&child, "tags", 4, tags);
-   }
-
-   if (stale != MONGOC_NO_MAX_STALENESS) {
-      bson_append_int64 (&child, "maxStalenessSeconds", 19, stale);
-   }
-
-   if (!bson_empty0 (hedge)) {
-      bson_append_document (&child, "hedge", 5, hedge);
-   }
-
-   bson_append_document_end (query, &child);
+   bson_append_document (
+      query, "$readPreference", 15, _mongoc_read_prefs_get_bson (prefs));
 }
 
 
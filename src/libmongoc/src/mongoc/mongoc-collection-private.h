@@ -22,9 +22,12 @@
 #include <bson/bson.h>
 
 #include "mongoc-client.h"
+#include "mongoc-write-command-private.h"
 
 BSON_BEGIN_DECLS
 
+struct _mongoc_update_opts_t;
+struct _mongoc_delete_opts_t;
 
 struct _mongoc_collection_t {
    mongoc_client_t *client;
@@ -54,6 +57,28 @@ _mongoc_collection_create_index_if_not_exists (mongoc_collection_t *collection,
                                                const bson_t *opts,
                                                bson_error_t *error);
 
+void
+_mongoc_collection_init_update_command (
+   mongoc_collection_t *collection,
+   mongoc_write_command_t *command,
+   const bson_t *selector,
+   const bson_t *update,
+   const struct _mongoc_update_opts_t *update_opts,
+   bool multi,
+   bool bypass,
+   const bson_t *array_filters,
+   bson_t *extra);
+
+void
+_mongoc_collection_init_delete_command (
+   mongoc_collection_t *collection,
+   mongoc_write_command_t *command,
+   bool multi,
+   const bson_t *selector,
+   const struct _mongoc_delete_opts_t *delete_opts,
+   const bson_t *cmd_opts,
+   bson_t *opts);
+
 BSON_END_DECLS
 
 
@@ -2011,30 +2011,31 @@ mongoc_collection_update (mongoc_collection_t *collection,
    RETURN (ret);
 }
 
-static bool
-_mongoc_collection_update_or_replace (mongoc_collection_t *collection,
-                                      const bson_t *selector,
-                                      const bson_t *update,
-                                      mongoc_update_opts_t *update_opts,
-                                      bool multi,
-                                      bool bypass,
-                                      const bson_t *array_filters,
-                                      bson_t *extra,
-                                      bson_t *reply,
-                                      bson_error_t *error)
-{
-   mongoc_write_command_t command;
-   mongoc_write_result_t result;
-   mongoc_server_stream_t *server_stream = NULL;
-   bool reply_initialized = false;
-   bool ret = false;
-
-   ENTRY;
-
-   BSON_ASSERT_PARAM (collection);
-   BSON_ASSERT_PARAM (selector);
-   BSON_ASSERT_PARAM (update);
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_collection_init_update_command --
+ *
+ *       Initialize @command as an update of the documents matching
+ *       @selector, with the options in @update_opts and @array_filters
+ *       appended to @extra. Shared with mongoc_reactor_update_one and
+ *       friends.
+ *
+ *--------------------------------------------------------------------------
+ */
 
+void
+_mongoc_collection_init_update_command (
+   mongoc_collection_t *collection,
+   mongoc_write_command_t *command,
+   const bson_t *selector,
+   const bson_t *update,
+   const mongoc_update_opts_t *update_opts,
+   bool multi,
+   bool bypass,
+   const bson_t *array_filters,
+   bson_t *extra)
+{
    if (update_opts->upsert) {
       bson_append_bool (extra, "upsert", 6, true);
    }
@@ -2055,22 +2056,61 @@ _mongoc_collection_update_or_replace (mongoc_collection_t *collection,
       bson_append_bool (extra, "multi", 5, true);
    }
 
-   _mongoc_write_result_init (&result);
    _mongoc_write_command_init_update_idl (
-      &command,
+      command,
       selector,
       update,
       extra,
       ++collection->client->cluster.operation_id);
 
-   command.flags.has_multi_write = multi;
-   command.flags.bypass_document_validation = bypass;
+   command->flags.has_multi_write = multi;
+   command->flags.bypass_document_validation = bypass;
    if (!bson_empty (&update_opts->collation)) {
-      command.flags.has_collation = true;
+      command->flags.has_collation = true;
    }
    if (update_opts->hint.value_type) {
-      command.flags.has_update_hint = true;
+      command->flags.has_update_hint = true;
+   }
+   if (!bson_empty0 (array_filters)) {
+      command->flags.has_array_filters = true;
    }
+}
+
+
+static bool
+_mongoc_collection_update_or_replace (mongoc_collection_t *collection,
+                                      const bson_t *selector,
+                                      const bson_t *update,
+                                      mongoc_update_opts_t *update_opts,
+                                      bool multi,
+                                      bool bypass,
+                                      const bson_t *array_filters,
+                                      bson_t *extra,
+                                      bson_t *reply,
+                                      bson_error_t *error)
+{
+   mongoc_write_command_t command;
+   mongoc_write_result_t result;
+   mongoc_server_stream_t *server_stream = NULL;
+   bool reply_initialized = false;
+   bool ret = false;
+
+   ENTRY;
+
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (selector);
+   BSON_ASSERT_PARAM (update);
+
+   _mongoc_write_result_init (&result);
+   _mongoc_collection_init_update_command (collection,
+                                           &command,
+                                           selector,
+                                           update,
+                                           update_opts,
+                                           multi,
+                                           bypass,
+                                           array_filters,
+                                           extra);
 
    server_stream =
       mongoc_cluster_stream_for_writes (&collection->client->cluster,
@@ -2467,27 +2507,29 @@ mongoc_collection_delete (mongoc_collection_t *collection,
 }
 
 
-static bool
-_mongoc_delete_one_or_many (mongoc_collection_t *collection,
-                            bool multi,
-                            const bson_t *selector,
-                            mongoc_delete_opts_t *delete_opts,
-                            const bson_t *cmd_opts,
-                            bson_t *opts,
-                            bson_t *reply,
-                            bson_error_t *error)
-{
-   mongoc_write_command_t command;
-   mongoc_write_result_t result;
-   bool ret;
-
-   ENTRY;
-
-   BSON_ASSERT_PARAM (collection);
-   BSON_ASSERT_PARAM (selector);
-   BSON_ASSERT (bson_empty0 (reply));
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_collection_init_delete_command --
+ *
+ *       Initialize @command as a delete of one or, if @multi, all
+ *       documents matching @selector, with the options in @delete_opts
+ *       appended to @opts. Shared with mongoc_reactor_delete_one and
+ *       mongoc_reactor_delete_many.
+ *
+ *--------------------------------------------------------------------------
+ */
 
-   _mongoc_write_result_init (&result);
+void
+_mongoc_collection_init_delete_command (
+   mongoc_collection_t *collection,
+   mongoc_write_command_t *command,
+   bool multi,
+   const bson_t *selector,
+   const mongoc_delete_opts_t *delete_opts,
+   const bson_t *cmd_opts,
+   bson_t *opts)
+{
    bson_append_int32 (opts, "limit", 5, multi ? 0 : 1);
 
    if (!bson_empty (&delete_opts->collation)) {
@@ -2499,19 +2541,45 @@ _mongoc_delete_one_or_many (mongoc_collection_t *collection,
    }
 
    _mongoc_write_command_init_delete_idl (
-      &command,
+      command,
       selector,
       cmd_opts,
       opts,
       ++collection->client->cluster.operation_id);
 
-   command.flags.has_multi_write = multi;
+   command->flags.has_multi_write = multi;
    if (!bson_empty (&delete_opts->collation)) {
-      command.flags.has_collation = true;
+      command->flags.has_collation = true;
    }
    if (delete_opts->hint.value_type) {
-      command.flags.has_delete_hint = true;
+      command->flags.has_delete_hint = true;
    }
+}
+
+
+static bool
+_mongoc_delete_one_or_many (mongoc_collection_t *collection,
+                            bool multi,
+                            const bson_t *selector,
+                            mongoc_delete_opts_t *delete_opts,
+                            const bson_t *cmd_opts,
+                            bson_t *opts,
+                            bson_t *reply,
+                            bson_error_t *error)
+{
+   mongoc_write_command_t command;
+   mongoc_write_result_t result;
+   bool ret;
+
+   ENTRY;
+
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (selector);
+   BSON_ASSERT (bson_empty0 (reply));
+
+   _mongoc_write_result_init (&result);
+   _mongoc_collection_init_delete_command (
+      collection, &command, multi, selector, delete_opts, cmd_opts, opts);
 
    _mongoc_collection_write_command_execute_idl (
       &command, collection, &delete_opts->crud, &result);
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-prelude.h"
+
+#ifndef MONGOC_CONNECTION_POOL_PRIVATE_H
+#define MONGOC_CONNECTION_POOL_PRIVATE_H
+
+#include <bson/bson.h>
+
+#include "mongoc-set-private.h"
+#include "mongoc-thread-private.h"
+
+BSON_BEGIN_DECLS
+
+/* default for the maxConnecting URI option */
+#define MONGOC_DEFAULT_MAX_CONNECTING 2
+
+struct _mongoc_cluster_node_t;
+
+/* Connections not in use by any client of a mongoc_client_pool_t. A pooled
+ * client checks a connection out of here when an operation needs one, and
+ * back in when the operation is done, so clients share connections instead
+ * of each holding one per server. See mongoc_cluster_fetch_stream_pooled. */
+typedef struct _mongoc_connection_pool_t {
+   bson_mutex_t mutex;
+   /* signaled when a connection is checked in or an attempt to connect ends */
+   mongoc_cond_t cond;
+   /* server id -> mongoc_connection_pool_server_t */
+   mongoc_set_t *servers;
+} mongoc_connection_pool_t;
+
+typedef struct _mongoc_connection_pool_server_t {
+   /* idle connections linked by node->next, most recently used first after
+    * those that owe the reply to a hedged read */
+   struct _mongoc_cluster_node_t *idle;
+   size_t n_idle;
+   /* connections being established, at most maxConnecting */
+   int32_t n_connecting;
+} mongoc_connection_pool_server_t;
+
+mongoc_connection_pool_t *
+mongoc_connection_pool_new (void);
+
+void
+mongoc_connection_pool_destroy (mongoc_connection_pool_t *pool);
+
+struct _mongoc_cluster_node_t *
+mongoc_connection_pool_checkout (mongoc_connection_pool_t *pool,
+                                 uint32_t server_id);
+
+void
+mongoc_connection_pool_checkin (mongoc_connection_pool_t *pool,
+                                uint32_t server_id,
+                                struct _mongoc_cluster_node_t *node);
+
+bool
+mongoc_connection_pool_checkout_or_reserve (
+   mongoc_connection_pool_t *pool,
+   uint32_t server_id,
+   int32_t max_connecting,
+   int64_t timeout_msec,
+   struct _mongoc_cluster_node_t **node);
+
+bool
+mongoc_connection_pool_reserve_warm (mongoc_connection_pool_t *pool,
+                                     uint32_t server_id,
+                                     size_t n_idle,
+                                     int32_t max_connecting,
+                                     int64_t timeout_msec,
+                                     bool *reserved);
+
+void
+mongoc_connection_pool_end_connect (mongoc_connection_pool_t *pool,
+                                    uint32_t server_id);
+
+void
+mongoc_connection_pool_prune (mongoc_connection_pool_t *pool,
+                              uint32_t server_id,
+                              uint32_t generation);
+
+void
+mongoc_connection_pool_purge (mongoc_connection_pool_t *pool,
+                              uint32_t server_id);
+
+void
+mongoc_connection_pool_purge_removed (mongoc_connection_pool_t *pool,
+                                      const uint32_t *server_ids,
+                                      size_t n_server_ids);
+
+size_t
+mongoc_connection_pool_reap (mongoc_connection_pool_t *pool,
+                             int64_t max_idle_usec);
+
+size_t
+mongoc_connection_pool_count_idle (mongoc_connection_pool_t *pool);
+
+size_t
+mongoc_connection_pool_count_idle_for_server (mongoc_connection_pool_t *pool,
+                                              uint32_t server_id);
+
+BSON_END_DECLS
+
+#endif /* MONGOC_CONNECTION_POOL_PRIVATE_H */
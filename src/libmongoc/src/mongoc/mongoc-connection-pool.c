@@ -0,0 +1,504 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-connection-pool-private.h"
+#include "mongoc-cluster-private.h"
+
+#undef MONGOC_LOG_DOMAIN
+#define MONGOC_LOG_DOMAIN "connection-pool"
+
+
+static void
+_server_dtor (void *item, void *ctx)
+{
+   mongoc_connection_pool_server_t *server =
+      (mongoc_connection_pool_server_t *) item;
+   mongoc_cluster_node_t *node;
+
+   while ((node = server->idle)) {
+      server->idle = node->next;
+      _mongoc_cluster_node_destroy (node);
+   }
+
+   bson_free (server);
+}
+
+
+mongoc_connection_pool_t *
+mongoc_connection_pool_new (void)
+{
+   mongoc_connection_pool_t *pool;
+
+   pool = (mongoc_connection_pool_t *) bson_malloc0 (sizeof *pool);
+   bson_mutex_init (&pool->mutex);
+   mongoc_cond_init (&pool->cond);
+   pool->servers = mongoc_set_new (8, _server_dtor, NULL);
+
+   return pool;
+}
+
+
+void
+mongoc_connection_pool_destroy (mongoc_connection_pool_t *pool)
+{
+   if (!pool) {
+      return;
+   }
+
+   mongoc_set_destroy (pool->servers);
+   mongoc_cond_destroy (&pool->cond);
+   bson_mutex_destroy (&pool->mutex);
+   bson_free (pool);
+}
+
+
+/* the caller must lock the pool's mutex */
+static mongoc_connection_pool_server_t *
+_get_server (mongoc_connection_pool_t *pool, uint32_t server_id)
+{
+   mongoc_connection_pool_server_t *server;
+
+   server = (mongoc_connection_pool_server_t *) mongoc_set_get (pool->servers,
+                                                                server_id);
+   if (!server) {
+      server = (mongoc_connection_pool_server_t *) bson_malloc0 (
+         sizeof *server);
+      mongoc_set_add (pool->servers, server_id, server);
+   }
+
+   return server;
+}
+
+
+/* the caller must lock the pool's mutex */
+static mongoc_cluster_node_t *
+_pop_idle (mongoc_connection_pool_server_t *server)
+{
+   mongoc_cluster_node_t *node = server->idle;
+
+   if (node) {
+      server->idle = node->next;
+      server->n_idle--;
+      node->next = NULL;
+   }
+
+   return node;
+}
+
+
+/* take the most recently used idle connection to @server_id, or NULL. the
+ * caller checks whether the connection is still current. */
+mongoc_cluster_node_t *
+mongoc_connection_pool_checkout (mongoc_connection_pool_t *pool,
+                                 uint32_t server_id)
+{
+   mongoc_connection_pool_server_t *server;
+   mongoc_cluster_node_t *node = NULL;
+
+   bson_mutex_lock (&pool->mutex);
+   server = (mongoc_connection_pool_server_t *) mongoc_set_get (pool->servers,
+                                                                server_id);
+   if (server) {
+      node = _pop_idle (server);
+   }
+
+   bson_mutex_unlock (&pool->mutex);
+
+   return node;
+}
+
+
+/* the caller must lock the pool's mutex. wait for the pool's condition
+ * until @expire_at_ms, return false if it has passed. */
+static bool
+_wait (mongoc_connection_pool_t *pool, int64_t expire_at_ms)
+{
+   int64_t now_ms = bson_get_monotonic_time () / 1000;
+
+   if (now_ms >= expire_at_ms) {
+      return false;
+   }
+
+   mongoc_cond_timedwait (&pool->cond, &pool->mutex, expire_at_ms - now_ms);
+
+   return true;
+}
+
+
+/* like mongoc_connection_pool_checkout, but if there is no idle connection,
+ * reserve the right to open one and set @node to NULL. at most
+ * @max_connecting connections to a server are established at once, a thread
+ * over the limit waits for an idle connection or for another attempt to end.
+ * returns false if that takes longer than @timeout_msec. after reserving, the
+ * caller connects and calls mongoc_connection_pool_end_connect. */
+bool
+mongoc_connection_pool_checkout_or_reserve (mongoc_connection_pool_t *pool,
+                                            uint32_t server_id,
+                                            int32_t max_connecting,
+                                            int64_t timeout_msec,
+                                            mongoc_cluster_node_t **node)
+{
+   mongoc_connection_pool_server_t *server;
+   int64_t expire_at_ms = bson_get_monotonic_time () / 1000 + timeout_msec;
+   bool ok = true;
+
+   bson_mutex_lock (&pool->mutex);
+   server = _get_server (pool, server_id);
+
+   while (!(*node = _pop_idle (server))) {
+      if (server->n_connecting < BSON_MAX (max_connecting, 1)) {
+         server->n_connecting++;
+         break;
+      }
+
+      if (!_wait (pool, expire_at_ms)) {
+         ok = false;
+         break;
+      }
+   }
+
+   bson_mutex_unlock (&pool->mutex);
+
+   return ok;
+}
+
+
+/* reserve the right to open a connection to @server_id to add to the pool,
+ * unless it already has @n_idle idle connections, in which case set
+ * @reserved to false. connections that other threads are establishing count
+ * toward @n_idle: wait for them rather than opening more. returns false if
+ * waiting takes longer than @timeout_msec. */
+bool
+mongoc_connection_pool_reserve_warm (mongoc_connection_pool_t *pool,
+                                     uint32_t server_id,
+                                     size_t n_idle,
+                                     int32_t max_connecting,
+                                     int64_t timeout_msec,
+                                     bool *reserved)
+{
+   mongoc_connection_pool_server_t *server;
+   int64_t expire_at_ms = bson_get_monotonic_time () / 1000 + timeout_msec;
+   bool ok = true;
+
+   *reserved = false;
+
+   bson_mutex_lock (&pool->mutex);
+   server = _get_server (pool, server_id);
+
+   for (;;) {
+      if (server->n_idle >= n_idle) {
+         break;
+      }
+
+      if (server->n_idle + (size_t) server->n_connecting < n_idle &&
+          server->n_connecting < BSON_MAX (max_connecting, 1)) {
+         server->n_connecting++;
+         *reserved = true;
+         break;
+      }
+
+      if (!_wait (pool, expire_at_ms)) {
+         ok = false;
+         break;
+      }
+   }
+
+   bson_mutex_unlock (&pool->mutex);
+
+   return ok;
+}
+
+
+/* release a reservation made by mongoc_connection_pool_checkout_or_reserve
+ * or mongoc_connection_pool_reserve_warm, whether or not connecting worked */
+void
+mongoc_connection_pool_end_connect (mongoc_connection_pool_t *pool,
+                                    uint32_t server_id)
+{
+   mongoc_connection_pool_server_t *server;
+
+   bson_mutex_lock (&pool->mutex);
+   server = _get_server (pool, server_id);
+   BSON_ASSERT (server->n_connecting > 0);
+   server->n_connecting--;
+   mongoc_cond_broadcast (&pool->cond);
+   bson_mutex_unlock (&pool->mutex);
+}
+
+
+/* close idle connections to @server_id older than @generation */
+void
+mongoc_connection_pool_prune (mongoc_connection_pool_t *pool,
+                              uint32_t server_id,
+                              uint32_t generation)
+{
+   mongoc_connection_pool_server_t *server;
+   mongoc_cluster_node_t **link;
+   mongoc_cluster_node_t *node;
+   mongoc_cluster_node_t *stale = NULL;
+
+   bson_mutex_lock (&pool->mutex);
+   server = (mongoc_connection_pool_server_t *) mongoc_set_get (pool->servers,
+                                                                server_id);
+   link = server ? &server->idle : NULL;
+   while (link && (node = *link)) {
+      if (node->generation < generation) {
+         *link = node->next;
+         server->n_idle--;
+         node->next = stale;
+         stale = node;
+      } else {
+         link = &node->next;
+      }
+   }
+
+   bson_mutex_unlock (&pool->mutex);
+
+   /* close sockets without holding the lock */
+   while ((node = stale)) {
+      stale = node->next;
+      _mongoc_cluster_node_destroy (node);
+   }
+}
+
+
+/* the caller must lock the pool's mutex */
+static void
+_take_all_idle (mongoc_connection_pool_server_t *server,
+                mongoc_cluster_node_t **taken)
+{
+   mongoc_cluster_node_t *node;
+
+   while ((node = _pop_idle (server))) {
+      node->next = *taken;
+      *taken = node;
+   }
+}
+
+
+static void
+_destroy_nodes (mongoc_cluster_node_t *nodes)
+{
+   mongoc_cluster_node_t *node;
+
+   while ((node = nodes)) {
+      nodes = node->next;
+      _mongoc_cluster_node_destroy (node);
+   }
+}
+
+
+/* close all idle connections to @server_id, e.g. after a network error */
+void
+mongoc_connection_pool_purge (mongoc_connection_pool_t *pool,
+                              uint32_t server_id)
+{
+   mongoc_connection_pool_server_t *server;
+   mongoc_cluster_node_t *purged = NULL;
+
+   bson_mutex_lock (&pool->mutex);
+   server = (mongoc_connection_pool_server_t *) mongoc_set_get (pool->servers,
+                                                                server_id);
+   if (server) {
+      _take_all_idle (server, &purged);
+   }
+
+   bson_mutex_unlock (&pool->mutex);
+
+   /* close sockets without holding the lock */
+   _destroy_nodes (purged);
+}
+
+
+static bool
+_contains_id (const uint32_t *ids, size_t n_ids, uint32_t id)
+{
+   size_t i;
+
+   for (i = 0; i < n_ids; i++) {
+      if (ids[i] == id) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+
+/* close idle connections to servers other than the @n_server_ids in
+ * @server_ids, the topology description's servers, and forget those servers
+ * unless a thread is connecting to one. */
+void
+mongoc_connection_pool_purge_removed (mongoc_connection_pool_t *pool,
+                                      const uint32_t *server_ids,
+                                      size_t n_server_ids)
+{
+   mongoc_connection_pool_server_t *server;
+   mongoc_cluster_node_t *purged = NULL;
+   uint32_t server_id;
+   size_t i;
+
+   bson_mutex_lock (&pool->mutex);
+   i = 0;
+   while (i < pool->servers->items_len) {
+      server = (mongoc_connection_pool_server_t *) mongoc_set_get_item_and_id (
+         pool->servers, (int) i, &server_id);
+      if (_contains_id (server_ids, n_server_ids, server_id)) {
+         i++;
+         continue;
+      }
+
+      _take_all_idle (server, &purged);
+      if (server->n_connecting) {
+         i++;
+      } else {
+         mongoc_set_rm (pool->servers, server_id);
+      }
+   }
+
+   bson_mutex_unlock (&pool->mutex);
+
+   /* close sockets without holding the lock */
+   _destroy_nodes (purged);
+}
+
+
+void
+mongoc_connection_pool_checkin (mongoc_connection_pool_t *pool,
+                                uint32_t server_id,
+                                mongoc_cluster_node_t *node)
+{
+   mongoc_connection_pool_server_t *server;
+   mongoc_cluster_node_t **link;
+
+   BSON_ASSERT (!node->in_use);
+
+   bson_mutex_lock (&pool->mutex);
+   server = _get_server (pool, server_id);
+   node->last_used_usec = bson_get_monotonic_time ();
+   /* connections that owe the reply to a hedged read stay first, so that
+    * checkouts read and discard it. see mongoc_cluster_run_command_hedged */
+   link = &server->idle;
+   while (!node->hedge_drain && *link && (*link)->hedge_drain) {
+      link = &(*link)->next;
+   }
+
+   node->next = *link;
+   *link = node;
+   server->n_idle++;
+   mongoc_cond_broadcast (&pool->cond);
+   bson_mutex_unlock (&pool->mutex);
+}
+
+
+typedef struct {
+   int64_t expire_before_usec;
+   mongoc_cluster_node_t *reaped;
+   size_t n_reaped;
+} _reap_ctx_t;
+
+
+static bool
+_reap_cb (void *item, void *ctx_void)
+{
+   mongoc_connection_pool_server_t *server =
+      (mongoc_connection_pool_server_t *) item;
+   _reap_ctx_t *ctx = (_reap_ctx_t *) ctx_void;
+   mongoc_cluster_node_t **link = &server->idle;
+   mongoc_cluster_node_t *node;
+
+   while ((node = *link)) {
+      if (node->last_used_usec < ctx->expire_before_usec) {
+         *link = node->next;
+         server->n_idle--;
+         node->next = ctx->reaped;
+         ctx->reaped = node;
+         ctx->n_reaped++;
+      } else {
+         link = &node->next;
+      }
+   }
+
+   return true;
+}
+
+
+/* close connections idle longer than @max_idle_usec, which checkouts would
+ * discard anyway. returns the number closed. */
+size_t
+mongoc_connection_pool_reap (mongoc_connection_pool_t *pool,
+                             int64_t max_idle_usec)
+{
+   _reap_ctx_t ctx;
+   mongoc_cluster_node_t *node;
+
+   ctx.expire_before_usec = bson_get_monotonic_time () - max_idle_usec;
+   ctx.reaped = NULL;
+   ctx.n_reaped = 0;
+
+   bson_mutex_lock (&pool->mutex);
+   mongoc_set_for_each (pool->servers, _reap_cb, &ctx);
+   bson_mutex_unlock (&pool->mutex);
+
+   /* close sockets without holding the lock */
+   while ((node = ctx.reaped)) {
+      ctx.reaped = node->next;
+      _mongoc_cluster_node_destroy (node);
+   }
+
+   return ctx.n_reaped;
+}
+
+
+static bool
+_count_idle_cb (void *item, void *ctx)
+{
+   *(size_t *) ctx += ((mongoc_connection_pool_server_t *) item)->n_idle;
+   return true;
+}
+
+
+size_t
+mongoc_connection_pool_count_idle (mongoc_connection_pool_t *pool)
+{
+   size_t n = 0;
+
+   bson_mutex_lock (&pool->mutex);
+   mongoc_set_for_each (pool->servers, _count_idle_cb, &n);
+   bson_mutex_unlock (&pool->mutex);
+
+   return n;
+}
+
+
+size_t
+mongoc_connection_pool_count_idle_for_server (mongoc_connection_pool_t *pool,
+                                              uint32_t server_id)
+{
+   mongoc_connection_pool_server_t *server;
+   size_t n = 0;
+
+   bson_mutex_lock (&pool->mutex);
+   server = (mongoc_connection_pool_server_t *) mongoc_set_get (pool->servers,
+                                                                server_id);
+   if (server) {
+      n = server->n_idle;
+   }
+
+   bson_mutex_unlock (&pool->mutex);
+
+   return n;
+}
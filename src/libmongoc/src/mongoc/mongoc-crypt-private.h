@@ -85,6 +85,28 @@ _mongoc_crypt_explicit_encrypt (_mongoc_crypt_t *crypt,
                                 bson_value_t *value_out,
                                 bson_error_t *error);
 
+/* The options to explicitly encrypt one value of a batch. */
+typedef struct {
+   const char *algorithm;
+   const bson_value_t *keyid;
+   const char *keyaltname;
+} _mongoc_crypt_encrypt_opts_t;
+
+/*
+Perform explicit encryption of n_values values, with opts[i] for values_in[i].
+- keys are fetched and decrypted once for the whole batch.
+- each of values_out is always initialized.
+- may return false and set error.
+*/
+bool
+_mongoc_crypt_explicit_encrypt_many (_mongoc_crypt_t *crypt,
+                                     mongoc_collection_t *key_vault_coll,
+                                     const _mongoc_crypt_encrypt_opts_t *opts,
+                                     const bson_value_t *values_in,
+                                     size_t n_values,
+                                     bson_value_t *values_out,
+                                     bson_error_t *error);
+
 /*
 Perform explicit decryption.
 - value_out is always initialized.
@@ -96,6 +118,19 @@ _mongoc_crypt_explicit_decrypt (_mongoc_crypt_t *crypt,
                                 const bson_value_t *value_in,
                                 bson_value_t *value_out,
                                 bson_error_t *error);
+
+/*
+Perform explicit decryption of n_values values with one libmongocrypt context.
+- each of values_out is always initialized.
+- may return false and set error.
+*/
+bool
+_mongoc_crypt_explicit_decrypt_many (_mongoc_crypt_t *crypt,
+                                     mongoc_collection_t *key_vault_coll,
+                                     const bson_value_t *values_in,
+                                     size_t n_values,
+                                     bson_value_t *values_out,
+                                     bson_error_t *error);
 /*
 Create a data key document (does not insert into key vault).
 - keyaltnames may be NULL.
@@ -111,5 +146,10 @@ _mongoc_crypt_create_datakey (_mongoc_crypt_t *crypt,
                               bson_t *doc_out,
                               bson_error_t *error);
 
+/* Connect to KMS servers with @opts instead of the default TLS options, for
+ * testing. Pass NULL to restore the defaults. */
+void
+_mongoc_crypt_set_kms_ssl_opts (const mongoc_ssl_opt_t *opts);
+
 #endif /* MONGOC_ENABLE_CLIENT_SIDE_ENCRYPTION */
 #endif /* MONGOC_CRYPT_PRIVATE_H */
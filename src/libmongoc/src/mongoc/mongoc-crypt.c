@@ -24,13 +24,36 @@
 
 #include "mongoc-client-private.h"
 #include "mongoc-collection-private.h"
+#include "mongoc-dns-cache-private.h"
 #include "mongoc-host-list-private.h"
+#include "mongoc-socket-private.h"
 #include "mongoc-stream-private.h"
+#include "mongoc-thread-private.h"
+#include "mongoc-trace-private.h"
+#include "utlist.h"
+
+/* The most idle KMS connections kept open per _mongoc_crypt_t. */
+#define MONGOC_CRYPT_MAX_IDLE_KMS_STREAMS 8
+
+/* An idle keep-alive connection to a KMS endpoint. */
+typedef struct _kms_stream_list_t {
+   struct _kms_stream_list_t *next;
+   char *endpoint;
+   mongoc_stream_t *stream;
+} kms_stream_list_t;
 
 struct __mongoc_crypt_t {
    mongocrypt_t *handle;
+   /* connections from finished KMS requests, reused by later requests to the
+    * same endpoint. */
+   kms_stream_list_t *kms_streams;
+   int kms_streams_count;
+   bson_mutex_t kms_streams_mutex;
 };
 
+/* NULL means the default TLS options. */
+static const mongoc_ssl_opt_t *kms_ssl_opts;
+
 static void
 _log_callback (mongocrypt_log_level_t mongocrypt_log_level,
                const char *message,
@@ -188,23 +211,39 @@ _bin_to_static_bson (mongocrypt_binary_t *bin, bson_t *out, bson_error_t *error)
 
 
 typedef struct {
+   _mongoc_crypt_t *crypt;
    mongocrypt_ctx_t *ctx;
    mongoc_collection_t *keyvault_coll;
    mongoc_client_t *mongocryptd_client;
    mongoc_client_t *collinfo_client;
    const char *db_name;
+   /* for explicit encryption: the value to encrypt, and the key to encrypt
+    * it with, either keyid or keyaltname. */
+   bson_t *explicit_input;
+   mongocrypt_binary_t *explicit_input_bin;
+   const bson_value_t *keyid;
+   const char *keyaltname;
 } _state_machine_t;
 
 _state_machine_t *
-_state_machine_new (void)
+_state_machine_new (_mongoc_crypt_t *crypt)
 {
-   return bson_malloc0 (sizeof (_state_machine_t));
+   _state_machine_t *state_machine;
+
+   state_machine = bson_malloc0 (sizeof (_state_machine_t));
+   state_machine->crypt = crypt;
+   return state_machine;
 }
 
 void
 _state_machine_destroy (_state_machine_t *state_machine)
 {
+   if (!state_machine) {
+      return;
+   }
    mongocrypt_ctx_destroy (state_machine->ctx);
+   mongocrypt_binary_destroy (state_machine->explicit_input_bin);
+   bson_destroy (state_machine->explicit_input);
    bson_free (state_machine);
 }
 
@@ -401,166 +440,677 @@ fail:
    return ret;
 }
 
-static mongoc_stream_t *
-_get_stream (const char *endpoint,
-             int32_t connecttimeoutms,
-             bson_error_t *error)
+/* Is @key_doc the key explicit encryption with @state_machine asks for? */
+static bool
+_key_matches (const _state_machine_t *state_machine, const bson_t *key_doc)
 {
-   mongoc_stream_t *base_stream = NULL;
-   mongoc_stream_t *tls_stream = NULL;
-   bool ret = false;
-   mongoc_ssl_opt_t ssl_opts = {0};
-   mongoc_host_list_t host;
-   char *host_and_port = NULL;
+   bson_iter_t iter;
+   bson_iter_t child;
+   const bson_value_t *keyid = state_machine->keyid;
+   const bson_value_t *value;
+
+   if (state_machine->keyaltname) {
+      if (!bson_iter_init_find (&iter, key_doc, "keyAltNames") ||
+          !BSON_ITER_HOLDS_ARRAY (&iter) ||
+          !bson_iter_recurse (&iter, &child)) {
+         return false;
+      }
 
-   if (!strchr (endpoint, ':')) {
-      host_and_port = bson_strdup_printf ("%s:443", endpoint);
-   } else {
-      host_and_port = (char *) endpoint; /* we promise not to modify */
+      while (bson_iter_next (&child)) {
+         if (BSON_ITER_HOLDS_UTF8 (&child) &&
+             !strcmp (bson_iter_utf8 (&child, NULL),
+                      state_machine->keyaltname)) {
+            return true;
+         }
+      }
+
+      return false;
    }
 
-   if (!_mongoc_host_list_from_string_with_err (&host, host_and_port, error)) {
-      goto fail;
+   if (!keyid || !bson_iter_init_find (&iter, key_doc, "_id")) {
+      return false;
+   }
+
+   value = bson_iter_value (&iter);
+   return value->value_type == BSON_TYPE_BINARY &&
+          value->value.v_binary.data_len == keyid->value.v_binary.data_len &&
+          !memcmp (value->value.v_binary.data,
+                   keyid->value.v_binary.data,
+                   keyid->value.v_binary.data_len);
+}
+
+/* State handler MONGOCRYPT_CTX_NEED_MONGO_KEYS for several explicit
+ * encryption contexts at once: find all their keys with one query, and feed
+ * each context the key it asked for. */
+static bool
+_state_need_mongo_keys_many (_state_machine_t **state_machines,
+                             size_t n_state_machines,
+                             bson_error_t *error)
+{
+   bool ret = false;
+   mongocrypt_binary_t *filter_bin = NULL;
+   bson_t filter_bson;
+   bson_t or_filters = BSON_INITIALIZER;
+   bson_t filter = BSON_INITIALIZER;
+   bson_t opts = BSON_INITIALIZER;
+   mongocrypt_binary_t *key_bin = NULL;
+   const bson_t *key_bson;
+   mongoc_cursor_t *cursor = NULL;
+   mongoc_read_concern_t *rc = NULL;
+   _state_machine_t *state_machine;
+   const char *key;
+   char buf[16];
+   size_t i;
+
+   for (i = 0; i < n_state_machines; i++) {
+      state_machine = state_machines[i];
+      mongocrypt_binary_destroy (filter_bin);
+      filter_bin = mongocrypt_binary_new ();
+      if (!mongocrypt_ctx_mongo_op (state_machine->ctx, filter_bin)) {
+         _ctx_check_error (state_machine->ctx, error, true);
+         goto fail;
+      }
+
+      if (!_bin_to_static_bson (filter_bin, &filter_bson, error)) {
+         _ctx_check_error (state_machine->ctx, error, true);
+         goto fail;
+      }
+
+      bson_uint32_to_string ((uint32_t) i, &key, buf, sizeof buf);
+      BSON_APPEND_DOCUMENT (&or_filters, key, &filter_bson);
    }
 
-   base_stream = mongoc_client_connect_tcp (connecttimeoutms, &host, error);
-   if (!base_stream) {
+   BSON_APPEND_ARRAY (&filter, "$or", &or_filters);
+
+   rc = mongoc_read_concern_new ();
+   mongoc_read_concern_set_level (rc, MONGOC_READ_CONCERN_LEVEL_MAJORITY);
+   if (!mongoc_read_concern_append (rc, &opts)) {
+      bson_set_error (error,
+                      MONGOC_ERROR_BSON,
+                      MONGOC_ERROR_BSON_INVALID,
+                      "%s",
+                      "could not set read concern");
       goto fail;
    }
 
-   /* Wrap in a tls_stream. */
-   memcpy (&ssl_opts, mongoc_ssl_opt_get_default (), sizeof ssl_opts);
-   tls_stream = mongoc_stream_tls_new_with_hostname (
-      base_stream, host.host, &ssl_opts, 1 /* client */);
+   cursor = mongoc_collection_find_with_opts (state_machines[0]->keyvault_coll,
+                                              &filter,
+                                              &opts,
+                                              NULL /* read prefs */);
+   while (mongoc_cursor_next (cursor, &key_bson)) {
+      mongocrypt_binary_destroy (key_bin);
+      key_bin = mongocrypt_binary_new_from_data (
+         (uint8_t *) bson_get_data (key_bson), key_bson->len);
+      for (i = 0; i < n_state_machines; i++) {
+         state_machine = state_machines[i];
+         if (!_key_matches (state_machine, key_bson)) {
+            continue;
+         }
 
-   if (!mongoc_stream_tls_handshake_block (
-          tls_stream, host.host, connecttimeoutms, error)) {
+         if (!mongocrypt_ctx_mongo_feed (state_machine->ctx, key_bin)) {
+            _ctx_check_error (state_machine->ctx, error, true);
+            goto fail;
+         }
+      }
+   }
+   if (mongoc_cursor_error (cursor, error)) {
+      _prefix_keyvault_error (error);
       goto fail;
    }
 
+   for (i = 0; i < n_state_machines; i++) {
+      state_machine = state_machines[i];
+      if (!mongocrypt_ctx_mongo_done (state_machine->ctx)) {
+         _ctx_check_error (state_machine->ctx, error, true);
+         goto fail;
+      }
+   }
+
    ret = true;
 fail:
+   mongocrypt_binary_destroy (filter_bin);
+   mongoc_cursor_destroy (cursor);
+   mongoc_read_concern_destroy (rc);
+   bson_destroy (&or_filters);
+   bson_destroy (&filter);
+   bson_destroy (&opts);
+   mongocrypt_binary_destroy (key_bin);
+   return ret;
+}
+
+/* Parse a KMS endpoint, which defaults to port 443. */
+static bool
+_kms_endpoint_to_host (const char *endpoint,
+                       mongoc_host_list_t *host,
+                       bson_error_t *error)
+{
+   char *host_and_port = NULL;
+   bool ret;
+
+   if (!strchr (endpoint, ':')) {
+      host_and_port = bson_strdup_printf ("%s:443", endpoint);
+   } else {
+      host_and_port = (char *) endpoint; /* we promise not to modify */
+   }
+
+   ret = _mongoc_host_list_from_string_with_err (host, host_and_port, error);
+
    if (host_and_port != endpoint) {
       bson_free (host_and_port);
    }
-   if (!ret) {
-      if (tls_stream) {
-         /* destroys base_stream too */
-         mongoc_stream_destroy (tls_stream);
-      } else if (base_stream) {
-         mongoc_stream_destroy (base_stream);
+
+   return ret;
+}
+
+/* Take an idle connection to @endpoint from @crypt, or return NULL. */
+static mongoc_stream_t *
+_kms_stream_take (_mongoc_crypt_t *crypt, const char *endpoint)
+{
+   kms_stream_list_t *iter;
+   kms_stream_list_t *tmp;
+   mongoc_stream_t *stream = NULL;
+
+   bson_mutex_lock (&crypt->kms_streams_mutex);
+   LL_FOREACH_SAFE (crypt->kms_streams, iter, tmp)
+   {
+      if (strcmp (iter->endpoint, endpoint) != 0) {
+         continue;
       }
-      return NULL;
+
+      LL_DELETE (crypt->kms_streams, iter);
+      crypt->kms_streams_count--;
+      stream = iter->stream;
+      bson_free (iter->endpoint);
+      bson_free (iter);
+
+      if (!mongoc_stream_check_closed (stream)) {
+         break;
+      }
+
+      /* the server closed it while it was idle. */
+      mongoc_stream_destroy (stream);
+      stream = NULL;
    }
-   return tls_stream;
+
+   bson_mutex_unlock (&crypt->kms_streams_mutex);
+
+   return stream;
 }
 
-static bool
-_state_need_kms (_state_machine_t *state_machine, bson_error_t *error)
+/* Keep @stream open for the next request to @endpoint. */
+static void
+_kms_stream_put (_mongoc_crypt_t *crypt,
+                 const char *endpoint,
+                 mongoc_stream_t *stream)
 {
-   mongocrypt_kms_ctx_t *kms_ctx = NULL;
-   mongoc_stream_t *tls_stream = NULL;
-   bool ret = false;
-   mongocrypt_binary_t *http_req = NULL;
-   mongocrypt_binary_t *http_reply = NULL;
+   kms_stream_list_t *entry;
+
+   bson_mutex_lock (&crypt->kms_streams_mutex);
+   if (crypt->kms_streams_count >= MONGOC_CRYPT_MAX_IDLE_KMS_STREAMS) {
+      bson_mutex_unlock (&crypt->kms_streams_mutex);
+      mongoc_stream_destroy (stream);
+      return;
+   }
+
+   entry = bson_malloc0 (sizeof (kms_stream_list_t));
+   entry->endpoint = bson_strdup (endpoint);
+   entry->stream = stream;
+   LL_PREPEND (crypt->kms_streams, entry);
+   crypt->kms_streams_count++;
+   bson_mutex_unlock (&crypt->kms_streams_mutex);
+}
+
+typedef enum {
+   KMS_OP_CONNECT,
+   KMS_OP_TCP,
+   KMS_OP_HANDSHAKE,
+   KMS_OP_SEND,
+   KMS_OP_REPLY,
+   KMS_OP_DONE
+} _kms_op_state_t;
+
+/* One KMS request in flight. */
+typedef struct {
+   mongocrypt_kms_ctx_t *kms_ctx;
+   mongocrypt_binary_t *http_req;
    const char *endpoint;
-   uint32_t sockettimeout;
+   mongoc_host_list_t host;
+   mongoc_dns_result_t *dns;
+   /* the address being connected to, from dns. */
+   const struct addrinfo *addr;
+   /* the socket of a connection in progress, owned by stream. */
+   mongoc_socket_t *sock;
+   mongoc_stream_t *stream;
+   _kms_op_state_t state;
+   /* the poll events the request is waiting for. */
+   int events;
+   /* the stream is a keep-alive connection from an earlier request. */
+   bool reused;
+   /* part of the reply was fed to libmongocrypt, the request can't be
+    * retried. */
+   bool fed;
+   /* the request was retried on a new connection. */
+   bool retried;
+} _kms_op_t;
+
+/* Begin a non-blocking connection to @op's endpoint, starting at op->addr.
+ * Addresses that can't be connected to are skipped. */
+static bool
+_kms_op_connect (_kms_op_t *op, bson_error_t *error)
+{
+   if (!op->dns) {
+      op->dns = _mongoc_dns_cache_resolve (
+         &op->host, MONGOC_DNS_CACHE_TIMEOUT_MS, error);
+      if (!op->dns) {
+         return false;
+      }
 
-   sockettimeout = MONGOC_DEFAULT_SOCKETTIMEOUTMS;
-   kms_ctx = mongocrypt_ctx_next_kms_ctx (state_machine->ctx);
-   while (kms_ctx) {
-      mongoc_iovec_t iov;
-
-      mongocrypt_binary_destroy (http_req);
-      http_req = mongocrypt_binary_new ();
-      if (!mongocrypt_kms_ctx_message (kms_ctx, http_req)) {
-         _kms_ctx_check_error (kms_ctx, error, true);
-         goto fail;
+      op->addr = op->dns->addrs;
+   }
+
+   for (; op->addr; op->addr = op->addr->ai_next) {
+      op->sock = mongoc_socket_new (op->addr->ai_family,
+                                    op->addr->ai_socktype,
+                                    op->addr->ai_protocol);
+      if (!op->sock) {
+         continue;
       }
 
-      if (!mongocrypt_kms_ctx_endpoint (kms_ctx, &endpoint)) {
-         _kms_ctx_check_error (kms_ctx, error, true);
-         goto fail;
+      /* a zero expire_at returns at once, poll for the result. */
+      (void) mongoc_socket_connect (op->sock,
+                                    op->addr->ai_addr,
+                                    (mongoc_socklen_t) op->addr->ai_addrlen,
+                                    0);
+      op->stream = mongoc_stream_socket_new (op->sock);
+      op->state = KMS_OP_TCP;
+      op->events = POLLOUT;
+      return true;
+   }
+
+   /* the addresses may be stale, look them up again next time. */
+   _mongoc_dns_cache_invalidate (&op->host, op->dns);
+   bson_set_error (error,
+                   MONGOC_ERROR_STREAM,
+                   MONGOC_ERROR_STREAM_CONNECT,
+                   "Failed to connect to KMS endpoint: %s",
+                   op->endpoint);
+   return false;
+}
+
+/* Wrap @op's connected socket in TLS, without handshaking. */
+static bool
+_kms_op_start_tls (_kms_op_t *op, bson_error_t *error)
+{
+   mongoc_stream_t *tls_stream;
+   mongoc_ssl_opt_t ssl_opts = {0};
+
+   memcpy (&ssl_opts,
+           kms_ssl_opts ? kms_ssl_opts : mongoc_ssl_opt_get_default (),
+           sizeof ssl_opts);
+   tls_stream = mongoc_stream_tls_new_with_hostname (
+      op->stream, op->host.host, &ssl_opts, 1 /* client */);
+   if (!tls_stream) {
+      bson_set_error (error,
+                      MONGOC_ERROR_STREAM,
+                      MONGOC_ERROR_STREAM_SOCKET,
+                      "Failed initialize TLS state.");
+      return false;
+   }
+
+   op->stream = tls_stream;
+   op->sock = NULL;
+   return true;
+}
+
+/* Feed as much of @op's reply as has arrived, without waiting. Sets
+ * op->events if more of the reply is due. */
+static bool
+_kms_op_read_reply (_kms_op_t *op, bson_error_t *error)
+{
+#define BUFFER_SIZE 1024
+   uint8_t buf[BUFFER_SIZE];
+   mongocrypt_binary_t *http_reply;
+   uint32_t bytes_needed;
+   ssize_t read_ret;
+   bool fed;
+
+   while ((bytes_needed = mongocrypt_kms_ctx_bytes_needed (op->kms_ctx)) > 0) {
+      /* Cap the bytes requested at the buffer size. */
+      if (bytes_needed > BUFFER_SIZE) {
+         bytes_needed = BUFFER_SIZE;
       }
 
-      mongoc_stream_destroy (tls_stream);
-      tls_stream = _get_stream (endpoint, sockettimeout, error);
-#ifdef MONGOC_ENABLE_SSL_SECURE_CHANNEL
-      /* Retry once with schannel as a workaround for CDRIVER-3566. */
-      if (!tls_stream) {
-         tls_stream = _get_stream (endpoint, sockettimeout, error);
+      read_ret = mongoc_stream_read (
+         op->stream, buf, bytes_needed, 0 /* min_bytes. */, 0);
+      if (read_ret <= 0 && mongoc_stream_should_retry (op->stream)) {
+         /* wait for the rest with the other requests. */
+         op->events = POLLIN;
+         return true;
       }
-#endif
-      if (!tls_stream) {
-         goto fail;
+
+      if (read_ret == -1) {
+         bson_set_error (error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_SOCKET,
+                         "failed to read from KMS stream: %d",
+                         errno);
+         return false;
       }
 
-      iov.iov_base = (char *) mongocrypt_binary_data (http_req);
-      iov.iov_len = mongocrypt_binary_len (http_req);
+      if (read_ret == 0) {
+         bson_set_error (error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_SOCKET,
+                         "unexpected EOF from KMS stream");
+         return false;
+      }
 
-      if (!_mongoc_stream_writev_full (
-             tls_stream, &iov, 1, sockettimeout, error)) {
-         goto fail;
+      op->fed = true;
+      http_reply = mongocrypt_binary_new_from_data (buf, (uint32_t) read_ret);
+      fed = mongocrypt_kms_ctx_feed (op->kms_ctx, http_reply);
+      mongocrypt_binary_destroy (http_reply);
+      if (!fed) {
+         _kms_ctx_check_error (op->kms_ctx, error, true);
+         return false;
       }
+   }
 
-      /* Read and feed reply. */
-      while (mongocrypt_kms_ctx_bytes_needed (kms_ctx) > 0) {
-#define BUFFER_SIZE 1024
-         uint8_t buf[BUFFER_SIZE];
-         uint32_t bytes_needed = mongocrypt_kms_ctx_bytes_needed (kms_ctx);
-         ssize_t read_ret;
+   op->state = KMS_OP_DONE;
+   op->events = 0;
+   return true;
+#undef BUFFER_SIZE
+}
+
+/* Advance @op as far as it goes without waiting: connect, handshake, send
+ * the request, and read the reply. Sets op->events if @op must wait for its
+ * stream. */
+static bool
+_kms_op_continue (_kms_op_t *op, int32_t timeout_msec, bson_error_t *error)
+{
+   mongoc_iovec_t iov;
+   int32_t handshake_timeout_msec = timeout_msec;
+   int events;
 
-         /* Cap the bytes requested at the buffer size. */
-         if (bytes_needed > BUFFER_SIZE) {
-            bytes_needed = BUFFER_SIZE;
+   if (op->state == KMS_OP_CONNECT) {
+      return _kms_op_connect (op, error);
+   }
+
+   if (op->state == KMS_OP_TCP) {
+      if (!_mongoc_socket_connected (op->sock)) {
+         /* try the endpoint's next address. */
+         mongoc_stream_destroy (op->stream);
+         op->stream = NULL;
+         op->sock = NULL;
+         op->addr = op->addr->ai_next;
+         return _kms_op_connect (op, error);
+      }
+
+      if (!_kms_op_start_tls (op, error)) {
+         return false;
+      }
+
+      op->state = KMS_OP_HANDSHAKE;
+   }
+
+   if (op->state == KMS_OP_HANDSHAKE) {
+#if defined(MONGOC_ENABLE_SSL_OPENSSL) || \
+   defined(MONGOC_ENABLE_SSL_SECURE_CHANNEL)
+      /* pass 0 for the timeout to begin / continue non-blocking handshake */
+      handshake_timeout_msec = 0;
+#endif
+      events = 0;
+      if (error) {
+         error->code = 0;
+      }
+      if (!mongoc_stream_tls_handshake (op->stream,
+                                        op->host.host,
+                                        handshake_timeout_msec,
+                                        &events,
+                                        error)) {
+         if (events) {
+            op->events = events;
+            return true;
          }
 
-         read_ret = mongoc_stream_read (
-            tls_stream, buf, bytes_needed, 1 /* min_bytes. */, sockettimeout);
-         if (read_ret == -1) {
+         if (error && !error->code) {
             bson_set_error (error,
                             MONGOC_ERROR_STREAM,
                             MONGOC_ERROR_STREAM_SOCKET,
-                            "failed to read from KMS stream: %d",
-                            errno);
-            goto fail;
+                            "TLS handshake failed.");
          }
 
-         if (read_ret == 0) {
-            bson_set_error (error,
-                            MONGOC_ERROR_STREAM,
-                            MONGOC_ERROR_STREAM_SOCKET,
-                            "unexpected EOF from KMS stream");
-            goto fail;
+         return false;
+      }
+
+      op->state = KMS_OP_SEND;
+   }
+
+   if (op->state == KMS_OP_SEND) {
+      iov.iov_base = (char *) mongocrypt_binary_data (op->http_req);
+      iov.iov_len = mongocrypt_binary_len (op->http_req);
+
+      /* KMS requests are small, and fit in the socket's send buffer. */
+      if (!_mongoc_stream_writev_full (
+             op->stream, &iov, 1, timeout_msec, error)) {
+         return false;
+      }
+
+      op->state = KMS_OP_REPLY;
+   }
+
+   if (op->state == KMS_OP_REPLY) {
+      return _kms_op_read_reply (op, error);
+   }
+
+   return true;
+}
+
+static bool
+_kms_op_can_retry (const _kms_op_t *op)
+{
+   if (op->fed) {
+      return false;
+   }
+
+   /* the server may have closed a keep-alive connection while it was idle. */
+   if (op->reused) {
+      return true;
+   }
+
+#ifdef MONGOC_ENABLE_SSL_SECURE_CHANNEL
+   /* Retry once with schannel as a workaround for CDRIVER-3566. */
+   return !op->retried;
+#else
+   return false;
+#endif
+}
+
+/* Advance @op, moving it to a new connection if its stream fails before any
+ * of the reply is fed. */
+static bool
+_kms_op_run (_kms_op_t *op, int32_t timeout_msec, bson_error_t *error)
+{
+   while (!_kms_op_continue (op, timeout_msec, error)) {
+      if (!_kms_op_can_retry (op)) {
+         return false;
+      }
+
+      TRACE ("retrying KMS request to %s", op->endpoint);
+      if (!op->reused) {
+         op->retried = true;
+      }
+
+      mongoc_stream_destroy (op->stream);
+      op->stream = NULL;
+      op->sock = NULL;
+      op->addr = op->dns ? op->dns->addrs : NULL;
+      op->reused = false;
+      op->events = 0;
+      op->state = KMS_OP_CONNECT;
+   }
+
+   return true;
+}
+
+/* Get @op's request and endpoint, and take an idle connection to the
+ * endpoint if there is one. */
+static bool
+_kms_op_init (_mongoc_crypt_t *crypt, _kms_op_t *op, bson_error_t *error)
+{
+   op->http_req = mongocrypt_binary_new ();
+   if (!mongocrypt_kms_ctx_message (op->kms_ctx, op->http_req)) {
+      _kms_ctx_check_error (op->kms_ctx, error, true);
+      return false;
+   }
+
+   if (!mongocrypt_kms_ctx_endpoint (op->kms_ctx, &op->endpoint)) {
+      _kms_ctx_check_error (op->kms_ctx, error, true);
+      return false;
+   }
+
+   if (!_kms_endpoint_to_host (op->endpoint, &op->host, error)) {
+      return false;
+   }
+
+   op->stream = _kms_stream_take (crypt, op->endpoint);
+   if (op->stream) {
+      op->reused = true;
+      op->state = KMS_OP_SEND;
+   } else {
+      op->state = KMS_OP_CONNECT;
+   }
+
+   return true;
+}
+
+/* Send the pending KMS requests of all @ctxs before waiting for any reply,
+ * then poll all the streams and feed each reply as it arrives. Connections
+ * are kept open afterward for later requests to the same endpoint. */
+static bool
+_kms_run (_mongoc_crypt_t *crypt,
+          mongocrypt_ctx_t **ctxs,
+          size_t n_ctxs,
+          bson_error_t *error)
+{
+   mongocrypt_kms_ctx_t *kms_ctx;
+   mongoc_array_t ops;
+   _kms_op_t *op;
+   mongoc_stream_poll_t *polls = NULL;
+   _kms_op_t **polled = NULL;
+   size_t n_polled;
+   size_t i;
+   ssize_t n_ready;
+   int32_t sockettimeout;
+   bool ret = false;
+
+   sockettimeout = MONGOC_DEFAULT_SOCKETTIMEOUTMS;
+   _mongoc_array_init (&ops, sizeof (_kms_op_t));
+
+   for (i = 0; i < n_ctxs; i++) {
+      kms_ctx = mongocrypt_ctx_next_kms_ctx (ctxs[i]);
+      while (kms_ctx) {
+         _kms_op_t new_op = {0};
+
+         new_op.kms_ctx = kms_ctx;
+         _mongoc_array_append_val (&ops, new_op);
+         kms_ctx = mongocrypt_ctx_next_kms_ctx (ctxs[i]);
+      }
+      /* When NULL is returned by mongocrypt_ctx_next_kms_ctx, this can either
+       * be an error or end-of-list. */
+      if (!_ctx_check_error (ctxs[i], error, false)) {
+         goto fail;
+      }
+   }
+
+   for (i = 0; i < ops.len; i++) {
+      op = &_mongoc_array_index (&ops, _kms_op_t, i);
+      if (!_kms_op_init (crypt, op, error) ||
+          !_kms_op_run (op, sockettimeout, error)) {
+         goto fail;
+      }
+   }
+
+   polls = bson_malloc0 (ops.len * sizeof (mongoc_stream_poll_t));
+   polled = bson_malloc0 (ops.len * sizeof (_kms_op_t *));
+
+   for (;;) {
+      n_polled = 0;
+      for (i = 0; i < ops.len; i++) {
+         op = &_mongoc_array_index (&ops, _kms_op_t, i);
+         if (op->state == KMS_OP_DONE) {
+            continue;
          }
 
-         mongocrypt_binary_destroy (http_reply);
-         http_reply = mongocrypt_binary_new_from_data (buf, read_ret);
-         if (!mongocrypt_kms_ctx_feed (kms_ctx, http_reply)) {
-            _kms_ctx_check_error (kms_ctx, error, true);
+         polls[n_polled].stream = op->stream;
+         polls[n_polled].events = op->events;
+         polls[n_polled].revents = 0;
+         polled[n_polled] = op;
+         n_polled++;
+      }
+
+      if (n_polled == 0) {
+         break;
+      }
+
+      n_ready = mongoc_stream_poll (polls, n_polled, sockettimeout);
+      if (n_ready == 0) {
+         bson_set_error (error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_SOCKET,
+                         "timed out waiting for KMS reply");
+         goto fail;
+      }
+
+      if (n_ready < 0) {
+         bson_set_error (error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_SOCKET,
+                         "failed to poll KMS streams: %d",
+                         errno);
+         goto fail;
+      }
+
+      for (i = 0; i < n_polled; i++) {
+         if (polls[i].revents &&
+             !_kms_op_run (polled[i], sockettimeout, error)) {
             goto fail;
          }
       }
-      kms_ctx = mongocrypt_ctx_next_kms_ctx (state_machine->ctx);
    }
-   /* When NULL is returned by mongocrypt_ctx_next_kms_ctx, this can either be
-    * an error or end-of-list. */
-   if (!_ctx_check_error (state_machine->ctx, error, false)) {
-      goto fail;
+
+   for (i = 0; i < ops.len; i++) {
+      op = &_mongoc_array_index (&ops, _kms_op_t, i);
+      _kms_stream_put (crypt, op->endpoint, op->stream);
+      op->stream = NULL;
    }
 
-   if (!mongocrypt_ctx_kms_done (state_machine->ctx)) {
-      _ctx_check_error (state_machine->ctx, error, true);
-      goto fail;
+   for (i = 0; i < n_ctxs; i++) {
+      if (!mongocrypt_ctx_kms_done (ctxs[i])) {
+         _ctx_check_error (ctxs[i], error, true);
+         goto fail;
+      }
    }
 
    ret = true;
 fail:
-   mongoc_stream_destroy (tls_stream);
-   mongocrypt_binary_destroy (http_req);
-   mongocrypt_binary_destroy (http_reply);
+   for (i = 0; i < ops.len; i++) {
+      op = &_mongoc_array_index (&ops, _kms_op_t, i);
+      mongoc_stream_destroy (op->stream);
+      mongocrypt_binary_destroy (op->http_req);
+      _mongoc_dns_result_release (op->dns);
+   }
+
+   _mongoc_array_destroy (&ops);
+   bson_free (polls);
+   bson_free (polled);
    return ret;
-#undef BUFFER_SIZE
+}
+
+/* State handler MONGOCRYPT_CTX_NEED_KMS */
+static bool
+_state_need_kms (_state_machine_t *state_machine, bson_error_t *error)
+{
+   return _kms_run (state_machine->crypt, &state_machine->ctx, 1, error);
 }
 
 static bool
@@ -658,8 +1208,64 @@ fail:
    return ret;
 }
 
-/* Note, _mongoc_crypt_t only has one member, to the top-level handle of
-   libmongocrypt, mongocrypt_t.
+/* Run explicit encryption @state_machines together until each is ready to
+ * finalize: their key lookups share one query, and their KMS requests are
+ * sent concurrently. Errors, and states explicit encryption does not reach,
+ * are left for _state_machine_run. */
+static bool
+_state_machines_fetch_keys (_mongoc_crypt_t *crypt,
+                            _state_machine_t **state_machines,
+                            size_t n_state_machines,
+                            bson_error_t *error)
+{
+   _state_machine_t **need_keys;
+   mongocrypt_ctx_t **need_kms;
+   size_t n_need_keys;
+   size_t n_need_kms;
+   size_t i;
+   bool ret = false;
+
+   need_keys = bson_malloc0 (n_state_machines * sizeof (_state_machine_t *));
+   need_kms = bson_malloc0 (n_state_machines * sizeof (mongocrypt_ctx_t *));
+
+   while (true) {
+      n_need_keys = 0;
+      n_need_kms = 0;
+      for (i = 0; i < n_state_machines; i++) {
+         switch (mongocrypt_ctx_state (state_machines[i]->ctx)) {
+         case MONGOCRYPT_CTX_NEED_MONGO_KEYS:
+            need_keys[n_need_keys++] = state_machines[i];
+            break;
+         case MONGOCRYPT_CTX_NEED_KMS:
+            need_kms[n_need_kms++] = state_machines[i]->ctx;
+            break;
+         default:
+            break;
+         }
+      }
+
+      if (n_need_keys > 0) {
+         if (!_state_need_mongo_keys_many (need_keys, n_need_keys, error)) {
+            goto fail;
+         }
+      } else if (n_need_kms > 0) {
+         if (!_kms_run (crypt, need_kms, n_need_kms, error)) {
+            goto fail;
+         }
+      } else {
+         break;
+      }
+   }
+
+   ret = true;
+fail:
+   bson_free (need_keys);
+   bson_free (need_kms);
+   return ret;
+}
+
+/* Note, _mongoc_crypt_t holds the top-level handle of libmongocrypt,
+   mongocrypt_t, and the idle connections to KMS endpoints.
    The purpose of defining _mongoc_crypt_t is to limit all interaction with
    libmongocrypt to this one
    file.
@@ -678,6 +1284,7 @@ _mongoc_crypt_new (const bson_t *kms_providers,
    /* Create the handle to libmongocrypt. */
    crypt = bson_malloc0 (sizeof (*crypt));
    crypt->handle = mongocrypt_new ();
+   bson_mutex_init (&crypt->kms_streams_mutex);
 
    mongocrypt_setopt_log_handler (
       crypt->handle, _log_callback, NULL /* context */);
@@ -720,10 +1327,20 @@ fail:
 void
 _mongoc_crypt_destroy (_mongoc_crypt_t *crypt)
 {
+   kms_stream_list_t *iter;
+   kms_stream_list_t *tmp;
+
    if (!crypt) {
       return;
    }
    mongocrypt_destroy (crypt->handle);
+   LL_FOREACH_SAFE (crypt->kms_streams, iter, tmp)
+   {
+      mongoc_stream_destroy (iter->stream);
+      bson_free (iter->endpoint);
+      bson_free (iter);
+   }
+   bson_mutex_destroy (&crypt->kms_streams_mutex);
    bson_free (crypt);
 }
 
@@ -743,7 +1360,7 @@ _mongoc_crypt_auto_encrypt (_mongoc_crypt_t *crypt,
 
    bson_init (cmd_out);
 
-   state_machine = _state_machine_new ();
+   state_machine = _state_machine_new (crypt);
    state_machine->keyvault_coll = keyvault_coll;
    state_machine->mongocryptd_client = mongocryptd_client;
    state_machine->collinfo_client = collinfo_client;
@@ -787,7 +1404,7 @@ _mongoc_crypt_auto_decrypt (_mongoc_crypt_t *crypt,
 
    bson_init (doc_out);
 
-   state_machine = _state_machine_new ();
+   state_machine = _state_machine_new (crypt);
    state_machine->keyvault_coll = keyvault_coll;
    state_machine->ctx = mongocrypt_ctx_new (crypt->handle);
    if (!state_machine->ctx) {
@@ -814,27 +1431,21 @@ fail:
    return ret;
 }
 
-bool
-_mongoc_crypt_explicit_encrypt (_mongoc_crypt_t *crypt,
-                                mongoc_collection_t *keyvault_coll,
-                                const char *algorithm,
-                                const bson_value_t *keyid,
-                                char *keyaltname,
-                                const bson_value_t *value_in,
-                                bson_value_t *value_out,
-                                bson_error_t *error)
+/* Create a state machine to explicitly encrypt @value_in. */
+static _state_machine_t *
+_explicit_encrypt_new (_mongoc_crypt_t *crypt,
+                       mongoc_collection_t *keyvault_coll,
+                       const char *algorithm,
+                       const bson_value_t *keyid,
+                       const char *keyaltname,
+                       const bson_value_t *value_in,
+                       bson_error_t *error)
 {
    _state_machine_t *state_machine = NULL;
-   bson_t *to_encrypt_doc = NULL;
-   mongocrypt_binary_t *to_encrypt_bin = NULL;
-   bson_iter_t iter;
    bool ret = false;
-   bson_t result = BSON_INITIALIZER;
-
-   value_out->value_type = BSON_TYPE_EOD;
 
    /* Create the context for the operation. */
-   state_machine = _state_machine_new ();
+   state_machine = _state_machine_new (crypt);
    state_machine->keyvault_coll = keyvault_coll;
    state_machine->ctx = mongocrypt_ctx_new (crypt->handle);
    if (!state_machine->ctx) {
@@ -863,6 +1474,8 @@ _mongoc_crypt_explicit_encrypt (_mongoc_crypt_t *crypt,
          _ctx_check_error (state_machine->ctx, error, true);
          goto fail;
       }
+
+      state_machine->keyaltname = keyaltname;
    }
 
    if (keyid && keyid->value_type == BSON_TYPE_BINARY) {
@@ -885,18 +1498,41 @@ _mongoc_crypt_explicit_encrypt (_mongoc_crypt_t *crypt,
          _ctx_check_error (state_machine->ctx, error, true);
          goto fail;
       }
+
+      state_machine->keyid = keyid;
    }
 
-   to_encrypt_doc = bson_new ();
-   BSON_APPEND_VALUE (to_encrypt_doc, "v", value_in);
-   to_encrypt_bin = mongocrypt_binary_new_from_data (
-      (uint8_t *) bson_get_data (to_encrypt_doc), to_encrypt_doc->len);
-   if (!mongocrypt_ctx_explicit_encrypt_init (state_machine->ctx,
-                                              to_encrypt_bin)) {
+   state_machine->explicit_input = bson_new ();
+   BSON_APPEND_VALUE (state_machine->explicit_input, "v", value_in);
+   state_machine->explicit_input_bin = mongocrypt_binary_new_from_data (
+      (uint8_t *) bson_get_data (state_machine->explicit_input),
+      state_machine->explicit_input->len);
+   if (!mongocrypt_ctx_explicit_encrypt_init (
+          state_machine->ctx, state_machine->explicit_input_bin)) {
       _ctx_check_error (state_machine->ctx, error, true);
       goto fail;
    }
 
+   ret = true;
+fail:
+   if (!ret) {
+      _state_machine_destroy (state_machine);
+      return NULL;
+   }
+
+   return state_machine;
+}
+
+/* Finish explicitly encrypting with @state_machine. */
+static bool
+_explicit_encrypt_run (_state_machine_t *state_machine,
+                       bson_value_t *value_out,
+                       bson_error_t *error)
+{
+   bson_iter_t iter;
+   bool ret = false;
+   bson_t result = BSON_INITIALIZER;
+
    bson_destroy (&result);
    if (!_state_machine_run (state_machine, &result, error)) {
       goto fail;
@@ -918,13 +1554,157 @@ _mongoc_crypt_explicit_encrypt (_mongoc_crypt_t *crypt,
 
    ret = true;
 fail:
-   _state_machine_destroy (state_machine);
-   mongocrypt_binary_destroy (to_encrypt_bin);
-   bson_destroy (to_encrypt_doc);
    bson_destroy (&result);
    return ret;
 }
 
+bool
+_mongoc_crypt_explicit_encrypt (_mongoc_crypt_t *crypt,
+                                mongoc_collection_t *keyvault_coll,
+                                const char *algorithm,
+                                const bson_value_t *keyid,
+                                char *keyaltname,
+                                const bson_value_t *value_in,
+                                bson_value_t *value_out,
+                                bson_error_t *error)
+{
+   _state_machine_t *state_machine = NULL;
+   bool ret = false;
+
+   value_out->value_type = BSON_TYPE_EOD;
+
+   state_machine = _explicit_encrypt_new (
+      crypt, keyvault_coll, algorithm, keyid, keyaltname, value_in, error);
+   if (!state_machine) {
+      goto fail;
+   }
+
+   if (!_explicit_encrypt_run (state_machine, value_out, error)) {
+      goto fail;
+   }
+
+   ret = true;
+fail:
+   _state_machine_destroy (state_machine);
+   return ret;
+}
+
+static bool
+_same_key (const _mongoc_crypt_encrypt_opts_t *a,
+           const _mongoc_crypt_encrypt_opts_t *b)
+{
+   const bson_value_t *a_id = a->keyid;
+   const bson_value_t *b_id = b->keyid;
+
+   if (a->keyaltname || b->keyaltname) {
+      return a->keyaltname && b->keyaltname &&
+             !strcmp (a->keyaltname, b->keyaltname);
+   }
+
+   if (!a_id || a_id->value_type != BSON_TYPE_BINARY || !b_id ||
+       b_id->value_type != BSON_TYPE_BINARY) {
+      return false;
+   }
+
+   return a_id->value.v_binary.data_len == b_id->value.v_binary.data_len &&
+          !memcmp (a_id->value.v_binary.data,
+                   b_id->value.v_binary.data,
+                   a_id->value.v_binary.data_len);
+}
+
+bool
+_mongoc_crypt_explicit_encrypt_many (_mongoc_crypt_t *crypt,
+                                     mongoc_collection_t *keyvault_coll,
+                                     const _mongoc_crypt_encrypt_opts_t *opts,
+                                     const bson_value_t *values_in,
+                                     size_t n_values,
+                                     bson_value_t *values_out,
+                                     bson_error_t *error)
+{
+   _state_machine_t **state_machines;
+   _state_machine_t **leaders;
+   size_t *leader_index;
+   size_t n_leaders = 0;
+   size_t i;
+   size_t j;
+   bool ret = false;
+
+   for (i = 0; i < n_values; i++) {
+      values_out[i].value_type = BSON_TYPE_EOD;
+   }
+
+   state_machines = bson_malloc0 (n_values * sizeof (_state_machine_t *));
+   leaders = bson_malloc0 (n_values * sizeof (_state_machine_t *));
+   leader_index = bson_malloc0 (n_values * sizeof (size_t));
+
+   /* The first value encrypted with each key leads. The leaders fetch and
+    * decrypt their keys together, then the other values find their keys in
+    * libmongocrypt's key cache. */
+   for (i = 0; i < n_values; i++) {
+      for (j = 0; j < n_leaders; j++) {
+         if (_same_key (&opts[i], &opts[leader_index[j]])) {
+            break;
+         }
+      }
+
+      if (j < n_leaders) {
+         continue;
+      }
+
+      state_machines[i] = _explicit_encrypt_new (crypt,
+                                                 keyvault_coll,
+                                                 opts[i].algorithm,
+                                                 opts[i].keyid,
+                                                 opts[i].keyaltname,
+                                                 &values_in[i],
+                                                 error);
+      if (!state_machines[i]) {
+         goto fail;
+      }
+
+      leaders[n_leaders] = state_machines[i];
+      leader_index[n_leaders] = i;
+      n_leaders++;
+   }
+
+   if (!_state_machines_fetch_keys (crypt, leaders, n_leaders, error)) {
+      goto fail;
+   }
+
+   for (i = 0; i < n_values; i++) {
+      if (!state_machines[i]) {
+         state_machines[i] = _explicit_encrypt_new (crypt,
+                                                    keyvault_coll,
+                                                    opts[i].algorithm,
+                                                    opts[i].keyid,
+                                                    opts[i].keyaltname,
+                                                    &values_in[i],
+                                                    error);
+         if (!state_machines[i]) {
+            goto fail;
+         }
+      }
+
+      if (!_explicit_encrypt_run (state_machines[i], &values_out[i], error)) {
+         goto fail;
+      }
+
+      _state_machine_destroy (state_machines[i]);
+      state_machines[i] = NULL;
+   }
+
+   ret = true;
+fail:
+   for (i = 0; i < n_values; i++) {
+      _state_machine_destroy (state_machines[i]);
+   }
+
+   bson_free (state_machines);
+   bson_free (leaders);
+   bson_free (leader_index);
+   return ret;
+}
+
 bool
 _mongoc_crypt_explicit_decrypt (_mongoc_crypt_t *crypt,
                                 mongoc_collection_t *keyvault_coll,
@@ -939,7 +1719,7 @@ _mongoc_crypt_explicit_decrypt (_mongoc_crypt_t *crypt,
    bool ret = false;
    bson_t result = BSON_INITIALIZER;
 
-   state_machine = _state_machine_new ();
+   state_machine = _state_machine_new (crypt);
    state_machine->keyvault_coll = keyvault_coll;
    state_machine->ctx = mongocrypt_ctx_new (crypt->handle);
    if (!state_machine->ctx) {
@@ -985,6 +1765,63 @@ fail:
    return ret;
 }
 
+bool
+_mongoc_crypt_explicit_decrypt_many (_mongoc_crypt_t *crypt,
+                                     mongoc_collection_t *keyvault_coll,
+                                     const bson_value_t *values_in,
+                                     size_t n_values,
+                                     bson_value_t *values_out,
+                                     bson_error_t *error)
+{
+   bson_t to_decrypt = BSON_INITIALIZER;
+   bson_t result = BSON_INITIALIZER;
+   bson_iter_t iter;
+   const char *key;
+   char buf[16];
+   size_t i;
+   bool ret = false;
+
+   for (i = 0; i < n_values; i++) {
+      values_out[i].value_type = BSON_TYPE_EOD;
+   }
+
+   /* Decrypt all the values as fields of one document, so one context finds
+    * all their keys with a single query. */
+   for (i = 0; i < n_values; i++) {
+      bson_uint32_to_string ((uint32_t) i, &key, buf, sizeof buf);
+      BSON_APPEND_VALUE (&to_decrypt, key, &values_in[i]);
+   }
+
+   bson_destroy (&result);
+   if (!_mongoc_crypt_auto_decrypt (
+          crypt, keyvault_coll, &to_decrypt, &result, error)) {
+      goto fail;
+   }
+
+   /* extract values */
+   i = 0;
+   if (bson_iter_init (&iter, &result)) {
+      while (i < n_values && bson_iter_next (&iter)) {
+         bson_value_copy (bson_iter_value (&iter), &values_out[i]);
+         i++;
+      }
+   }
+
+   if (i != n_values) {
+      bson_set_error (error,
+                      MONGOC_ERROR_CLIENT,
+                      MONGOC_ERROR_CLIENT_INVALID_ENCRYPTION_STATE,
+                      "decrypted result unexpected");
+      goto fail;
+   }
+
+   ret = true;
+fail:
+   bson_destroy (&to_decrypt);
+   bson_destroy (&result);
+   return ret;
+}
+
 bool
 _mongoc_crypt_create_datakey (_mongoc_crypt_t *crypt,
                               const char *kms_provider,
@@ -1000,7 +1837,7 @@ _mongoc_crypt_create_datakey (_mongoc_crypt_t *crypt,
    mongocrypt_binary_t *masterkey_w_provider_bin = NULL;
 
    bson_init (doc_out);
-   state_machine = _state_machine_new ();
+   state_machine = _state_machine_new (crypt);
    state_machine->ctx = mongocrypt_ctx_new (crypt->handle);
    if (!state_machine->ctx) {
       _crypt_check_error (crypt->handle, error, true);
@@ -1062,6 +1899,12 @@ fail:
    return ret;
 }
 
+void
+_mongoc_crypt_set_kms_ssl_opts (const mongoc_ssl_opt_t *opts)
+{
+   kms_ssl_opts = opts;
+}
+
 #else
 /* ensure the translation unit is not empty */
 extern int no_mongoc_client_side_encryption;
@@ -47,7 +47,8 @@ _getmore_type (mongoc_cursor_t *cursor)
       return UNKNOWN;
    }
    use_cmd = server_stream->sd->max_wire_version >= WIRE_VERSION_FIND_CMD &&
-             !_mongoc_cursor_get_opt_bool (cursor, MONGOC_CURSOR_EXHAUST);
+             (!_mongoc_cursor_get_opt_bool (cursor, MONGOC_CURSOR_EXHAUST) ||
+              _mongoc_cursor_use_exhaust_getmore (cursor, server_stream));
    data->getmore_type = use_cmd ? GETMORE_CMD : OP_GETMORE;
    mongoc_server_stream_cleanup (server_stream);
    return data->getmore_type;
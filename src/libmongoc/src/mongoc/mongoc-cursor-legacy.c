@@ -410,6 +410,8 @@ _mongoc_cursor_parse_opts_for_op_query (mongoc_cursor_t *cursor,
        * exhaust noCursorTimeout oplogReplay tailable in _mongoc_cursor_flags
        * maxAwaitTimeMS is handled in _mongoc_cursor_prepare_getmore_command
        * sessionId is used to retrieve the mongoc_client_session_t
+       * prefetch and adaptiveBatchSize are driver options for getMore
+       * commands, OP_QUERY cursors ignore them
        */
       else if (strcmp (key, MONGOC_CURSOR_SINGLE_BATCH) &&
                strcmp (key, MONGOC_CURSOR_LIMIT) &&
@@ -418,7 +420,9 @@ _mongoc_cursor_parse_opts_for_op_query (mongoc_cursor_t *cursor,
                strcmp (key, MONGOC_CURSOR_NO_CURSOR_TIMEOUT) &&
                strcmp (key, MONGOC_CURSOR_OPLOG_REPLAY) &&
                strcmp (key, MONGOC_CURSOR_TAILABLE) &&
-               strcmp (key, MONGOC_CURSOR_MAX_AWAIT_TIME_MS)) {
+               strcmp (key, MONGOC_CURSOR_MAX_AWAIT_TIME_MS) &&
+               strcmp (key, MONGOC_CURSOR_PREFETCH) &&
+               strcmp (key, MONGOC_CURSOR_ADAPTIVE_BATCH_SIZE)) {
          /* pass unrecognized options to server, prefixed with $ */
          PUSH_DOLLAR_QUERY ();
          dollar_modifier = bson_strdup_printf ("$%s", key);
@@ -29,6 +29,8 @@
 
 BSON_BEGIN_DECLS
 
+#define MONGOC_CURSOR_ADAPTIVE_BATCH_SIZE "adaptiveBatchSize"
+#define MONGOC_CURSOR_ADAPTIVE_BATCH_SIZE_LEN 17
 #define MONGOC_CURSOR_ALLOW_PARTIAL_RESULTS "allowPartialResults"
 #define MONGOC_CURSOR_ALLOW_PARTIAL_RESULTS_LEN 19
 #define MONGOC_CURSOR_AWAIT_DATA "awaitData"
@@ -65,6 +67,8 @@ BSON_BEGIN_DECLS
 #define MONGOC_CURSOR_OPLOG_REPLAY_LEN 11
 #define MONGOC_CURSOR_ORDERBY "orderby"
 #define MONGOC_CURSOR_ORDERBY_LEN 7
+#define MONGOC_CURSOR_PREFETCH "prefetch"
+#define MONGOC_CURSOR_PREFETCH_LEN 8
 #define MONGOC_CURSOR_PROJECTION "projection"
 #define MONGOC_CURSOR_PROJECTION_LEN 10
 #define MONGOC_CURSOR_QUERY "query"
@@ -108,6 +112,41 @@ typedef struct _mongoc_cursor_response_legacy {
    bson_reader_t *reader;
 } mongoc_cursor_response_legacy_t;
 
+/* a getMore sent before the application drains the current batch */
+typedef enum {
+   PREFETCH_NONE,    /* nothing sent ahead */
+   PREFETCH_SENDING, /* sending the getMore, do not read its reply */
+   PREFETCH_SENT,    /* the reply is on its way, see client->prefetching */
+   PREFETCH_READ     /* the reply (or error) is in prefetch.reply */
+} mongoc_cursor_prefetch_state_t;
+
+typedef struct _mongoc_cursor_prefetch_t {
+   mongoc_cursor_prefetch_state_t state;
+   int64_t low_water_mark;  /* for the current batch, -1 if disabled */
+   int64_t remaining;       /* documents not yet read from the batch */
+   mongoc_stream_t *stream; /* the connection the getMore was sent on */
+   uint32_t request_id;     /* the getMore's APM request id */
+   int64_t started;         /* when the getMore was sent */
+   bool ok;
+   bson_t reply;
+   bson_error_t error;
+} mongoc_cursor_prefetch_t;
+
+/* an adaptive cursor aims for batches of MIN_BYTES, doubled up to MAX_BYTES
+ * each time a batch takes SLOW_USEC or longer to arrive */
+#define MONGOC_CURSOR_ADAPTIVE_MIN_BYTES (4 * 1024 * 1024)
+#define MONGOC_CURSOR_ADAPTIVE_MAX_BYTES (16 * 1024 * 1024)
+#define MONGOC_CURSOR_ADAPTIVE_SLOW_USEC (10 * 1000)
+
+/* batchSize chosen from the batches seen so far, for "adaptiveBatchSize" */
+typedef struct _mongoc_cursor_adaptive_t {
+   int64_t batch_size;   /* for the next getMore, 0 for the server default */
+   int64_t target_bytes; /* the size to aim for, 0 until the first batch */
+   int64_t n_docs;       /* documents received so far */
+   int64_t n_bytes;      /* their total size */
+   int64_t latency_usec; /* time taken by the latest batch, 0 if unknown */
+} mongoc_cursor_adaptive_t;
+
 /* 3.2+ responses -- read batch docs like {cursor:{id: 123, firstBatch: []}} */
 typedef struct _mongoc_cursor_response_t {
    bson_t reply;           /* the entire command reply */
@@ -120,6 +159,9 @@ struct _mongoc_cursor_t {
    uint32_t client_generation;
 
    uint32_t server_id;
+   /* server_id was chosen with mongoc_cursor_set_hint or "serverId", so
+    * reads are not hedged to another server */
+   bool server_id_hinted;
    bool slave_ok;
 
    mongoc_cursor_state_t state;
@@ -149,6 +191,9 @@ struct _mongoc_cursor_t {
 
    int64_t operation_id;
    int64_t cursor_id;
+
+   mongoc_cursor_prefetch_t prefetch;
+   mongoc_cursor_adaptive_t adaptive;
 };
 
 int32_t
@@ -172,6 +217,11 @@ void
 _mongoc_cursor_collection (const mongoc_cursor_t *cursor,
                            const char **collection,
                            int *collection_len);
+void
+_mongoc_cursor_prefetch_read (mongoc_cursor_t *cursor);
+bool
+_mongoc_cursor_use_exhaust_getmore (
+   mongoc_cursor_t *cursor, const mongoc_server_stream_t *server_stream);
 bool
 _mongoc_cursor_run_command (mongoc_cursor_t *cursor,
                             const bson_t *command,
@@ -29,6 +29,7 @@
 #include "mongoc-write-concern-private.h"
 #include "mongoc-read-prefs-private.h"
 #include "mongoc-aggregate-private.h"
+#include "mongoc-client-side-encryption-private.h"
 
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "cursor"
@@ -121,7 +122,9 @@ _mongoc_n_return (mongoc_cursor_t *cursor)
     * https://github.com/mongodb/specifications/blob/master/source/crud/crud.rst#combining-limit-and-batch-size-for-the-wire-protocol
     */
    limit = mongoc_cursor_get_limit (cursor);
-   batch_size = mongoc_cursor_get_batch_size (cursor);
+   batch_size = cursor->adaptive.batch_size
+                   ? cursor->adaptive.batch_size
+                   : mongoc_cursor_get_batch_size (cursor);
 
    if (limit < 0) {
       n_return = limit;
@@ -236,18 +239,21 @@ _mongoc_cursor_new_with_opts (mongoc_client_t *client,
                               const mongoc_read_concern_t *read_concern)
 {
    mongoc_cursor_t *cursor;
-   mongoc_topology_description_type_t td_type;
    uint32_t server_id;
    mongoc_read_concern_t *read_concern_local = NULL;
    bson_error_t validate_err;
    const char *dollar_field;
    bson_iter_t iter;
+   mongoc_topology_description_t *td;
+   bool op_query_mongos;
 
    ENTRY;
 
    BSON_ASSERT (client);
 
    cursor = (mongoc_cursor_t *) bson_malloc0 (sizeof *cursor);
+   bson_init (&cursor->prefetch.reply);
+   cursor->prefetch.low_water_mark = -1;
    cursor->client = client;
    cursor->state = UNPRIMED;
    cursor->client_generation = client->generation;
@@ -369,9 +375,19 @@ _mongoc_cursor_new_with_opts (mongoc_client_t *client,
          GOTO (finish);
       }
 
-      td_type = _mongoc_topology_get_type (client->topology);
-
-      if (td_type == MONGOC_TOPOLOGY_SHARDED) {
+      /* mongos does not support OP_QUERY exhaust. MongoDB 4.2+ exhaust uses
+       * OP_MSG, and mongos ignores exhaustAllowed and replies to each getMore
+       * as usual. see _mongoc_cursor_use_exhaust_getmore */
+      bson_mutex_lock (&client->topology->mutex);
+      td = &client->topology->description;
+      op_query_mongos =
+         td->type == MONGOC_TOPOLOGY_SHARDED &&
+         (mongoc_topology_description_lowest_max_wire_version (td) <
+             WIRE_VERSION_4_2 ||
+          _mongoc_cse_is_enabled (client));
+      bson_mutex_unlock (&client->topology->mutex);
+
+      if (op_query_mongos) {
          bson_set_error (&cursor->error,
                          MONGOC_ERROR_CURSOR,
                          MONGOC_ERROR_CURSOR_INVALID_CURSOR,
@@ -589,12 +605,29 @@ void
 mongoc_cursor_destroy (mongoc_cursor_t *cursor)
 {
    char *db;
+   bson_iter_t iter;
    ENTRY;
 
    if (!cursor) {
       EXIT;
    }
 
+   if (cursor->prefetch.state == PREFETCH_SENT) {
+      if (cursor->client_generation == cursor->client->generation) {
+         /* read the reply so the connection can be reused */
+         _mongoc_cursor_prefetch_read (cursor);
+      } else if (cursor->client->prefetching == cursor) {
+         cursor->client->prefetching = NULL;
+      }
+   }
+
+   if (cursor->prefetch.state == PREFETCH_READ && cursor->prefetch.ok &&
+       bson_iter_init (&iter, &cursor->prefetch.reply) &&
+       bson_iter_find_descendant (&iter, "cursor.id", &iter)) {
+      /* no killCursors if the prefetched batch was the last */
+      cursor->cursor_id = bson_iter_as_int64 (&iter);
+   }
+
    if (cursor->impl.destroy) {
       cursor->impl.destroy (&cursor->impl);
    }
@@ -605,8 +638,10 @@ mongoc_cursor_destroy (mongoc_cursor_t *cursor)
    if (cursor->in_exhaust) {
       cursor->client->in_exhaust = false;
       if (cursor->state != DONE) {
-         /* The only way to stop an exhaust cursor is to kill the connection
-            */
+         /* The only way to stop an exhaust cursor is to kill the connection,
+          * the server keeps pushing batches (OP_REPLY, or OP_MSG with
+          * moreToCome) until the cursor is exhausted.
+          */
          mongoc_cluster_disconnect_node (&cursor->client->cluster,
                                          cursor->server_id);
       }
@@ -635,6 +670,7 @@ mongoc_cursor_destroy (mongoc_cursor_t *cursor)
 
    bson_destroy (&cursor->opts);
    bson_destroy (&cursor->error_doc);
+   bson_destroy (&cursor->prefetch.reply);
    bson_free (cursor->ns);
    bson_free (cursor);
 
@@ -909,6 +945,19 @@ _mongoc_cursor_opts_to_flags (mongoc_cursor_t *cursor,
    return true;
 }
 
+/* OP_MSG exhaust cursors send their getMores with exhaustAllowed, which
+ * requires MongoDB 4.2. Older servers use OP_QUERY exhaust instead. */
+bool
+_mongoc_cursor_use_exhaust_getmore (mongoc_cursor_t *cursor,
+                                    const mongoc_server_stream_t *server_stream)
+{
+   /* auto encryption runs a copy of the command, moreToCome is not returned */
+   return _mongoc_cursor_get_opt_bool (cursor, MONGOC_CURSOR_EXHAUST) &&
+          server_stream->sd->max_wire_version >= WIRE_VERSION_4_2 &&
+          !_mongoc_cse_is_enabled (cursor->client);
+}
+
+
 bool
 _mongoc_cursor_run_command (mongoc_cursor_t *cursor,
                             const bson_t *command,
@@ -941,6 +990,13 @@ _mongoc_cursor_run_command (mongoc_cursor_t *cursor,
       GOTO (done);
    }
 
+   if (cursor->prefetch.state == PREFETCH_SENDING &&
+       server_stream->sd->max_wire_version < WIRE_VERSION_OP_MSG) {
+      /* only OP_MSG lets us send without reading the reply, do nothing */
+      _mongoc_bson_init_if_set (reply);
+      GOTO (done);
+   }
+
    if (opts) {
       if (!bson_iter_init (&iter, opts)) {
          _mongoc_bson_init_if_set (reply);
@@ -1048,9 +1104,58 @@ _mongoc_cursor_run_command (mongoc_cursor_t *cursor,
       GOTO (done);
    }
 
+   /* an exhaust getMore asks the server to push all remaining batches on this
+    * connection. while it does, each getMore only reads the next reply. */
+   if (!strcmp (cmd_name, "getMore") &&
+       _mongoc_cursor_use_exhaust_getmore (cursor, server_stream)) {
+      parts.assembled.exhaust_allowed = true;
+      parts.assembled.reply_pending = cursor->in_exhaust;
+   } else if (!strcmp (cmd_name, "getMore") &&
+              server_stream->sd->max_wire_version >= WIRE_VERSION_OP_MSG) {
+      /* a getMore sent ahead of time, see _mongoc_cursor_prefetch_send */
+      parts.assembled.defer_reply =
+         cursor->prefetch.state == PREFETCH_SENDING;
+      parts.assembled.reply_pending = cursor->prefetch.state == PREFETCH_SENT;
+      if (parts.assembled.reply_pending) {
+         parts.assembled.deferred_request_id = cursor->prefetch.request_id;
+         parts.assembled.deferred_started = cursor->prefetch.started;
+      }
+   }
+
+   if (parts.assembled.reply_pending &&
+       server_stream->stream != cursor->prefetch.stream &&
+       !cursor->in_exhaust) {
+      _mongoc_bson_init_if_set (reply);
+      bson_set_error (&cursor->error,
+                      MONGOC_ERROR_STREAM,
+                      MONGOC_ERROR_STREAM_NOT_ESTABLISHED,
+                      "Connection closed before a prefetched batch was read");
+      GOTO (done);
+   }
+
 retry:
-   ret = mongoc_cluster_run_command_monitored (
-      &cursor->client->cluster, &parts.assembled, reply, &cursor->error);
+   ret = mongoc_cluster_run_command_hedged (&cursor->client->cluster,
+                                            &parts.assembled,
+                                            cursor->server_id_hinted
+                                               ? NULL
+                                               : parts.read_prefs,
+                                            reply,
+                                            &cursor->error);
+
+   /* a hedged read may have been answered by another server */
+   cursor->server_id = server_stream->sd->id;
+
+   if (parts.assembled.exhaust_allowed) {
+      cursor->in_exhaust = parts.assembled.more_to_come;
+      cursor->client->in_exhaust = parts.assembled.more_to_come;
+   }
+
+   if (ret && parts.assembled.defer_reply) {
+      cursor->prefetch.state = PREFETCH_SENT;
+      cursor->prefetch.stream = server_stream->stream;
+      cursor->prefetch.request_id = parts.assembled.deferred_request_id;
+      cursor->prefetch.started = parts.assembled.deferred_started;
+   }
 
    if (ret) {
       memset (&cursor->error, 0, sizeof (bson_error_t));
@@ -1373,6 +1478,8 @@ mongoc_cursor_clone (const mongoc_cursor_t *cursor)
 
    bson_copy_to (&cursor->opts, &_clone->opts);
    bson_init (&_clone->error_doc);
+   bson_init (&_clone->prefetch.reply);
+   _clone->prefetch.low_water_mark = -1;
 
    _clone->ns = bson_strdup (cursor->ns);
 
@@ -1491,6 +1598,7 @@ mongoc_cursor_set_hint (mongoc_cursor_t *cursor, uint32_t server_id)
    }
 
    cursor->server_id = server_id;
+   cursor->server_id_hinted = true;
 
    return true;
 }
@@ -1543,6 +1651,26 @@ mongoc_cursor_get_max_await_time_ms (const mongoc_cursor_t *cursor)
 }
 
 
+void
+mongoc_cursor_set_prefetch (mongoc_cursor_t *cursor, uint32_t low_water_mark)
+{
+   BSON_ASSERT (cursor);
+
+   _mongoc_cursor_set_opt_int64 (
+      cursor, MONGOC_CURSOR_PREFETCH, (int64_t) low_water_mark);
+}
+
+
+void
+mongoc_cursor_set_adaptive_batch_size (mongoc_cursor_t *cursor, bool adaptive)
+{
+   BSON_ASSERT (cursor);
+
+   _mongoc_cursor_set_opt_bool (
+      cursor, MONGOC_CURSOR_ADAPTIVE_BATCH_SIZE, adaptive);
+}
+
+
 /* deprecated for mongoc_cursor_new_from_command_reply_with_opts */
 mongoc_cursor_t *
 mongoc_cursor_new_from_command_reply (mongoc_client_t *client,
@@ -1595,6 +1723,193 @@ mongoc_cursor_new_from_command_reply_with_opts (mongoc_client_t *client,
 }
 
 
+/* run the getMore for a prefetch, sending it or reading its reply depending
+ * on prefetch.state. the outcome is kept for the batch it belongs to. */
+static void
+_mongoc_cursor_prefetch_run (mongoc_cursor_t *cursor)
+{
+   bson_t getmore_cmd;
+
+   _mongoc_cursor_prepare_getmore_command (cursor, &getmore_cmd);
+   bson_destroy (&cursor->prefetch.reply);
+   cursor->prefetch.ok = _mongoc_cursor_run_command (
+      cursor, &getmore_cmd, NULL /* opts */, &cursor->prefetch.reply, true);
+   bson_destroy (&getmore_cmd);
+
+   /* the current batch is still good, report any error with the next one */
+   memcpy (&cursor->prefetch.error, &cursor->error, sizeof (bson_error_t));
+   memset (&cursor->error, 0, sizeof (bson_error_t));
+   bson_reinit (&cursor->error_doc);
+}
+
+
+/* once no more than the "prefetch" option's number of documents remain in the
+ * current batch, send the next getMore without waiting for its reply. */
+static void
+_mongoc_cursor_prefetch_send (mongoc_cursor_t *cursor)
+{
+   mongoc_client_t *client = cursor->client;
+
+   if (cursor->prefetch.state != PREFETCH_NONE ||
+       cursor->prefetch.remaining > cursor->prefetch.low_water_mark) {
+      return;
+   }
+
+   /* one outstanding reply per client, the connection is shared */
+   if (!cursor->cursor_id || cursor->error.domain || client->prefetching ||
+       client->in_exhaust || _mongoc_cse_is_enabled (client) ||
+       cursor->client_generation != client->generation) {
+      return;
+   }
+
+   /* registered before sending, so the connection stays with this client */
+   cursor->prefetch.state = PREFETCH_SENDING;
+   client->prefetching = cursor;
+   _mongoc_cursor_prefetch_run (cursor);
+
+   if (cursor->prefetch.state == PREFETCH_SENT) {
+      return;
+   }
+
+   client->prefetching = NULL;
+
+   if (cursor->prefetch.error.domain) {
+      /* keep the error for the next batch */
+      cursor->prefetch.state = PREFETCH_READ;
+   } else {
+      /* not sent, the server is too old */
+      cursor->prefetch.state = PREFETCH_NONE;
+      cursor->prefetch.low_water_mark = -1;
+   }
+}
+
+
+static void
+_mongoc_cursor_prefetch_start_batch (mongoc_cursor_t *cursor,
+                                     const bson_iter_t *batch_iter)
+{
+   bson_iter_t iter;
+
+   cursor->prefetch.low_water_mark =
+      _mongoc_cursor_get_opt_int64 (cursor, MONGOC_CURSOR_PREFETCH, -1);
+
+   /* tailable cursors may block awaiting data, exhaust cursors stream */
+   if (_mongoc_cursor_get_opt_bool (cursor, MONGOC_CURSOR_TAILABLE) ||
+       _mongoc_cursor_get_opt_bool (cursor, MONGOC_CURSOR_EXHAUST)) {
+      cursor->prefetch.low_water_mark = -1;
+   }
+
+   if (cursor->prefetch.low_water_mark < 0) {
+      return;
+   }
+
+   cursor->prefetch.remaining = 0;
+   memcpy (&iter, batch_iter, sizeof (bson_iter_t));
+   while (bson_iter_next (&iter)) {
+      cursor->prefetch.remaining++;
+   }
+
+   _mongoc_cursor_prefetch_send (cursor);
+}
+
+
+/* read the reply to the cursor's prefetched getMore. called before anything
+ * else uses the connection, see _mongoc_client_read_prefetched. */
+void
+_mongoc_cursor_prefetch_read (mongoc_cursor_t *cursor)
+{
+   BSON_ASSERT (cursor->prefetch.state == PREFETCH_SENT);
+
+   if (cursor->client->prefetching == cursor) {
+      cursor->client->prefetching = NULL;
+   }
+
+   _mongoc_cursor_prefetch_run (cursor);
+   cursor->prefetch.state = PREFETCH_READ;
+}
+
+
+/* steal the prefetched reply for the next batch, reading it if necessary */
+static bool
+_mongoc_cursor_prefetch_take (mongoc_cursor_t *cursor, bson_t *reply)
+{
+   bool ok;
+
+   if (cursor->prefetch.state == PREFETCH_SENT) {
+      _mongoc_cursor_prefetch_read (cursor);
+   }
+
+   BSON_ASSERT (cursor->prefetch.state == PREFETCH_READ);
+   ok = cursor->prefetch.ok;
+   BSON_ASSERT (bson_steal (reply, &cursor->prefetch.reply));
+   bson_init (&cursor->prefetch.reply);
+   cursor->prefetch.state = PREFETCH_NONE;
+
+   if (!ok) {
+      memcpy (&cursor->error, &cursor->prefetch.error, sizeof (bson_error_t));
+      bson_destroy (&cursor->error_doc);
+      bson_copy_to (reply, &cursor->error_doc);
+   }
+
+   return ok;
+}
+
+
+/* choose the next getMore's batchSize: double the size of the latest batch,
+ * but keep the expected reply, at the average document size seen so far,
+ * within adaptive.target_bytes */
+static void
+_mongoc_cursor_adaptive_start_batch (mongoc_cursor_t *cursor,
+                                     const bson_iter_t *batch_iter)
+{
+   mongoc_cursor_adaptive_t *adaptive = &cursor->adaptive;
+   bson_iter_t iter;
+   const uint8_t *data;
+   uint32_t len;
+   int64_t n_docs = 0;
+   int64_t max_docs;
+
+   if (!_mongoc_cursor_get_opt_bool (cursor,
+                                     MONGOC_CURSOR_ADAPTIVE_BATCH_SIZE) ||
+       _mongoc_cursor_get_opt_bool (cursor, MONGOC_CURSOR_TAILABLE) ||
+       _mongoc_cursor_get_opt_bool (cursor, MONGOC_CURSOR_EXHAUST)) {
+      adaptive->batch_size = 0;
+      return;
+   }
+
+   memcpy (&iter, batch_iter, sizeof (bson_iter_t));
+   while (bson_iter_next (&iter)) {
+      if (BSON_ITER_HOLDS_DOCUMENT (&iter)) {
+         bson_iter_document (&iter, &len, &data);
+         adaptive->n_bytes += len;
+         n_docs++;
+      }
+   }
+
+   adaptive->n_docs += n_docs;
+
+   if (!adaptive->target_bytes) {
+      adaptive->target_bytes = MONGOC_CURSOR_ADAPTIVE_MIN_BYTES;
+   } else if (adaptive->latency_usec >= MONGOC_CURSOR_ADAPTIVE_SLOW_USEC) {
+      /* fewer, larger batches hide more of the round trip time */
+      adaptive->target_bytes = BSON_MIN (adaptive->target_bytes * 2,
+                                         MONGOC_CURSOR_ADAPTIVE_MAX_BYTES);
+   }
+
+   if (!adaptive->n_docs) {
+      return;
+   }
+
+   max_docs = adaptive->target_bytes /
+              BSON_MAX (adaptive->n_bytes / adaptive->n_docs, 1);
+
+   adaptive->batch_size =
+      BSON_MAX (BSON_MIN (BSON_MAX (n_docs, adaptive->batch_size) * 2,
+                          BSON_MIN (max_docs, INT32_MAX)),
+                1);
+}
+
+
 bool
 _mongoc_cursor_start_reading_response (mongoc_cursor_t *cursor,
                                        mongoc_cursor_response_t *response)
@@ -1633,6 +1948,11 @@ _mongoc_cursor_start_reading_response (mongoc_cursor_t *cursor,
       cursor->client_session = NULL;
    }
 
+   if (in_batch) {
+      _mongoc_cursor_adaptive_start_batch (cursor, &response->batch_iter);
+      _mongoc_cursor_prefetch_start_batch (cursor, &response->batch_iter);
+   }
+
    return in_batch;
 }
 
@@ -1654,6 +1974,11 @@ _mongoc_cursor_response_read (mongoc_cursor_t *cursor,
       /* bson_iter_next guarantees valid BSON, so this must succeed */
       BSON_ASSERT (bson_init_static (&response->current_doc, data, data_len));
       *bson = &response->current_doc;
+
+      if (cursor->prefetch.low_water_mark >= 0) {
+         cursor->prefetch.remaining--;
+         _mongoc_cursor_prefetch_send (cursor);
+      }
    }
 }
 
@@ -1664,15 +1989,27 @@ _mongoc_cursor_response_refresh (mongoc_cursor_t *cursor,
                                  const bson_t *opts,
                                  mongoc_cursor_response_t *response)
 {
+   bool ok;
+   int64_t started;
+
    ENTRY;
 
    bson_destroy (&response->reply);
 
+   if (cursor->prefetch.state != PREFETCH_NONE) {
+      /* this getMore was sent while the previous batch was read */
+      ok = _mongoc_cursor_prefetch_take (cursor, &response->reply);
+      cursor->adaptive.latency_usec = 0;
+   } else {
+      started = bson_get_monotonic_time ();
+      ok = _mongoc_cursor_run_command (
+         cursor, command, opts, &response->reply, false);
+      cursor->adaptive.latency_usec = bson_get_monotonic_time () - started;
+   }
+
    /* server replies to find / aggregate with {cursor: {id: N, firstBatch: []}},
     * to getMore command with {cursor: {id: N, nextBatch: []}}. */
-   if (_mongoc_cursor_run_command (
-          cursor, command, opts, &response->reply, false) &&
-       _mongoc_cursor_start_reading_response (cursor, response)) {
+   if (ok && _mongoc_cursor_start_reading_response (cursor, response)) {
       return;
    }
    if (!cursor->error.domain) {
@@ -1702,7 +2039,9 @@ _mongoc_cursor_prepare_getmore_command (mongoc_cursor_t *cursor,
    bson_append_int64 (command, "getMore", 7, mongoc_cursor_get_id (cursor));
    bson_append_utf8 (command, "collection", 10, collection, collection_len);
 
-   batch_size = mongoc_cursor_get_batch_size (cursor);
+   batch_size = cursor->adaptive.batch_size
+                   ? cursor->adaptive.batch_size
+                   : mongoc_cursor_get_batch_size (cursor);
 
    /* See find, getMore, and killCursors Spec for batchSize rules */
    if (batch_size) {
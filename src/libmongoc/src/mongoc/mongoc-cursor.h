@@ -76,6 +76,10 @@ mongoc_cursor_set_max_await_time_ms (mongoc_cursor_t *cursor,
                                      uint32_t max_await_time_ms);
 MONGOC_EXPORT (uint32_t)
 mongoc_cursor_get_max_await_time_ms (const mongoc_cursor_t *cursor);
+MONGOC_EXPORT (void)
+mongoc_cursor_set_prefetch (mongoc_cursor_t *cursor, uint32_t low_water_mark);
+MONGOC_EXPORT (void)
+mongoc_cursor_set_adaptive_batch_size (mongoc_cursor_t *cursor, bool adaptive);
 MONGOC_EXPORT (mongoc_cursor_t *)
 mongoc_cursor_new_from_command_reply (struct _mongoc_client_t *client,
                                       bson_t *reply,
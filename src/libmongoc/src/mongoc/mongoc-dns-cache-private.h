@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-prelude.h"
+
+#ifndef MONGOC_DNS_CACHE_PRIVATE_H
+#define MONGOC_DNS_CACHE_PRIVATE_H
+
+#include <bson/bson.h>
+
+#include "mongoc-host-list.h"
+#include "mongoc-socket.h"
+
+BSON_BEGIN_DECLS
+
+#define MONGOC_DNS_CACHE_TIMEOUT_MS (10 * 60 * 1000)
+/* hosts tracked before stale or least recently resolved ones are evicted. */
+#define MONGOC_DNS_CACHE_MAX_ENTRIES 1024
+
+/* The getaddrinfo results for one host, shared by the topology scanner and
+ * application connections. Reference counted: release with
+ * _mongoc_dns_result_release. */
+typedef struct _mongoc_dns_result_t {
+   /* ordered by host preference. */
+   struct addrinfo *addrs;
+   /* monotonic time of the lookup, in microseconds. */
+   int64_t resolved_at;
+   volatile int32_t refcount;
+} mongoc_dns_result_t;
+
+void
+_mongoc_dns_cache_init (void);
+
+void
+_mongoc_dns_cache_cleanup (void);
+
+mongoc_dns_result_t *
+_mongoc_dns_cache_resolve (const mongoc_host_list_t *host,
+                           int64_t timeout_ms,
+                           bson_error_t *error);
+
+void
+_mongoc_dns_cache_invalidate (const mongoc_host_list_t *host,
+                              const mongoc_dns_result_t *result);
+
+void
+_mongoc_dns_result_release (mongoc_dns_result_t *result);
+
+size_t
+_mongoc_dns_cache_count (void);
+
+BSON_END_DECLS
+
+#endif /* MONGOC_DNS_CACHE_PRIVATE_H */
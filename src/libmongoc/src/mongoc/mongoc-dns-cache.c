@@ -0,0 +1,313 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-dns-cache-private.h"
+
+#include "mongoc-counters-private.h"
+#include "mongoc-error.h"
+#include "mongoc-thread-private.h"
+#include "mongoc-trace-private.h"
+#include "utlist.h"
+
+#undef MONGOC_LOG_DOMAIN
+#define MONGOC_LOG_DOMAIN "dns"
+
+typedef struct _cache_entry_list_t {
+   struct _cache_entry_list_t *next;
+   char *host_and_port;
+   int family;
+   /* the cache's reference to the latest results, or NULL. */
+   mongoc_dns_result_t *result;
+   /* a thread is calling getaddrinfo for this host. */
+   bool resolving;
+   /* the last lookup failed. */
+   bool failed;
+   /* threads waiting for the lookup in progress. */
+   int n_waiters;
+} cache_entry_list_t;
+
+static cache_entry_list_t *cache;
+static size_t n_entries;
+static bson_mutex_t dns_cache_mutex;
+/* signaled when a lookup finishes. */
+static mongoc_cond_t dns_cache_cond;
+
+void
+_mongoc_dns_cache_init (void)
+{
+   bson_mutex_init (&dns_cache_mutex);
+   mongoc_cond_init (&dns_cache_cond);
+}
+
+void
+_mongoc_dns_result_release (mongoc_dns_result_t *result)
+{
+   if (!result) {
+      return;
+   }
+
+   if (bson_atomic_int_add (&result->refcount, -1) == 0) {
+      freeaddrinfo (result->addrs);
+      bson_free (result);
+   }
+}
+
+static cache_entry_list_t *
+_get_cache_entry (const mongoc_host_list_t *host)
+{
+   cache_entry_list_t *iter;
+
+   LL_FOREACH (cache, iter)
+   {
+      if (iter->family == host->family &&
+          !strcmp (iter->host_and_port, host->host_and_port)) {
+         return iter;
+      }
+   }
+
+   return NULL;
+}
+
+static bool
+_is_fresh (const mongoc_dns_result_t *result, int64_t timeout_ms)
+{
+   return result &&
+          bson_get_monotonic_time () - result->resolved_at <= timeout_ms * 1000;
+}
+
+static void
+_destroy_entry (cache_entry_list_t *entry)
+{
+   LL_DELETE (cache, entry);
+   n_entries--;
+   _mongoc_dns_result_release (entry->result);
+   bson_free (entry->host_and_port);
+   bson_free (entry);
+}
+
+/* Make room for a new entry. Drop the entries whose results are older than
+ * the default cache timeout, then the least recently resolved ones. Entries
+ * that a thread is resolving or waiting on stay. */
+static void
+_make_room (void)
+{
+   cache_entry_list_t *iter;
+   cache_entry_list_t *tmp;
+   cache_entry_list_t *oldest;
+
+   LL_FOREACH_SAFE (cache, iter, tmp)
+   {
+      if (!iter->resolving && !iter->n_waiters &&
+          !_is_fresh (iter->result, MONGOC_DNS_CACHE_TIMEOUT_MS)) {
+         _destroy_entry (iter);
+      }
+   }
+
+   while (n_entries >= MONGOC_DNS_CACHE_MAX_ENTRIES) {
+      oldest = NULL;
+      LL_FOREACH (cache, iter)
+      {
+         if (iter->resolving || iter->n_waiters) {
+            continue;
+         }
+
+         /* entries without results were removed above. */
+         if (!oldest ||
+             iter->result->resolved_at <= oldest->result->resolved_at) {
+            oldest = iter;
+         }
+      }
+
+      if (!oldest) {
+         /* every entry is in use. */
+         return;
+      }
+
+      _destroy_entry (oldest);
+   }
+}
+
+static mongoc_dns_result_t *
+_ref (mongoc_dns_result_t *result)
+{
+   bson_atomic_int_add (&result->refcount, 1);
+   return result;
+}
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_dns_cache_resolve --
+ *
+ *      Get the addresses of @host, calling getaddrinfo unless another
+ *      caller resolved @host less than @timeout_ms ago. If another thread
+ *      is already resolving @host, wait for its results instead of
+ *      querying the resolver again.
+ *
+ * Returns:
+ *      A reference to the results, to be released with
+ *      _mongoc_dns_result_release. On failure, returns NULL and sets
+ *      @error.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+mongoc_dns_result_t *
+_mongoc_dns_cache_resolve (const mongoc_host_list_t *host,
+                           int64_t timeout_ms,
+                           bson_error_t *error)
+{
+   cache_entry_list_t *entry;
+   mongoc_dns_result_t *result;
+   struct addrinfo hints;
+   struct addrinfo *addrs;
+   char portstr[8];
+   bool waited = false;
+   int s;
+
+   ENTRY;
+
+   bson_mutex_lock (&dns_cache_mutex);
+   entry = _get_cache_entry (host);
+   if (!entry) {
+      if (n_entries >= MONGOC_DNS_CACHE_MAX_ENTRIES) {
+         _make_room ();
+      }
+
+      entry = bson_malloc0 (sizeof (cache_entry_list_t));
+      entry->host_and_port = bson_strdup (host->host_and_port);
+      entry->family = host->family;
+      LL_PREPEND (cache, entry);
+      n_entries++;
+   }
+
+   while (entry->resolving) {
+      entry->n_waiters++;
+      mongoc_cond_wait (&dns_cache_cond, &dns_cache_mutex);
+      entry->n_waiters--;
+      waited = true;
+   }
+
+   if (_is_fresh (entry->result, timeout_ms)) {
+      result = _ref (entry->result);
+      bson_mutex_unlock (&dns_cache_mutex);
+      RETURN (result);
+   }
+
+   if (waited && entry->failed) {
+      /* the lookup we waited for failed, don't repeat it right away. */
+      bson_mutex_unlock (&dns_cache_mutex);
+      GOTO (failure);
+   }
+
+   entry->resolving = true;
+   bson_mutex_unlock (&dns_cache_mutex);
+
+   bson_snprintf (portstr, sizeof portstr, "%hu", host->port);
+
+   memset (&hints, 0, sizeof hints);
+   hints.ai_family = host->family;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_flags = 0;
+   hints.ai_protocol = 0;
+
+   TRACE ("DNS lookup for %s", host->host);
+   s = getaddrinfo (host->host, portstr, &hints, &addrs);
+
+   bson_mutex_lock (&dns_cache_mutex);
+   entry->resolving = false;
+   entry->failed = (s != 0);
+   mongoc_cond_broadcast (&dns_cache_cond);
+
+   if (s != 0) {
+      bson_mutex_unlock (&dns_cache_mutex);
+      GOTO (failure);
+   }
+
+   mongoc_counter_dns_success_inc ();
+
+   result = bson_malloc0 (sizeof (mongoc_dns_result_t));
+   result->addrs = addrs;
+   result->resolved_at = bson_get_monotonic_time ();
+   /* one reference for the cache, one for the caller. */
+   result->refcount = 2;
+
+   _mongoc_dns_result_release (entry->result);
+   entry->result = result;
+   bson_mutex_unlock (&dns_cache_mutex);
+
+   RETURN (result);
+
+failure:
+   mongoc_counter_dns_failure_inc ();
+   TRACE ("Failed to resolve %s", host->host);
+   bson_set_error (error,
+                   MONGOC_ERROR_STREAM,
+                   MONGOC_ERROR_STREAM_NAME_RESOLUTION,
+                   "Failed to resolve '%s'",
+                   host->host);
+   RETURN (NULL);
+}
+
+/* Forget @host's cached results if they are still @result, e.g. after
+ * failing to connect to any of its addresses. */
+void
+_mongoc_dns_cache_invalidate (const mongoc_host_list_t *host,
+                              const mongoc_dns_result_t *result)
+{
+   cache_entry_list_t *entry;
+
+   bson_mutex_lock (&dns_cache_mutex);
+   entry = _get_cache_entry (host);
+   if (entry && entry->result == result) {
+      _mongoc_dns_result_release (entry->result);
+      entry->result = NULL;
+   }
+
+   bson_mutex_unlock (&dns_cache_mutex);
+}
+
+/* The number of hosts in the cache, for testing. */
+size_t
+_mongoc_dns_cache_count (void)
+{
+   size_t count;
+
+   bson_mutex_lock (&dns_cache_mutex);
+   count = n_entries;
+   bson_mutex_unlock (&dns_cache_mutex);
+
+   return count;
+}
+
+void
+_mongoc_dns_cache_cleanup (void)
+{
+   cache_entry_list_t *iter;
+   cache_entry_list_t *tmp;
+
+   LL_FOREACH_SAFE (cache, iter, tmp)
+   {
+      _mongoc_dns_result_release (iter->result);
+      bson_free (iter->host_and_port);
+      bson_free (iter);
+   }
+
+   cache = NULL;
+   n_entries = 0;
+   mongoc_cond_destroy (&dns_cache_cond);
+   bson_mutex_destroy (&dns_cache_mutex);
+}
@@ -22,6 +22,7 @@
 #include "mongoc-init.h"
 
 #include "mongoc-handshake-private.h"
+#include "mongoc-dns-cache-private.h"
 
 #ifdef MONGOC_ENABLE_SSL_OPENSSL
 #include "mongoc-openssl-private.h"
@@ -37,6 +38,11 @@
 
 #ifdef MONGOC_ENABLE_MONGODB_AWS_AUTH
 #include "kms_message/kms_message.h"
+#include "mongoc-cluster-aws-private.h"
+#endif
+
+#ifdef MONGOC_ENABLE_CRYPTO
+#include "mongoc-scram-private.h"
 #endif
 
 #ifdef MONGOC_ENABLE_OCSP_OPENSSL
@@ -139,8 +145,15 @@ static BSON_ONCE_FUN (_mongoc_do_init)
 
    _mongoc_handshake_init ();
 
+   _mongoc_dns_cache_init ();
+
+#ifdef MONGOC_ENABLE_CRYPTO
+   _mongoc_scram_key_cache_init ();
+#endif
+
 #if defined(MONGOC_ENABLE_MONGODB_AWS_AUTH)
    kms_message_init ();
+   _mongoc_aws_credentials_cache_init ();
 #endif
 
 #if defined(MONGOC_ENABLE_OCSP_OPENSSL)
@@ -184,8 +197,15 @@ static BSON_ONCE_FUN (_mongoc_do_cleanup)
 
    _mongoc_handshake_cleanup ();
 
+   _mongoc_dns_cache_cleanup ();
+
+#ifdef MONGOC_ENABLE_CRYPTO
+   _mongoc_scram_key_cache_cleanup ();
+#endif
+
 #if defined(MONGOC_ENABLE_MONGODB_AWS_AUTH)
    kms_message_cleanup ();
+   _mongoc_aws_credentials_cache_cleanup ();
 #endif
 
 #if defined(MONGOC_ENABLE_OCSP_OPENSSL)
@@ -26,6 +26,15 @@
 #ifdef MONGOC_ENABLE_OCSP_OPENSSL
 #include <openssl/ocsp.h>
 
+/* responses are hashed into buckets that each have their own lock, so
+ * handshakes with different servers don't contend. */
+#define MONGOC_OCSP_CACHE_BUCKETS 64
+/* the most responses the cache holds. */
+#define MONGOC_OCSP_CACHE_MAX_SIZE 1024
+/* each bucket holds its share, so the bound is kept under the bucket's lock. */
+#define MONGOC_OCSP_CACHE_BUCKET_MAX_SIZE \
+   (MONGOC_OCSP_CACHE_MAX_SIZE / MONGOC_OCSP_CACHE_BUCKETS)
+
 void
 _mongoc_ocsp_cache_init (void);
 
@@ -19,42 +19,80 @@
 #ifdef MONGOC_ENABLE_OCSP_OPENSSL
 
 #include "utlist.h"
+#include "mongoc-counters-private.h"
 #include "mongoc-trace-private.h"
 #include <bson/bson.h>
 #include <common-thread-private.h>
 
 typedef struct _cache_entry_list_t {
    struct _cache_entry_list_t *next;
+   uint32_t hash;
    OCSP_CERTID *id;
    int cert_status, reason;
    ASN1_GENERALIZEDTIME *this_update, *next_update;
 } cache_entry_list_t;
 
-static cache_entry_list_t *cache;
-static bson_mutex_t ocsp_cache_mutex;
+typedef struct {
+   bson_mutex_t mutex;
+   cache_entry_list_t *entries;
+   int32_t n_entries;
+} cache_bucket_t;
+
+static cache_bucket_t cache[MONGOC_OCSP_CACHE_BUCKETS];
+static volatile int32_t cache_size;
 
 void
 _mongoc_ocsp_cache_init ()
 {
-   bson_mutex_init (&ocsp_cache_mutex);
+   int i;
+
+   for (i = 0; i < MONGOC_OCSP_CACHE_BUCKETS; i++) {
+      bson_mutex_init (&cache[i].mutex);
+      cache[i].entries = NULL;
+      cache[i].n_entries = 0;
+   }
+
+   cache_size = 0;
 }
 
-static int
-cache_cmp (cache_entry_list_t *out, OCSP_CERTID *id)
+/* hash the DER encoding of @id: its issuer name and key digests and the
+ * certificate's serial number. */
+static uint32_t
+cache_hash (OCSP_CERTID *id)
 {
-   ENTRY;
-   if (!out || !out->id || !id)
-      RETURN (1);
-   RETURN (OCSP_id_cmp (out->id, id));
+   unsigned char *der = NULL;
+   uint32_t hash = 5381;
+   int len;
+   int i;
+
+   len = i2d_OCSP_CERTID (id, &der);
+   for (i = 0; i < len; i++) {
+      hash = ((hash << 5) + hash) + der[i];
+   }
+
+   OPENSSL_free (der);
+   return hash;
+}
+
+static cache_bucket_t *
+get_bucket (uint32_t hash)
+{
+   return &cache[hash % MONGOC_OCSP_CACHE_BUCKETS];
 }
 
 static cache_entry_list_t *
-get_cache_entry (OCSP_CERTID *id)
+get_cache_entry (cache_bucket_t *bucket, OCSP_CERTID *id, uint32_t hash)
 {
    cache_entry_list_t *iter = NULL;
    ENTRY;
 
-   LL_SEARCH (cache, iter, id, cache_cmp);
+   LL_FOREACH (bucket->entries, iter)
+   {
+      if (iter->hash == hash && !OCSP_id_cmp (iter->id, id)) {
+         break;
+      }
+   }
+
    RETURN (iter);
 }
 
@@ -100,6 +138,65 @@ _cmp_time (ASN1_TIME *a, ASN1_TIME *b)
 }
 #endif
 
+static void
+cache_entry_destroy (cache_entry_list_t *entry)
+{
+   OCSP_CERTID_free (entry->id);
+   ASN1_GENERALIZEDTIME_free (entry->this_update);
+   ASN1_GENERALIZEDTIME_free (entry->next_update);
+   bson_free (entry);
+}
+
+static void
+remove_entry (cache_bucket_t *bucket, cache_entry_list_t *entry)
+{
+   LL_DELETE (bucket->entries, entry);
+   cache_entry_destroy (entry);
+   bucket->n_entries--;
+   bson_atomic_int_add (&cache_size, -1);
+}
+
+/* Make room in @bucket for a response that expires at @next_update: remove
+ * its responses past their nextUpdate, then if it is still full, the one that
+ * expires first, unless the new response expires even sooner. Returns false if
+ * the new response should not be cached. */
+static bool
+make_room (cache_bucket_t *bucket, ASN1_GENERALIZEDTIME *next_update)
+{
+   cache_entry_list_t *iter;
+   cache_entry_list_t *tmp;
+   cache_entry_list_t *oldest = NULL;
+
+   LL_FOREACH_SAFE (bucket->entries, iter, tmp)
+   {
+      if (iter->next_update && X509_cmp_current_time (iter->next_update) < 0) {
+         remove_entry (bucket, iter);
+      }
+   }
+
+   if (bucket->n_entries < MONGOC_OCSP_CACHE_BUCKET_MAX_SIZE) {
+      return true;
+   }
+
+   LL_FOREACH (bucket->entries, iter)
+   {
+      if (!oldest || !iter->next_update ||
+          (oldest->next_update &&
+           _cmp_time (iter->next_update, oldest->next_update) < 0)) {
+         oldest = iter;
+      }
+   }
+
+   if (!oldest || (oldest->next_update &&
+                   (!next_update ||
+                    _cmp_time (oldest->next_update, next_update) > 0))) {
+      return false;
+   }
+
+   remove_entry (bucket, oldest);
+   return true;
+}
+
 void
 _mongoc_ocsp_cache_set_resp (OCSP_CERTID *id,
                              int cert_status,
@@ -108,42 +205,46 @@ _mongoc_ocsp_cache_set_resp (OCSP_CERTID *id,
                              ASN1_GENERALIZEDTIME *next_update)
 {
    cache_entry_list_t *entry = NULL;
+   cache_bucket_t *bucket;
+   uint32_t hash;
    ENTRY;
 
-   bson_mutex_lock (&ocsp_cache_mutex);
-   if (!(entry = get_cache_entry (id))) {
+   hash = cache_hash (id);
+   bucket = get_bucket (hash);
+
+   bson_mutex_lock (&bucket->mutex);
+   if (!(entry = get_cache_entry (bucket, id, hash))) {
+      if (!make_room (bucket, next_update)) {
+         TRACE ("%s", "OCSP cache bucket is full, not caching response");
+         GOTO (done);
+      }
+
       entry = bson_malloc0 (sizeof (cache_entry_list_t));
       entry->id = OCSP_CERTID_dup (id);
-      LL_APPEND (cache, entry);
+      entry->hash = hash;
+      LL_PREPEND (bucket->entries, entry);
+      bucket->n_entries++;
+      bson_atomic_int_add (&cache_size, 1);
       update_entry (entry, cert_status, reason, this_update, next_update);
    } else if (next_update && _cmp_time (next_update, entry->next_update) == 1) {
       update_entry (entry, cert_status, reason, this_update, next_update);
    } else {
       /* Do nothing; our next_update is at a later date */
    }
-   bson_mutex_unlock (&ocsp_cache_mutex);
+
+done:
+   bson_mutex_unlock (&bucket->mutex);
+   EXIT;
 }
 
 int
 _mongoc_ocsp_cache_length ()
 {
-   cache_entry_list_t *iter;
-   int counter;
-
-   bson_mutex_lock (&ocsp_cache_mutex);
-   LL_COUNT (cache, iter, counter);
-   bson_mutex_unlock (&ocsp_cache_mutex);
-   RETURN (counter);
+   return (int) bson_atomic_int_add (&cache_size, 0);
 }
 
-static void
-cache_entry_destroy (cache_entry_list_t *entry)
-{
-   OCSP_CERTID_free (entry->id);
-   ASN1_GENERALIZEDTIME_free (entry->this_update);
-   ASN1_GENERALIZEDTIME_free (entry->next_update);
-   bson_free (entry);
-}
+/* On success, @this_update and @next_update are set to copies of the cached
+ * times, which the caller must free with ASN1_GENERALIZEDTIME_free. */
 bool
 _mongoc_ocsp_cache_get_status (OCSP_CERTID *id,
                                int *cert_status,
@@ -152,18 +253,22 @@ _mongoc_ocsp_cache_get_status (OCSP_CERTID *id,
                                ASN1_GENERALIZEDTIME **next_update)
 {
    cache_entry_list_t *entry = NULL;
+   cache_bucket_t *bucket;
+   uint32_t hash;
    bool ret = false;
    ENTRY;
 
-   bson_mutex_lock (&ocsp_cache_mutex);
-   if (!(entry = get_cache_entry (id))) {
+   hash = cache_hash (id);
+   bucket = get_bucket (hash);
+
+   bson_mutex_lock (&bucket->mutex);
+   if (!(entry = get_cache_entry (bucket, id, hash))) {
       GOTO (done);
    }
 
    if (entry->this_update && entry->next_update &&
        !OCSP_check_validity (entry->this_update, entry->next_update, 0L, -1L)) {
-      LL_DELETE (cache, entry);
-      cache_entry_destroy (entry);
+      remove_entry (bucket, entry);
       GOTO (done);
    }
 
@@ -174,12 +279,19 @@ _mongoc_ocsp_cache_get_status (OCSP_CERTID *id,
 
    *cert_status = entry->cert_status;
    *reason = entry->reason;
-   *this_update = entry->this_update;
-   *next_update = entry->next_update;
+   /* copy the times while the lock keeps the entry alive */
+   *this_update = ASN1_STRING_dup (entry->this_update);
+   *next_update = ASN1_STRING_dup (entry->next_update);
 
    ret = true;
 done:
-   bson_mutex_unlock (&ocsp_cache_mutex);
+   bson_mutex_unlock (&bucket->mutex);
+   if (ret) {
+      mongoc_counter_ocsp_cache_hits_inc ();
+   } else {
+      mongoc_counter_ocsp_cache_misses_inc ();
+   }
+
    RETURN (ret);
 }
 
@@ -188,17 +300,23 @@ _mongoc_ocsp_cache_cleanup ()
 {
    cache_entry_list_t *iter = NULL;
    cache_entry_list_t *next = NULL;
+   int i;
    ENTRY;
 
-   bson_mutex_lock (&ocsp_cache_mutex);
-   for (iter = cache; iter != NULL; iter = next) {
-      next = iter->next;
-      cache_entry_destroy (iter);
+   for (i = 0; i < MONGOC_OCSP_CACHE_BUCKETS; i++) {
+      bson_mutex_lock (&cache[i].mutex);
+      for (iter = cache[i].entries; iter != NULL; iter = next) {
+         next = iter->next;
+         cache_entry_destroy (iter);
+      }
+
+      cache[i].entries = NULL;
+      cache[i].n_entries = 0;
+      bson_mutex_unlock (&cache[i].mutex);
+      bson_mutex_destroy (&cache[i].mutex);
    }
 
-   cache = NULL;
-   bson_mutex_unlock (&ocsp_cache_mutex);
-   bson_mutex_destroy (&ocsp_cache_mutex);
+   cache_size = 0;
 }
 
 #endif /* MONGOC_ENABLE_OCSP_OPENSSL */
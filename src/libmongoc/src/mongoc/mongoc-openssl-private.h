@@ -26,15 +26,48 @@
 
 #include "mongoc-ssl.h"
 #include "mongoc-stream-tls-openssl-private.h"
+#include "mongoc-thread-private.h"
 
 #if (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_OCSP) && \
    !defined(LIBRESSL_VERSION_NUMBER)
 #define MONGOC_ENABLE_OCSP_OPENSSL
+#include <openssl/ocsp.h>
+#endif
+
+/* OpenSSL 3.0 can hand a connection's record encryption to the Linux kernel
+ * (kTLS) when the SSL reads and writes a socket BIO. */
+#if defined(__linux__) && defined(SSL_OP_ENABLE_KTLS) && \
+   !defined(OPENSSL_NO_KTLS)
+#define MONGOC_ENABLE_KTLS_OPENSSL
 #endif
 
 
 BSON_BEGIN_DECLS
 
+typedef struct _mongoc_openssl_session_t {
+   struct _mongoc_openssl_session_t *next;
+   char *host;
+   SSL_SESSION *session;
+#ifdef MONGOC_ENABLE_OCSP_OPENSSL
+   /* the host's certificate passed OCSP validation in a full handshake. */
+   bool ocsp_validated;
+   /* the certificate's OCSP id, and whether its status was cached then. A
+    * session is only resumed while that status is cached and not revoked. */
+   OCSP_CERTID *ocsp_id;
+   bool ocsp_status_cached;
+#endif
+} mongoc_openssl_session_t;
+
+/* An SSL_CTX shared by the TLS streams of one client, pool, or mock server,
+ * with the last session negotiated with each host. Reference counted. */
+typedef struct _mongoc_openssl_shared_ctx_t {
+   SSL_CTX *ctx;
+   bool client;
+   bson_mutex_t mutex;
+   mongoc_openssl_session_t *sessions;
+   volatile int32_t refcount;
+} mongoc_openssl_shared_ctx_t;
+
 bool
 _mongoc_openssl_check_peer_hostname (SSL *ssl,
                                      const char *host,
@@ -47,10 +80,33 @@ void
 _mongoc_openssl_init (void);
 void
 _mongoc_openssl_cleanup (void);
+mongoc_openssl_shared_ctx_t *
+_mongoc_openssl_shared_ctx_new (mongoc_ssl_opt_t *opt, bool client);
+mongoc_openssl_shared_ctx_t *
+_mongoc_openssl_shared_ctx_ref (mongoc_openssl_shared_ctx_t *shared);
+void
+_mongoc_openssl_shared_ctx_release (mongoc_openssl_shared_ctx_t *shared);
+void
+_mongoc_openssl_shared_ctx_resume (mongoc_openssl_shared_ctx_t *shared,
+                                   SSL *ssl,
+                                   const char *host,
+                                   bool check_ocsp);
 
 #ifdef MONGOC_ENABLE_OCSP_OPENSSL
 int
-_mongoc_ocsp_tlsext_status (SSL *ssl, mongoc_openssl_ocsp_opt_t *opts);
+_mongoc_ocsp_tlsext_status (SSL *ssl,
+                            mongoc_openssl_ocsp_opt_t *opts,
+                            OCSP_CERTID **peer_id);
+void
+_mongoc_openssl_shared_ctx_ocsp_validated (mongoc_openssl_shared_ctx_t *shared,
+                                           const char *host,
+                                           OCSP_CERTID *peer_id);
+bool
+_mongoc_openssl_shared_ctx_ocsp_check_resumed (
+   mongoc_openssl_shared_ctx_t *shared, const char *host);
+void
+_mongoc_openssl_shared_ctx_forget (mongoc_openssl_shared_ctx_t *shared,
+                                   const char *host);
 #endif
 
 bool
@@ -38,6 +38,7 @@
 #include "mongoc-thread-private.h"
 #include "mongoc-trace-private.h"
 #include "mongoc-util-private.h"
+#include "utlist.h"
 
 #ifdef MONGOC_ENABLE_OCSP_OPENSSL
 #include "mongoc-ocsp-cache-private.h"
@@ -763,8 +764,13 @@ _contact_ocsp_responder (OCSP_CERTID *id,
 #define X509_CHECK_SUCCESS 1
 #define OCSP_VERIFY_SUCCESS 1
 
+/* Validate the peer certificate's OCSP status in a full handshake. On success,
+ * @peer_id is set to the certificate's OCSP id or NULL, to be freed by the
+ * caller. */
 int
-_mongoc_ocsp_tlsext_status (SSL *ssl, mongoc_openssl_ocsp_opt_t *opts)
+_mongoc_ocsp_tlsext_status (SSL *ssl,
+                            mongoc_openssl_ocsp_opt_t *opts,
+                            OCSP_CERTID **peer_id)
 {
    enum { OCSP_CB_ERROR = -1, OCSP_CB_REVOKED, OCSP_CB_SUCCESS } ret;
    bool stapled_response = true;
@@ -781,6 +787,8 @@ _mongoc_ocsp_tlsext_status (SSL *ssl, mongoc_openssl_ocsp_opt_t *opts)
                         *next_update = NULL;
    int ocsp_uri_count = 0;
 
+   *peer_id = NULL;
+
    if (opts->weak_cert_validation) {
       return OCSP_CB_SUCCESS;
    }
@@ -904,6 +912,10 @@ _mongoc_ocsp_tlsext_status (SSL *ssl, mongoc_openssl_ocsp_opt_t *opts)
       GOTO (done);
    }
 
+   /* own the times like those from the cache, they outlive basic */
+   this_update = ASN1_STRING_dup (this_update);
+   next_update = ASN1_STRING_dup (next_update);
+
    /* checks the validity of this_update and next_update values */
    if (!OCSP_check_validity (this_update, next_update, 0L, -1L)) {
       SOFT_FAIL ("OCSP response has expired: %s", ERR_STR);
@@ -944,6 +956,10 @@ done:
    if (ret == OCSP_CB_ERROR && !stapled_response) {
       ret = OCSP_CB_SUCCESS;
    }
+   if (ret == OCSP_CB_SUCCESS) {
+      *peer_id = id;
+      id = NULL;
+   }
    if (basic)
       OCSP_BASICRESP_free (basic);
    if (resp)
@@ -954,6 +970,8 @@ done:
       X509_free (peer);
    if (cert_chain)
       _free_verified_chain (cert_chain);
+   ASN1_GENERALIZEDTIME_free (this_update);
+   ASN1_GENERALIZEDTIME_free (next_update);
    RETURN (ret);
 }
 
@@ -1057,6 +1075,345 @@ _mongoc_openssl_ctx_new (mongoc_ssl_opt_t *opt)
 }
 
 
+/* Callback to get the client provided SNI, if any
+ * It is only called in SSL "server mode" (e.g. when using the Mock Server),
+ * and we don't actually use the hostname for anything, just debug print it
+ */
+static int
+_mongoc_openssl_sni (SSL *ssl, int *ad, void *arg)
+{
+   const char *hostname;
+
+   if (ssl == NULL) {
+      TRACE ("%s", "No SNI hostname provided");
+      return SSL_TLSEXT_ERR_NOACK;
+   }
+
+   hostname = SSL_get_servername (ssl, TLSEXT_NAMETYPE_host_name);
+   /* This is intentionally debug since its only used by the mock test server */
+   MONGOC_DEBUG ("Got SNI: '%s'", hostname);
+
+   return SSL_TLSEXT_ERR_OK;
+}
+
+
+/* Get @host's entry in @shared's sessions, adding it if @add is true. Call
+ * with @shared's mutex locked. */
+static mongoc_openssl_session_t *
+_get_session_entry (mongoc_openssl_shared_ctx_t *shared,
+                    const char *host,
+                    bool add)
+{
+   mongoc_openssl_session_t *iter;
+
+   LL_FOREACH (shared->sessions, iter)
+   {
+      if (!strcmp (iter->host, host)) {
+         return iter;
+      }
+   }
+
+   if (!add) {
+      return NULL;
+   }
+
+   iter = bson_malloc0 (sizeof (mongoc_openssl_session_t));
+   iter->host = bson_strdup (host);
+   LL_PREPEND (shared->sessions, iter);
+
+   return iter;
+}
+
+
+static void
+_session_entry_destroy (mongoc_openssl_session_t *entry)
+{
+   if (entry->session) {
+      SSL_SESSION_free (entry->session);
+   }
+
+#ifdef MONGOC_ENABLE_OCSP_OPENSSL
+   if (entry->ocsp_id) {
+      OCSP_CERTID_free (entry->ocsp_id);
+   }
+#endif
+
+   bson_free (entry->host);
+   bson_free (entry);
+}
+
+
+#ifdef MONGOC_ENABLE_OCSP_OPENSSL
+/* Whether the OCSP cache still vouches for the certificate @entry's session
+ * was negotiated with. Call with the shared context's mutex locked. */
+static bool
+_ocsp_allows_resume (const mongoc_openssl_session_t *entry)
+{
+   ASN1_GENERALIZEDTIME *this_update = NULL;
+   ASN1_GENERALIZEDTIME *next_update = NULL;
+   int cert_status;
+   int reason;
+
+   if (!entry->ocsp_validated || !entry->ocsp_id) {
+      return false;
+   }
+
+   if (!_mongoc_ocsp_cache_get_status (
+          entry->ocsp_id, &cert_status, &reason, &this_update, &next_update)) {
+      /* past its nextUpdate or evicted. if there was no status to cache, a
+       * full handshake would soft-fail the same way. */
+      return !entry->ocsp_status_cached;
+   }
+
+   ASN1_GENERALIZEDTIME_free (this_update);
+   ASN1_GENERALIZEDTIME_free (next_update);
+
+   return cert_status != V_OCSP_CERTSTATUS_REVOKED;
+}
+#endif
+
+
+static bool
+_session_resumable (const mongoc_openssl_session_t *entry, bool check_ocsp)
+{
+   if (!entry->session) {
+      return false;
+   }
+
+#ifdef MONGOC_ENABLE_OCSP_OPENSSL
+   if (check_ocsp) {
+      return _ocsp_allows_resume (entry);
+   }
+#endif
+
+   return true;
+}
+
+
+/* Called when a client-mode SSL receives a session it can resume later. The
+ * SSL's app data is the host it connected to. Returns 1 to take ownership of
+ * @session. */
+static int
+_mongoc_openssl_new_session (SSL *ssl, SSL_SESSION *session)
+{
+   mongoc_openssl_shared_ctx_t *shared;
+   mongoc_openssl_session_t *entry;
+   const char *host;
+
+   shared = (mongoc_openssl_shared_ctx_t *) SSL_CTX_get_app_data (
+      SSL_get_SSL_CTX (ssl));
+   host = (const char *) SSL_get_app_data (ssl);
+   if (!shared || !host) {
+      return 0;
+   }
+
+   bson_mutex_lock (&shared->mutex);
+   entry = _get_session_entry (shared, host, true);
+   if (entry->session) {
+      SSL_SESSION_free (entry->session);
+   }
+
+   entry->session = session;
+   bson_mutex_unlock (&shared->mutex);
+
+   return 1;
+}
+
+
+/**
+ * _mongoc_openssl_shared_ctx_new:
+ *
+ * Create an SSL_CTX from @opt to be shared by many TLS streams, so each
+ * connection skips loading certificates and can resume a previous session.
+ * @client selects whether streams are client or server side.
+ *
+ * Returns NULL if the context could not be created.
+ */
+mongoc_openssl_shared_ctx_t *
+_mongoc_openssl_shared_ctx_new (mongoc_ssl_opt_t *opt, bool client)
+{
+   mongoc_openssl_shared_ctx_t *shared;
+   SSL_CTX *ctx;
+
+   ctx = _mongoc_openssl_ctx_new (opt);
+   if (!ctx) {
+      return NULL;
+   }
+
+   if (client) {
+      /* store sessions per host ourselves, OpenSSL's internal cache is only
+       * used by servers. */
+      SSL_CTX_set_session_cache_mode (
+         ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+      SSL_CTX_sess_set_new_cb (ctx, _mongoc_openssl_new_session);
+   } else {
+      /* Only used by the Mock Server.
+       * Set a callback to get the SNI, if provided */
+      SSL_CTX_set_tlsext_servername_callback (ctx, _mongoc_openssl_sni);
+      /* required to resume sessions when client certificates are verified */
+      SSL_CTX_set_session_id_context (
+         ctx, (const unsigned char *) "mongoc", sizeof "mongoc" - 1);
+   }
+
+   if (opt->weak_cert_validation) {
+      SSL_CTX_set_verify (ctx, SSL_VERIFY_NONE, NULL);
+   } else {
+      SSL_CTX_set_verify (ctx, SSL_VERIFY_PEER, NULL);
+   }
+
+   shared = bson_malloc0 (sizeof (mongoc_openssl_shared_ctx_t));
+   shared->ctx = ctx;
+   shared->client = client;
+   shared->refcount = 1;
+   bson_mutex_init (&shared->mutex);
+   SSL_CTX_set_app_data (ctx, shared);
+
+   return shared;
+}
+
+
+mongoc_openssl_shared_ctx_t *
+_mongoc_openssl_shared_ctx_ref (mongoc_openssl_shared_ctx_t *shared)
+{
+   if (shared) {
+      bson_atomic_int_add (&shared->refcount, 1);
+   }
+
+   return shared;
+}
+
+
+void
+_mongoc_openssl_shared_ctx_release (mongoc_openssl_shared_ctx_t *shared)
+{
+   mongoc_openssl_session_t *iter;
+   mongoc_openssl_session_t *tmp;
+
+   if (!shared || bson_atomic_int_add (&shared->refcount, -1) > 0) {
+      return;
+   }
+
+   LL_FOREACH_SAFE (shared->sessions, iter, tmp)
+   {
+      _session_entry_destroy (iter);
+   }
+
+   SSL_CTX_free (shared->ctx);
+   bson_mutex_destroy (&shared->mutex);
+   bson_free (shared);
+}
+
+
+/**
+ * _mongoc_openssl_shared_ctx_resume:
+ *
+ * Prepare a client-mode @ssl connecting to @host to resume the last session
+ * negotiated with @host, and to save the session it negotiates. @host must
+ * outlive @ssl.
+ *
+ * If @check_ocsp is true, the session is only resumed once @host's
+ * certificate passed OCSP validation, and while the OCSP cache holds no
+ * revoked or expired status for it. Otherwise the handshake is a full one,
+ * which checks OCSP again.
+ */
+void
+_mongoc_openssl_shared_ctx_resume (mongoc_openssl_shared_ctx_t *shared,
+                                   SSL *ssl,
+                                   const char *host,
+                                   bool check_ocsp)
+{
+   mongoc_openssl_session_t *entry;
+
+   SSL_set_app_data (ssl, (char *) host);
+
+   bson_mutex_lock (&shared->mutex);
+   entry = _get_session_entry (shared, host, false);
+   if (entry && _session_resumable (entry, check_ocsp)) {
+      SSL_set_session (ssl, entry->session);
+   }
+
+   bson_mutex_unlock (&shared->mutex);
+}
+
+
+#ifdef MONGOC_ENABLE_OCSP_OPENSSL
+/* Record that @host's certificate, with OCSP id @peer_id, passed OCSP
+ * validation in a full handshake. Takes ownership of @peer_id. */
+void
+_mongoc_openssl_shared_ctx_ocsp_validated (mongoc_openssl_shared_ctx_t *shared,
+                                           const char *host,
+                                           OCSP_CERTID *peer_id)
+{
+   mongoc_openssl_session_t *entry;
+   ASN1_GENERALIZEDTIME *this_update = NULL;
+   ASN1_GENERALIZEDTIME *next_update = NULL;
+   int cert_status;
+   int reason;
+   bool status_cached = false;
+
+   if (peer_id) {
+      status_cached = _mongoc_ocsp_cache_get_status (
+         peer_id, &cert_status, &reason, &this_update, &next_update);
+      ASN1_GENERALIZEDTIME_free (this_update);
+      ASN1_GENERALIZEDTIME_free (next_update);
+   }
+
+   bson_mutex_lock (&shared->mutex);
+   entry = _get_session_entry (shared, host, true);
+   if (entry->ocsp_id) {
+      OCSP_CERTID_free (entry->ocsp_id);
+   }
+
+   entry->ocsp_id = peer_id;
+   entry->ocsp_status_cached = status_cached;
+   entry->ocsp_validated = true;
+   bson_mutex_unlock (&shared->mutex);
+}
+
+
+/* Check a session resumed with @host against the OCSP cache. Servers staple
+ * no response when resuming, so the cache is the only source of a status. */
+bool
+_mongoc_openssl_shared_ctx_ocsp_check_resumed (
+   mongoc_openssl_shared_ctx_t *shared, const char *host)
+{
+   mongoc_openssl_session_t *entry;
+   bool ret;
+
+   bson_mutex_lock (&shared->mutex);
+   entry = _get_session_entry (shared, host, false);
+   ret = entry && _ocsp_allows_resume (entry);
+   bson_mutex_unlock (&shared->mutex);
+
+   if (!ret) {
+      MONGOC_ERROR ("OCSP status of the resumed session's certificate is "
+                    "revoked or expired");
+   }
+
+   return ret;
+}
+
+
+/* Forget @host's session and OCSP validation, after its certificate failed
+ * OCSP validation. */
+void
+_mongoc_openssl_shared_ctx_forget (mongoc_openssl_shared_ctx_t *shared,
+                                   const char *host)
+{
+   mongoc_openssl_session_t *entry;
+
+   bson_mutex_lock (&shared->mutex);
+   entry = _get_session_entry (shared, host, false);
+   if (entry) {
+      LL_DELETE (shared->sessions, entry);
+      _session_entry_destroy (entry);
+   }
+
+   bson_mutex_unlock (&shared->mutex);
+}
+#endif
+
+
 char *
 _mongoc_openssl_extract_subject (const char *filename, const char *passphrase)
 {
@@ -0,0 +1,1701 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <bson/bson.h>
+
+#include "mongoc-reactor.h"
+#include "mongoc-async-private.h"
+#include "mongoc-async-cmd-private.h"
+#include "mongoc-bulk-operation-private.h"
+#include "mongoc-client-private.h"
+#include "mongoc-client-session-private.h"
+#include "mongoc-client-side-encryption-private.h"
+#include "mongoc-cluster-private.h"
+#include "mongoc-cmd-private.h"
+#include "mongoc-collection-private.h"
+#include "mongoc-error.h"
+#include "mongoc-opts-private.h"
+#include "mongoc-read-prefs-private.h"
+#include "mongoc-socket-private.h"
+#include "mongoc-topology-private.h"
+#include "mongoc-trace-private.h"
+#include "mongoc-util-private.h"
+#include "mongoc-write-command-private.h"
+#include "mongoc-write-concern-private.h"
+#include "utlist.h"
+
+#undef MONGOC_LOG_DOMAIN
+#define MONGOC_LOG_DOMAIN "reactor"
+
+/* socketTimeoutMS=0 means no timeout, mongoc_async_step needs a finite one */
+#define MONGOC_REACTOR_NO_TIMEOUT_MSEC (INT32_MAX - 1)
+
+
+typedef enum {
+   MONGOC_REACTOR_OP_COMMAND,
+   MONGOC_REACTOR_OP_BULK,
+   MONGOC_REACTOR_OP_INSERT,
+   MONGOC_REACTOR_OP_UPDATE,
+   MONGOC_REACTOR_OP_DELETE,
+} mongoc_reactor_op_type_t;
+
+
+typedef struct _mongoc_reactor_op_t {
+   mongoc_reactor_t *reactor;
+   mongoc_reactor_op_type_t type;
+   mongoc_reactor_cb_t cb;
+   void *ctx;
+
+   /* the connection is detached from the client while the op is running */
+   mongoc_server_stream_t *server_stream;
+   mongoc_cluster_node_t *node;
+   mongoc_async_cmd_t *acmd;
+
+   /* the command being sent */
+   bson_t body;
+   mongoc_cmd_parts_t parts;
+   bool has_parts;
+   mongoc_read_write_opts_t read_write_opts;
+   bool has_read_write_opts;
+   uint32_t request_id;
+   int64_t started_usec;
+
+   /* writes: the batches of each write command are sent in turn */
+   char *database;
+   char *collection;
+   mongoc_write_command_t command;
+   mongoc_write_command_t *commands;
+   size_t n_commands;
+   size_t command_index;
+   size_t payload_offset;
+   size_t batch_size;
+   uint32_t batch_n_documents;
+   uint32_t offset;
+   uint32_t index_offset;
+   mongoc_write_concern_t *write_concern;
+   mongoc_client_session_t *session;
+   mongoc_write_result_t write_result;
+   mongoc_write_result_t *result;
+   mongoc_bulk_operation_t *bulk;
+
+   struct _mongoc_reactor_op_t *next;
+   struct _mongoc_reactor_op_t *prev;
+} mongoc_reactor_op_t;
+
+
+struct _mongoc_reactor_t {
+   mongoc_client_t *client;
+   mongoc_async_t *async;
+   mongoc_reactor_op_t *ops;
+   size_t n_ops;
+};
+
+
+static mongoc_reactor_op_t *
+_mongoc_reactor_op_new (mongoc_reactor_t *reactor,
+                        mongoc_reactor_op_type_t type,
+                        mongoc_reactor_cb_t cb,
+                        void *ctx)
+{
+   mongoc_reactor_op_t *op;
+
+   op = (mongoc_reactor_op_t *) bson_malloc0 (sizeof *op);
+   op->reactor = reactor;
+   op->type = type;
+   op->cb = cb;
+   op->ctx = ctx;
+   bson_init (&op->body);
+
+   /* a bulk operation's result is in the bulk */
+   if (type != MONGOC_REACTOR_OP_COMMAND && type != MONGOC_REACTOR_OP_BULK) {
+      _mongoc_write_result_init (&op->write_result);
+      op->result = &op->write_result;
+   }
+
+   DL_APPEND (reactor->ops, op);
+   reactor->n_ops++;
+
+   return op;
+}
+
+
+/* if the op still has its connection, the reply is unread: close it */
+static void
+_mongoc_reactor_op_destroy (mongoc_reactor_op_t *op)
+{
+   DL_DELETE (op->reactor->ops, op);
+   op->reactor->n_ops--;
+
+   if (op->acmd) {
+      mongoc_async_cmd_destroy (op->acmd);
+   }
+
+   mongoc_server_stream_cleanup (op->server_stream);
+   if (op->node) {
+      _mongoc_cluster_node_destroy (op->node);
+   }
+
+   if (op->has_parts) {
+      mongoc_cmd_parts_cleanup (&op->parts);
+   }
+
+   if (op->has_read_write_opts) {
+      _mongoc_read_write_opts_cleanup (&op->read_write_opts);
+   }
+
+   if (op->commands == &op->command) {
+      _mongoc_write_command_destroy (&op->command);
+   }
+
+   if (op->result == &op->write_result) {
+      _mongoc_write_result_destroy (&op->write_result);
+   }
+
+   bson_destroy (&op->body);
+   bson_free (op->database);
+   bson_free (op->collection);
+   mongoc_write_concern_destroy (op->write_concern);
+   bson_free (op);
+}
+
+
+static bool
+_mongoc_reactor_check_client (mongoc_reactor_t *reactor, bson_error_t *error)
+{
+   if (_mongoc_cse_is_enabled (reactor->client)) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "A reactor cannot be used with automatic encryption");
+      return false;
+   }
+
+   return true;
+}
+
+
+static bool
+_mongoc_reactor_check_collection (mongoc_reactor_t *reactor,
+                                  const mongoc_collection_t *collection,
+                                  bson_error_t *error)
+{
+   if (collection->client != reactor->client) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "The collection must belong to the reactor's client");
+      return false;
+   }
+
+   return _mongoc_reactor_check_client (reactor, error);
+}
+
+
+/* take the op's connection from the client, so that the client can run
+ * other operations while the reply is awaited */
+static bool
+_mongoc_reactor_detach (mongoc_reactor_op_t *op, bson_error_t *error)
+{
+   int32_t max_wire_version = op->server_stream->sd->max_wire_version;
+
+   if (max_wire_version < WIRE_VERSION_OP_MSG) {
+      bson_set_error (error,
+                      MONGOC_ERROR_PROTOCOL,
+                      MONGOC_ERROR_PROTOCOL_BAD_WIRE_VERSION,
+                      "A reactor requires MongoDB 3.6 or later, the server "
+                      "has wire version %d",
+                      max_wire_version);
+      return false;
+   }
+
+   op->node = mongoc_cluster_detach_node (
+      &op->reactor->client->cluster, op->server_stream, error);
+
+   return op->node != NULL;
+}
+
+
+static void
+_mongoc_reactor_op_cb (mongoc_async_cmd_t *acmd,
+                       mongoc_async_cmd_result_t result,
+                       const bson_t *bson,
+                       int64_t duration_usec);
+
+
+static void
+_mongoc_reactor_send (mongoc_reactor_op_t *op)
+{
+   mongoc_cluster_t *cluster = &op->reactor->client->cluster;
+   int64_t timeout_msec;
+
+   timeout_msec = cluster->sockettimeoutms
+                     ? (int64_t) cluster->sockettimeoutms
+                     : MONGOC_REACTOR_NO_TIMEOUT_MSEC;
+   timeout_msec = BSON_MIN (timeout_msec, MONGOC_REACTOR_NO_TIMEOUT_MSEC);
+
+   op->started_usec = bson_get_monotonic_time ();
+   op->request_id =
+      mongoc_cluster_detached_started (cluster, &op->parts.assembled);
+   op->acmd = mongoc_async_cmd_new_from_cmd (op->reactor->async,
+                                             op->node->stream,
+                                             &op->parts.assembled,
+                                             _mongoc_reactor_op_cb,
+                                             op,
+                                             timeout_msec);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_reactor_command --
+ *
+ *       Start a command like _mongoc_client_command_with_opts does, on a
+ *       server selected with @prefs or on @server_id if it's non-zero. A
+ *       cursor command must not use an implicit session, which would end
+ *       before its getMore.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_mongoc_reactor_command (mongoc_reactor_t *reactor,
+                         const char *db_name,
+                         const bson_t *command,
+                         mongoc_command_mode_t mode,
+                         const bson_t *opts,
+                         const mongoc_read_prefs_t *user_prefs,
+                         const mongoc_read_prefs_t *default_prefs,
+                         const mongoc_read_concern_t *default_rc,
+                         uint32_t server_id,
+                         bool is_cursor_command,
+                         mongoc_reactor_cb_t cb,
+                         void *ctx,
+                         bson_error_t *error)
+{
+   mongoc_client_t *client = reactor->client;
+   mongoc_cluster_t *cluster = &client->cluster;
+   const mongoc_read_prefs_t *prefs = COALESCE (user_prefs, default_prefs);
+   mongoc_read_write_opts_t *read_write_opts;
+   mongoc_reactor_op_t *op;
+   mongoc_client_session_t *cs;
+   const char *command_name;
+   int32_t wire_version;
+
+   ENTRY;
+
+   if (!_mongoc_reactor_check_client (reactor, error)) {
+      RETURN (false);
+   }
+
+   command_name = _mongoc_get_command_name (command);
+   if (!command_name) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "Empty command document");
+      RETURN (false);
+   }
+
+   op = _mongoc_reactor_op_new (reactor, MONGOC_REACTOR_OP_COMMAND, cb, ctx);
+   bson_concat (&op->body, command);
+   mongoc_cmd_parts_init (
+      &op->parts, client, db_name, MONGOC_QUERY_NONE, &op->body);
+   op->has_parts = true;
+   op->parts.is_read_command = (mode & MONGOC_CMD_READ);
+
+   read_write_opts = &op->read_write_opts;
+   op->has_read_write_opts = true;
+   if (!_mongoc_read_write_opts_parse (client, opts, read_write_opts, error)) {
+      GOTO (fail);
+   }
+
+   cs = read_write_opts->client_session;
+
+   if (_mongoc_client_session_in_txn (cs)) {
+      if (!IS_PREF_PRIMARY (user_prefs)) {
+         bson_set_error (error,
+                         MONGOC_ERROR_COMMAND,
+                         MONGOC_ERROR_COMMAND_INVALID_ARG,
+                         "Read preference in a transaction must be primary");
+         GOTO (fail);
+      }
+
+      if (!bson_empty (&read_write_opts->readConcern)) {
+         bson_set_error (error,
+                         MONGOC_ERROR_COMMAND,
+                         MONGOC_ERROR_COMMAND_INVALID_ARG,
+                         "Cannot set read concern after starting transaction");
+         GOTO (fail);
+      }
+
+      if (read_write_opts->writeConcern &&
+          strcmp (command_name, "commitTransaction") != 0 &&
+          strcmp (command_name, "abortTransaction") != 0) {
+         bson_set_error (error,
+                         MONGOC_ERROR_COMMAND,
+                         MONGOC_ERROR_COMMAND_INVALID_ARG,
+                         "Cannot set write concern after starting transaction");
+         GOTO (fail);
+      }
+   }
+
+   /* NULL read pref is ok */
+   if (!_mongoc_read_prefs_validate (prefs, error)) {
+      GOTO (fail);
+   }
+
+   op->parts.read_prefs = prefs;
+
+   if (!server_id) {
+      server_id = read_write_opts->serverId;
+   }
+
+   if (server_id) {
+      op->server_stream = mongoc_cluster_stream_for_server (
+         cluster, server_id, true /* reconnect ok */, cs, NULL, error);
+
+      if (op->server_stream &&
+          op->server_stream->sd->type != MONGOC_SERVER_MONGOS) {
+         op->parts.user_query_flags |= MONGOC_QUERY_SLAVE_OK;
+      }
+   } else {
+      op->server_stream =
+         mongoc_cluster_stream_for_reads (cluster, prefs, cs, NULL, error);
+   }
+
+   if (!op->server_stream) {
+      GOTO (fail);
+   }
+
+   wire_version = op->server_stream->sd->max_wire_version;
+   if (!mongoc_cmd_parts_append_read_write (
+          &op->parts, read_write_opts, wire_version, error)) {
+      GOTO (fail);
+   }
+
+   /* use default read concern for read command, unless it's in opts */
+   if ((mode & MONGOC_CMD_READ) && bson_empty (&read_write_opts->readConcern)) {
+      if (!mongoc_cmd_parts_set_read_concern (
+             &op->parts, default_rc, wire_version, error)) {
+         GOTO (fail);
+      }
+   }
+
+   if (is_cursor_command && !cs) {
+      op->parts.prohibit_lsid = true;
+   }
+
+   op->parts.assembled.operation_id = ++cluster->operation_id;
+   if (!mongoc_cmd_parts_assemble (&op->parts, op->server_stream, error)) {
+      GOTO (fail);
+   }
+
+   if (!_mongoc_reactor_detach (op, error)) {
+      GOTO (fail);
+   }
+
+   _mongoc_reactor_send (op);
+
+   RETURN (true);
+
+fail:
+   _mongoc_reactor_op_destroy (op);
+
+   RETURN (false);
+}
+
+
+static void
+_mongoc_reactor_command_reply (mongoc_reactor_op_t *op,
+                               const bson_t *reply,
+                               bson_error_t *error,
+                               bool timed_out)
+{
+   mongoc_cluster_t *cluster = &op->reactor->client->cluster;
+   uint32_t server_id = op->server_stream->sd->id;
+   bson_t reply_out;
+   bool ok;
+
+   ok = mongoc_cluster_detached_reply (cluster,
+                                       &op->parts.assembled,
+                                       op->request_id,
+                                       op->started_usec,
+                                       reply,
+                                       &reply_out,
+                                       error);
+
+   /* before the callback, which may start another op on this server */
+   mongoc_cluster_release_detached (cluster,
+                                    op->server_stream,
+                                    op->node,
+                                    reply ? NULL : error,
+                                    timed_out);
+   op->server_stream = NULL;
+   op->node = NULL;
+
+   op->cb (ok, &reply_out, error, server_id, op->ctx);
+
+   bson_destroy (&reply_out);
+   _mongoc_reactor_op_destroy (op);
+}
+
+
+/* prepare the first batch of a write command, see _mongoc_write_opmsg */
+static bool
+_mongoc_reactor_write_assemble (mongoc_reactor_op_t *op,
+                                const mongoc_write_command_t *command)
+{
+   mongoc_server_stream_t *server_stream = op->server_stream;
+   int32_t wire_version = server_stream->sd->max_wire_version;
+   mongoc_write_result_t *result = op->result;
+   mongoc_crud_opts_t crud = {0};
+   bson_iter_t iter;
+
+   crud.writeConcern = op->write_concern;
+   crud.client_session = op->session;
+   if (!_mongoc_write_command_check (command, wire_version, &crud, result)) {
+      return false;
+   }
+
+   bson_reinit (&op->body);
+   _mongoc_write_command_init (
+      &op->body, (mongoc_write_command_t *) command, op->collection);
+   mongoc_cmd_parts_init (&op->parts,
+                          op->reactor->client,
+                          op->database,
+                          MONGOC_QUERY_NONE,
+                          &op->body);
+   op->has_parts = true;
+   op->parts.assembled.operation_id = command->operation_id;
+   op->parts.is_write_command = true;
+   /* writes aren't retried, don't send a transaction number */
+   op->parts.allow_txn_number = MONGOC_CMD_PARTS_ALLOW_TXN_NUMBER_NO;
+   mongoc_cmd_parts_set_session (&op->parts, op->session);
+
+   BSON_ASSERT (bson_iter_init (&iter, &command->cmd_opts));
+
+   return mongoc_cmd_parts_set_write_concern (
+             &op->parts, op->write_concern, wire_version, &result->error) &&
+          mongoc_cmd_parts_append_opts (
+             &op->parts, &iter, wire_version, &result->error) &&
+          mongoc_cmd_parts_assemble (
+             &op->parts, server_stream, &result->error);
+}
+
+
+/* send as many of the command's remaining documents as fit in a message */
+static bool
+_mongoc_reactor_write_batch (mongoc_reactor_op_t *op,
+                             const mongoc_write_command_t *command)
+{
+   mongoc_server_stream_t *server_stream = op->server_stream;
+   const char *field = _mongoc_command_type_to_field_name (command->type);
+   const uint8_t *data = command->payload.data + op->payload_offset;
+   size_t remaining = command->payload.len - op->payload_offset;
+   int32_t max_bson_obj_size;
+   int32_t max_msg_size;
+   int32_t max_document_count;
+   size_t header;
+   size_t batch_size = 0;
+   uint32_t n_documents = 0;
+   int32_t len;
+
+   max_bson_obj_size = mongoc_server_stream_max_bson_obj_size (server_stream);
+   max_msg_size = mongoc_server_stream_max_msg_size (server_stream);
+   max_document_count =
+      mongoc_server_stream_max_write_batch_size (server_stream);
+
+   /* see _mongoc_write_opmsg */
+   header = 26 + op->parts.assembled.command->len + strlen (field) + 1;
+
+   while (batch_size < remaining) {
+      memcpy (&len, data + batch_size, 4);
+      len = BSON_UINT32_FROM_LE (len);
+
+      if (len > max_bson_obj_size + BSON_OBJECT_ALLOWANCE) {
+         if (n_documents) {
+            /* send the documents before it first */
+            break;
+         }
+
+         _mongoc_write_command_too_large_error (
+            &op->result->error, op->index_offset, len, max_bson_obj_size);
+         op->result->failed = true;
+         return false;
+      }
+
+      if (n_documents && header + batch_size + len > (size_t) max_msg_size) {
+         break;
+      }
+
+      batch_size += len;
+      if (++n_documents == (uint32_t) max_document_count) {
+         break;
+      }
+   }
+
+   op->batch_size = batch_size;
+   op->batch_n_documents = n_documents;
+   op->parts.assembled.payload = data;
+   op->parts.assembled.payload_size = (int32_t) batch_size;
+   op->parts.assembled.payload_identifier = field;
+
+   _mongoc_reactor_send (op);
+
+   return true;
+}
+
+
+/* returns false if the remaining commands must not be sent */
+static bool
+_mongoc_reactor_write_command_done (mongoc_reactor_op_t *op,
+                                    const mongoc_write_command_t *command)
+{
+   mongoc_write_result_t *result = op->result;
+
+   if (op->has_parts) {
+      mongoc_cmd_parts_cleanup (&op->parts);
+      op->has_parts = false;
+   }
+
+   if (result->failed && (command->flags.ordered || result->must_stop)) {
+      return false;
+   }
+
+   op->offset += command->n_documents;
+   op->index_offset = op->offset;
+   op->payload_offset = 0;
+   op->command_index++;
+
+   return true;
+}
+
+
+/* send the next batch, returns false if there is nothing left to send */
+static bool
+_mongoc_reactor_write_next (mongoc_reactor_op_t *op)
+{
+   mongoc_write_result_t *result = op->result;
+   const mongoc_write_command_t *command;
+
+   while (op->command_index < op->n_commands) {
+      command = &op->commands[op->command_index];
+
+      if (!op->has_parts && !_mongoc_reactor_write_assemble (op, command)) {
+         result->failed = true;
+      } else if (op->payload_offset < command->payload.len &&
+                 !result->must_stop) {
+         if (_mongoc_reactor_write_batch (op, command)) {
+            return true;
+         }
+      }
+
+      if (!_mongoc_reactor_write_command_done (op, command)) {
+         return false;
+      }
+   }
+
+   return false;
+}
+
+
+/* the reply and error of the whole write, like the synchronous API's */
+static bool
+_mongoc_reactor_write_complete (mongoc_reactor_op_t *op,
+                                bson_t *reply,
+                                bson_error_t *error)
+{
+   mongoc_write_result_t *result = op->result;
+   int32_t error_api_version = op->reactor->client->error_api_version;
+
+   bson_init (reply);
+   memset (error, 0, sizeof (bson_error_t));
+
+   switch (op->type) {
+   case MONGOC_REACTOR_OP_BULK:
+      return MONGOC_WRITE_RESULT_COMPLETE (result,
+                                           error_api_version,
+                                           op->write_concern,
+                                           MONGOC_ERROR_COMMAND /* err domain */,
+                                           reply,
+                                           error);
+   case MONGOC_REACTOR_OP_INSERT:
+      return MONGOC_WRITE_RESULT_COMPLETE (result,
+                                           error_api_version,
+                                           op->write_concern,
+                                           /* no error domain override */
+                                           (mongoc_error_domain_t) 0,
+                                           reply,
+                                           error,
+                                           "insertedCount");
+   case MONGOC_REACTOR_OP_UPDATE:
+      return MONGOC_WRITE_RESULT_COMPLETE (result,
+                                           error_api_version,
+                                           op->write_concern,
+                                           /* no error domain override */
+                                           (mongoc_error_domain_t) 0,
+                                           reply,
+                                           error,
+                                           "modifiedCount",
+                                           "matchedCount",
+                                           "upsertedCount",
+                                           "upsertedId");
+   case MONGOC_REACTOR_OP_DELETE:
+      return MONGOC_WRITE_RESULT_COMPLETE (result,
+                                           error_api_version,
+                                           op->write_concern,
+                                           /* no error domain override */
+                                           (mongoc_error_domain_t) 0,
+                                           reply,
+                                           error,
+                                           "deletedCount");
+   case MONGOC_REACTOR_OP_COMMAND:
+   default:
+      BSON_ASSERT (false);
+      return false;
+   }
+}
+
+
+static void
+_mongoc_reactor_write_finish (mongoc_reactor_op_t *op,
+                              const bson_error_t *why,
+                              bool timed_out)
+{
+   uint32_t server_id = op->server_stream->sd->id;
+   bson_t reply;
+   bson_error_t error;
+   bool ok;
+
+   mongoc_cluster_release_detached (&op->reactor->client->cluster,
+                                    op->server_stream,
+                                    op->node,
+                                    why,
+                                    timed_out);
+   op->server_stream = NULL;
+   op->node = NULL;
+
+   ok = _mongoc_reactor_write_complete (op, &reply, &error);
+
+   if (op->bulk) {
+      op->bulk->server_id = server_id;
+   }
+
+   op->cb (ok, &reply, &error, server_id, op->ctx);
+
+   bson_destroy (&reply);
+   _mongoc_reactor_op_destroy (op);
+}
+
+
+static void
+_mongoc_reactor_write_reply (mongoc_reactor_op_t *op,
+                             const bson_t *reply,
+                             const bson_error_t *error,
+                             bool timed_out)
+{
+   mongoc_write_result_t *result = op->result;
+   mongoc_write_command_t *command = &op->commands[op->command_index];
+   bson_error_t why;
+   bson_t reply_out;
+
+   if (!reply) {
+      /* keep the network error, the result's may be replaced */
+      memcpy (&why, error, sizeof (bson_error_t));
+      memcpy (&result->error, error, sizeof (bson_error_t));
+   }
+
+   if (!mongoc_cluster_detached_reply (&op->reactor->client->cluster,
+                                       &op->parts.assembled,
+                                       op->request_id,
+                                       op->started_usec,
+                                       reply,
+                                       &reply_out,
+                                       &result->error)) {
+      result->failed = true;
+      if (command->flags.ordered || !reply) {
+         result->must_stop = true;
+      }
+   }
+
+   /* Result merge needs to know the absolute index for a document, see
+    * _mongoc_write_opmsg */
+   _mongoc_write_result_merge (result, command, &reply_out, op->index_offset);
+   bson_destroy (&reply_out);
+
+   op->index_offset += op->batch_n_documents;
+   op->payload_offset += op->batch_size;
+
+   if (!reply) {
+      _mongoc_reactor_write_finish (op, &why, timed_out);
+   } else if (!_mongoc_reactor_write_next (op)) {
+      _mongoc_reactor_write_finish (op, NULL, false);
+   }
+}
+
+
+static void
+_mongoc_reactor_op_cb (mongoc_async_cmd_t *acmd,
+                       mongoc_async_cmd_result_t result,
+                       const bson_t *bson,
+                       int64_t duration_usec)
+{
+   mongoc_reactor_op_t *op = (mongoc_reactor_op_t *) acmd->data;
+   bson_error_t error = {0};
+   bool timed_out = (result == MONGOC_ASYNC_CMD_TIMEOUT);
+
+   if (result == MONGOC_ASYNC_CMD_CONNECTED ||
+       result == MONGOC_ASYNC_CMD_IN_PROGRESS) {
+      return;
+   }
+
+   /* mongoc_async_cmd_run destroys the acmd after the callback */
+   op->acmd = NULL;
+
+   if (result != MONGOC_ASYNC_CMD_SUCCESS) {
+      memcpy (&error, &acmd->error, sizeof (bson_error_t));
+      bson = NULL;
+   }
+
+   if (op->type == MONGOC_REACTOR_OP_COMMAND) {
+      _mongoc_reactor_command_reply (op, bson, &error, timed_out);
+   } else {
+      _mongoc_reactor_write_reply (op, bson, &error, timed_out);
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_reactor_write_start --
+ *
+ *       Select a server for @op's write commands and send the first batch.
+ *       If nothing can be sent, the callback isn't called, the result's
+ *       error is returned instead.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_mongoc_reactor_write_start (mongoc_reactor_op_t *op,
+                             uint32_t server_id,
+                             bson_error_t *error)
+{
+   mongoc_cluster_t *cluster = &op->reactor->client->cluster;
+   bson_t reply;
+
+   ENTRY;
+
+   if (op->write_concern && !mongoc_write_concern_is_valid (op->write_concern)) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "The write concern is invalid.");
+      GOTO (fail);
+   }
+
+   if (!mongoc_write_concern_is_acknowledged (op->write_concern)) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "A reactor cannot run unacknowledged writes");
+      GOTO (fail);
+   }
+
+   if (server_id) {
+      op->server_stream = mongoc_cluster_stream_for_server (
+         cluster, server_id, true /* reconnect ok */, op->session, NULL, error);
+   } else {
+      op->server_stream =
+         mongoc_cluster_stream_for_writes (cluster, op->session, NULL, error);
+   }
+
+   if (!op->server_stream || !_mongoc_reactor_detach (op, error)) {
+      GOTO (fail);
+   }
+
+   if (_mongoc_reactor_write_next (op)) {
+      RETURN (true);
+   }
+
+   /* no command could be sent */
+   mongoc_cluster_release_detached (
+      cluster, op->server_stream, op->node, NULL, false);
+   op->server_stream = NULL;
+   op->node = NULL;
+
+   (void) _mongoc_reactor_write_complete (op, &reply, error);
+   bson_destroy (&reply);
+
+fail:
+   _mongoc_reactor_op_destroy (op);
+
+   RETURN (false);
+}
+
+
+/* start a single write command, which is moved into the op */
+static bool
+_mongoc_reactor_write (mongoc_reactor_t *reactor,
+                       mongoc_collection_t *collection,
+                       mongoc_reactor_op_type_t type,
+                       mongoc_write_command_t *command,
+                       const mongoc_crud_opts_t *crud,
+                       mongoc_reactor_cb_t cb,
+                       void *ctx,
+                       bson_error_t *error)
+{
+   mongoc_client_session_t *cs = crud->client_session;
+   mongoc_reactor_op_t *op;
+
+   if (_mongoc_client_session_in_txn (cs) && crud->writeConcern) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "Cannot set write concern after starting transaction");
+      _mongoc_write_command_destroy (command);
+      return false;
+   }
+
+   op = _mongoc_reactor_op_new (reactor, type, cb, ctx);
+   op->command = *command;
+   op->commands = &op->command;
+   op->n_commands = 1;
+   op->database = bson_strdup (collection->db);
+   op->collection = bson_strdup (collection->collection);
+   op->session = cs;
+
+   if (crud->writeConcern) {
+      op->write_concern = mongoc_write_concern_copy (crud->writeConcern);
+   } else if (!_mongoc_client_session_in_txn (cs)) {
+      op->write_concern = mongoc_write_concern_copy (collection->write_concern);
+   }
+
+   return _mongoc_reactor_write_start (op, 0, error);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_reactor_new --
+ *
+ *       Create a reactor that runs operations on @client's connections
+ *       without blocking. @client must come from a mongoc_client_pool_t.
+ *
+ * Returns:
+ *       A new reactor, or NULL if @client is single-threaded.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+mongoc_reactor_t *
+mongoc_reactor_new (mongoc_client_t *client)
+{
+   mongoc_reactor_t *reactor;
+
+   BSON_ASSERT_PARAM (client);
+
+   if (client->topology->single_threaded) {
+      MONGOC_ERROR ("A reactor requires a client from a client pool");
+      return NULL;
+   }
+
+   reactor = (mongoc_reactor_t *) bson_malloc0 (sizeof *reactor);
+   reactor->client = client;
+   reactor->async = mongoc_async_new ();
+
+   return reactor;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_reactor_destroy --
+ *
+ *       Cancel the operations in progress without calling their callbacks
+ *       and free @reactor. Their connections are closed.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+mongoc_reactor_destroy (mongoc_reactor_t *reactor)
+{
+   mongoc_reactor_op_t *op, *tmp;
+
+   if (!reactor) {
+      return;
+   }
+
+   DL_FOREACH_SAFE (reactor->ops, op, tmp)
+   {
+      _mongoc_reactor_op_destroy (op);
+   }
+
+   mongoc_async_destroy (reactor->async);
+   bson_free (reactor);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_reactor_get_fds --
+ *
+ *       Fill @fds with up to @n_fds sockets to wait on and the events to
+ *       wait for, and @timeout_msec with the longest time to wait before
+ *       calling mongoc_reactor_dispatch.
+ *
+ * Returns:
+ *       The number of sockets to wait on, which may exceed @n_fds.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+size_t
+mongoc_reactor_get_fds (mongoc_reactor_t *reactor,
+                        mongoc_reactor_fd_t *fds,
+                        size_t n_fds,
+                        int64_t *timeout_msec)
+{
+   mongoc_async_t *async;
+   mongoc_socket_t *sock;
+   size_t npolled;
+   size_t i;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (timeout_msec);
+
+   async = reactor->async;
+   npolled = mongoc_async_prepare (async, timeout_msec);
+
+   for (i = 0; i < npolled && i < n_fds; i++) {
+      sock = mongoc_async_get_socket (async, i);
+      fds[i].fd = sock ? sock->sd : -1;
+      fds[i].events = async->poller[i].events;
+      fds[i].revents = 0;
+   }
+
+   return npolled;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_reactor_dispatch --
+ *
+ *       Advance the operations whose sockets, returned by the last call to
+ *       mongoc_reactor_get_fds, have events in @fds[i].revents. Operations
+ *       that have timed out fail. Completed operations' callbacks are
+ *       called.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+mongoc_reactor_dispatch (mongoc_reactor_t *reactor,
+                         const mongoc_reactor_fd_t *fds,
+                         size_t n_fds)
+{
+   mongoc_async_t *async;
+   ssize_t nactive = 0;
+   size_t i;
+
+   BSON_ASSERT_PARAM (reactor);
+
+   async = reactor->async;
+
+   for (i = 0; i < async->npolled && i < n_fds; i++) {
+      async->poller[i].revents = fds[i].revents;
+      if (fds[i].revents) {
+         nactive++;
+      }
+   }
+
+   mongoc_async_dispatch (async, nactive);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_reactor_perform --
+ *
+ *       Wait at most @max_wait_msec for the reactor's sockets, then
+ *       advance its operations like mongoc_reactor_dispatch.
+ *
+ * Returns:
+ *       The number of operations still in progress.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+size_t
+mongoc_reactor_perform (mongoc_reactor_t *reactor, int64_t max_wait_msec)
+{
+   BSON_ASSERT_PARAM (reactor);
+
+   if (reactor->n_ops) {
+      (void) mongoc_async_step (reactor->async, max_wait_msec);
+   }
+
+   return reactor->n_ops;
+}
+
+
+bool
+mongoc_reactor_command (mongoc_reactor_t *reactor,
+                        const char *db_name,
+                        const bson_t *command,
+                        const mongoc_read_prefs_t *read_prefs,
+                        const bson_t *opts,
+                        mongoc_reactor_cb_t cb,
+                        void *ctx,
+                        bson_error_t *error)
+{
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (db_name);
+   BSON_ASSERT_PARAM (command);
+   BSON_ASSERT_PARAM (cb);
+
+   return _mongoc_reactor_command (reactor,
+                                   db_name,
+                                   command,
+                                   MONGOC_CMD_RAW,
+                                   opts,
+                                   read_prefs,
+                                   NULL /* default prefs */,
+                                   NULL /* default read concern */,
+                                   0 /* server id */,
+                                   false /* is cursor command */,
+                                   cb,
+                                   ctx,
+                                   error);
+}
+
+
+bool
+mongoc_reactor_find (mongoc_reactor_t *reactor,
+                     mongoc_collection_t *collection,
+                     const bson_t *filter,
+                     const bson_t *opts,
+                     const mongoc_read_prefs_t *read_prefs,
+                     mongoc_reactor_cb_t cb,
+                     void *ctx,
+                     bson_error_t *error)
+{
+   bson_t command = BSON_INITIALIZER;
+   bool ret;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (filter);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!_mongoc_reactor_check_collection (reactor, collection, error)) {
+      return false;
+   }
+
+   BSON_APPEND_UTF8 (&command, "find", collection->collection);
+   BSON_APPEND_DOCUMENT (&command, "filter", filter);
+
+   ret = _mongoc_reactor_command (reactor,
+                                  collection->db,
+                                  &command,
+                                  MONGOC_CMD_READ,
+                                  opts,
+                                  read_prefs,
+                                  collection->read_prefs,
+                                  collection->read_concern,
+                                  0 /* server id */,
+                                  true /* is cursor command */,
+                                  cb,
+                                  ctx,
+                                  error);
+
+   bson_destroy (&command);
+
+   return ret;
+}
+
+
+bool
+mongoc_reactor_get_more (mongoc_reactor_t *reactor,
+                         mongoc_collection_t *collection,
+                         int64_t cursor_id,
+                         uint32_t server_id,
+                         const bson_t *opts,
+                         mongoc_reactor_cb_t cb,
+                         void *ctx,
+                         bson_error_t *error)
+{
+   bson_t command = BSON_INITIALIZER;
+   bool ret;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!_mongoc_reactor_check_collection (reactor, collection, error)) {
+      return false;
+   }
+
+   if (!cursor_id || !server_id) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "A getMore requires a cursor id and a server id");
+      return false;
+   }
+
+   BSON_APPEND_INT64 (&command, "getMore", cursor_id);
+   BSON_APPEND_UTF8 (&command, "collection", collection->collection);
+
+   ret = _mongoc_reactor_command (reactor,
+                                  collection->db,
+                                  &command,
+                                  MONGOC_CMD_RAW,
+                                  opts,
+                                  NULL /* read prefs */,
+                                  NULL /* default prefs */,
+                                  NULL /* default read concern */,
+                                  server_id,
+                                  true /* is cursor command */,
+                                  cb,
+                                  ctx,
+                                  error);
+
+   bson_destroy (&command);
+
+   return ret;
+}
+
+
+bool
+mongoc_reactor_insert_one (mongoc_reactor_t *reactor,
+                           mongoc_collection_t *collection,
+                           const bson_t *document,
+                           const bson_t *opts,
+                           mongoc_reactor_cb_t cb,
+                           void *ctx,
+                           bson_error_t *error)
+{
+   mongoc_insert_one_opts_t insert_one_opts;
+   mongoc_write_command_t command;
+   bool ret = false;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (document);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!_mongoc_reactor_check_collection (reactor, collection, error)) {
+      return false;
+   }
+
+   if (!_mongoc_insert_one_opts_parse (
+          collection->client, opts, &insert_one_opts, error)) {
+      GOTO (done);
+   }
+
+   if (!_mongoc_validate_new_document (
+          document, insert_one_opts.crud.validate, error)) {
+      GOTO (done);
+   }
+
+   _mongoc_write_command_init_insert_idl (
+      &command,
+      document,
+      &insert_one_opts.extra,
+      ++collection->client->cluster.operation_id);
+
+   command.flags.bypass_document_validation = insert_one_opts.bypass;
+   ret = _mongoc_reactor_write (reactor,
+                                collection,
+                                MONGOC_REACTOR_OP_INSERT,
+                                &command,
+                                &insert_one_opts.crud,
+                                cb,
+                                ctx,
+                                error);
+
+done:
+   _mongoc_insert_one_opts_cleanup (&insert_one_opts);
+
+   return ret;
+}
+
+
+bool
+mongoc_reactor_insert_many (mongoc_reactor_t *reactor,
+                            mongoc_collection_t *collection,
+                            const bson_t **documents,
+                            size_t n_documents,
+                            const bson_t *opts,
+                            mongoc_reactor_cb_t cb,
+                            void *ctx,
+                            bson_error_t *error)
+{
+   mongoc_insert_many_opts_t insert_many_opts;
+   mongoc_write_command_t command;
+   size_t i;
+   bool ret = false;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (documents);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!_mongoc_reactor_check_collection (reactor, collection, error)) {
+      return false;
+   }
+
+   if (!_mongoc_insert_many_opts_parse (
+          collection->client, opts, &insert_many_opts, error)) {
+      GOTO (done);
+   }
+
+   for (i = 0; i < n_documents; i++) {
+      if (!_mongoc_validate_new_document (
+             documents[i], insert_many_opts.crud.validate, error)) {
+         GOTO (done);
+      }
+   }
+
+   _mongoc_write_command_init_insert_idl (
+      &command,
+      NULL,
+      &insert_many_opts.extra,
+      ++collection->client->cluster.operation_id);
+
+   command.flags.ordered = insert_many_opts.ordered;
+   command.flags.bypass_document_validation = insert_many_opts.bypass;
+
+   for (i = 0; i < n_documents; i++) {
+      _mongoc_write_command_insert_append (&command, documents[i]);
+   }
+
+   ret = _mongoc_reactor_write (reactor,
+                                collection,
+                                MONGOC_REACTOR_OP_INSERT,
+                                &command,
+                                &insert_many_opts.crud,
+                                cb,
+                                ctx,
+                                error);
+
+done:
+   _mongoc_insert_many_opts_cleanup (&insert_many_opts);
+
+   return ret;
+}
+
+
+static bool
+_mongoc_reactor_update (mongoc_reactor_t *reactor,
+                        mongoc_collection_t *collection,
+                        const bson_t *selector,
+                        const bson_t *update,
+                        const mongoc_update_opts_t *update_opts,
+                        bool multi,
+                        const bson_t *array_filters,
+                        bson_t *extra,
+                        mongoc_reactor_cb_t cb,
+                        void *ctx,
+                        bson_error_t *error)
+{
+   mongoc_write_command_t command;
+
+   _mongoc_collection_init_update_command (collection,
+                                           &command,
+                                           selector,
+                                           update,
+                                           update_opts,
+                                           multi,
+                                           update_opts->bypass,
+                                           array_filters,
+                                           extra);
+
+   return _mongoc_reactor_write (reactor,
+                                 collection,
+                                 MONGOC_REACTOR_OP_UPDATE,
+                                 &command,
+                                 &update_opts->crud,
+                                 cb,
+                                 ctx,
+                                 error);
+}
+
+
+bool
+mongoc_reactor_update_one (mongoc_reactor_t *reactor,
+                           mongoc_collection_t *collection,
+                           const bson_t *selector,
+                           const bson_t *update,
+                           const bson_t *opts,
+                           mongoc_reactor_cb_t cb,
+                           void *ctx,
+                           bson_error_t *error)
+{
+   mongoc_update_one_opts_t update_one_opts;
+   bool ret = false;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (selector);
+   BSON_ASSERT_PARAM (update);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!_mongoc_reactor_check_collection (reactor, collection, error)) {
+      return false;
+   }
+
+   if (!_mongoc_update_one_opts_parse (
+          collection->client, opts, &update_one_opts, error)) {
+      GOTO (done);
+   }
+
+   if (!_mongoc_validate_update (
+          update, update_one_opts.update.crud.validate, error)) {
+      GOTO (done);
+   }
+
+   ret = _mongoc_reactor_update (reactor,
+                                 collection,
+                                 selector,
+                                 update,
+                                 &update_one_opts.update,
+                                 false /* multi */,
+                                 &update_one_opts.arrayFilters,
+                                 &update_one_opts.extra,
+                                 cb,
+                                 ctx,
+                                 error);
+
+done:
+   _mongoc_update_one_opts_cleanup (&update_one_opts);
+
+   return ret;
+}
+
+
+bool
+mongoc_reactor_update_many (mongoc_reactor_t *reactor,
+                            mongoc_collection_t *collection,
+                            const bson_t *selector,
+                            const bson_t *update,
+                            const bson_t *opts,
+                            mongoc_reactor_cb_t cb,
+                            void *ctx,
+                            bson_error_t *error)
+{
+   mongoc_update_many_opts_t update_many_opts;
+   bool ret = false;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (selector);
+   BSON_ASSERT_PARAM (update);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!_mongoc_reactor_check_collection (reactor, collection, error)) {
+      return false;
+   }
+
+   if (!_mongoc_update_many_opts_parse (
+          collection->client, opts, &update_many_opts, error)) {
+      GOTO (done);
+   }
+
+   if (!_mongoc_validate_update (
+          update, update_many_opts.update.crud.validate, error)) {
+      GOTO (done);
+   }
+
+   ret = _mongoc_reactor_update (reactor,
+                                 collection,
+                                 selector,
+                                 update,
+                                 &update_many_opts.update,
+                                 true /* multi */,
+                                 &update_many_opts.arrayFilters,
+                                 &update_many_opts.extra,
+                                 cb,
+                                 ctx,
+                                 error);
+
+done:
+   _mongoc_update_many_opts_cleanup (&update_many_opts);
+
+   return ret;
+}
+
+
+bool
+mongoc_reactor_replace_one (mongoc_reactor_t *reactor,
+                            mongoc_collection_t *collection,
+                            const bson_t *selector,
+                            const bson_t *replacement,
+                            const bson_t *opts,
+                            mongoc_reactor_cb_t cb,
+                            void *ctx,
+                            bson_error_t *error)
+{
+   mongoc_replace_one_opts_t replace_one_opts;
+   bool ret = false;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (selector);
+   BSON_ASSERT_PARAM (replacement);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!_mongoc_reactor_check_collection (reactor, collection, error)) {
+      return false;
+   }
+
+   if (!_mongoc_replace_one_opts_parse (
+          collection->client, opts, &replace_one_opts, error)) {
+      GOTO (done);
+   }
+
+   if (!_mongoc_validate_replace (
+          replacement, replace_one_opts.update.crud.validate, error)) {
+      GOTO (done);
+   }
+
+   ret = _mongoc_reactor_update (reactor,
+                                 collection,
+                                 selector,
+                                 replacement,
+                                 &replace_one_opts.update,
+                                 false /* multi */,
+                                 NULL /* array filters */,
+                                 &replace_one_opts.extra,
+                                 cb,
+                                 ctx,
+                                 error);
+
+done:
+   _mongoc_replace_one_opts_cleanup (&replace_one_opts);
+
+   return ret;
+}
+
+
+static bool
+_mongoc_reactor_delete (mongoc_reactor_t *reactor,
+                        mongoc_collection_t *collection,
+                        bool multi,
+                        const bson_t *selector,
+                        const mongoc_delete_opts_t *delete_opts,
+                        const bson_t *cmd_opts,
+                        mongoc_reactor_cb_t cb,
+                        void *ctx,
+                        bson_error_t *error)
+{
+   mongoc_write_command_t command;
+   bson_t limit = BSON_INITIALIZER;
+
+   /* the delete statement, with its limit, is copied into the command */
+   _mongoc_collection_init_delete_command (
+      collection, &command, multi, selector, delete_opts, cmd_opts, &limit);
+   bson_destroy (&limit);
+
+   return _mongoc_reactor_write (reactor,
+                                 collection,
+                                 MONGOC_REACTOR_OP_DELETE,
+                                 &command,
+                                 &delete_opts->crud,
+                                 cb,
+                                 ctx,
+                                 error);
+}
+
+
+bool
+mongoc_reactor_delete_one (mongoc_reactor_t *reactor,
+                           mongoc_collection_t *collection,
+                           const bson_t *selector,
+                           const bson_t *opts,
+                           mongoc_reactor_cb_t cb,
+                           void *ctx,
+                           bson_error_t *error)
+{
+   mongoc_delete_one_opts_t delete_one_opts;
+   bool ret = false;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (selector);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!_mongoc_reactor_check_collection (reactor, collection, error)) {
+      return false;
+   }
+
+   if (!_mongoc_delete_one_opts_parse (
+          collection->client, opts, &delete_one_opts, error)) {
+      GOTO (done);
+   }
+
+   ret = _mongoc_reactor_delete (reactor,
+                                 collection,
+                                 false /* multi */,
+                                 selector,
+                                 &delete_one_opts.delete,
+                                 &delete_one_opts.extra,
+                                 cb,
+                                 ctx,
+                                 error);
+
+done:
+   _mongoc_delete_one_opts_cleanup (&delete_one_opts);
+
+   return ret;
+}
+
+
+bool
+mongoc_reactor_delete_many (mongoc_reactor_t *reactor,
+                            mongoc_collection_t *collection,
+                            const bson_t *selector,
+                            const bson_t *opts,
+                            mongoc_reactor_cb_t cb,
+                            void *ctx,
+                            bson_error_t *error)
+{
+   mongoc_delete_many_opts_t delete_many_opts;
+   bool ret = false;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (collection);
+   BSON_ASSERT_PARAM (selector);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!_mongoc_reactor_check_collection (reactor, collection, error)) {
+      return false;
+   }
+
+   if (!_mongoc_delete_many_opts_parse (
+          collection->client, opts, &delete_many_opts, error)) {
+      GOTO (done);
+   }
+
+   ret = _mongoc_reactor_delete (reactor,
+                                 collection,
+                                 true /* multi */,
+                                 selector,
+                                 &delete_many_opts.delete,
+                                 &delete_many_opts.extra,
+                                 cb,
+                                 ctx,
+                                 error);
+
+done:
+   _mongoc_delete_many_opts_cleanup (&delete_many_opts);
+
+   return ret;
+}
+
+
+bool
+mongoc_reactor_bulk_operation_execute (mongoc_reactor_t *reactor,
+                                       mongoc_bulk_operation_t *bulk,
+                                       mongoc_reactor_cb_t cb,
+                                       void *ctx,
+                                       bson_error_t *error)
+{
+   mongoc_reactor_op_t *op;
+   const mongoc_write_concern_t *write_concern;
+
+   BSON_ASSERT_PARAM (reactor);
+   BSON_ASSERT_PARAM (bulk);
+   BSON_ASSERT_PARAM (cb);
+
+   if (bulk->client != reactor->client) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "The bulk operation must belong to the reactor's client");
+      return false;
+   }
+
+   if (!_mongoc_reactor_check_client (reactor, error)) {
+      return false;
+   }
+
+   if (bulk->executed) {
+      _mongoc_write_result_destroy (&bulk->result);
+      _mongoc_write_result_init (&bulk->result);
+   }
+
+   bulk->executed = true;
+
+   if (!bulk->database) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "mongoc_reactor_bulk_operation_execute() requires a "
+                      "database and one has not been set.");
+      return false;
+   } else if (!bulk->collection) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "mongoc_reactor_bulk_operation_execute() requires a "
+                      "collection and one has not been set.");
+      return false;
+   }
+
+   /* error stored by functions like mongoc_bulk_operation_insert that
+    * can't report errors immediately */
+   if (bulk->result.error.domain) {
+      if (error) {
+         memcpy (error, &bulk->result.error, sizeof (bson_error_t));
+      }
+
+      return false;
+   }
+
+   if (!bulk->commands.len) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "Cannot do an empty bulk write");
+      return false;
+   }
+
+   write_concern = COALESCE (bulk->write_concern, reactor->client->write_concern);
+
+   op = _mongoc_reactor_op_new (reactor, MONGOC_REACTOR_OP_BULK, cb, ctx);
+   op->commands = (mongoc_write_command_t *) bulk->commands.data;
+   op->n_commands = bulk->commands.len;
+   op->database = bson_strdup (bulk->database);
+   op->collection = bson_strdup (bulk->collection);
+   op->session = bulk->session;
+   op->write_concern = mongoc_write_concern_copy (write_concern);
+   op->result = &bulk->result;
+   op->bulk = bulk;
+
+   return _mongoc_reactor_write_start (op, bulk->server_id, error);
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-prelude.h"
+
+#ifndef MONGOC_REACTOR_H
+#define MONGOC_REACTOR_H
+
+#include <bson/bson.h>
+
+#include "mongoc-macros.h"
+#include "mongoc-bulk-operation.h"
+#include "mongoc-client.h"
+#include "mongoc-collection.h"
+#include "mongoc-read-prefs.h"
+#include "mongoc-socket.h"
+
+
+BSON_BEGIN_DECLS
+
+
+typedef struct _mongoc_reactor_t mongoc_reactor_t;
+
+typedef struct _mongoc_reactor_fd_t {
+#ifdef _WIN32
+   SOCKET fd;
+#else
+   int fd;
+#endif
+   int events;
+   int revents;
+} mongoc_reactor_fd_t;
+
+typedef void (*mongoc_reactor_cb_t) (bool success,
+                                     const bson_t *reply,
+                                     const bson_error_t *error,
+                                     uint32_t server_id,
+                                     void *ctx);
+
+
+MONGOC_EXPORT (mongoc_reactor_t *)
+mongoc_reactor_new (mongoc_client_t *client);
+MONGOC_EXPORT (void)
+mongoc_reactor_destroy (mongoc_reactor_t *reactor);
+MONGOC_EXPORT (size_t)
+mongoc_reactor_get_fds (mongoc_reactor_t *reactor,
+                        mongoc_reactor_fd_t *fds,
+                        size_t n_fds,
+                        int64_t *timeout_msec);
+MONGOC_EXPORT (void)
+mongoc_reactor_dispatch (mongoc_reactor_t *reactor,
+                         const mongoc_reactor_fd_t *fds,
+                         size_t n_fds);
+MONGOC_EXPORT (size_t)
+mongoc_reactor_perform (mongoc_reactor_t *reactor, int64_t max_wait_msec);
+MONGOC_EXPORT (bool)
+mongoc_reactor_command (mongoc_reactor_t *reactor,
+                        const char *db_name,
+                        const bson_t *command,
+                        const mongoc_read_prefs_t *read_prefs,
+                        const bson_t *opts,
+                        mongoc_reactor_cb_t cb,
+                        void *ctx,
+                        bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_find (mongoc_reactor_t *reactor,
+                     mongoc_collection_t *collection,
+                     const bson_t *filter,
+                     const bson_t *opts,
+                     const mongoc_read_prefs_t *read_prefs,
+                     mongoc_reactor_cb_t cb,
+                     void *ctx,
+                     bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_get_more (mongoc_reactor_t *reactor,
+                         mongoc_collection_t *collection,
+                         int64_t cursor_id,
+                         uint32_t server_id,
+                         const bson_t *opts,
+                         mongoc_reactor_cb_t cb,
+                         void *ctx,
+                         bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_insert_one (mongoc_reactor_t *reactor,
+                           mongoc_collection_t *collection,
+                           const bson_t *document,
+                           const bson_t *opts,
+                           mongoc_reactor_cb_t cb,
+                           void *ctx,
+                           bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_insert_many (mongoc_reactor_t *reactor,
+                            mongoc_collection_t *collection,
+                            const bson_t **documents,
+                            size_t n_documents,
+                            const bson_t *opts,
+                            mongoc_reactor_cb_t cb,
+                            void *ctx,
+                            bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_update_one (mongoc_reactor_t *reactor,
+                           mongoc_collection_t *collection,
+                           const bson_t *selector,
+                           const bson_t *update,
+                           const bson_t *opts,
+                           mongoc_reactor_cb_t cb,
+                           void *ctx,
+                           bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_update_many (mongoc_reactor_t *reactor,
+                            mongoc_collection_t *collection,
+                            const bson_t *selector,
+                            const bson_t *update,
+                            const bson_t *opts,
+                            mongoc_reactor_cb_t cb,
+                            void *ctx,
+                            bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_replace_one (mongoc_reactor_t *reactor,
+                            mongoc_collection_t *collection,
+                            const bson_t *selector,
+                            const bson_t *replacement,
+                            const bson_t *opts,
+                            mongoc_reactor_cb_t cb,
+                            void *ctx,
+                            bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_delete_one (mongoc_reactor_t *reactor,
+                           mongoc_collection_t *collection,
+                           const bson_t *selector,
+                           const bson_t *opts,
+                           mongoc_reactor_cb_t cb,
+                           void *ctx,
+                           bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_delete_many (mongoc_reactor_t *reactor,
+                            mongoc_collection_t *collection,
+                            const bson_t *selector,
+                            const bson_t *opts,
+                            mongoc_reactor_cb_t cb,
+                            void *ctx,
+                            bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_reactor_bulk_operation_execute (mongoc_reactor_t *reactor,
+                                       mongoc_bulk_operation_t *bulk,
+                                       mongoc_reactor_cb_t cb,
+                                       void *ctx,
+                                       bson_error_t *error);
+
+
+BSON_END_DECLS
+
+
+#endif /* MONGOC_REACTOR_H */
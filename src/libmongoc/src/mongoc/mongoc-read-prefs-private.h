@@ -32,6 +32,9 @@ struct _mongoc_read_prefs_t {
    bson_t tags;
    int64_t max_staleness_seconds;
    bson_t hedge;
+   /* the "$readPreference" document, rebuilt by each setter so that commands
+    * append it without encoding it again */
+   bson_t compiled;
 };
 
 
@@ -60,6 +63,9 @@ assemble_query (const mongoc_read_prefs_t *read_prefs,
 void
 assemble_query_result_cleanup (mongoc_assemble_query_result_t *result);
 
+const bson_t *
+_mongoc_read_prefs_get_bson (const mongoc_read_prefs_t *read_prefs);
+
 bool
 _mongoc_read_prefs_validate (const mongoc_read_prefs_t *read_prefs,
                              bson_error_t *error);
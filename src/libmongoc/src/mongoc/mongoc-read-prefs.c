@@ -20,6 +20,10 @@
 #include "mongoc-trace-private.h"
 
 
+static void
+_mongoc_read_prefs_compile (mongoc_read_prefs_t *read_prefs);
+
+
 mongoc_read_prefs_t *
 mongoc_read_prefs_new (mongoc_read_mode_t mode)
 {
@@ -30,6 +34,8 @@ mongoc_read_prefs_new (mongoc_read_mode_t mode)
    bson_init (&read_prefs->tags);
    read_prefs->max_staleness_seconds = MONGOC_NO_MAX_STALENESS;
    bson_init (&read_prefs->hedge);
+   bson_init (&read_prefs->compiled);
+   _mongoc_read_prefs_compile (read_prefs);
 
    return read_prefs;
 }
@@ -50,6 +56,7 @@ mongoc_read_prefs_set_mode (mongoc_read_prefs_t *read_prefs,
    BSON_ASSERT (mode <= MONGOC_READ_NEAREST);
 
    read_prefs->mode = mode;
+   _mongoc_read_prefs_compile (read_prefs);
 }
 
 
@@ -73,6 +80,8 @@ mongoc_read_prefs_set_tags (mongoc_read_prefs_t *read_prefs, const bson_t *tags)
    } else {
       bson_init (&read_prefs->tags);
    }
+
+   _mongoc_read_prefs_compile (read_prefs);
 }
 
 
@@ -95,6 +104,7 @@ mongoc_read_prefs_add_tag (mongoc_read_prefs_t *read_prefs, const bson_t *tag)
    }
 
    bson_destroy (&empty);
+   _mongoc_read_prefs_compile (read_prefs);
 }
 
 
@@ -115,6 +125,7 @@ mongoc_read_prefs_set_max_staleness_seconds (mongoc_read_prefs_t *read_prefs,
    BSON_ASSERT (read_prefs);
 
    read_prefs->max_staleness_seconds = max_staleness_seconds;
+   _mongoc_read_prefs_compile (read_prefs);
 }
 
 
@@ -140,6 +151,8 @@ mongoc_read_prefs_set_hedge (mongoc_read_prefs_t *read_prefs,
    } else {
       bson_init (&read_prefs->hedge);
    }
+
+   _mongoc_read_prefs_compile (read_prefs);
 }
 
 
@@ -174,6 +187,7 @@ mongoc_read_prefs_destroy (mongoc_read_prefs_t *read_prefs)
    if (read_prefs) {
       bson_destroy (&read_prefs->tags);
       bson_destroy (&read_prefs->hedge);
+      bson_destroy (&read_prefs->compiled);
       bson_free (read_prefs);
    }
 }
@@ -191,12 +205,63 @@ mongoc_read_prefs_copy (const mongoc_read_prefs_t *read_prefs)
       ret->max_staleness_seconds = read_prefs->max_staleness_seconds;
       bson_destroy (&ret->hedge);
       bson_copy_to (&read_prefs->hedge, &ret->hedge);
+      bson_destroy (&ret->compiled);
+      bson_copy_to (&read_prefs->compiled, &ret->compiled);
    }
 
    return ret;
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_read_prefs_compile --
+ *
+ *       Encode the "$readPreference" document. Unlike the lazily frozen
+ *       read and write concerns, read prefs are compiled by each setter,
+ *       so _mongoc_read_prefs_get_bson never modifies a const read prefs
+ *       that threads may share.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static void
+_mongoc_read_prefs_compile (mongoc_read_prefs_t *read_prefs)
+{
+   bson_t *compiled = &read_prefs->compiled;
+
+   bson_reinit (compiled);
+   bson_append_utf8 (
+      compiled, "mode", 4, _mongoc_read_mode_as_str (read_prefs->mode), -1);
+
+   if (!bson_empty (&read_prefs->tags)) {
+      bson_append_array (compiled, "tags", 4, &read_prefs->tags);
+   }
+
+   if (read_prefs->max_staleness_seconds != MONGOC_NO_MAX_STALENESS) {
+      bson_append_int64 (compiled,
+                         "maxStalenessSeconds",
+                         19,
+                         read_prefs->max_staleness_seconds);
+   }
+
+   if (!bson_empty (&read_prefs->hedge)) {
+      bson_append_document (compiled, "hedge", 5, &read_prefs->hedge);
+   }
+}
+
+
+/* The "$readPreference" document for commands. */
+const bson_t *
+_mongoc_read_prefs_get_bson (const mongoc_read_prefs_t *read_prefs)
+{
+   BSON_ASSERT (read_prefs);
+
+   return &read_prefs->compiled;
+}
+
+
 const char *
 _mongoc_read_mode_as_str (mongoc_read_mode_t mode)
 {
@@ -228,8 +293,6 @@ _apply_read_preferences_mongos (
 {
    mongoc_read_mode_t mode;
    const bson_t *tags = NULL;
-   bson_t child;
-   const char *mode_str;
    int64_t max_staleness_seconds = MONGOC_NO_MAX_STALENESS;
    const bson_t *hedge = NULL;
 
@@ -285,24 +348,10 @@ _apply_read_preferences_mongos (
             result->assembled_query, "$query", 6, query_bson);
       }
 
-      bson_append_document_begin (
-         result->assembled_query, "$readPreference", 15, &child);
-      mode_str = _mongoc_read_mode_as_str (mode);
-      bson_append_utf8 (&child, "mode", 4, mode_str, -1);
-      if (!bson_empty0 (tags)) {
-         bson_append_array (&child, "tags", 4, tags);
-      }
-
-      if (max_staleness_seconds != MONGOC_NO_MAX_STALENESS) {
-         bson_append_int64 (
-            &child, "maxStalenessSeconds", 19, max_staleness_seconds);
-      }
-
-      if (!bson_empty0 (hedge)) {
-         bson_append_document (&child, "hedge", 5, hedge);
-      }
-
-      bson_append_document_end (result->assembled_query, &child);
+      bson_append_document (result->assembled_query,
+                            "$readPreference",
+                            15,
+                            _mongoc_read_prefs_get_bson (read_prefs));
    }
 }
 
@@ -985,11 +985,21 @@ _mongoc_rpc_scatter_reply_header_only (mongoc_rpc_t *rpc,
 bool
 _mongoc_rpc_get_first_document (mongoc_rpc_t *rpc, bson_t *reply)
 {
+   int32_t len;
+
    if (rpc->header.opcode == MONGOC_OPCODE_REPLY &&
        _mongoc_rpc_reply_get_first (&rpc->reply, reply)) {
       return true;
    }
 
+   if (rpc->header.opcode == MONGOC_OPCODE_MSG && rpc->msg.n_sections > 0 &&
+       rpc->msg.sections[0].payload_type == 0) {
+      memcpy (&len, rpc->msg.sections[0].payload.bson_document, 4);
+      len = BSON_UINT32_FROM_LE (len);
+      return bson_init_static (
+         reply, rpc->msg.sections[0].payload.bson_document, len);
+   }
+
    return false;
 }
 
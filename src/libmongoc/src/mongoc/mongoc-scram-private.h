@@ -112,6 +112,17 @@ _mongoc_scram_step (mongoc_scram_t *scram,
 void
 _mongoc_scram_cache_destroy (mongoc_scram_cache_t *cache);
 
+/* Discards the keys scram used from its cache and the process-wide cache,
+ * after the server rejected them */
+void
+_mongoc_scram_invalidate_cache (mongoc_scram_t *scram);
+
+void
+_mongoc_scram_key_cache_init (void);
+
+void
+_mongoc_scram_key_cache_cleanup (void);
+
 /* returns false if this string does not need SASLPrep. It returns true
  * conservatively, if str might need to be SASLPrep'ed. */
 bool
@@ -29,6 +29,9 @@
 #include "common-b64-private.h"
 
 #include "mongoc-memcmp-private.h"
+#include "mongoc-counters-private.h"
+#include "common-thread-private.h"
+#include "utlist.h"
 
 #define MONGOC_SCRAM_SERVER_KEY "Server Key"
 #define MONGOC_SCRAM_CLIENT_KEY "Client Key"
@@ -81,6 +84,189 @@ _mongoc_scram_cache_copy (const mongoc_scram_cache_t *cache)
    return ret;
 }
 
+/* Keys derived for any client in the process, so that clients authenticating
+ * as the same user don't each repeat the salted password's iterations. The
+ * password is only stored as a digest of the hashed password. */
+typedef struct _key_cache_entry_t {
+   struct _key_cache_entry_t *next;
+   char *user;
+   mongoc_crypto_hash_algorithm_t algorithm;
+   uint8_t password_digest[MONGOC_SCRAM_HASH_MAX_SIZE];
+   uint8_t decoded_salt[MONGOC_SCRAM_B64_HASH_MAX_SIZE];
+   uint32_t iterations;
+   uint8_t client_key[MONGOC_SCRAM_HASH_MAX_SIZE];
+   uint8_t server_key[MONGOC_SCRAM_HASH_MAX_SIZE];
+   uint8_t salted_password[MONGOC_SCRAM_HASH_MAX_SIZE];
+} key_cache_entry_t;
+
+static key_cache_entry_t *key_cache;
+static bson_mutex_t key_cache_mutex;
+
+
+void
+_mongoc_scram_key_cache_init (void)
+{
+   bson_mutex_init (&key_cache_mutex);
+}
+
+
+static void
+_key_cache_entry_destroy (key_cache_entry_t *entry)
+{
+   bson_free (entry->user);
+   bson_zero_free (entry, sizeof (*entry));
+}
+
+
+void
+_mongoc_scram_key_cache_cleanup (void)
+{
+   key_cache_entry_t *iter;
+   key_cache_entry_t *tmp;
+
+   LL_FOREACH_SAFE (key_cache, iter, tmp)
+   {
+      _key_cache_entry_destroy (iter);
+   }
+
+   key_cache = NULL;
+   bson_mutex_destroy (&key_cache_mutex);
+}
+
+
+static bool
+_key_cache_password_digest (mongoc_scram_t *scram, uint8_t *digest)
+{
+   memset (digest, 0, MONGOC_SCRAM_HASH_MAX_SIZE);
+
+   return scram->user && scram->hashed_password &&
+          mongoc_crypto_hash (&scram->crypto,
+                              (const unsigned char *) scram->hashed_password,
+                              strlen (scram->hashed_password),
+                              digest);
+}
+
+
+/* Returns the entry for scram's user, mechanism and password, or NULL. Its
+ * salt and iteration count may not match scram's. */
+static key_cache_entry_t *
+_key_cache_find (mongoc_scram_t *scram, const uint8_t *digest)
+{
+   key_cache_entry_t *iter;
+
+   LL_FOREACH (key_cache, iter)
+   {
+      if (iter->algorithm == scram->crypto.algorithm &&
+          !strcmp (iter->user, scram->user) &&
+          !memcmp (iter->password_digest,
+                   digest,
+                   sizeof (iter->password_digest))) {
+         return iter;
+      }
+   }
+
+   return NULL;
+}
+
+
+static bool
+_key_cache_entry_matches (key_cache_entry_t *entry, mongoc_scram_t *scram)
+{
+   return entry->iterations == scram->iterations &&
+          !memcmp (entry->decoded_salt,
+                   scram->decoded_salt,
+                   sizeof (entry->decoded_salt));
+}
+
+
+/* Copies the process-wide cache's keys to scram if they were derived from
+ * scram's pre-secrets */
+static void
+_mongoc_scram_key_cache_apply (mongoc_scram_t *scram)
+{
+   key_cache_entry_t *entry;
+   uint8_t digest[MONGOC_SCRAM_HASH_MAX_SIZE];
+
+   if (!_key_cache_password_digest (scram, digest)) {
+      return;
+   }
+
+   bson_mutex_lock (&key_cache_mutex);
+   entry = _key_cache_find (scram, digest);
+   if (entry && _key_cache_entry_matches (entry, scram)) {
+      memcpy (scram->client_key, entry->client_key, sizeof (scram->client_key));
+      memcpy (scram->server_key, entry->server_key, sizeof (scram->server_key));
+      memcpy (scram->salted_password,
+              entry->salted_password,
+              sizeof (scram->salted_password));
+   }
+
+   bson_mutex_unlock (&key_cache_mutex);
+}
+
+
+/* Stores scram's pre-secrets and keys in the process-wide cache, replacing
+ * the keys previously derived for the same user, mechanism and password */
+static void
+_mongoc_scram_key_cache_put (mongoc_scram_t *scram)
+{
+   key_cache_entry_t *entry;
+   uint8_t digest[MONGOC_SCRAM_HASH_MAX_SIZE];
+
+   if (!_key_cache_password_digest (scram, digest)) {
+      return;
+   }
+
+   bson_mutex_lock (&key_cache_mutex);
+   entry = _key_cache_find (scram, digest);
+   if (!entry) {
+      entry = (key_cache_entry_t *) bson_malloc0 (sizeof (*entry));
+      entry->user = bson_strdup (scram->user);
+      entry->algorithm = scram->crypto.algorithm;
+      memcpy (entry->password_digest, digest, sizeof (entry->password_digest));
+      LL_PREPEND (key_cache, entry);
+   }
+
+   memcpy (
+      entry->decoded_salt, scram->decoded_salt, sizeof (entry->decoded_salt));
+   entry->iterations = scram->iterations;
+   memcpy (entry->client_key, scram->client_key, sizeof (entry->client_key));
+   memcpy (entry->server_key, scram->server_key, sizeof (entry->server_key));
+   memcpy (entry->salted_password,
+           scram->salted_password,
+           sizeof (entry->salted_password));
+
+   bson_mutex_unlock (&key_cache_mutex);
+}
+
+
+void
+_mongoc_scram_invalidate_cache (mongoc_scram_t *scram)
+{
+   key_cache_entry_t *entry;
+   uint8_t digest[MONGOC_SCRAM_HASH_MAX_SIZE];
+
+   BSON_ASSERT (scram);
+
+   if (scram->cache) {
+      _mongoc_scram_cache_destroy (scram->cache);
+      scram->cache = NULL;
+   }
+
+   if (!_key_cache_password_digest (scram, digest)) {
+      return;
+   }
+
+   bson_mutex_lock (&key_cache_mutex);
+   entry = _key_cache_find (scram, digest);
+   if (entry && _key_cache_entry_matches (entry, scram)) {
+      LL_DELETE (key_cache, entry);
+      _key_cache_entry_destroy (entry);
+   }
+
+   bson_mutex_unlock (&key_cache_mutex);
+}
+
 #ifdef MONGOC_ENABLE_ICU
 #include <unicode/usprep.h>
 #include <unicode/ustring.h>
@@ -540,6 +726,8 @@ _mongoc_scram_step2 (mongoc_scram_t *scram,
    /* the decoded salt leaves four trailing bytes to add the int32 0x00000001 */
    const int32_t expected_salt_length = _scram_hash_size (scram) - 4;
    bool rval = true;
+   /* whether the keys were computed rather than found in a cache */
+   bool derived = false;
 
    int iterations;
 
@@ -763,6 +951,8 @@ _mongoc_scram_step2 (mongoc_scram_t *scram,
    if (scram->cache &&
        _mongoc_scram_cache_has_presecrets (scram->cache, scram)) {
       _mongoc_scram_cache_apply_secrets (scram->cache, scram);
+   } else {
+      _mongoc_scram_key_cache_apply (scram);
    }
 
    if (!*scram->salted_password) {
@@ -772,10 +962,18 @@ _mongoc_scram_step2 (mongoc_scram_t *scram,
                                    decoded_salt,
                                    decoded_salt_len,
                                    (uint32_t) iterations);
+      derived = true;
+      mongoc_counter_auth_scram_derivations_inc ();
    }
 
    _mongoc_scram_generate_client_proof (scram, outbuf, outbufmax, outbuflen);
 
+   if (derived) {
+      /* share the keys before the server accepts them, so that clients
+       * connecting at the same time can use them. */
+      _mongoc_scram_key_cache_put (scram);
+   }
+
    goto CLEANUP;
 
 BUFFER_AUTH:
@@ -961,6 +1159,7 @@ _mongoc_scram_step3 (mongoc_scram_t *scram,
 
    /* Update the cache if authentication succeeds */
    _mongoc_scram_update_cache (scram);
+   _mongoc_scram_key_cache_put (scram);
 
    goto CLEANUP;
 
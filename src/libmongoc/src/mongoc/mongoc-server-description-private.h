@@ -20,6 +20,7 @@
 #define MONGOC_SERVER_DESCRIPTION_PRIVATE_H
 
 #include "mongoc-server-description.h"
+#include "mongoc-thread-private.h"
 
 
 #define MONGOC_DEFAULT_WIRE_VERSION 0
@@ -44,6 +45,24 @@
 
 #define MONGOC_RTT_UNSET -1
 
+/* how many recent operations a server's operation latency averages */
+#define MONGOC_SERVER_LOAD_WINDOW 16
+
+/* Operations in progress on a server and the latencies of recent ones,
+ * measured by a client pool's application threads. Every copy of a server's
+ * description in a topology shares one, so it outlives snapshots and is
+ * visible in server descriptions passed to SDAM monitoring callbacks. */
+typedef struct _mongoc_server_load_t {
+   volatile int32_t refs;
+   /* read without the mutex, as a hint for server selection */
+   volatile int32_t in_progress;
+   volatile int32_t avg_latency_usec;
+   bson_mutex_t mutex;
+   int64_t latency_usec[MONGOC_SERVER_LOAD_WINDOW];
+   int64_t latency_sum_usec;
+   uint32_t n_latencies;
+} mongoc_server_load_t;
+
 typedef enum {
    MONGOC_SERVER_UNKNOWN,
    MONGOC_SERVER_STANDALONE,
@@ -110,8 +129,27 @@ struct _mongoc_server_description_t {
    pre-4.2 server.
    */
    uint32_t generation;
+
+   /* shared with copies, NULL if not part of a topology description */
+   mongoc_server_load_t *load;
 };
 
+mongoc_server_load_t *
+_mongoc_server_load_new (void);
+
+void
+_mongoc_server_load_begin (mongoc_server_load_t *load);
+
+void
+_mongoc_server_load_end (mongoc_server_load_t *load, int64_t latency_usec);
+
+void
+_mongoc_server_load_add (mongoc_server_load_t *load, int64_t latency_usec);
+
+int64_t
+_mongoc_server_load_latency_percentile (mongoc_server_load_t *load,
+                                        int percentile);
+
 void
 mongoc_server_description_init (mongoc_server_description_t *sd,
                                 const char *address,
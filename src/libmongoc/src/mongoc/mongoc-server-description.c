@@ -35,6 +35,125 @@ static bool
 _match_tag_set (const mongoc_server_description_t *sd,
                 bson_iter_t *tag_set_iter);
 
+
+mongoc_server_load_t *
+_mongoc_server_load_new (void)
+{
+   mongoc_server_load_t *load;
+
+   load = bson_malloc0 (sizeof (mongoc_server_load_t));
+   load->refs = 1;
+   load->avg_latency_usec = -1;
+   bson_mutex_init (&load->mutex);
+
+   return load;
+}
+
+
+static mongoc_server_load_t *
+_mongoc_server_load_ref (mongoc_server_load_t *load)
+{
+   if (load) {
+      bson_atomic_int_add (&load->refs, 1);
+   }
+
+   return load;
+}
+
+
+static void
+_mongoc_server_load_release (mongoc_server_load_t *load)
+{
+   if (load && bson_atomic_int_add (&load->refs, -1) == 0) {
+      bson_mutex_destroy (&load->mutex);
+      bson_free (load);
+   }
+}
+
+
+/* an application thread starts an operation on the server */
+void
+_mongoc_server_load_begin (mongoc_server_load_t *load)
+{
+   bson_atomic_int_add (&load->in_progress, 1);
+}
+
+
+/* an operation that took @latency_usec finished. if @latency_usec is
+ * negative the latency is recorded later with _mongoc_server_load_add */
+void
+_mongoc_server_load_end (mongoc_server_load_t *load, int64_t latency_usec)
+{
+   bson_atomic_int_add (&load->in_progress, -1);
+
+   if (latency_usec >= 0) {
+      _mongoc_server_load_add (load, latency_usec);
+   }
+}
+
+
+/* record the latency of a finished operation */
+void
+_mongoc_server_load_add (mongoc_server_load_t *load, int64_t latency_usec)
+{
+   int64_t *slot;
+   uint32_t n;
+
+   bson_mutex_lock (&load->mutex);
+   slot = &load->latency_usec[load->n_latencies % MONGOC_SERVER_LOAD_WINDOW];
+   if (load->n_latencies >= MONGOC_SERVER_LOAD_WINDOW) {
+      load->latency_sum_usec -= *slot;
+   } else {
+      load->n_latencies++;
+   }
+
+   *slot = latency_usec;
+   load->latency_sum_usec += latency_usec;
+   n = BSON_MIN (load->n_latencies, MONGOC_SERVER_LOAD_WINDOW);
+   load->avg_latency_usec =
+      (int32_t) BSON_MIN (load->latency_sum_usec / n, INT32_MAX);
+   bson_mutex_unlock (&load->mutex);
+}
+
+static int
+_cmp_int64 (const void *a, const void *b)
+{
+   int64_t x = *(const int64_t *) a;
+   int64_t y = *(const int64_t *) b;
+
+   return x < y ? -1 : x > y;
+}
+
+
+/* the @percentile latency in microseconds of the recent operations, or -1 if
+ * none has finished yet */
+int64_t
+_mongoc_server_load_latency_percentile (mongoc_server_load_t *load,
+                                        int percentile)
+{
+   int64_t sorted[MONGOC_SERVER_LOAD_WINDOW];
+   uint32_t n;
+   uint32_t rank;
+
+   BSON_ASSERT (percentile > 0 && percentile <= 100);
+
+   bson_mutex_lock (&load->mutex);
+   n = BSON_MIN (load->n_latencies, MONGOC_SERVER_LOAD_WINDOW);
+   memcpy (sorted, load->latency_usec, n * sizeof (int64_t));
+   bson_mutex_unlock (&load->mutex);
+
+   if (!n) {
+      return -1;
+   }
+
+   qsort (sorted, n, sizeof (int64_t), _cmp_int64);
+   /* nearest rank */
+   rank = (n * (uint32_t) percentile + 99) / 100;
+
+   return sorted[rank - 1];
+}
+
+
 /* Destroy allocated resources within @description, but don't free it */
 void
 mongoc_server_description_cleanup (mongoc_server_description_t *sd)
@@ -48,6 +167,7 @@ mongoc_server_description_cleanup (mongoc_server_description_t *sd)
    bson_destroy (&sd->tags);
    bson_destroy (&sd->compressors);
    bson_destroy (&sd->topology_version);
+   _mongoc_server_load_release (sd->load);
 }
 
 /* Reset fields inside this sd, but keep same id, host information, RTT,
@@ -121,6 +241,7 @@ mongoc_server_description_init (mongoc_server_description_t *sd,
    sd->id = id;
    sd->type = MONGOC_SERVER_UNKNOWN;
    sd->round_trip_time_msec = MONGOC_RTT_UNSET;
+   sd->load = NULL;
 
    if (!_mongoc_host_list_from_string (&sd->host, address)) {
       MONGOC_WARNING ("Failed to parse uri for %s", address);
@@ -303,6 +424,57 @@ mongoc_server_description_last_update_time (
    return description->last_update_time_usec;
 }
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_server_description_operations_in_progress --
+ *
+ *      Get the number of operations a client pool's clients are running
+ *      on this server.
+ *
+ * Returns:
+ *      The number of operations, or zero for a server description that
+ *      is not from a client pool.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+int32_t
+mongoc_server_description_operations_in_progress (
+   const mongoc_server_description_t *description)
+{
+   return description->load ? description->load->in_progress : 0;
+}
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_server_description_operation_latency --
+ *
+ *      Get the average duration of a client pool's recent operations on
+ *      this server, from server selection until the reply is read.
+ *
+ * Returns:
+ *      The average in milliseconds, or -1 if no operation has finished.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+int64_t
+mongoc_server_description_operation_latency (
+   const mongoc_server_description_t *description)
+{
+   int32_t avg_latency_usec;
+
+   if (!description->load) {
+      return -1;
+   }
+
+   avg_latency_usec = description->load->avg_latency_usec;
+
+   return avg_latency_usec < 0 ? -1 : avg_latency_usec / 1000;
+}
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -781,6 +953,7 @@ mongoc_server_description_new_copy (
    memcpy (&copy->error, &description->error, sizeof copy->error);
 
    copy->generation = description->generation;
+   copy->load = _mongoc_server_load_ref (description->load);
    return copy;
 }
 
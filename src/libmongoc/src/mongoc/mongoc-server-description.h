@@ -50,6 +50,14 @@ MONGOC_EXPORT (int64_t)
 mongoc_server_description_round_trip_time (
    const mongoc_server_description_t *description);
 
+MONGOC_EXPORT (int32_t)
+mongoc_server_description_operations_in_progress (
+   const mongoc_server_description_t *description);
+
+MONGOC_EXPORT (int64_t)
+mongoc_server_description_operation_latency (
+   const mongoc_server_description_t *description);
+
 MONGOC_EXPORT (const char *)
 mongoc_server_description_type (const mongoc_server_description_t *description);
 
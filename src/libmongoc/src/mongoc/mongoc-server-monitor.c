@@ -669,6 +669,7 @@ _server_monitor_update_topology_description (
          ismaster_reply,
          description->round_trip_time_msec,
          &description->error);
+      _mongoc_topology_publish_snapshot (topology);
       /* Reconcile server monitors. */
       _mongoc_topology_background_monitoring_reconcile (topology);
    }
@@ -1148,6 +1149,7 @@ static BSON_THREAD_FUN (_server_monitor_rtt_thread, server_monitor_void)
             /* If the server description has been removed, the RTT thread will
              * be terminated by background monitoring soon. */
             mongoc_server_description_update_rtt (sd, rtt_ms);
+            _mongoc_topology_publish_snapshot (server_monitor->topology);
          }
          bson_mutex_unlock (&server_monitor->topology->mutex);
       }
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-prelude.h"
+
+#ifndef MONGOC_SERVER_SESSION_POOL_PRIVATE_H
+#define MONGOC_SERVER_SESSION_POOL_PRIVATE_H
+
+#include <bson/bson.h>
+
+#include "mongoc-client-session-private.h"
+#include "mongoc-thread-private.h"
+
+BSON_BEGIN_DECLS
+
+/* Pooled sessions are spread over several independently locked lists, so
+ * that threads starting and ending sessions neither contend with each other
+ * on one mutex nor with server selection on the topology mutex. Each thread
+ * pushes sessions to its home shard and pops from there first, so with one
+ * thread the pool is LIFO, as the Driver Sessions Spec requires. */
+#define MONGOC_SERVER_SESSION_POOL_SHARD_BITS 4
+#define MONGOC_SERVER_SESSION_POOL_SHARDS \
+   (1 << MONGOC_SERVER_SESSION_POOL_SHARD_BITS)
+
+/* without a background thread, returning a session prunes the pool at most
+ * this often */
+#define MONGOC_SERVER_SESSION_POOL_PRUNE_INTERVAL_SEC 60
+
+typedef struct {
+   bson_mutex_t mutex;
+   /* most recently pushed first */
+   mongoc_server_session_t *sessions;
+} mongoc_server_session_pool_shard_t;
+
+typedef struct _mongoc_server_session_pool_t {
+   mongoc_server_session_pool_shard_t shards[MONGOC_SERVER_SESSION_POOL_SHARDS];
+   /* sessions in the shards, read without locking */
+   volatile int32_t n_sessions;
+   /* never-used sessions generated ahead of time, handed out when the shards
+    * are empty. Guarded by fresh_mutex. */
+   bson_mutex_t fresh_mutex;
+   mongoc_server_session_t *fresh;
+   int32_t n_fresh;
+   /* the "prewarmedSessions" URI option: how many fresh sessions to keep */
+   int32_t n_prewarmed;
+   /* monotonic time of the last prune, in seconds */
+   volatile int32_t last_prune_sec;
+} mongoc_server_session_pool_t;
+
+void
+_mongoc_server_session_pool_init (mongoc_server_session_pool_t *pool,
+                                  int32_t n_prewarmed);
+
+void
+_mongoc_server_session_pool_destroy (mongoc_server_session_pool_t *pool);
+
+mongoc_server_session_t *
+_mongoc_server_session_pool_pop (mongoc_server_session_pool_t *pool,
+                                 int64_t timeout_minutes,
+                                 bson_error_t *error);
+
+void
+_mongoc_server_session_pool_push (mongoc_server_session_pool_t *pool,
+                                  mongoc_server_session_t *server_session,
+                                  int64_t timeout_minutes);
+
+mongoc_server_session_t *
+_mongoc_server_session_pool_take (mongoc_server_session_pool_t *pool);
+
+bool
+_mongoc_server_session_pool_is_empty (
+   const mongoc_server_session_pool_t *pool);
+
+bool
+_mongoc_server_session_pool_prune_due (
+   const mongoc_server_session_pool_t *pool);
+
+void
+_mongoc_server_session_pool_prune (mongoc_server_session_pool_t *pool,
+                                   int64_t timeout_minutes);
+
+void
+_mongoc_server_session_pool_prewarm (mongoc_server_session_pool_t *pool);
+
+void
+_mongoc_server_session_pool_clear (mongoc_server_session_pool_t *pool);
+
+BSON_END_DECLS
+
+#endif /* MONGOC_SERVER_SESSION_POOL_PRIVATE_H */
@@ -0,0 +1,346 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-server-session-pool-private.h"
+
+#include "mongoc-server-description-private.h"
+#include "mongoc-trace-private.h"
+#include "utlist.h"
+
+#undef MONGOC_LOG_DOMAIN
+#define MONGOC_LOG_DOMAIN "session"
+
+
+static int32_t
+_now_sec (void)
+{
+   return (int32_t) (bson_get_monotonic_time () / (1000 * 1000));
+}
+
+
+void
+_mongoc_server_session_pool_init (mongoc_server_session_pool_t *pool,
+                                  int32_t n_prewarmed)
+{
+   int i;
+
+   memset (pool, 0, sizeof *pool);
+   for (i = 0; i < MONGOC_SERVER_SESSION_POOL_SHARDS; i++) {
+      bson_mutex_init (&pool->shards[i].mutex);
+   }
+
+   bson_mutex_init (&pool->fresh_mutex);
+   pool->n_prewarmed = BSON_MAX (0, n_prewarmed);
+   pool->last_prune_sec = _now_sec ();
+}
+
+
+void
+_mongoc_server_session_pool_destroy (mongoc_server_session_pool_t *pool)
+{
+   int i;
+
+   _mongoc_server_session_pool_clear (pool);
+
+   for (i = 0; i < MONGOC_SERVER_SESSION_POOL_SHARDS; i++) {
+      bson_mutex_destroy (&pool->shards[i].mutex);
+   }
+
+   bson_mutex_destroy (&pool->fresh_mutex);
+}
+
+
+static mongoc_server_session_t *
+_shard_pop (mongoc_server_session_pool_t *pool, int i)
+{
+   mongoc_server_session_pool_shard_t *shard = &pool->shards[i];
+   mongoc_server_session_t *ss;
+
+   bson_mutex_lock (&shard->mutex);
+   ss = shard->sessions;
+   if (ss) {
+      CDL_DELETE (shard->sessions, ss);
+      bson_atomic_int_add (&pool->n_sessions, -1);
+   }
+   bson_mutex_unlock (&shard->mutex);
+
+   return ss;
+}
+
+
+static mongoc_server_session_t *
+_fresh_pop (mongoc_server_session_pool_t *pool)
+{
+   mongoc_server_session_t *ss;
+
+   bson_mutex_lock (&pool->fresh_mutex);
+   ss = pool->fresh;
+   if (ss) {
+      CDL_DELETE (pool->fresh, ss);
+      pool->n_fresh--;
+   }
+   bson_mutex_unlock (&pool->fresh_mutex);
+
+   return ss;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_server_session_pool_pop --
+ *
+ *       Get the most recently used session of the calling thread's home
+ *       shard, or of another shard, or a prewarmed session, or create one.
+ *       Timed-out sessions that are popped are destroyed; the others are
+ *       left for _mongoc_server_session_pool_prune. On error, return NULL
+ *       and fill out @error.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+mongoc_server_session_t *
+_mongoc_server_session_pool_pop (mongoc_server_session_pool_t *pool,
+                                 int64_t timeout_minutes,
+                                 bson_error_t *error)
+{
+   mongoc_server_session_t *ss;
+   int home;
+   int i;
+
+   home = _mongoc_thread_home_shard (MONGOC_SERVER_SESSION_POOL_SHARD_BITS);
+
+   for (i = 0; i < MONGOC_SERVER_SESSION_POOL_SHARDS && pool->n_sessions;) {
+      ss = _shard_pop (pool, (home + i) % MONGOC_SERVER_SESSION_POOL_SHARDS);
+      if (!ss) {
+         i++;
+         continue;
+      }
+
+      if (!_mongoc_server_session_timed_out (ss, timeout_minutes)) {
+         return ss;
+      }
+
+      _mongoc_server_session_destroy (ss);
+   }
+
+   ss = _fresh_pop (pool);
+   if (ss) {
+      return ss;
+   }
+
+   return _mongoc_server_session_new (error);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_server_session_pool_push --
+ *
+ *       Return a server session to the calling thread's home shard, unless
+ *       it is timed out or dirty (a network error occurred on it). Only
+ *       sessions the server is aware of are pooled; a never-used session
+ *       replenishes the prewarmed sessions if they run short.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+_mongoc_server_session_pool_push (mongoc_server_session_pool_t *pool,
+                                  mongoc_server_session_t *server_session,
+                                  int64_t timeout_minutes)
+{
+   mongoc_server_session_pool_shard_t *shard;
+
+   if (server_session->dirty ||
+       _mongoc_server_session_timed_out (server_session, timeout_minutes)) {
+      _mongoc_server_session_destroy (server_session);
+      return;
+   }
+
+   if (server_session->last_used_usec == SESSION_NEVER_USED) {
+      bson_mutex_lock (&pool->fresh_mutex);
+      if (pool->n_fresh < pool->n_prewarmed) {
+         CDL_PREPEND (pool->fresh, server_session);
+         pool->n_fresh++;
+         server_session = NULL;
+      }
+      bson_mutex_unlock (&pool->fresh_mutex);
+
+      if (server_session) {
+         _mongoc_server_session_destroy (server_session);
+      }
+
+      return;
+   }
+
+   shard = &pool->shards[_mongoc_thread_home_shard (
+      MONGOC_SERVER_SESSION_POOL_SHARD_BITS)];
+
+   bson_mutex_lock (&shard->mutex);
+   CDL_PREPEND (shard->sessions, server_session);
+   bson_atomic_int_add (&pool->n_sessions, 1);
+   bson_mutex_unlock (&shard->mutex);
+}
+
+
+/* Remove and return any pooled session, or NULL. */
+mongoc_server_session_t *
+_mongoc_server_session_pool_take (mongoc_server_session_pool_t *pool)
+{
+   mongoc_server_session_t *ss;
+   int i;
+
+   for (i = 0; i < MONGOC_SERVER_SESSION_POOL_SHARDS; i++) {
+      ss = _shard_pop (pool, i);
+      if (ss) {
+         return ss;
+      }
+   }
+
+   return NULL;
+}
+
+
+/* True if no session the server is aware of is pooled. */
+bool
+_mongoc_server_session_pool_is_empty (const mongoc_server_session_pool_t *pool)
+{
+   return pool->n_sessions == 0;
+}
+
+
+/* True if the pool has not been pruned for a while. */
+bool
+_mongoc_server_session_pool_prune_due (
+   const mongoc_server_session_pool_t *pool)
+{
+   return _now_sec () - pool->last_prune_sec >=
+          MONGOC_SERVER_SESSION_POOL_PRUNE_INTERVAL_SEC;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_server_session_pool_prune --
+ *
+ *       Destroy sessions that timed out while pooled. Each shard's oldest
+ *       sessions are at its back, so stop at the first one that has not
+ *       timed out.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+_mongoc_server_session_pool_prune (mongoc_server_session_pool_t *pool,
+                                   int64_t timeout_minutes)
+{
+   mongoc_server_session_pool_shard_t *shard;
+   mongoc_server_session_t *ss;
+   mongoc_server_session_t *reaped;
+   mongoc_server_session_t *tmp1, *tmp2;
+   int i;
+
+   pool->last_prune_sec = _now_sec ();
+
+   for (i = 0; i < MONGOC_SERVER_SESSION_POOL_SHARDS; i++) {
+      shard = &pool->shards[i];
+      reaped = NULL;
+
+      bson_mutex_lock (&shard->mutex);
+      while (shard->sessions) {
+         ss = shard->sessions->prev;
+         if (!_mongoc_server_session_timed_out (ss, timeout_minutes)) {
+            break;
+         }
+
+         CDL_DELETE (shard->sessions, ss);
+         bson_atomic_int_add (&pool->n_sessions, -1);
+         CDL_PREPEND (reaped, ss);
+      }
+      bson_mutex_unlock (&shard->mutex);
+
+      CDL_FOREACH_SAFE (reaped, ss, tmp1, tmp2)
+      {
+         _mongoc_server_session_destroy (ss);
+      }
+   }
+}
+
+
+/* Generate sessions until "prewarmedSessions" are ready to hand out. The
+ * random ids are generated without holding a lock. */
+void
+_mongoc_server_session_pool_prewarm (mongoc_server_session_pool_t *pool)
+{
+   mongoc_server_session_t *ss;
+   bson_error_t error;
+   int32_t n;
+
+   for (;;) {
+      bson_mutex_lock (&pool->fresh_mutex);
+      n = pool->n_prewarmed - pool->n_fresh;
+      bson_mutex_unlock (&pool->fresh_mutex);
+
+      if (n <= 0) {
+         return;
+      }
+
+      while (n-- > 0) {
+         ss = _mongoc_server_session_new (&error);
+         if (!ss) {
+            MONGOC_DEBUG ("could not prewarm session: %s", error.message);
+            return;
+         }
+
+         /* push checks the count again */
+         _mongoc_server_session_pool_push (pool, ss, MONGOC_NO_SESSIONS);
+      }
+   }
+}
+
+
+/* Destroy all sessions without sending endSessions. */
+void
+_mongoc_server_session_pool_clear (mongoc_server_session_pool_t *pool)
+{
+   mongoc_server_session_pool_shard_t *shard;
+   mongoc_server_session_t *ss, *tmp1, *tmp2;
+   int i;
+
+   for (i = 0; i < MONGOC_SERVER_SESSION_POOL_SHARDS; i++) {
+      shard = &pool->shards[i];
+      bson_mutex_lock (&shard->mutex);
+      CDL_FOREACH_SAFE (shard->sessions, ss, tmp1, tmp2)
+      {
+         _mongoc_server_session_destroy (ss);
+         bson_atomic_int_add (&pool->n_sessions, -1);
+      }
+      shard->sessions = NULL;
+      bson_mutex_unlock (&shard->mutex);
+   }
+
+   bson_mutex_lock (&pool->fresh_mutex);
+   CDL_FOREACH_SAFE (pool->fresh, ss, tmp1, tmp2)
+   {
+      _mongoc_server_session_destroy (ss);
+   }
+   pool->fresh = NULL;
+   pool->n_fresh = 0;
+   bson_mutex_unlock (&pool->fresh_mutex);
+}
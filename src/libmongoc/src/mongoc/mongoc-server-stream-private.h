@@ -29,11 +29,21 @@
 
 BSON_BEGIN_DECLS
 
+struct _mongoc_topology_snapshot_t;
+
 typedef struct _mongoc_server_stream_t {
    mongoc_topology_description_type_t topology_type;
-   mongoc_server_description_t *sd; /* owned */
-   bson_t cluster_time;             /* owned */
-   mongoc_stream_t *stream;         /* borrowed */
+   /* owned, or borrowed from the snapshot if snapshot is set */
+   mongoc_server_description_t *sd;
+   bson_t cluster_time;     /* owned */
+   mongoc_stream_t *stream; /* borrowed */
+   /* borrowed, set if stream was checked out of the connection pool */
+   struct _mongoc_cluster_t *cluster;
+   /* owned reference, set if sd is read-only */
+   struct _mongoc_topology_snapshot_t *snapshot;
+   /* if snapshot is set, when the stream was created, to measure sd->load.
+    * 0 if the operation's latency is recorded elsewhere */
+   int64_t start_usec;
 } mongoc_server_stream_t;
 
 
@@ -42,6 +52,13 @@ mongoc_server_stream_new (const mongoc_topology_description_t *td,
                           mongoc_server_description_t *sd,
                           mongoc_stream_t *stream);
 
+mongoc_server_stream_t *
+mongoc_server_stream_new_from_snapshot (
+   struct _mongoc_topology_snapshot_t *snapshot,
+   mongoc_server_description_t *sd,
+   bson_t *cluster_time,
+   mongoc_stream_t *stream);
+
 int32_t
 mongoc_server_stream_max_bson_obj_size (mongoc_server_stream_t *server_stream);
 
@@ -17,6 +17,7 @@
 
 #include "mongoc-cluster-private.h"
 #include "mongoc-server-stream-private.h"
+#include "mongoc-topology-private.h"
 #include "mongoc-util-private.h"
 
 #undef MONGOC_LOG_DOMAIN
@@ -37,6 +38,40 @@ mongoc_server_stream_new (const mongoc_topology_description_t *td,
    bson_copy_to (&td->cluster_time, &server_stream->cluster_time);
    server_stream->sd = sd;         /* becomes owned */
    server_stream->stream = stream; /* merely borrowed */
+   server_stream->cluster = NULL;
+   server_stream->snapshot = NULL;
+
+   return server_stream;
+}
+
+
+/* a server stream that reads @sd from @snapshot instead of copying it. the
+ * stream takes ownership of the caller's reference to @snapshot, and steals
+ * @cluster_time */
+mongoc_server_stream_t *
+mongoc_server_stream_new_from_snapshot (mongoc_topology_snapshot_t *snapshot,
+                                        mongoc_server_description_t *sd,
+                                        bson_t *cluster_time,
+                                        mongoc_stream_t *stream)
+{
+   mongoc_server_stream_t *server_stream;
+
+   BSON_ASSERT (snapshot);
+   BSON_ASSERT (sd);
+   BSON_ASSERT (stream);
+
+   server_stream = bson_malloc (sizeof (mongoc_server_stream_t));
+   server_stream->topology_type = snapshot->description.type;
+   bson_steal (&server_stream->cluster_time, cluster_time);
+   server_stream->sd = sd;
+   server_stream->stream = stream;
+   server_stream->cluster = NULL;
+   server_stream->snapshot = snapshot;
+   server_stream->start_usec = bson_get_monotonic_time ();
+
+   if (sd->load) {
+      _mongoc_server_load_begin (sd->load);
+   }
 
    return server_stream;
 }
@@ -45,7 +80,24 @@ void
 mongoc_server_stream_cleanup (mongoc_server_stream_t *server_stream)
 {
    if (server_stream) {
-      mongoc_server_description_destroy (server_stream->sd);
+      if (server_stream->cluster) {
+         mongoc_cluster_release_stream (server_stream->cluster, server_stream);
+      }
+
+      if (server_stream->snapshot) {
+         if (server_stream->sd->load) {
+            _mongoc_server_load_end (
+               server_stream->sd->load,
+               server_stream->start_usec
+                  ? bson_get_monotonic_time () - server_stream->start_usec
+                  : -1);
+         }
+
+         _mongoc_topology_snapshot_release (server_stream->snapshot);
+      } else {
+         mongoc_server_description_destroy (server_stream->sd);
+      }
+
       bson_destroy (&server_stream->cluster_time);
       bson_free (server_stream);
    }
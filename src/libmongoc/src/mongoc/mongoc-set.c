@@ -71,11 +71,12 @@ mongoc_set_add (mongoc_set_t *set, uint32_t id, void *item)
    }
 }
 
-void
-mongoc_set_rm (mongoc_set_t *set, uint32_t id)
+static void *
+_mongoc_set_rm (mongoc_set_t *set, uint32_t id, bool destroy)
 {
    mongoc_set_item_t *ptr;
    mongoc_set_item_t key;
+   void *item = NULL;
    int i;
 
    key.id = id;
@@ -84,8 +85,11 @@ mongoc_set_rm (mongoc_set_t *set, uint32_t id)
       &key, set->items, set->items_len, sizeof (key), mongoc_set_id_cmp);
 
    if (ptr) {
-      if (set->dtor) {
+      item = ptr->item;
+
+      if (destroy && set->dtor) {
          set->dtor (ptr->item, set->dtor_ctx);
+         item = NULL;
       }
 
       i = ptr - set->items;
@@ -98,6 +102,20 @@ mongoc_set_rm (mongoc_set_t *set, uint32_t id)
 
       set->items_len--;
    }
+
+   return item;
+}
+
+void
+mongoc_set_rm (mongoc_set_t *set, uint32_t id)
+{
+   _mongoc_set_rm (set, id, true);
+}
+
+void *
+mongoc_set_steal (mongoc_set_t *set, uint32_t id)
+{
+   return _mongoc_set_rm (set, id, false);
 }
 
 void *
@@ -39,6 +39,17 @@ mongoc_socket_accept_ex (mongoc_socket_t *sock,
                          int64_t expire_at,
                          uint16_t *port);
 
+/* how long each connection attempt waits before starting the next. */
+#define MONGOC_HAPPY_EYEBALLS_DELAY_MS 250
+
+mongoc_socket_t *
+mongoc_socket_connect_any (const struct addrinfo *addrs,
+                           int64_t delay_ms,
+                           int64_t expire_at);
+
+bool
+_mongoc_socket_connected (mongoc_socket_t *sock);
+
 BSON_END_DECLS
 
 #endif /* MONGOC_SOCKET_PRIVATE_H */
@@ -896,6 +896,136 @@ mongoc_socket_connect (mongoc_socket_t *sock,       /* IN */
 }
 
 
+/* true if a non-blocking connect on @sock completed without error. */
+bool
+_mongoc_socket_connected (mongoc_socket_t *sock)
+{
+   int optval = -1;
+   mongoc_socklen_t optlen = (mongoc_socklen_t) sizeof optval;
+
+   if (getsockopt (sock->sd, SOL_SOCKET, SO_ERROR, (char *) &optval, &optlen) ||
+       optval != 0) {
+      errno = sock->errno_ = optval;
+      return false;
+   }
+
+   return true;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_socket_connect_any --
+ *
+ *       Connect to the first reachable address in @addrs, racing connection
+ *       attempts as described in RFC 6555 ("Happy Eyeballs"). Addresses
+ *       are tried in order; each waits @delay_ms for the previous
+ *       attempts, or starts as soon as they all fail. The first attempt to
+ *       connect wins and the others are closed.
+ *
+ * Returns:
+ *       A connected socket, or NULL if every attempt failed or
+ *       @expire_at passed.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+mongoc_socket_t *
+mongoc_socket_connect_any (const struct addrinfo *addrs, /* IN */
+                           int64_t delay_ms,              /* IN */
+                           int64_t expire_at)             /* IN */
+{
+   const struct addrinfo *next;
+   mongoc_socket_poll_t *pending;
+   mongoc_socket_t *sock;
+   mongoc_socket_t *winner = NULL;
+   size_t n_addrs = 0;
+   size_t n_pending = 0;
+   int64_t next_start;
+   int64_t now;
+   int64_t until;
+   size_t i;
+
+   ENTRY;
+
+   for (next = addrs; next; next = next->ai_next) {
+      n_addrs++;
+   }
+
+   pending = bson_malloc0 (sizeof (mongoc_socket_poll_t) * n_addrs);
+   next = addrs;
+   next_start = bson_get_monotonic_time ();
+
+   while (!winner) {
+      now = bson_get_monotonic_time ();
+      if (now >= expire_at) {
+         break;
+      }
+
+      if (next && (now >= next_start || n_pending == 0)) {
+         sock = mongoc_socket_new (
+            next->ai_family, next->ai_socktype, next->ai_protocol);
+         if (sock) {
+            if (0 == mongoc_socket_connect (sock,
+                                            next->ai_addr,
+                                            (mongoc_socklen_t) next->ai_addrlen,
+                                            0)) {
+               winner = sock;
+            } else if (_mongoc_socket_errno_is_again (sock)) {
+               pending[n_pending].socket = sock;
+               pending[n_pending].events = POLLOUT;
+               n_pending++;
+            } else {
+               mongoc_socket_destroy (sock);
+            }
+         }
+
+         next = next->ai_next;
+         next_start = now + delay_ms * 1000;
+         continue;
+      }
+
+      if (n_pending == 0) {
+         /* every address failed. */
+         break;
+      }
+
+      until = next ? BSON_MIN (next_start, expire_at) : expire_at;
+      /* round up, so less than 1ms remaining doesn't poll for 0ms. */
+      if (mongoc_socket_poll (pending,
+                              n_pending,
+                              (int32_t) ((until - now + 999) / 1000)) < 0) {
+         break;
+      }
+
+      for (i = 0; i < n_pending;) {
+         if (!pending[i].revents) {
+            i++;
+            continue;
+         }
+
+         sock = pending[i].socket;
+         pending[i] = pending[--n_pending];
+         if (!winner && _mongoc_socket_connected (sock)) {
+            winner = sock;
+         } else {
+            mongoc_socket_destroy (sock);
+            /* don't wait to start the next attempt. */
+            next_start = now;
+         }
+      }
+   }
+
+   for (i = 0; i < n_pending; i++) {
+      mongoc_socket_destroy (pending[i].socket);
+   }
+
+   bson_free (pending);
+   RETURN (winner);
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -20,6 +20,7 @@
 #define MONGOC_SSL_PRIVATE_H
 
 #include <bson/bson.h>
+#include "mongoc-config.h"
 #include "mongoc-uri-private.h"
 
 
@@ -28,6 +29,11 @@ BSON_BEGIN_DECLS
 typedef struct {
    bool tls_disable_certificate_revocation_check;
    bool tls_disable_ocsp_endpoint_check;
+   bool tls_kernel_offload;
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+   /* the SSL_CTX shared by streams created with these options, or NULL. */
+   struct _mongoc_openssl_shared_ctx_t *openssl_ctx;
+#endif
 } _mongoc_internal_tls_opts_t;
 
 char *
@@ -42,6 +48,15 @@ _mongoc_ssl_opts_copy_to (const mongoc_ssl_opt_t *src,
                           mongoc_ssl_opt_t *dst,
                           bool copy_internal);
 
+void
+_mongoc_ssl_opts_set_internal (mongoc_ssl_opt_t *opt,
+                               const _mongoc_internal_tls_opts_t *internal);
+
+void
+_mongoc_ssl_opts_share_ctx (const mongoc_ssl_opt_t *src,
+                            mongoc_ssl_opt_t *dst,
+                            bool client);
+
 bool
 _mongoc_ssl_opts_disable_certificate_revocation_check (
    const mongoc_ssl_opt_t *ssl_opt);
@@ -49,6 +64,9 @@ _mongoc_ssl_opts_disable_certificate_revocation_check (
 bool
 _mongoc_ssl_opts_disable_ocsp_endpoint_check (const mongoc_ssl_opt_t *ssl_opt);
 
+bool
+_mongoc_ssl_opts_kernel_offload (const mongoc_ssl_opt_t *ssl_opt);
+
 void
 _mongoc_ssl_opts_cleanup (mongoc_ssl_opt_t *opt, bool free_internal);
 
@@ -117,6 +117,8 @@ _mongoc_ssl_opts_from_uri (mongoc_ssl_opt_t *ssl_opt,
          uri, MONGOC_URI_TLSDISABLECERTIFICATEREVOCATIONCHECK, false);
    internal->tls_disable_ocsp_endpoint_check = mongoc_uri_get_option_as_bool (
       uri, MONGOC_URI_TLSDISABLEOCSPENDPOINTCHECK, false);
+   internal->tls_kernel_offload = mongoc_uri_get_option_as_bool (
+      uri, MONGOC_URI_TLSKERNELOFFLOAD, false);
 }
 
 void
@@ -140,10 +142,67 @@ _mongoc_ssl_opts_copy_to (const mongoc_ssl_opt_t *src,
          dst->internal = bson_malloc (sizeof (_mongoc_internal_tls_opts_t));
          memcpy (
             dst->internal, src->internal, sizeof (_mongoc_internal_tls_opts_t));
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+         _mongoc_openssl_shared_ctx_ref (
+            ((_mongoc_internal_tls_opts_t *) dst->internal)->openssl_ctx);
+#endif
       }
    }
 }
 
+/* Set @opt's internal options, keeping its shared TLS context. */
+void
+_mongoc_ssl_opts_set_internal (mongoc_ssl_opt_t *opt,
+                               const _mongoc_internal_tls_opts_t *internal)
+{
+   _mongoc_internal_tls_opts_t *dst;
+
+   if (!opt->internal) {
+      opt->internal = bson_malloc0 (sizeof (_mongoc_internal_tls_opts_t));
+   }
+
+   dst = (_mongoc_internal_tls_opts_t *) opt->internal;
+   dst->tls_disable_certificate_revocation_check =
+      internal->tls_disable_certificate_revocation_check;
+   dst->tls_disable_ocsp_endpoint_check =
+      internal->tls_disable_ocsp_endpoint_check;
+   dst->tls_kernel_offload = internal->tls_kernel_offload;
+}
+
+/* Give @dst the TLS context of @src, or build one from @dst for @client or
+ * server side streams. Streams created with @dst share the context instead of
+ * loading certificates per connection, and can resume TLS sessions. @src must
+ * be internal options, user options may have garbage in their padding. Does
+ * nothing if @dst has no internal options. */
+void
+_mongoc_ssl_opts_share_ctx (const mongoc_ssl_opt_t *src,
+                            mongoc_ssl_opt_t *dst,
+                            bool client)
+{
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+   _mongoc_internal_tls_opts_t *src_internal;
+   _mongoc_internal_tls_opts_t *dst_internal;
+   mongoc_openssl_shared_ctx_t *shared;
+
+   if (!dst->internal) {
+      return;
+   }
+
+   src_internal = (_mongoc_internal_tls_opts_t *) src->internal;
+   if (src_internal && src_internal->openssl_ctx &&
+       src_internal->openssl_ctx->client == client) {
+      shared = _mongoc_openssl_shared_ctx_ref (src_internal->openssl_ctx);
+   } else {
+      /* if this fails, each stream reports the error when it is created. */
+      shared = _mongoc_openssl_shared_ctx_new (dst, client);
+   }
+
+   dst_internal = (_mongoc_internal_tls_opts_t *) dst->internal;
+   _mongoc_openssl_shared_ctx_release (dst_internal->openssl_ctx);
+   dst_internal->openssl_ctx = shared;
+#endif
+}
+
 void
 _mongoc_ssl_opts_cleanup (mongoc_ssl_opt_t *opt, bool free_internal)
 {
@@ -152,6 +211,14 @@ _mongoc_ssl_opts_cleanup (mongoc_ssl_opt_t *opt, bool free_internal)
    bson_free ((char *) opt->ca_file);
    bson_free ((char *) opt->ca_dir);
    bson_free ((char *) opt->crl_file);
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+   if (opt->internal) {
+      /* the context was built from the options being cleaned up. */
+      _mongoc_openssl_shared_ctx_release (
+         ((_mongoc_internal_tls_opts_t *) opt->internal)->openssl_ctx);
+      ((_mongoc_internal_tls_opts_t *) opt->internal)->openssl_ctx = NULL;
+   }
+#endif
    if (free_internal) {
       bson_free (opt->internal);
    }
@@ -178,5 +245,15 @@ _mongoc_ssl_opts_disable_ocsp_endpoint_check (const mongoc_ssl_opt_t *ssl_opt)
       ->tls_disable_ocsp_endpoint_check;
 }
 
+bool
+_mongoc_ssl_opts_kernel_offload (const mongoc_ssl_opt_t *ssl_opt)
+{
+   if (!ssl_opt->internal) {
+      return false;
+   }
+   return ((_mongoc_internal_tls_opts_t *) ssl_opt->internal)
+      ->tls_kernel_offload;
+}
+
 
 #endif
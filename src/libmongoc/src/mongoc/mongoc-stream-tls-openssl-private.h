@@ -21,6 +21,10 @@
 
 #ifdef MONGOC_ENABLE_SSL_OPENSSL
 #include <bson/bson.h>
+#include <openssl/bio.h>
+#include <openssl/ssl.h>
+
+#include "mongoc-stream.h"
 
 BSON_BEGIN_DECLS
 
@@ -45,10 +49,18 @@ mongoc_openssl_ocsp_opt_destroy (void *ocsp_opt);
 typedef struct {
    BIO *bio;
    BIO_METHOD *meth;
-   SSL_CTX *ctx;
+   struct _mongoc_openssl_shared_ctx_t *ctx;
    mongoc_openssl_ocsp_opt_t *ocsp_opts;
+   /* the host a client connects to, keys the sessions to resume. */
+   char *host;
+   /* the SSL reads and writes the socket directly, so the kernel can
+    * encrypt and decrypt records (tlsKernelOffload). */
+   bool socket_bio;
 } mongoc_stream_tls_openssl_t;
 
+int
+_mongoc_stream_tls_openssl_get_kernel_offload (mongoc_stream_t *stream);
+
 
 BSON_END_DECLS
 
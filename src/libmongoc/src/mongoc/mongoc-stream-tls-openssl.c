@@ -33,6 +33,8 @@
 #include "mongoc-ssl-private.h"
 #include "mongoc-stream-tls.h"
 #include "mongoc-stream-private.h"
+#include "mongoc-stream-socket.h"
+#include "mongoc-socket-private.h"
 #include "mongoc-stream-tls-private.h"
 #include "mongoc-stream-tls-openssl-bio-private.h"
 #include "mongoc-stream-tls-openssl-private.h"
@@ -93,9 +95,11 @@ _mongoc_stream_tls_openssl_destroy (mongoc_stream_t *stream)
    mongoc_stream_destroy (tls->base_stream);
    tls->base_stream = NULL;
 
-   SSL_CTX_free (openssl->ctx);
+   _mongoc_openssl_shared_ctx_release (openssl->ctx);
    openssl->ctx = NULL;
 
+   bson_free (openssl->host);
+
    mongoc_openssl_ocsp_opt_destroy (openssl->ocsp_opts);
    openssl->ocsp_opts = NULL;
 
@@ -193,6 +197,45 @@ _mongoc_stream_tls_openssl_flush (mongoc_stream_t *stream)
 }
 
 
+#ifdef MONGOC_ENABLE_KTLS_OPENSSL
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_stream_tls_openssl_wait --
+ *
+ *       With tlsKernelOffload the SSL reads and writes the non-blocking
+ *       socket directly instead of through the base stream: wait until
+ *       the socket is ready for the operation the SSL retries.
+ *
+ * Returns:
+ *       false if @expire passed first. @expire is a monotonic time, or 0
+ *       to wait forever.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_mongoc_stream_tls_openssl_wait (mongoc_stream_tls_t *tls, int64_t expire)
+{
+   mongoc_stream_tls_openssl_t *openssl =
+      (mongoc_stream_tls_openssl_t *) tls->ctx;
+   mongoc_stream_poll_t poller;
+   int32_t timeout_msec = -1;
+
+   if (expire) {
+      timeout_msec = (int32_t) BSON_MAX (
+         0, (expire - bson_get_monotonic_time ()) / 1000L);
+   }
+
+   poller.stream = tls->base_stream;
+   poller.events = BIO_should_read (openssl->bio) ? POLLIN : POLLOUT;
+   poller.revents = 0;
+
+   return mongoc_stream_poll (&poller, 1, timeout_msec) > 0;
+}
+#endif
+
+
 static ssize_t
 _mongoc_stream_tls_openssl_write (mongoc_stream_tls_t *tls,
                                   char *buf,
@@ -215,6 +258,13 @@ _mongoc_stream_tls_openssl_write (mongoc_stream_tls_t *tls,
 
    ret = BIO_write (openssl->bio, buf, buf_len);
 
+#ifdef MONGOC_ENABLE_KTLS_OPENSSL
+   while (ret <= 0 && openssl->socket_bio && BIO_should_retry (openssl->bio) &&
+          _mongoc_stream_tls_openssl_wait (tls, expire)) {
+      ret = BIO_write (openssl->bio, buf, buf_len);
+   }
+#endif
+
    if (ret <= 0) {
       return ret;
    }
@@ -442,6 +492,19 @@ _mongoc_stream_tls_openssl_readv (mongoc_stream_t *stream,
                               (char *) iov[i].iov_base + iov_pos,
                               (int) (iov[i].iov_len - iov_pos));
 
+#ifdef MONGOC_ENABLE_KTLS_OPENSSL
+         if (read_ret <= 0 && openssl->socket_bio &&
+             BIO_should_retry (openssl->bio)) {
+            if (_mongoc_stream_tls_openssl_wait (tls, expire)) {
+               continue;
+            }
+
+            mongoc_counter_streams_timeout_inc ();
+            errno = ETIMEDOUT;
+            RETURN (-1);
+         }
+#endif
+
          /* https://www.openssl.org/docs/crypto/BIO_should_retry.html:
           *
           * If BIO_should_retry() returns false then the precise "error
@@ -543,6 +606,43 @@ _mongoc_stream_tls_openssl_check_closed (mongoc_stream_t *stream) /* IN */
 }
 
 
+#ifdef MONGOC_ENABLE_OCSP_OPENSSL
+/* Check the peer's OCSP status after a handshake. A resumed session is
+ * checked against the OCSP cache, a full handshake validates the status and
+ * records it for later resumptions. */
+static bool
+_mongoc_stream_tls_openssl_check_ocsp (mongoc_stream_tls_openssl_t *openssl,
+                                       SSL *ssl)
+{
+   OCSP_CERTID *peer_id = NULL;
+   bool ret;
+
+   if (SSL_session_reused (ssl)) {
+      ret = openssl->host && _mongoc_openssl_shared_ctx_ocsp_check_resumed (
+                                openssl->ctx, openssl->host);
+   } else {
+      ret = 1 == _mongoc_ocsp_tlsext_status (ssl, openssl->ocsp_opts, &peer_id);
+      if (ret && openssl->host) {
+         _mongoc_openssl_shared_ctx_ocsp_validated (
+            openssl->ctx, openssl->host, peer_id);
+         peer_id = NULL;
+      }
+   }
+
+   if (!ret && openssl->host) {
+      /* do not resume a session with this certificate */
+      _mongoc_openssl_shared_ctx_forget (openssl->ctx, openssl->host);
+   }
+
+   if (peer_id) {
+      OCSP_CERTID_free (peer_id);
+   }
+
+   return ret;
+}
+#endif
+
+
 /**
  * mongoc_stream_tls_openssl_handshake:
  */
@@ -566,10 +666,23 @@ _mongoc_stream_tls_openssl_handshake (mongoc_stream_t *stream,
    if (BIO_do_handshake (openssl->bio) == 1) {
       *events = 0;
 
+      if (openssl->socket_bio) {
+         TRACE ("kTLS offload flags: %d",
+                _mongoc_stream_tls_openssl_get_kernel_offload (stream));
+      }
+
+      if (openssl->ctx->client) {
+         if (SSL_session_reused (ssl)) {
+            mongoc_counter_tls_sessions_resumed_inc ();
+         } else {
+            mongoc_counter_tls_handshakes_full_inc ();
+         }
+      }
+
 #ifdef MONGOC_ENABLE_OCSP_OPENSSL
       /* Validate OCSP */
       if (openssl->ocsp_opts &&
-          1 != _mongoc_ocsp_tlsext_status (ssl, openssl->ocsp_opts)) {
+          !_mongoc_stream_tls_openssl_check_ocsp (openssl, ssl)) {
          bson_set_error (error,
                          MONGOC_ERROR_STREAM,
                          MONGOC_ERROR_STREAM_SOCKET,
@@ -615,27 +728,6 @@ _mongoc_stream_tls_openssl_handshake (mongoc_stream_t *stream,
    RETURN (false);
 }
 
-/* Callback to get the client provided SNI, if any
- * It is only called in SSL "server mode" (e.g. when using the Mock Server),
- * and we don't actually use the hostname for anything, just debug print it
- */
-static int
-_mongoc_stream_tls_openssl_sni (SSL *ssl, int *ad, void *arg)
-{
-   const char *hostname;
-
-   if (ssl == NULL) {
-      TRACE ("%s", "No SNI hostname provided");
-      return SSL_TLSEXT_ERR_NOACK;
-   }
-
-   hostname = SSL_get_servername (ssl, TLSEXT_NAMETYPE_host_name);
-   /* This is intentionally debug since its only used by the mock test server */
-   MONGOC_DEBUG ("Got SNI: '%s'", hostname);
-
-   return SSL_TLSEXT_ERR_OK;
-}
-
 static bool
 _mongoc_stream_tls_openssl_timed_out (mongoc_stream_t *stream)
 {
@@ -694,26 +786,71 @@ mongoc_stream_tls_openssl_new (mongoc_stream_t *base_stream,
    mongoc_stream_tls_t *tls;
    mongoc_stream_tls_openssl_t *openssl;
    mongoc_openssl_ocsp_opt_t *ocsp_opts = NULL;
-   SSL_CTX *ssl_ctx = NULL;
+   mongoc_openssl_shared_ctx_t *ssl_ctx;
+   _mongoc_internal_tls_opts_t *internal;
+   SSL *ssl;
    BIO *bio_ssl = NULL;
-   BIO *bio_mongoc_shim = NULL;
-   BIO_METHOD *meth;
+   BIO *bio_transport = NULL;
+   BIO_METHOD *meth = NULL;
+   bool socket_bio = false;
 
    BSON_ASSERT (base_stream);
    BSON_ASSERT (opt);
    ENTRY;
 
-   ssl_ctx = _mongoc_openssl_ctx_new (opt);
+   /* use the SSL_CTX the client or pool built from @opt, if any */
+   internal = (_mongoc_internal_tls_opts_t *) opt->internal;
+   if (internal && internal->openssl_ctx &&
+       internal->openssl_ctx->client == !!client) {
+      ssl_ctx = _mongoc_openssl_shared_ctx_ref (internal->openssl_ctx);
+   } else {
+      ssl_ctx = _mongoc_openssl_shared_ctx_new (opt, !!client);
+   }
 
    if (!ssl_ctx) {
       RETURN (NULL);
    }
 
+   bio_ssl = BIO_new_ssl (ssl_ctx->ctx, client);
+   if (!bio_ssl) {
+      _mongoc_openssl_shared_ctx_release (ssl_ctx);
+      RETURN (NULL);
+   }
+
+   BIO_get_ssl (bio_ssl, &ssl);
+
+#ifdef MONGOC_ENABLE_KTLS_OPENSSL
+   if (client && _mongoc_ssl_opts_kernel_offload (opt) &&
+       base_stream->type == MONGOC_STREAM_SOCKET) {
+      /* OpenSSL only enables kTLS on a socket BIO. If the kernel or the
+       * negotiated cipher can't do it, OpenSSL encrypts records itself. */
+      mongoc_socket_t *sock = mongoc_stream_socket_get_socket (
+         (mongoc_stream_socket_t *) base_stream);
+
+      bio_transport = BIO_new_socket (sock->sd, BIO_NOCLOSE);
+      SSL_set_options (ssl, SSL_OP_ENABLE_KTLS);
+      socket_bio = true;
+   }
+#endif
+
+   if (!socket_bio) {
+      meth = mongoc_stream_tls_openssl_bio_meth_new ();
+      bio_transport = BIO_new (meth);
+   }
+
+   if (!bio_transport) {
+      BIO_free_all (bio_ssl);
+      BIO_meth_free (meth);
+      _mongoc_openssl_shared_ctx_release (ssl_ctx);
+      RETURN (NULL);
+   }
+
 #if OPENSSL_VERSION_NUMBER >= 0x10002000L && !defined(LIBRESSL_VERSION_NUMBER)
+   /* the expected host is set per connection, the context is shared */
    if (!opt->allow_invalid_hostname) {
       struct in_addr addr;
       struct in6_addr addr6;
-      X509_VERIFY_PARAM *param = X509_VERIFY_PARAM_new ();
+      X509_VERIFY_PARAM *param = SSL_get0_param (ssl);
 
       X509_VERIFY_PARAM_set_hostflags (param,
                                        X509_CHECK_FLAG_NO_PARTIAL_WILDCARDS);
@@ -723,57 +860,22 @@ mongoc_stream_tls_openssl_new (mongoc_stream_t *base_stream,
       } else {
          X509_VERIFY_PARAM_set1_host (param, host, 0);
       }
-      SSL_CTX_set1_param (ssl_ctx, param);
-      X509_VERIFY_PARAM_free (param);
    }
 #endif
 
-   if (!client) {
-      /* Only used by the Mock Server.
-       * Set a callback to get the SNI, if provided */
-      SSL_CTX_set_tlsext_servername_callback (ssl_ctx,
-                                              _mongoc_stream_tls_openssl_sni);
-   }
-
-   if (opt->weak_cert_validation) {
-      SSL_CTX_set_verify (ssl_ctx, SSL_VERIFY_NONE, NULL);
-   } else {
-      SSL_CTX_set_verify (ssl_ctx, SSL_VERIFY_PEER, NULL);
-   }
-
-   bio_ssl = BIO_new_ssl (ssl_ctx, client);
-   if (!bio_ssl) {
-      SSL_CTX_free (ssl_ctx);
-      RETURN (NULL);
-   }
-   meth = mongoc_stream_tls_openssl_bio_meth_new ();
-   bio_mongoc_shim = BIO_new (meth);
-   if (!bio_mongoc_shim) {
-      BIO_free_all (bio_ssl);
-      BIO_meth_free (meth);
-      SSL_CTX_free (ssl_ctx);
-      RETURN (NULL);
-   }
-
 /* Added in OpenSSL 0.9.8f, as a build time option */
 #ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
    if (client) {
-      SSL *ssl;
       /* Set the SNI hostname we are expecting certificate for */
-      BIO_get_ssl (bio_ssl, &ssl);
       SSL_set_tlsext_host_name (ssl, host);
 #endif
    }
 
-   BIO_push (bio_ssl, bio_mongoc_shim);
+   BIO_push (bio_ssl, bio_transport);
 
 #ifdef MONGOC_ENABLE_OCSP_OPENSSL
    if (client && !opt->weak_cert_validation &&
        !_mongoc_ssl_opts_disable_certificate_revocation_check (opt)) {
-      SSL *ssl;
-
-      BIO_get_ssl (bio_ssl, &ssl);
-
       /* Set the status_request extension on the SSL object.
        * Do not use SSL_CTX_set_tlsext_status_type, since that requires OpenSSL
        * 1.1.0.
@@ -783,7 +885,7 @@ mongoc_stream_tls_openssl_new (mongoc_stream_t *base_stream,
          mongoc_openssl_ocsp_opt_destroy (ocsp_opts);
          BIO_free_all (bio_ssl);
          BIO_meth_free (meth);
-         SSL_CTX_free (ssl_ctx);
+         _mongoc_openssl_shared_ctx_release (ssl_ctx);
          RETURN (NULL);
       }
 
@@ -802,6 +904,13 @@ mongoc_stream_tls_openssl_new (mongoc_stream_t *base_stream,
    openssl->meth = meth;
    openssl->ctx = ssl_ctx;
    openssl->ocsp_opts = ocsp_opts;
+   openssl->socket_bio = socket_bio;
+
+   if (client && host) {
+      openssl->host = bson_strdup (host);
+      _mongoc_openssl_shared_ctx_resume (
+         ssl_ctx, ssl, openssl->host, ocsp_opts != NULL);
+   }
 
    tls = (mongoc_stream_tls_t *) bson_malloc0 (sizeof *tls);
    tls->parent.type = MONGOC_STREAM_TLS;
@@ -821,13 +930,62 @@ mongoc_stream_tls_openssl_new (mongoc_stream_t *base_stream,
    tls->ctx = (void *) openssl;
    tls->timeout_msec = -1;
    tls->base_stream = base_stream;
-   mongoc_stream_tls_openssl_bio_set_data (bio_mongoc_shim, tls);
+   if (!socket_bio) {
+      mongoc_stream_tls_openssl_bio_set_data (bio_transport, tls);
+   }
 
    mongoc_counter_streams_active_inc ();
 
    RETURN ((mongoc_stream_t *) tls);
 }
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_stream_tls_openssl_get_kernel_offload --
+ *
+ *       Report whether the kernel encrypts and decrypts the records of
+ *       the TLS stream @stream.
+ *
+ * Returns:
+ *       MONGOC_STREAM_TLS_KERNEL_OFFLOAD_SEND and _RECV flags, or
+ *       MONGOC_STREAM_TLS_KERNEL_OFFLOAD_NONE if tlsKernelOffload is off, the
+ *       handshake is not done, or the kernel or the negotiated cipher
+ *       don't support kTLS and OpenSSL processes the records.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+int
+_mongoc_stream_tls_openssl_get_kernel_offload (mongoc_stream_t *stream)
+{
+   int mode = MONGOC_STREAM_TLS_KERNEL_OFFLOAD_NONE;
+#ifdef MONGOC_ENABLE_KTLS_OPENSSL
+   mongoc_stream_tls_t *tls = (mongoc_stream_tls_t *) stream;
+   mongoc_stream_tls_openssl_t *openssl;
+   SSL *ssl;
+
+   BSON_ASSERT (stream);
+   BSON_ASSERT (stream->type == MONGOC_STREAM_TLS);
+
+   openssl = (mongoc_stream_tls_openssl_t *) tls->ctx;
+   if (!openssl->socket_bio) {
+      return mode;
+   }
+
+   BIO_get_ssl (openssl->bio, &ssl);
+   if (BIO_get_ktls_send (SSL_get_wbio (ssl))) {
+      mode |= MONGOC_STREAM_TLS_KERNEL_OFFLOAD_SEND;
+   }
+
+   if (BIO_get_ktls_recv (SSL_get_rbio (ssl))) {
+      mode |= MONGOC_STREAM_TLS_KERNEL_OFFLOAD_RECV;
+   }
+#endif
+
+   return mode;
+}
+
 void
 mongoc_openssl_ocsp_opt_destroy (void *ocsp_opt)
 {
@@ -30,6 +30,7 @@
 #include "mongoc-stream-private.h"
 #if defined(MONGOC_ENABLE_SSL_OPENSSL)
 #include "mongoc-stream-tls-openssl.h"
+#include "mongoc-stream-tls-openssl-private.h"
 #include "mongoc-openssl-private.h"
 #elif defined(MONGOC_ENABLE_SSL_LIBRESSL)
 #include "mongoc-libressl-private.h"
@@ -238,4 +239,40 @@ mongoc_stream_tls_new (mongoc_stream_t *base_stream,
    return mongoc_stream_tls_new_with_hostname (base_stream, NULL, opt, client);
 }
 
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_stream_tls_get_kernel_offload --
+ *
+ *       Report which directions of the TLS stream wrapped by @stream the
+ *       kernel encrypts and decrypts (kTLS).
+ *
+ * Returns:
+ *       mongoc_stream_tls_kernel_offload_t flags, or
+ *       MONGOC_STREAM_TLS_KERNEL_OFFLOAD_NONE if @stream is not a TLS
+ *       stream or OpenSSL processes its records.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+int
+mongoc_stream_tls_get_kernel_offload (mongoc_stream_t *stream)
+{
+   mongoc_stream_t *tls_stream;
+
+   BSON_ASSERT (stream);
+
+   tls_stream = mongoc_stream_get_tls_stream (stream);
+   if (!tls_stream) {
+      return MONGOC_STREAM_TLS_KERNEL_OFFLOAD_NONE;
+   }
+
+#if defined(MONGOC_ENABLE_SSL_OPENSSL)
+   return _mongoc_stream_tls_openssl_get_kernel_offload (tls_stream);
+#else
+   return MONGOC_STREAM_TLS_KERNEL_OFFLOAD_NONE;
+#endif
+}
+
 #endif
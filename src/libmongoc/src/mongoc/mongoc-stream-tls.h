@@ -30,6 +30,12 @@ BSON_BEGIN_DECLS
 
 typedef struct _mongoc_stream_tls_t mongoc_stream_tls_t;
 
+typedef enum {
+   MONGOC_STREAM_TLS_KERNEL_OFFLOAD_NONE = 0,
+   MONGOC_STREAM_TLS_KERNEL_OFFLOAD_SEND = 1 << 0,
+   MONGOC_STREAM_TLS_KERNEL_OFFLOAD_RECV = 1 << 1,
+} mongoc_stream_tls_kernel_offload_t;
+
 MONGOC_EXPORT (bool)
 mongoc_stream_tls_handshake (mongoc_stream_t *stream,
                              const char *host,
@@ -57,6 +63,8 @@ mongoc_stream_tls_new (mongoc_stream_t *base_stream,
                        mongoc_ssl_opt_t *opt,
                        int client)
    BSON_GNUC_DEPRECATED_FOR (mongoc_stream_tls_new_with_hostname);
+MONGOC_EXPORT (int)
+mongoc_stream_tls_get_kernel_offload (mongoc_stream_t *stream);
 
 
 BSON_END_DECLS
@@ -103,5 +103,27 @@ mongoc_cond_destroy (mongoc_cond_t *_ignored)
 }
 #endif
 
+/* Map the calling thread to one of (1 << bits) shards, for structures that
+ * spread contention over several independently locked parts. */
+static BSON_INLINE int
+_mongoc_thread_home_shard (int bits)
+{
+   uint64_t id = 0;
+#ifdef _WIN32
+   id = (uint64_t) GetCurrentThreadId ();
+#else
+   pthread_t self = pthread_self ();
+
+   memcpy (&id, &self, BSON_MIN (sizeof id, sizeof self));
+#endif
+
+   /* Fibonacci hashing: thread ids are often aligned addresses, so take the
+    * well-mixed high bits of the product rather than the low bits of the id.
+    */
+   id *= 0x9e3779b97f4a7c15ull;
+
+   return (int) (id >> (64 - bits));
+}
+
 
 #endif /* MONGOC_THREAD_PRIVATE_H */
@@ -31,6 +31,10 @@
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "monitor"
 
+/* How long the shared monitor thread waits for I/O before checking for
+ * shutdown. */
+#define MONGOC_SHARED_MONITOR_STEP_MS 100
+
 static BSON_THREAD_FUN (srv_polling_run, topology_void)
 {
    mongoc_topology_t *topology;
@@ -83,6 +87,79 @@ static BSON_THREAD_FUN (srv_polling_run, topology_void)
    BSON_THREAD_RETURN;
 }
 
+/* Check all servers from one thread with the topology scanner's nonblocking
+ * isMaster calls, for the "sharedMonitorThread" URI option. Also polls SRV
+ * records, if applicable.
+ *
+ * Holds the topology mutex except while waiting for the scanner's I/O.
+ */
+static BSON_THREAD_FUN (shared_monitor_run, topology_void)
+{
+   mongoc_topology_t *topology;
+   int64_t last_scan_ms = 0;
+
+   topology = topology_void;
+   bson_mutex_lock (&topology->mutex);
+   while (topology->scanner_state == MONGOC_TOPOLOGY_SCANNER_BG_RUNNING) {
+      int64_t now_ms;
+      int64_t due_ms;
+      bool in_progress;
+
+      now_ms = bson_get_monotonic_time () / 1000;
+      if (topology->shared_monitor_scan_requested) {
+         due_ms = last_scan_ms + topology->min_heartbeat_frequency_msec;
+      } else {
+         due_ms = last_scan_ms + topology->description.heartbeat_msec;
+      }
+
+      if (mongoc_topology_should_rescan_srv (topology)) {
+         int64_t srv_due_ms;
+
+         srv_due_ms = topology->srv_polling_last_scan_ms +
+                      topology->srv_polling_rescan_interval_ms;
+         if (srv_due_ms <= now_ms) {
+            /* Unlocks and relocks the topology mutex for the DNS lookup. */
+            mongoc_topology_rescan_srv (topology);
+            continue;
+         }
+
+         due_ms = BSON_MIN (due_ms, srv_due_ms);
+      }
+
+      if (due_ms > now_ms) {
+         mongoc_cond_timedwait (&topology->shared_monitor_cond,
+                                &topology->mutex,
+                                due_ms - now_ms);
+         continue;
+      }
+
+      topology->shared_monitor_scan_requested = false;
+      mongoc_topology_reconcile (topology);
+      mongoc_topology_scanner_start (topology->scanner, false);
+
+      /* The scanner callback locks the topology mutex to apply each reply.
+       * Step in short intervals to notice shutdown promptly. */
+      bson_mutex_unlock (&topology->mutex);
+      do {
+         in_progress = mongoc_topology_scanner_work_step (
+            topology->scanner, MONGOC_SHARED_MONITOR_STEP_MS);
+
+         bson_mutex_lock (&topology->mutex);
+         if (topology->scanner_state != MONGOC_TOPOLOGY_SCANNER_BG_RUNNING) {
+            mongoc_topology_scanner_cancel (topology->scanner);
+         }
+         bson_mutex_unlock (&topology->mutex);
+      } while (in_progress);
+
+      bson_mutex_lock (&topology->mutex);
+      _mongoc_topology_scanner_finish (topology->scanner);
+      last_scan_ms = bson_get_monotonic_time () / 1000;
+   }
+
+   bson_mutex_unlock (&topology->mutex);
+   BSON_THREAD_RETURN;
+}
+
 /* Create a server monitor if necessary.
  *
  * Called by monitor threads and application threads when reconciling the
@@ -147,6 +224,13 @@ _mongoc_topology_background_monitoring_start (mongoc_topology_t *topology)
    _mongoc_handshake_freeze ();
    _mongoc_topology_description_monitor_opening (&topology->description);
 
+   if (topology->shared_monitor_thread) {
+      /* The shared monitor thread checks servers and polls SRV records. */
+      COMMON_PREFIX (thread_create)
+      (&topology->shared_monitor, shared_monitor_run, topology);
+      return;
+   }
+
    /* Reconcile to create the first server monitors. */
    _mongoc_topology_background_monitoring_reconcile (topology);
    /* Start SRV polling thread. */
@@ -222,6 +306,11 @@ _mongoc_topology_background_monitoring_reconcile (mongoc_topology_t *topology)
       return;
    }
 
+   if (topology->shared_monitor_thread) {
+      /* The shared monitor thread reconciles scanner nodes before each scan. */
+      return;
+   }
+
    /* Add newly discovered server monitors, and update existing ones. */
    for (i = 0; i < server_descriptions->items_len; i++) {
       mongoc_server_description_t *sd;
@@ -255,6 +344,12 @@ _mongoc_topology_background_monitoring_request_scan (
       return;
    }
 
+   if (topology->shared_monitor_thread) {
+      topology->shared_monitor_scan_requested = true;
+      mongoc_cond_signal (&topology->shared_monitor_cond);
+      return;
+   }
+
    server_monitors = topology->server_monitors;
 
    for (i = 0; i < server_monitors->items_len; i++) {
@@ -297,6 +392,10 @@ _mongoc_topology_background_monitoring_stop (mongoc_topology_t *topology)
       mongoc_cond_signal (&topology->srv_polling_cond);
    }
 
+   if (topology->shared_monitor_thread) {
+      mongoc_cond_signal (&topology->shared_monitor_cond);
+   }
+
    /* Signal all server monitors to shut down. */
    for (i = 0; i < topology->server_monitors->items_len; i++) {
       server_monitor = mongoc_set_get_item (topology->server_monitors, i);
@@ -334,6 +433,10 @@ _mongoc_topology_background_monitoring_stop (mongoc_topology_t *topology)
       COMMON_PREFIX (thread_join) (topology->srv_polling_thread);
    }
 
+   if (topology->shared_monitor_thread) {
+      COMMON_PREFIX (thread_join) (topology->shared_monitor);
+   }
+
    bson_mutex_lock (&topology->mutex);
    mongoc_set_destroy (topology->server_monitors);
    mongoc_set_destroy (topology->rtt_monitors);
@@ -776,7 +776,8 @@ mongoc_topology_description_has_data_node (mongoc_topology_description_t *td)
  *      current topology, it does not retry or trigger topology checks.
  *
  *      NOTE: this method should only be called while holding the mutex on
- *      the owning topology object.
+ *      the owning topology object, since it advances @topology's
+ *      rand_seed. See _mongoc_topology_description_select.
  *
  * Returns:
  *      Selected server description, or NULL upon failure.
@@ -792,6 +793,36 @@ mongoc_topology_description_select (mongoc_topology_description_t *topology,
                                     mongoc_ss_optype_t optype,
                                     const mongoc_read_prefs_t *read_pref,
                                     int64_t local_threshold_ms)
+{
+   return _mongoc_topology_description_select (
+      topology, optype, read_pref, local_threshold_ms, &topology->rand_seed);
+}
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * _mongoc_topology_description_select --
+ *
+ *      Like mongoc_topology_description_select, but choose among suitable
+ *      servers with the caller's @rand_seed. @topology is not modified, so
+ *      threads may select from a shared, immutable topology snapshot
+ *      concurrently, each with its own seed.
+ *
+ * Returns:
+ *      Selected server description, or NULL upon failure.
+ *
+ * Side effects:
+ *      Advances @rand_seed.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+mongoc_server_description_t *
+_mongoc_topology_description_select (mongoc_topology_description_t *topology,
+                                     mongoc_ss_optype_t optype,
+                                     const mongoc_read_prefs_t *read_pref,
+                                     int64_t local_threshold_ms,
+                                     unsigned int *rand_seed)
 {
    mongoc_array_t suitable_servers;
    mongoc_server_description_t *sd = NULL;
@@ -817,7 +848,7 @@ mongoc_topology_description_select (mongoc_topology_description_t *topology,
    mongoc_topology_description_suitable_servers (
       &suitable_servers, optype, topology, read_pref, local_threshold_ms);
    if (suitable_servers.len != 0) {
-      rand_n = _mongoc_rand_simple (&topology->rand_seed);
+      rand_n = _mongoc_rand_simple (rand_seed);
       sd = _mongoc_array_index (&suitable_servers,
                                 mongoc_server_description_t *,
                                 rand_n % suitable_servers.len);
@@ -1174,6 +1205,7 @@ mongoc_topology_description_add_server (mongoc_topology_description_t *topology,
       description =
          (mongoc_server_description_t *) bson_malloc0 (sizeof *description);
       mongoc_server_description_init (description, server, server_id);
+      description->load = _mongoc_server_load_new ();
 
       mongoc_set_add (topology->servers, server_id, description);
 
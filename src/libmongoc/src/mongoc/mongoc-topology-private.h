@@ -20,6 +20,7 @@
 #define MONGOC_TOPOLOGY_PRIVATE_H
 
 #include "mongoc-config.h"
+#include "mongoc-connection-pool-private.h"
 #include "mongoc-topology-scanner-private.h"
 #include "mongoc-server-description-private.h"
 #include "mongoc-topology-description-private.h"
@@ -27,6 +28,7 @@
 #include "mongoc-uri.h"
 #include "mongoc-client-session-private.h"
 #include "mongoc-crypt-private.h"
+#include "mongoc-server-session-pool-private.h"
 
 #define MONGOC_TOPOLOGY_MIN_HEARTBEAT_FREQUENCY_MS 500
 #define MONGOC_TOPOLOGY_SOCKET_CHECK_INTERVAL_MS 5000
@@ -36,6 +38,7 @@
 #define MONGOC_TOPOLOGY_HEARTBEAT_FREQUENCY_MS_MULTI_THREADED 10000
 #define MONGOC_TOPOLOGY_HEARTBEAT_FREQUENCY_MS_SINGLE_THREADED 60000
 #define MONGOC_TOPOLOGY_MIN_RESCAN_SRV_INTERVAL_MS 60000
+#define MONGOC_TOPOLOGY_MAX_SELECTION_KEYS 16
 
 typedef enum {
    MONGOC_TOPOLOGY_SCANNER_OFF,
@@ -46,6 +49,25 @@ typedef enum {
 struct _mongoc_background_monitor_t;
 struct _mongoc_client_pool_t;
 
+/* An operation type and read preference that server selection has seen. */
+typedef struct _mongoc_topology_selection_key_t {
+   mongoc_ss_optype_t optype;
+   mongoc_read_prefs_t *read_prefs; /* owned, NULL means primary */
+} mongoc_topology_selection_key_t;
+
+/* An immutable copy of a multi-threaded topology's description. Monitors
+ * publish a new snapshot whenever they change the description; application
+ * threads select servers and build server streams from the latest snapshot
+ * without taking the topology mutex. */
+typedef struct _mongoc_topology_snapshot_t {
+   mongoc_topology_description_t description;
+   volatile int32_t refs;
+   /* suitable servers for each of the topology's first n_suitable selection
+    * keys, computed once when the snapshot is published */
+   mongoc_array_t suitable[MONGOC_TOPOLOGY_MAX_SELECTION_KEYS];
+   size_t n_suitable;
+} mongoc_topology_snapshot_t;
+
 typedef struct _mongoc_topology_t {
    mongoc_topology_description_t description;
    /* topology->uri is initialized as a copy of the client/pool's URI.
@@ -57,6 +79,8 @@ typedef struct _mongoc_topology_t {
    mongoc_uri_t *uri;
    mongoc_topology_scanner_t *scanner;
    bool server_selection_try_once;
+   /* multi-threaded only, choose the less busy of two suitable servers */
+   bool server_selection_load_aware;
 
    int64_t last_scan;
    int64_t local_threshold_msec;
@@ -73,6 +97,14 @@ typedef struct _mongoc_topology_t {
    bson_thread_t srv_polling_thread;
    mongoc_cond_t srv_polling_cond;
 
+   /* For multi-threaded with the "sharedMonitorThread" option, one thread
+    * checks all servers with the topology scanner and polls SRV records,
+    * instead of a server monitor thread and an RTT thread per server. */
+   bool shared_monitor_thread;
+   bson_thread_t shared_monitor;
+   mongoc_cond_t shared_monitor_cond;
+   bool shared_monitor_scan_requested;
+
    bson_mutex_t mutex;
    mongoc_cond_t cond_client;
    mongoc_topology_scanner_state_t scanner_state;
@@ -80,7 +112,8 @@ typedef struct _mongoc_topology_t {
    bool single_threaded;
    bool stale;
 
-   mongoc_server_session_t *session_pool;
+   /* not guarded by mutex */
+   mongoc_server_session_pool_t session_pool;
 
    /* Is client side encryption enabled? */
    bool cse_enabled;
@@ -104,6 +137,26 @@ typedef struct _mongoc_topology_t {
    mongoc_set_t *server_monitors;
    mongoc_set_t *rtt_monitors;
    bson_mutex_t apm_mutex;
+
+   /* For multi-threaded, connections shared by the pool's clients. */
+   mongoc_connection_pool_t *connection_pool;
+
+   /* For multi-threaded, the latest published snapshot of the description,
+    * and the greatest seen cluster time, which changes too often to publish
+    * a snapshot for each update. Both are guarded by snapshot_mutex, which is
+    * only held briefly to swap them or copy them out. Lock order: mutex, then
+    * snapshot_mutex. */
+   bson_mutex_t snapshot_mutex;
+   mongoc_topology_snapshot_t *snapshot;
+   bson_t snapshot_cluster_time;
+
+   /* For multi-threaded, the selection keys whose suitable servers each
+    * snapshot precomputes. Appended under mutex and never changed, so a
+    * snapshot's readers compare against its first n_suitable keys without
+    * locking. */
+   mongoc_topology_selection_key_t
+      selection_keys[MONGOC_TOPOLOGY_MAX_SELECTION_KEYS];
+   size_t n_selection_keys;
 } mongoc_topology_t;
 
 mongoc_topology_t *
@@ -193,6 +246,9 @@ _mongoc_topology_end_sessions_cmd (mongoc_topology_t *topology, bson_t *cmd);
 void
 _mongoc_topology_clear_session_pool (mongoc_topology_t *topology);
 
+void
+_mongoc_topology_prune_server_sessions (mongoc_topology_t *topology);
+
 void
 _mongoc_topology_do_blocking_scan (mongoc_topology_t *topology,
                                    bson_error_t *error);
@@ -227,6 +283,21 @@ _mongoc_topology_clear_connection_pool (mongoc_topology_t *topology,
 void
 mongoc_topology_rescan_srv (mongoc_topology_t *topology);
 
+void
+_mongoc_topology_publish_snapshot (mongoc_topology_t *topology);
+
+mongoc_topology_snapshot_t *
+_mongoc_topology_snapshot_acquire (mongoc_topology_t *topology,
+                                   bson_t *cluster_time);
+
+void
+_mongoc_topology_snapshot_release (mongoc_topology_snapshot_t *snapshot);
+
+uint32_t
+_mongoc_topology_select_hedge_server_id (mongoc_topology_t *topology,
+                                         const mongoc_read_prefs_t *read_prefs,
+                                         uint32_t exclude_id);
+
 bool
 mongoc_topology_should_rescan_srv (mongoc_topology_t *topology);
 #endif
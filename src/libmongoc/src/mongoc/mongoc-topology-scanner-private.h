@@ -24,6 +24,7 @@
 #include <bson/bson.h>
 #include "mongoc-async-private.h"
 #include "mongoc-async-cmd-private.h"
+#include "mongoc-dns-cache-private.h"
 #include "mongoc-handshake-private.h"
 #include "mongoc-host-list.h"
 #include "mongoc-apm-private.h"
@@ -64,12 +65,12 @@ typedef struct mongoc_topology_scanner_node {
    bson_error_t last_error;
 
    /* the hostname for a node may resolve to multiple DNS results.
-    * dns_results has the full list of DNS results, ordered by host preference.
+    * dns_results has the full list of DNS results, ordered by host preference,
+    * shared with application connections through the DNS cache.
     * successful_dns_result is the most recent successful DNS result.
     */
-   struct addrinfo *dns_results;
+   mongoc_dns_result_t *dns_results;
    struct addrinfo *successful_dns_result;
-   int64_t last_dns_cache;
 
    /* used by single-threaded clients to store negotiated sasl mechanisms on a
     * node. */
@@ -158,6 +159,13 @@ mongoc_topology_scanner_start (mongoc_topology_scanner_t *ts,
 void
 mongoc_topology_scanner_work (mongoc_topology_scanner_t *ts);
 
+bool
+mongoc_topology_scanner_work_step (mongoc_topology_scanner_t *ts,
+                                   int64_t max_wait_msec);
+
+void
+mongoc_topology_scanner_cancel (mongoc_topology_scanner_t *ts);
+
 void
 _mongoc_topology_scanner_finish (mongoc_topology_scanner_t *ts);
 
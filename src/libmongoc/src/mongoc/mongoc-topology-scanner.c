@@ -22,6 +22,7 @@
 #include "mongoc-topology-scanner-private.h"
 #include "mongoc-stream-private.h"
 #include "mongoc-stream-socket.h"
+#include "mongoc-socket-private.h"
 
 #include "mongoc-handshake.h"
 #include "mongoc-handshake-private.h"
@@ -42,9 +43,6 @@
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "topology_scanner"
 
-#define DNS_CACHE_TIMEOUT_MS 10 * 60 * 1000
-#define HAPPY_EYEBALLS_DELAY_MS 250
-
 /* forward declarations */
 static void
 _async_connected (mongoc_async_cmd_t *acmd);
@@ -359,7 +357,7 @@ mongoc_topology_scanner_new (
    ts->handshake_ok_to_send = false;
    ts->connect_timeout_msec = connect_timeout_msec;
    /* may be overridden for testing. */
-   ts->dns_cache_timeout_ms = DNS_CACHE_TIMEOUT_MS;
+   ts->dns_cache_timeout_ms = MONGOC_DNS_CACHE_TIMEOUT_MS;
 
    return ts;
 }
@@ -497,9 +495,7 @@ mongoc_topology_scanner_node_destroy (mongoc_topology_scanner_node_t *node,
 {
    DL_DELETE (node->ts->nodes, node);
    mongoc_topology_scanner_node_disconnect (node, failed);
-   if (node->dns_results) {
-      freeaddrinfo (node->dns_results);
-   }
+   _mongoc_dns_result_release (node->dns_results);
 
    bson_destroy (&node->speculative_auth_response);
 
@@ -656,7 +652,8 @@ _async_error_or_timeout (mongoc_async_cmd_t *acmd,
 
       /* invalidate any cached DNS results. */
       if (node->dns_results) {
-         freeaddrinfo (node->dns_results);
+         _mongoc_dns_cache_invalidate (&node->host, node->dns_results);
+         _mongoc_dns_result_release (node->dns_results);
          node->dns_results = NULL;
          node->successful_dns_result = NULL;
       }
@@ -783,59 +780,35 @@ bool
 mongoc_topology_scanner_node_setup_tcp (mongoc_topology_scanner_node_t *node,
                                         bson_error_t *error)
 {
-   struct addrinfo hints;
    struct addrinfo *iter;
-   char portstr[8];
-   mongoc_host_list_t *host;
-   int s;
+   mongoc_dns_result_t *dns_results;
    int64_t delay = 0;
-   int64_t now = bson_get_monotonic_time ();
 
    ENTRY;
 
-   host = &node->host;
-
-   /* if cached dns results are expired, flush. */
-   if (node->dns_results &&
-       (now - node->last_dns_cache) > node->ts->dns_cache_timeout_ms * 1000) {
-      freeaddrinfo (node->dns_results);
-      node->dns_results = NULL;
-      node->successful_dns_result = NULL;
+   /* if cached dns results are expired, the DNS cache looks them up again. */
+   dns_results = _mongoc_dns_cache_resolve (
+      &node->host, node->ts->dns_cache_timeout_ms, error);
+   if (!dns_results) {
+      RETURN (false);
    }
 
-   if (!node->dns_results) {
-      bson_snprintf (portstr, sizeof portstr, "%hu", host->port);
-
-      memset (&hints, 0, sizeof hints);
-      hints.ai_family = host->family;
-      hints.ai_socktype = SOCK_STREAM;
-      hints.ai_flags = 0;
-      hints.ai_protocol = 0;
-
-      s = getaddrinfo (host->host, portstr, &hints, &node->dns_results);
-
-      if (s != 0) {
-         mongoc_counter_dns_failure_inc ();
-         bson_set_error (error,
-                         MONGOC_ERROR_STREAM,
-                         MONGOC_ERROR_STREAM_NAME_RESOLUTION,
-                         "Failed to resolve '%s'",
-                         host->host);
-         RETURN (false);
-      }
-
-      mongoc_counter_dns_success_inc ();
-      node->last_dns_cache = now;
+   if (dns_results != node->dns_results) {
+      _mongoc_dns_result_release (node->dns_results);
+      node->dns_results = dns_results;
+      node->successful_dns_result = NULL;
+   } else {
+      _mongoc_dns_result_release (dns_results);
    }
 
    if (node->successful_dns_result) {
       _begin_ismaster_cmd (node, NULL, false, node->successful_dns_result, 0);
    } else {
-      LL_FOREACH2 (node->dns_results, iter, ai_next)
+      LL_FOREACH2 (node->dns_results->addrs, iter, ai_next)
       {
          _begin_ismaster_cmd (node, NULL, false, iter, delay);
          /* each subsequent DNS result will have an additional 250ms delay. */
-         delay += HAPPY_EYEBALLS_DELAY_MS;
+         delay += MONGOC_HAPPY_EYEBALLS_DELAY_MS;
       }
    }
 
@@ -1147,6 +1120,50 @@ mongoc_topology_scanner_work (mongoc_topology_scanner_t *ts)
    BSON_ASSERT (ts->async->ncmds == 0);
 }
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_topology_scanner_work_step --
+ *
+ *      Like mongoc_topology_scanner_work, but wait at most @max_wait_msec
+ *      for I/O, so a monitoring thread can check whether to stop between
+ *      steps.
+ *
+ * Returns:
+ *      True if the scan is still in progress.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+mongoc_topology_scanner_work_step (mongoc_topology_scanner_t *ts,
+                                   int64_t max_wait_msec)
+{
+   return mongoc_async_step (ts->async, max_wait_msec) > 0;
+}
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_topology_scanner_cancel --
+ *
+ *      Cancel all commands in progress. The next step of the scan ends
+ *      them with an error.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+mongoc_topology_scanner_cancel (mongoc_topology_scanner_t *ts)
+{
+   mongoc_async_cmd_t *acmd;
+
+   DL_FOREACH (ts->async->cmds, acmd)
+   {
+      acmd->state = MONGOC_ASYNC_CMD_CANCELED_STATE;
+   }
+}
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -1320,7 +1337,8 @@ _jumpstart_other_acmds (mongoc_topology_scanner_node_t *node,
       if ((mongoc_topology_scanner_node_t *) iter->data == node &&
           iter != acmd && acmd->initiate_delay_ms < iter->initiate_delay_ms) {
          iter->initiate_delay_ms =
-            BSON_MAX (iter->initiate_delay_ms - HAPPY_EYEBALLS_DELAY_MS, 0);
+            BSON_MAX (iter->initiate_delay_ms - MONGOC_HAPPY_EYEBALLS_DELAY_MS,
+                      0);
       }
    }
 }
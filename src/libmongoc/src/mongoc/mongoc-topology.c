@@ -58,7 +58,8 @@ _mongoc_topology_reconcile_add_nodes (mongoc_server_description_t *sd,
 /* Called from:
  * - the topology scanner callback (when an ismaster was just received)
  * - at the start of a single-threaded scan (mongoc_topology_scan_once)
- * Not called for multi threaded monitoring.
+ * - at the start of a scan by a client pool's shared monitor thread
+ * Not called for multi threaded monitoring with server monitor threads.
  */
 void
 mongoc_topology_reconcile (mongoc_topology_t *topology)
@@ -86,6 +87,7 @@ mongoc_topology_reconcile (mongoc_topology_t *topology)
          mongoc_topology_scanner_node_retire (ele);
       }
    }
+
 }
 
 
@@ -99,6 +101,7 @@ _mongoc_topology_update_no_lock (uint32_t id,
 {
    mongoc_topology_description_handle_ismaster (
       &topology->description, id, ismaster_response, rtt_msec, error);
+   _mongoc_topology_publish_snapshot (topology);
 
    /* return false if server removed from topology */
    return mongoc_topology_description_server_by_id (
@@ -114,6 +117,9 @@ _mongoc_topology_update_no_lock (uint32_t id,
  *       Callback method to handle errors during topology scanner node
  *       setup, typically DNS or SSL errors.
  *
+ *       NOTE: for a shared monitor thread, the caller has locked the given
+ *       topology's mutex.
+ *
  *-------------------------------------------------------------------------
  */
 
@@ -133,6 +139,7 @@ _mongoc_topology_scanner_setup_err_cb (uint32_t id,
                                                 NULL /* ismaster reply */,
                                                 -1 /* rtt_msec */,
                                                 error);
+   _mongoc_topology_publish_snapshot (topology);
 }
 
 
@@ -145,7 +152,8 @@ _mongoc_topology_scanner_setup_err_cb (uint32_t id,
  *       command objects.
  *
  *       NOTE: This method locks the given topology's mutex.
- *       Only called for single-threaded monitoring.
+ *       Only called for single-threaded monitoring, or by a client pool's
+ *       shared monitor thread.
  *
  *-------------------------------------------------------------------------
  */
@@ -164,7 +172,18 @@ _mongoc_topology_scanner_cb (uint32_t id,
 
    topology = (mongoc_topology_t *) data;
 
+   if (ismaster_response && !topology->single_threaded) {
+      /* like a server monitor, gossip the cluster time */
+      _mongoc_topology_update_cluster_time (topology, ismaster_response);
+   }
+
    bson_mutex_lock (&topology->mutex);
+   if (topology->scanner_state == MONGOC_TOPOLOGY_SCANNER_SHUTTING_DOWN) {
+      /* the shared monitor thread is canceling its last scan */
+      bson_mutex_unlock (&topology->mutex);
+      return;
+   }
+
    sd = mongoc_topology_description_server_by_id (
       &topology->description, id, NULL);
 
@@ -245,7 +264,10 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
 #endif
 
    topology = (mongoc_topology_t *) bson_malloc0 (sizeof *topology);
-   topology->session_pool = NULL;
+   _mongoc_server_session_pool_init (
+      &topology->session_pool,
+      mongoc_uri_get_option_as_int32 (uri, MONGOC_URI_PREWARMEDSESSIONS, 0));
+   _mongoc_server_session_pool_prewarm (&topology->session_pool);
    heartbeat_default =
       single_threaded ? MONGOC_TOPOLOGY_HEARTBEAT_FREQUENCY_MS_SINGLE_THREADED
                       : MONGOC_TOPOLOGY_HEARTBEAT_FREQUENCY_MS_MULTI_THREADED;
@@ -275,6 +297,10 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
          uri, MONGOC_URI_SERVERSELECTIONTRYONCE, true);
    } else {
       topology->server_selection_try_once = false;
+      topology->server_selection_load_aware = mongoc_uri_get_option_as_bool (
+         uri, MONGOC_URI_SERVERSELECTIONLOADAWARE, false);
+      topology->shared_monitor_thread = mongoc_uri_get_option_as_bool (
+         uri, MONGOC_URI_SHAREDMONITORTHREAD, false);
    }
 
    topology->server_selection_timeout_msec = mongoc_uri_get_option_as_int32 (
@@ -429,8 +455,12 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
    if (!topology->single_threaded) {
       topology->server_monitors = mongoc_set_new (1, NULL, NULL);
       topology->rtt_monitors = mongoc_set_new (1, NULL, NULL);
+      topology->connection_pool = mongoc_connection_pool_new ();
       bson_mutex_init (&topology->apm_mutex);
       mongoc_cond_init (&topology->srv_polling_cond);
+      mongoc_cond_init (&topology->shared_monitor_cond);
+      bson_mutex_init (&topology->snapshot_mutex);
+      bson_init (&topology->snapshot_cluster_time);
    }
 
    if (!topology_valid) {
@@ -447,6 +477,10 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
       hl = hl->next;
    }
 
+   /* an invalid topology has no snapshot, so server selection always takes
+    * the slow path and reports the scanner's error */
+   _mongoc_topology_publish_snapshot (topology);
+
    return topology;
 }
 /*
@@ -502,6 +536,8 @@ mongoc_topology_set_apm_callbacks (mongoc_topology_t *topology,
 void
 mongoc_topology_destroy (mongoc_topology_t *topology)
 {
+   size_t i;
+
    if (!topology) {
       return;
    }
@@ -523,8 +559,17 @@ mongoc_topology_destroy (mongoc_topology_t *topology)
       BSON_ASSERT (topology->scanner_state == MONGOC_TOPOLOGY_SCANNER_OFF);
       mongoc_set_destroy (topology->server_monitors);
       mongoc_set_destroy (topology->rtt_monitors);
+      mongoc_connection_pool_destroy (topology->connection_pool);
       bson_mutex_destroy (&topology->apm_mutex);
       mongoc_cond_destroy (&topology->srv_polling_cond);
+      mongoc_cond_destroy (&topology->shared_monitor_cond);
+      _mongoc_topology_snapshot_release (topology->snapshot);
+      bson_destroy (&topology->snapshot_cluster_time);
+      bson_mutex_destroy (&topology->snapshot_mutex);
+
+      for (i = 0; i < topology->n_selection_keys; i++) {
+         mongoc_read_prefs_destroy (topology->selection_keys[i].read_prefs);
+      }
    }
    _mongoc_topology_description_monitor_closed (&topology->description);
 
@@ -536,7 +581,7 @@ mongoc_topology_destroy (mongoc_topology_t *topology)
       _mongoc_topology_end_sessions_cmd when it dies. This removes
       sessions from the pool as it calls endSessions on them. In
       case this does not succeed, we clear the pool again here. */
-   _mongoc_topology_clear_session_pool (topology);
+   _mongoc_server_session_pool_destroy (&topology->session_pool);
 
    mongoc_cond_destroy (&topology->cond_client);
    bson_mutex_destroy (&topology->mutex);
@@ -555,7 +600,8 @@ mongoc_topology_destroy (mongoc_topology_t *topology)
  *       Nothing.
  *
  * Side effects:
- *       Server session pool will be emptied.
+ *       Server session pool will be emptied, including prewarmed sessions:
+ *       after a fork the child must not use its parent's session ids.
  *
  *--------------------------------------------------------------------------
  */
@@ -563,13 +609,7 @@ mongoc_topology_destroy (mongoc_topology_t *topology)
 void
 _mongoc_topology_clear_session_pool (mongoc_topology_t *topology)
 {
-   mongoc_server_session_t *ss, *tmp1, *tmp2;
-
-   CDL_FOREACH_SAFE (topology->session_pool, ss, tmp1, tmp2)
-   {
-      _mongoc_server_session_destroy (ss);
-   }
-   topology->session_pool = NULL;
+   _mongoc_server_session_pool_clear (&topology->session_pool);
 }
 
 /* Returns false if none of the hosts were valid. */
@@ -730,6 +770,8 @@ mongoc_topology_rescan_srv (mongoc_topology_t *topology)
       GOTO (done);
    }
 
+   _mongoc_topology_publish_snapshot (topology);
+
 done:
    bson_free (prefixed_service);
    _mongoc_host_list_destroy_all (rr_data.hosts);
@@ -925,6 +967,330 @@ mongoc_topology_select (mongoc_topology_t *topology,
    }
 }
 
+static bool
+_mongoc_topology_selection_key_matches (
+   const mongoc_topology_selection_key_t *key,
+   mongoc_ss_optype_t optype,
+   const mongoc_read_prefs_t *read_prefs)
+{
+   mongoc_read_mode_t mode;
+
+   if (key->optype != optype) {
+      return false;
+   }
+
+   if (optype == MONGOC_SS_WRITE) {
+      /* writes ignore the read preference */
+      return true;
+   }
+
+   mode = mongoc_read_prefs_get_mode (read_prefs);
+   if (mode != mongoc_read_prefs_get_mode (key->read_prefs)) {
+      return false;
+   }
+
+   if (mode == MONGOC_READ_PRIMARY) {
+      return true;
+   }
+
+   return read_prefs->max_staleness_seconds ==
+             key->read_prefs->max_staleness_seconds &&
+          bson_equal (&read_prefs->tags, &key->read_prefs->tags);
+}
+
+
+/* the suitable servers that @snapshot precomputed for @optype and
+ * @read_prefs, or NULL if it did not */
+static const mongoc_array_t *
+_mongoc_topology_snapshot_suitable_servers (
+   mongoc_topology_t *topology,
+   const mongoc_topology_snapshot_t *snapshot,
+   mongoc_ss_optype_t optype,
+   const mongoc_read_prefs_t *read_prefs)
+{
+   size_t i;
+
+   for (i = 0; i < snapshot->n_suitable; i++) {
+      if (_mongoc_topology_selection_key_matches (
+             &topology->selection_keys[i], optype, read_prefs)) {
+         return &snapshot->suitable[i];
+      }
+   }
+
+   return NULL;
+}
+
+
+/* have each snapshot, starting now, precompute the suitable servers for
+ * @optype and @read_prefs */
+static void
+_mongoc_topology_add_selection_key (mongoc_topology_t *topology,
+                                    mongoc_ss_optype_t optype,
+                                    const mongoc_read_prefs_t *read_prefs)
+{
+   mongoc_topology_selection_key_t *key;
+   size_t i;
+
+   bson_mutex_lock (&topology->mutex);
+   for (i = 0; i < topology->n_selection_keys; i++) {
+      if (_mongoc_topology_selection_key_matches (
+             &topology->selection_keys[i], optype, read_prefs)) {
+         /* another thread added it */
+         bson_mutex_unlock (&topology->mutex);
+         return;
+      }
+   }
+
+   if (topology->n_selection_keys < MONGOC_TOPOLOGY_MAX_SELECTION_KEYS) {
+      key = &topology->selection_keys[topology->n_selection_keys];
+      key->optype = optype;
+      key->read_prefs =
+         optype == MONGOC_SS_READ ? mongoc_read_prefs_copy (read_prefs) : NULL;
+      topology->n_selection_keys++;
+      _mongoc_topology_publish_snapshot (topology);
+   }
+
+   bson_mutex_unlock (&topology->mutex);
+}
+
+
+/* choose among @suitable servers at random. if the topology is load-aware,
+ * choose the one of two random servers with fewer operations in progress, or
+ * else with lower recent latency ("power of two choices") */
+static mongoc_server_description_t *
+_mongoc_topology_pick_server (mongoc_topology_t *topology,
+                              const mongoc_array_t *suitable,
+                              unsigned int *rand_seed)
+{
+   mongoc_server_description_t *a;
+   mongoc_server_description_t *b;
+   size_t i;
+   size_t j;
+
+   if (!suitable->len) {
+      return NULL;
+   }
+
+   i = (size_t) _mongoc_rand_simple (rand_seed) % suitable->len;
+   a = _mongoc_array_index (suitable, mongoc_server_description_t *, i);
+   if (!topology->server_selection_load_aware || suitable->len < 2 ||
+       !a->load) {
+      return a;
+   }
+
+   /* a different server than the first */
+   j = (size_t) _mongoc_rand_simple (rand_seed) % (suitable->len - 1);
+   if (j >= i) {
+      j++;
+   }
+
+   b = _mongoc_array_index (suitable, mongoc_server_description_t *, j);
+   if (a->load->in_progress != b->load->in_progress) {
+      return a->load->in_progress < b->load->in_progress ? a : b;
+   }
+
+   return b->load->avg_latency_usec >= 0 &&
+                b->load->avg_latency_usec < a->load->avg_latency_usec
+             ? b
+             : a;
+}
+
+
+/* like _mongoc_topology_description_select, but choose among suitable
+ * servers with _mongoc_topology_pick_server, so that selections while
+ * holding the topology's mutex are load-aware too */
+static mongoc_server_description_t *
+_mongoc_topology_select_from_description (
+   mongoc_topology_t *topology,
+   mongoc_topology_description_t *description,
+   mongoc_ss_optype_t optype,
+   const mongoc_read_prefs_t *read_prefs,
+   int64_t local_threshold_ms,
+   unsigned int *rand_seed)
+{
+   mongoc_array_t suitable;
+   mongoc_server_description_t *sd;
+
+   if (description->type == MONGOC_TOPOLOGY_SINGLE) {
+      /* there is nothing to choose between */
+      return _mongoc_topology_description_select (
+         description, optype, read_prefs, local_threshold_ms, rand_seed);
+   }
+
+   _mongoc_array_init (&suitable, sizeof (mongoc_server_description_t *));
+   mongoc_topology_description_suitable_servers (
+      &suitable, optype, description, read_prefs, (size_t) local_threshold_ms);
+   sd = _mongoc_topology_pick_server (topology, &suitable, rand_seed);
+   _mongoc_array_destroy (&suitable);
+
+   return sd;
+}
+
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * _mongoc_topology_select_from_snapshot --
+ *
+ *       Multi-threaded only. Try to select a server from the latest
+ *       published snapshot, without locking @topology's mutex. Threads
+ *       share the snapshot, so each selection seeds its own random choice
+ *       among suitable servers.
+ *
+ *       The snapshot precomputes suitable servers for up to
+ *       MONGOC_TOPOLOGY_MAX_SELECTION_KEYS operation types and read
+ *       preferences. The first selection with others filters the
+ *       snapshot's servers itself, and adds a selection key so the
+ *       following snapshots precompute them too.
+ *
+ * Returns:
+ *       A server id, or 0 if the snapshot has no suitable server, in which
+ *       case the caller waits for the topology to change.
+ *
+ *-------------------------------------------------------------------------
+ */
+static uint32_t
+_mongoc_topology_select_from_snapshot (mongoc_topology_t *topology,
+                                       mongoc_ss_optype_t optype,
+                                       const mongoc_read_prefs_t *read_prefs)
+{
+   mongoc_topology_snapshot_t *snapshot;
+   mongoc_server_description_t *selected_server = NULL;
+   const mongoc_array_t *suitable;
+   mongoc_array_t computed;
+   unsigned int rand_seed;
+   uint32_t server_id = 0;
+   bool add_key = false;
+
+   snapshot = _mongoc_topology_snapshot_acquire (topology, NULL);
+   if (!snapshot) {
+      return 0;
+   }
+
+   if (!mongoc_topology_compatible (&snapshot->description, read_prefs, NULL)) {
+      _mongoc_topology_snapshot_release (snapshot);
+      return 0;
+   }
+
+   rand_seed = snapshot->description.rand_seed ^
+               (unsigned int) bson_get_monotonic_time ();
+
+   if (snapshot->description.type == MONGOC_TOPOLOGY_SINGLE) {
+      /* there is nothing to choose between */
+      selected_server =
+         _mongoc_topology_description_select (&snapshot->description,
+                                              optype,
+                                              read_prefs,
+                                              topology->local_threshold_msec,
+                                              &rand_seed);
+   } else {
+      suitable = _mongoc_topology_snapshot_suitable_servers (
+         topology, snapshot, optype, read_prefs);
+      if (!suitable) {
+         _mongoc_array_init (&computed,
+                             sizeof (mongoc_server_description_t *));
+         mongoc_topology_description_suitable_servers (
+            &computed,
+            optype,
+            &snapshot->description,
+            read_prefs,
+            (size_t) topology->local_threshold_msec);
+         suitable = &computed;
+         add_key =
+            snapshot->n_suitable < MONGOC_TOPOLOGY_MAX_SELECTION_KEYS;
+      }
+
+      selected_server =
+         _mongoc_topology_pick_server (topology, suitable, &rand_seed);
+
+      if (suitable == &computed) {
+         _mongoc_array_destroy (&computed);
+      }
+   }
+
+   if (selected_server) {
+      server_id = selected_server->id;
+   }
+
+   _mongoc_topology_snapshot_release (snapshot);
+
+   if (add_key) {
+      _mongoc_topology_add_selection_key (topology, optype, read_prefs);
+   }
+
+   return server_id;
+}
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * _mongoc_topology_select_hedge_server_id --
+ *
+ *       Multi-threaded only. Select a server suitable for reading with
+ *       @read_prefs other than @exclude_id from the latest published
+ *       snapshot, to send a hedged read to. Does not wait for the topology
+ *       to change.
+ *
+ * Returns:
+ *       A server id, or 0 if there is no other suitable server.
+ *
+ *-------------------------------------------------------------------------
+ */
+uint32_t
+_mongoc_topology_select_hedge_server_id (mongoc_topology_t *topology,
+                                         const mongoc_read_prefs_t *read_prefs,
+                                         uint32_t exclude_id)
+{
+   mongoc_topology_snapshot_t *snapshot;
+   mongoc_server_description_t *sd;
+   const mongoc_array_t *suitable;
+   mongoc_array_t computed;
+   mongoc_array_t others;
+   unsigned int rand_seed;
+   uint32_t server_id = 0;
+   size_t i;
+
+   snapshot = _mongoc_topology_snapshot_acquire (topology, NULL);
+   if (!snapshot) {
+      return 0;
+   }
+
+   _mongoc_array_init (&computed, sizeof (mongoc_server_description_t *));
+   suitable = _mongoc_topology_snapshot_suitable_servers (
+      topology, snapshot, MONGOC_SS_READ, read_prefs);
+   if (!suitable) {
+      mongoc_topology_description_suitable_servers (
+         &computed,
+         MONGOC_SS_READ,
+         &snapshot->description,
+         read_prefs,
+         (size_t) topology->local_threshold_msec);
+      suitable = &computed;
+   }
+
+   _mongoc_array_init (&others, sizeof (mongoc_server_description_t *));
+   for (i = 0; i < suitable->len; i++) {
+      sd = _mongoc_array_index (suitable, mongoc_server_description_t *, i);
+      if (sd->id != exclude_id) {
+         _mongoc_array_append_val (&others, sd);
+      }
+   }
+
+   rand_seed = snapshot->description.rand_seed ^
+               (unsigned int) bson_get_monotonic_time ();
+   sd = _mongoc_topology_pick_server (topology, &others, &rand_seed);
+   if (sd) {
+      server_id = sd->id;
+   }
+
+   _mongoc_array_destroy (&others);
+   _mongoc_array_destroy (&computed);
+   _mongoc_topology_snapshot_release (snapshot);
+
+   return server_id;
+}
+
+
 /*
  *-------------------------------------------------------------------------
  *
@@ -967,6 +1333,15 @@ mongoc_topology_select_server_id (mongoc_topology_t *topology,
    BSON_ASSERT (topology);
    ts = topology->scanner;
 
+   if (!topology->single_threaded) {
+      /* the common case: a suitable server is already known */
+      server_id =
+         _mongoc_topology_select_from_snapshot (topology, optype, read_prefs);
+      if (server_id) {
+         return server_id;
+      }
+   }
+
    bson_mutex_lock (&topology->mutex);
    /* It isn't strictly necessary to lock here, because if the topology
     * is invalid, it will never become valid. Lock anyway for consistency. */
@@ -1042,8 +1417,13 @@ mongoc_topology_select_server_id (mongoc_topology_t *topology,
             return 0;
          }
 
-         selected_server = mongoc_topology_description_select (
-            &topology->description, optype, read_prefs, local_threshold_ms);
+         selected_server = _mongoc_topology_select_from_description (
+            topology,
+            &topology->description,
+            optype,
+            read_prefs,
+            local_threshold_ms,
+            &topology->description.rand_seed);
 
          if (selected_server) {
             return selected_server->id;
@@ -1085,8 +1465,13 @@ mongoc_topology_select_server_id (mongoc_topology_t *topology,
          return 0;
       }
 
-      selected_server = mongoc_topology_description_select (
-         &topology->description, optype, read_prefs, local_threshold_ms);
+      selected_server = _mongoc_topology_select_from_description (
+         topology,
+         &topology->description,
+         optype,
+         read_prefs,
+         local_threshold_ms,
+         &topology->description.rand_seed);
 
       if (!selected_server) {
          TRACE (
@@ -1260,6 +1645,7 @@ mongoc_topology_invalidate_server (mongoc_topology_t *topology,
    bson_mutex_lock (&topology->mutex);
    mongoc_topology_description_invalidate_server (
       &topology->description, id, error);
+   _mongoc_topology_publish_snapshot (topology);
    bson_mutex_unlock (&topology->mutex);
 }
 
@@ -1391,10 +1777,172 @@ _mongoc_topology_update_cluster_time (mongoc_topology_t *topology,
                                                     reply);
    _mongoc_topology_scanner_set_cluster_time (
       topology->scanner, &topology->description.cluster_time);
+
+   if (!topology->single_threaded &&
+       !bson_equal (&topology->snapshot_cluster_time,
+                    &topology->description.cluster_time)) {
+      bson_mutex_lock (&topology->snapshot_mutex);
+      bson_destroy (&topology->snapshot_cluster_time);
+      bson_copy_to (&topology->description.cluster_time,
+                    &topology->snapshot_cluster_time);
+      bson_mutex_unlock (&topology->snapshot_mutex);
+   }
    bson_mutex_unlock (&topology->mutex);
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_topology_publish_snapshot --
+ *
+ *       Internal function. Replace the snapshot that application threads
+ *       read with a copy of the current topology description. Call this
+ *       after each change to the description of a multi-threaded topology;
+ *       threads still holding the previous snapshot keep reading it until
+ *       they release it. No-op for a single-threaded topology.
+ *
+ *       NOTE: this method expects @topology's mutex to be locked on entry.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+_mongoc_topology_publish_snapshot (mongoc_topology_t *topology)
+{
+   mongoc_topology_snapshot_t *snapshot;
+   mongoc_topology_snapshot_t *old;
+   mongoc_topology_selection_key_t *key;
+   size_t i;
+
+   if (topology->single_threaded) {
+      return;
+   }
+
+   snapshot = bson_malloc0 (sizeof (mongoc_topology_snapshot_t));
+   _mongoc_topology_description_copy_to (&topology->description,
+                                         &snapshot->description);
+   snapshot->description.rand_seed = topology->description.rand_seed;
+   snapshot->refs = 1;
+
+   /* the description only changes when a snapshot is published, so filter
+    * by read preference, staleness and latency once here, not per operation */
+   for (i = 0; i < topology->n_selection_keys; i++) {
+      key = &topology->selection_keys[i];
+      _mongoc_array_init (&snapshot->suitable[i],
+                          sizeof (mongoc_server_description_t *));
+      mongoc_topology_description_suitable_servers (
+         &snapshot->suitable[i],
+         key->optype,
+         &snapshot->description,
+         key->read_prefs,
+         (size_t) topology->local_threshold_msec);
+   }
+
+   snapshot->n_suitable = topology->n_selection_keys;
+
+   bson_mutex_lock (&topology->snapshot_mutex);
+   old = topology->snapshot;
+   topology->snapshot = snapshot;
+   bson_mutex_unlock (&topology->snapshot_mutex);
+
+   _mongoc_topology_snapshot_release (old);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_topology_snapshot_acquire --
+ *
+ *       Internal function. Take a reference to the latest snapshot of a
+ *       multi-threaded topology's description, without locking
+ *       @topology's mutex. If @cluster_time is not NULL, it is initialized
+ *       with the greatest cluster time seen so far.
+ *
+ * Returns:
+ *       A snapshot to release with _mongoc_topology_snapshot_release, or
+ *       NULL if the topology is single-threaded or invalid.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+mongoc_topology_snapshot_t *
+_mongoc_topology_snapshot_acquire (mongoc_topology_t *topology,
+                                   bson_t *cluster_time)
+{
+   mongoc_topology_snapshot_t *snapshot;
+
+   if (topology->single_threaded) {
+      if (cluster_time) {
+         bson_init (cluster_time);
+      }
+
+      return NULL;
+   }
+
+   bson_mutex_lock (&topology->snapshot_mutex);
+   snapshot = topology->snapshot;
+   if (snapshot) {
+      bson_atomic_int_add (&snapshot->refs, 1);
+   }
+
+   if (cluster_time) {
+      bson_copy_to (&topology->snapshot_cluster_time, cluster_time);
+   }
+   bson_mutex_unlock (&topology->snapshot_mutex);
+
+   return snapshot;
+}
+
+
+void
+_mongoc_topology_snapshot_release (mongoc_topology_snapshot_t *snapshot)
+{
+   size_t i;
+
+   if (!snapshot) {
+      return;
+   }
+
+   if (bson_atomic_int_add (&snapshot->refs, -1) == 0) {
+      for (i = 0; i < snapshot->n_suitable; i++) {
+         _mongoc_array_destroy (&snapshot->suitable[i]);
+      }
+
+      mongoc_topology_description_destroy (&snapshot->description);
+      bson_free (snapshot);
+   }
+}
+
+
+/* The session timeout for the hot path. Multi-threaded topologies read it
+ * from the latest snapshot instead of taking the topology mutex. */
+static int64_t
+_mongoc_topology_session_timeout (mongoc_topology_t *topology)
+{
+   mongoc_topology_snapshot_t *snapshot;
+   int64_t timeout;
+
+   if (topology->single_threaded) {
+      return topology->description.session_timeout_minutes;
+   }
+
+   snapshot = _mongoc_topology_snapshot_acquire (topology, NULL);
+   if (snapshot) {
+      timeout = snapshot->description.session_timeout_minutes;
+      _mongoc_topology_snapshot_release (snapshot);
+      return timeout;
+   }
+
+   bson_mutex_lock (&topology->mutex);
+   timeout = topology->description.session_timeout_minutes;
+   bson_mutex_unlock (&topology->mutex);
+
+   return timeout;
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -1411,19 +1959,22 @@ _mongoc_topology_pop_server_session (mongoc_topology_t *topology,
                                      bson_error_t *error)
 {
    int64_t timeout;
-   mongoc_server_session_t *ss = NULL;
+   mongoc_server_session_t *ss;
    mongoc_topology_description_t *td;
 
    ENTRY;
 
-   bson_mutex_lock (&topology->mutex);
-
-   td = &topology->description;
-   timeout = td->session_timeout_minutes;
+   timeout = _mongoc_topology_session_timeout (topology);
 
    if (timeout == MONGOC_NO_SESSIONS) {
+      bson_mutex_lock (&topology->mutex);
+
+      td = &topology->description;
+      timeout = td->session_timeout_minutes;
+
       /* if needed, connect and check for session timeout again */
-      if (!mongoc_topology_description_has_data_node (td)) {
+      if (timeout == MONGOC_NO_SESSIONS &&
+          !mongoc_topology_description_has_data_node (td)) {
          bson_mutex_unlock (&topology->mutex);
          if (!mongoc_topology_select_server_id (
                 topology, MONGOC_SS_READ, NULL, error)) {
@@ -1434,8 +1985,9 @@ _mongoc_topology_pop_server_session (mongoc_topology_t *topology,
          timeout = td->session_timeout_minutes;
       }
 
+      bson_mutex_unlock (&topology->mutex);
+
       if (timeout == MONGOC_NO_SESSIONS) {
-         bson_mutex_unlock (&topology->mutex);
          bson_set_error (error,
                          MONGOC_ERROR_CLIENT,
                          MONGOC_ERROR_CLIENT_SESSION_FAILURE,
@@ -1444,22 +1996,8 @@ _mongoc_topology_pop_server_session (mongoc_topology_t *topology,
       }
    }
 
-   while (topology->session_pool) {
-      ss = topology->session_pool;
-      CDL_DELETE (topology->session_pool, ss);
-      if (_mongoc_server_session_timed_out (ss, timeout)) {
-         _mongoc_server_session_destroy (ss);
-         ss = NULL;
-      } else {
-         break;
-      }
-   }
-
-   bson_mutex_unlock (&topology->mutex);
-
-   if (!ss) {
-      ss = _mongoc_server_session_new (error);
-   }
+   ss = _mongoc_server_session_pool_pop (
+      &topology->session_pool, timeout, error);
 
    RETURN (ss);
 }
@@ -1469,7 +2007,9 @@ _mongoc_topology_pop_server_session (mongoc_topology_t *topology,
  *
  * _mongoc_topology_push_server_session --
  *
- *       Internal function. Return a server session to the pool.
+ *       Internal function. Return a server session to the pool. Sessions
+ *       that time out while pooled are pruned in the background, or here
+ *       at most once a minute if no background thread does it.
  *
  *--------------------------------------------------------------------------
  */
@@ -1479,49 +2019,39 @@ _mongoc_topology_push_server_session (mongoc_topology_t *topology,
                                       mongoc_server_session_t *server_session)
 {
    int64_t timeout;
-   mongoc_server_session_t *ss;
 
    ENTRY;
 
-   bson_mutex_lock (&topology->mutex);
-
-   timeout = topology->description.session_timeout_minutes;
+   timeout = _mongoc_topology_session_timeout (topology);
+   _mongoc_server_session_pool_push (
+      &topology->session_pool, server_session, timeout);
 
-   /* start at back of queue and reap timed-out sessions */
-   while (topology->session_pool && topology->session_pool->prev) {
-      ss = topology->session_pool->prev;
-      if (_mongoc_server_session_timed_out (ss, timeout)) {
-         BSON_ASSERT (ss->next); /* silences clang scan-build */
-         CDL_DELETE (topology->session_pool, ss);
-         _mongoc_server_session_destroy (ss);
-      } else {
-         /* if ss is not timed out, sessions in front of it are ok too */
-         break;
-      }
+   if (_mongoc_server_session_pool_prune_due (&topology->session_pool)) {
+      _mongoc_topology_prune_server_sessions (topology);
    }
 
-   /* If session is expiring or "dirty" (a network error occurred on it), do not
-    * return it to the pool. */
-   if (_mongoc_server_session_timed_out (server_session, timeout) ||
-       server_session->dirty) {
-      _mongoc_server_session_destroy (server_session);
-   } else {
-      /* silences clang scan-build */
-      BSON_ASSERT (!topology->session_pool || (topology->session_pool->next &&
-                                               topology->session_pool->prev));
-
-      /* add server session (lsid) to session pool to be reused only if the
-       * server session has been used (the server is aware of the session) */
-      if (server_session->last_used_usec == SESSION_NEVER_USED) {
-         _mongoc_server_session_destroy (server_session);
-      } else {
-         CDL_PREPEND (topology->session_pool, server_session);
-      }
-   }
+   EXIT;
+}
 
-   bson_mutex_unlock (&topology->mutex);
 
-   EXIT;
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_topology_prune_server_sessions --
+ *
+ *       Internal function. Destroy pooled sessions that have timed out and
+ *       replenish the prewarmed sessions. Called by a client pool's
+ *       background maintenance.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+_mongoc_topology_prune_server_sessions (mongoc_topology_t *topology)
+{
+   _mongoc_server_session_pool_prune (
+      &topology->session_pool, _mongoc_topology_session_timeout (topology));
+   _mongoc_server_session_pool_prewarm (&topology->session_pool);
 }
 
 
@@ -1548,7 +2078,7 @@ _mongoc_topology_push_server_session (mongoc_topology_t *topology,
 bool
 _mongoc_topology_end_sessions_cmd (mongoc_topology_t *topology, bson_t *cmd)
 {
-   mongoc_server_session_t *ss, *tmp1, *tmp2;
+   mongoc_server_session_t *ss;
    char buf[16];
    const char *key;
    uint32_t i;
@@ -1558,16 +2088,12 @@ _mongoc_topology_end_sessions_cmd (mongoc_topology_t *topology, bson_t *cmd)
    BSON_APPEND_ARRAY_BEGIN (cmd, "endSessions", &ar);
 
    i = 0;
-   CDL_FOREACH_SAFE (topology->session_pool, ss, tmp1, tmp2)
-   {
+   while (i < 10000 &&
+          (ss = _mongoc_server_session_pool_take (&topology->session_pool))) {
       bson_uint32_to_string (i, &key, buf, sizeof buf);
       BSON_APPEND_DOCUMENT (&ar, key, &ss->lsid);
-      CDL_DELETE (topology->session_pool, ss);
       _mongoc_server_session_destroy (ss);
-
-      if (++i == 10000) {
-         break;
-      }
+      i++;
    }
 
    bson_append_array_end (cmd, &ar);
@@ -1643,6 +2169,7 @@ _mongoc_topology_clear_connection_pool (mongoc_topology_t *topology,
    }
    TRACE ("clearing pool for server: %s", sd->host.host_and_port);
    sd->generation++;
+   _mongoc_topology_publish_snapshot (topology);
 }
 
 
@@ -1751,6 +2278,7 @@ _mongoc_topology_handle_app_error (mongoc_topology_t *topology,
        * description with a ServerDescription of type Unknown. */
       mongoc_topology_description_invalidate_server (
          &topology->description, server_id, &cmd_error);
+      _mongoc_topology_publish_snapshot (topology);
 
       if (topology->single_threaded) {
          /* SDAM: For single-threaded clients, in the case of a "not master" or
@@ -176,6 +176,11 @@ _mongoc_write_command_execute (mongoc_write_command_t *command,
                                uint32_t offset,
                                mongoc_client_session_t *cs,
                                mongoc_write_result_t *result);
+bool
+_mongoc_write_command_check (const mongoc_write_command_t *command,
+                             int32_t max_wire_version,
+                             const struct _mongoc_crud_opts_t *crud,
+                             mongoc_write_result_t *result);
 void
 _mongoc_write_command_execute_idl (mongoc_write_command_t *command,
                                    mongoc_client_t *client,
@@ -392,7 +392,7 @@ _mongoc_write_command_too_large_error (bson_error_t *error,
 
 
 void
-_empty_error (mongoc_write_command_t *command, bson_error_t *error)
+_empty_error (const mongoc_write_command_t *command, bson_error_t *error)
 {
    static const uint32_t codes[] = {MONGOC_ERROR_COLLECTION_DELETE_FAILED,
                                     MONGOC_ERROR_COLLECTION_INSERT_FAILED,
@@ -527,6 +527,12 @@ _mongoc_write_opmsg (mongoc_write_command_t *command,
    header =
       26 + parts.assembled.command->len + gCommandFieldLens[command->type] + 1;
 
+   /* no replies are read, so send all batches in as few writes as possible */
+   if (!parts.assembled.is_acknowledged) {
+      mongoc_cluster_begin_unacknowledged_batch (&client->cluster,
+                                                 server_stream);
+   }
+
    do {
       memcpy (&len,
               command->payload.data + payload_batch_size + payload_total_offset,
@@ -645,6 +651,13 @@ _mongoc_write_opmsg (mongoc_write_command_t *command,
       /* While we have more documents to write */
    } while (payload_total_offset < command->payload.len && !result->must_stop);
 
+   if (!parts.assembled.is_acknowledged &&
+       !mongoc_cluster_end_unacknowledged_batch (&client->cluster, error)) {
+      result->failed = true;
+      result->must_stop = true;
+      ret = false;
+   }
+
    bson_destroy (&cmd);
    mongoc_cmd_parts_cleanup (&parts);
 
@@ -654,15 +667,13 @@ _mongoc_write_opmsg (mongoc_write_command_t *command,
           * use the newly selected server. */
          result->retry_server_id =
             mongoc_server_description_id (retry_server_stream->sd);
+         /* clear the initial error, but not that of an earlier command in
+          * an unordered bulk */
+         memset (&result->error, 0, sizeof (bson_error_t));
       }
       mongoc_server_stream_cleanup (retry_server_stream);
    }
 
-   if (ret) {
-      /* if a retry succeeded, clear the initial error */
-      memset (&result->error, 0, sizeof (bson_error_t));
-   }
-
    EXIT;
 }
 
@@ -933,25 +944,28 @@ _mongoc_write_command_execute (
    EXIT;
 }
 
-void
-_mongoc_write_command_execute_idl (mongoc_write_command_t *command,
-                                   mongoc_client_t *client,
-                                   mongoc_server_stream_t *server_stream,
-                                   const char *database,
-                                   const char *collection,
-                                   uint32_t offset,
-                                   const mongoc_crud_opts_t *crud,
-                                   mongoc_write_result_t *result)
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_write_command_check --
+ *
+ *       Check that @command can be sent to a server with
+ *       @max_wire_version with the write concern and session in @crud.
+ *
+ * Returns:
+ *       True if so, otherwise false and @result->error is set.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+_mongoc_write_command_check (const mongoc_write_command_t *command,
+                             int32_t max_wire_version,
+                             const mongoc_crud_opts_t *crud,
+                             mongoc_write_result_t *result)
 {
    ENTRY;
 
-   BSON_ASSERT (command);
-   BSON_ASSERT (client);
-   BSON_ASSERT (server_stream);
-   BSON_ASSERT (database);
-   BSON_ASSERT (collection);
-   BSON_ASSERT (result);
-
    if (command->flags.has_collation) {
       if (!mongoc_write_concern_is_acknowledged (crud->writeConcern)) {
          result->failed = true;
@@ -959,16 +973,16 @@ _mongoc_write_command_execute_idl (mongoc_write_command_t *command,
                          MONGOC_ERROR_COMMAND,
                          MONGOC_ERROR_COMMAND_INVALID_ARG,
                          "Cannot set collation for unacknowledged writes");
-         EXIT;
+         RETURN (false);
       }
 
-      if (server_stream->sd->max_wire_version < WIRE_VERSION_COLLATION) {
+      if (max_wire_version < WIRE_VERSION_COLLATION) {
          bson_set_error (&result->error,
                          MONGOC_ERROR_COMMAND,
                          MONGOC_ERROR_PROTOCOL_BAD_WIRE_VERSION,
                          "The selected server does not support collation");
          result->failed = true;
-         EXIT;
+         RETURN (false);
       }
    }
 
@@ -979,23 +993,22 @@ _mongoc_write_command_execute_idl (mongoc_write_command_t *command,
                          MONGOC_ERROR_COMMAND,
                          MONGOC_ERROR_COMMAND_INVALID_ARG,
                          "Cannot use array filters with unacknowledged writes");
-         EXIT;
+         RETURN (false);
       }
 
-      if (server_stream->sd->max_wire_version < WIRE_VERSION_ARRAY_FILTERS) {
+      if (max_wire_version < WIRE_VERSION_ARRAY_FILTERS) {
          bson_set_error (&result->error,
                          MONGOC_ERROR_COMMAND,
                          MONGOC_ERROR_PROTOCOL_BAD_WIRE_VERSION,
                          "The selected server does not support array filters");
          result->failed = true;
-         EXIT;
+         RETURN (false);
       }
    }
 
    if (command->flags.has_update_hint) {
-      if (server_stream->sd->max_wire_version <
-             WIRE_VERSION_HINT_SERVER_SIDE_ERROR ||
-          (server_stream->sd->max_wire_version < WIRE_VERSION_UPDATE_HINT &&
+      if (max_wire_version < WIRE_VERSION_HINT_SERVER_SIDE_ERROR ||
+          (max_wire_version < WIRE_VERSION_UPDATE_HINT &&
            !mongoc_write_concern_is_acknowledged (crud->writeConcern))) {
          bson_set_error (
             &result->error,
@@ -1003,14 +1016,13 @@ _mongoc_write_command_execute_idl (mongoc_write_command_t *command,
             MONGOC_ERROR_PROTOCOL_BAD_WIRE_VERSION,
             "The selected server does not support hint for update");
          result->failed = true;
-         EXIT;
+         RETURN (false);
       }
    }
 
    if (command->flags.has_delete_hint) {
-      if (server_stream->sd->max_wire_version <
-             WIRE_VERSION_HINT_SERVER_SIDE_ERROR ||
-          (server_stream->sd->max_wire_version < WIRE_VERSION_DELETE_HINT &&
+      if (max_wire_version < WIRE_VERSION_HINT_SERVER_SIDE_ERROR ||
+          (max_wire_version < WIRE_VERSION_DELETE_HINT &&
            !mongoc_write_concern_is_acknowledged (crud->writeConcern))) {
          bson_set_error (
             &result->error,
@@ -1018,7 +1030,7 @@ _mongoc_write_command_execute_idl (mongoc_write_command_t *command,
             MONGOC_ERROR_COMMAND_INVALID_ARG,
             "The selected server does not support hint for delete");
          result->failed = true;
-         EXIT;
+         RETURN (false);
       }
    }
 
@@ -1030,7 +1042,7 @@ _mongoc_write_command_execute_idl (mongoc_write_command_t *command,
             MONGOC_ERROR_COMMAND,
             MONGOC_ERROR_COMMAND_INVALID_ARG,
             "Cannot set bypassDocumentValidation for unacknowledged writes");
-         EXIT;
+         RETURN (false);
       }
    }
 
@@ -1041,11 +1053,39 @@ _mongoc_write_command_execute_idl (mongoc_write_command_t *command,
                       MONGOC_ERROR_COMMAND,
                       MONGOC_ERROR_COMMAND_INVALID_ARG,
                       "Cannot use client session with unacknowledged writes");
-      EXIT;
+      RETURN (false);
    }
 
    if (command->payload.len == 0) {
       _empty_error (command, &result->error);
+      RETURN (false);
+   }
+
+   RETURN (true);
+}
+
+
+void
+_mongoc_write_command_execute_idl (mongoc_write_command_t *command,
+                                   mongoc_client_t *client,
+                                   mongoc_server_stream_t *server_stream,
+                                   const char *database,
+                                   const char *collection,
+                                   uint32_t offset,
+                                   const mongoc_crud_opts_t *crud,
+                                   mongoc_write_result_t *result)
+{
+   ENTRY;
+
+   BSON_ASSERT (command);
+   BSON_ASSERT (client);
+   BSON_ASSERT (server_stream);
+   BSON_ASSERT (database);
+   BSON_ASSERT (collection);
+   BSON_ASSERT (result);
+
+   if (!_mongoc_write_command_check (
+          command, server_stream->sd->max_wire_version, crud, result)) {
       EXIT;
    }
 
@@ -46,6 +46,7 @@
 #include "mongoc-matcher.h"
 #include "mongoc-handshake.h"
 #include "mongoc-opcode.h"
+#include "mongoc-reactor.h"
 #include "mongoc-log.h"
 #include "mongoc-socket.h"
 #include "mongoc-client-session.h"
@@ -23,6 +23,8 @@
 
 #include "test-libmongoc.h"
 
+#include <errno.h>
+
 
 #define MONGOC_STREAM_DEBUG 7
 typedef struct _mongoc_stream_debug_t {
@@ -106,8 +108,18 @@ _mongoc_stream_debug_writev (mongoc_stream_t *stream,
                              size_t iovcnt,
                              int32_t timeout_msec)
 {
+   mongoc_stream_debug_t *debug_stream = (mongoc_stream_debug_t *) stream;
+
+   debug_stream->stats->n_writev++;
+
+   if (debug_stream->stats->n_writev_fail > 0) {
+      debug_stream->stats->n_writev_fail--;
+      errno = EPIPE;
+      return -1;
+   }
+
    return mongoc_stream_writev (
-      ((mongoc_stream_debug_t *) stream)->wrapped, iov, iovcnt, timeout_msec);
+      debug_stream->wrapped, iov, iovcnt, timeout_msec);
 }
 
 
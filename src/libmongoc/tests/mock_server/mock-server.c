@@ -20,6 +20,7 @@
 
 #include "mongoc/mongoc-buffer-private.h"
 #include "mongoc/mongoc-socket-private.h"
+#include "mongoc/mongoc-ssl-private.h"
 #include "mongoc/mongoc-thread-private.h"
 #include "mongoc/mongoc-util-private.h"
 #include "mongoc/mongoc-trace-private.h"
@@ -293,7 +294,17 @@ mock_server_set_ssl_opts (mock_server_t *server, mongoc_ssl_opt_t *opts)
 {
    bson_mutex_lock (&server->mutex);
    server->ssl = true;
-   memcpy (&server->ssl_opts, opts, sizeof *opts);
+   _mongoc_ssl_opts_cleanup (&server->ssl_opts, false);
+   _mongoc_ssl_opts_copy_to (opts, &server->ssl_opts, false);
+   server->ssl_opts.weak_cert_validation = 1;
+   if (!server->ssl_opts.internal) {
+      server->ssl_opts.internal =
+         bson_malloc0 (sizeof (_mongoc_internal_tls_opts_t));
+   }
+
+   /* connections share a TLS context, so clients can resume sessions */
+   _mongoc_ssl_opts_share_ctx (
+      &server->ssl_opts, &server->ssl_opts, false /* server */);
    bson_mutex_unlock (&server->mutex);
 }
 
@@ -1526,6 +1537,12 @@ mock_server_destroy (mock_server_t *server)
    bson_free (server->uri_str);
    mongoc_uri_destroy (server->uri);
 
+#ifdef MONGOC_ENABLE_SSL
+   if (server->ssl) {
+      _mongoc_ssl_opts_cleanup (&server->ssl_opts, true);
+   }
+#endif
+
    while ((request = (request_t *) q_get_nowait (server->q))) {
       request_destroy (request);
    }
@@ -1614,7 +1631,6 @@ static BSON_THREAD_FUN (main_thread, data)
          bson_mutex_lock (&server->mutex);
          if (server->ssl) {
             mongoc_stream_t *tls_stream;
-            server->ssl_opts.weak_cert_validation = 1;
             tls_stream = mongoc_stream_tls_new_with_hostname (
                client_stream, NULL, &server->ssl_opts, 0);
             if (!tls_stream) {
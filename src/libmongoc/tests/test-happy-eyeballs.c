@@ -1,6 +1,7 @@
 #include <mongoc/mongoc.h>
 #include <mongoc/mongoc-socket-private.h>
 #include <mongoc/mongoc-host-list-private.h>
+#include <mongoc/mongoc-dns-cache-private.h>
 #include <mongoc/mongoc-util-private.h>
 #include <mongoc/mongoc-stream-private.h>
 #include <mongoc/utlist.h>
@@ -429,6 +430,164 @@ test_happy_eyeballs_dns_cache (void)
 #undef E
 }
 
+static void
+_scanner_callback_ok (uint32_t id,
+                      const bson_t *bson,
+                      int64_t rtt_msec,
+                      void *data,
+                      const bson_error_t *error /* IN */)
+{
+   ASSERT_OR_PRINT (!error->code, (*error));
+}
+
+static void
+test_happy_eyeballs_dns_cache_shared (void)
+{
+   mock_server_t *server;
+   mongoc_topology_scanner_t *ts;
+   mongoc_host_list_t host;
+   mongoc_dns_result_t *result;
+   mongoc_stream_t *stream;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   _init_host (&host, mock_server_get_port (server), "ipv4");
+
+   ts = mongoc_topology_scanner_new (
+      NULL, NULL, &_scanner_callback_ok, NULL, TIMEOUT);
+   mongoc_topology_scanner_add (ts, &host, 1);
+   mongoc_topology_scanner_scan (ts, 1);
+   mongoc_topology_scanner_work (ts);
+
+   /* application connections reuse the scanner's DNS results. */
+   result = _mongoc_dns_cache_resolve (&host, TIMEOUT, &error);
+   ASSERT_OR_PRINT (result, error);
+   BSON_ASSERT (result == ts->nodes->dns_results);
+   _mongoc_dns_result_release (result);
+
+   stream = mongoc_client_connect_tcp (TIMEOUT, &host, &error);
+   ASSERT_OR_PRINT (stream, error);
+   mongoc_stream_destroy (stream);
+
+   result = _mongoc_dns_cache_resolve (&host, TIMEOUT, &error);
+   ASSERT_OR_PRINT (result, error);
+   BSON_ASSERT (result == ts->nodes->dns_results);
+
+   /* after an invalidation, the next caller looks up the host again. */
+   _mongoc_dns_cache_invalidate (&host, result);
+   _mongoc_dns_result_release (result);
+   result = _mongoc_dns_cache_resolve (&host, TIMEOUT, &error);
+   ASSERT_OR_PRINT (result, error);
+   BSON_ASSERT (result != ts->nodes->dns_results);
+   _mongoc_dns_result_release (result);
+
+   mongoc_topology_scanner_destroy (ts);
+   mock_server_destroy (server);
+}
+
+static void
+test_happy_eyeballs_dns_cache_bounded (void)
+{
+   mongoc_host_list_t host;
+   mongoc_dns_result_t *first;
+   mongoc_dns_result_t *last;
+   mongoc_dns_result_t *result;
+   bson_error_t error;
+   uint16_t port;
+
+   _init_host (&host, 1, "ipv4");
+   first = _mongoc_dns_cache_resolve (&host, TIMEOUT, &error);
+   ASSERT_OR_PRINT (first, error);
+
+   for (port = 2; port <= MONGOC_DNS_CACHE_MAX_ENTRIES + 1; port++) {
+      _init_host (&host, port, "ipv4");
+      result = _mongoc_dns_cache_resolve (&host, TIMEOUT, &error);
+      ASSERT_OR_PRINT (result, error);
+      _mongoc_dns_result_release (result);
+      ASSERT_CMPSIZE_T (
+         _mongoc_dns_cache_count (), <=, (size_t) MONGOC_DNS_CACHE_MAX_ENTRIES);
+   }
+
+   /* the most recent host is still cached. */
+   last = _mongoc_dns_cache_resolve (&host, TIMEOUT, &error);
+   ASSERT_OR_PRINT (last, error);
+   result = _mongoc_dns_cache_resolve (&host, TIMEOUT, &error);
+   ASSERT_OR_PRINT (result, error);
+   BSON_ASSERT (result == last);
+   _mongoc_dns_result_release (result);
+   _mongoc_dns_result_release (last);
+
+   /* the least recently resolved host was evicted and is looked up again. */
+   _init_host (&host, 1, "ipv4");
+   result = _mongoc_dns_cache_resolve (&host, TIMEOUT, &error);
+   ASSERT_OR_PRINT (result, error);
+   BSON_ASSERT (result != first);
+   _mongoc_dns_result_release (result);
+   _mongoc_dns_result_release (first);
+}
+
+static void
+test_happy_eyeballs_connect_any (void)
+{
+   mock_server_t *server;
+   mongoc_socket_t *refuser;
+   mongoc_socket_t *sock;
+   struct sockaddr_in addr = {0};
+   mongoc_socklen_t addrlen = sizeof addr;
+   struct addrinfo hints = {0};
+   struct addrinfo *refused;
+   struct addrinfo *listening;
+   char portstr[8];
+   int64_t start;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_MAX);
+   mock_server_run (server);
+
+   /* a bound socket that is not listening refuses connections. */
+   refuser = mongoc_socket_new (AF_INET, SOCK_STREAM, 0);
+   BSON_ASSERT (refuser);
+   addr.sin_family = AF_INET;
+   BSON_ASSERT (inet_pton (AF_INET, "127.0.0.1", &addr.sin_addr));
+   BSON_ASSERT (!mongoc_socket_bind (
+      refuser, (struct sockaddr *) &addr, (mongoc_socklen_t) sizeof addr));
+   BSON_ASSERT (!mongoc_socket_getsockname (
+      refuser, (struct sockaddr *) &addr, &addrlen));
+
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+   bson_snprintf (portstr, sizeof portstr, "%hu", ntohs (addr.sin_port));
+   BSON_ASSERT (!getaddrinfo ("127.0.0.1", portstr, &hints, &refused));
+   bson_snprintf (
+      portstr, sizeof portstr, "%hu", mock_server_get_port (server));
+   BSON_ASSERT (!getaddrinfo ("127.0.0.1", portstr, &hints, &listening));
+   BSON_ASSERT (!refused->ai_next);
+
+   /* the second address is tried as soon as the first fails, without
+    * waiting for the happy eyeballs delay. */
+   refused->ai_next = listening;
+   start = bson_get_monotonic_time ();
+   sock = mongoc_socket_connect_any (
+      refused, 10 * 1000, start + TIMEOUT * 1000);
+   BSON_ASSERT (sock);
+   if (!test_suite_valgrind ()) {
+      ASSERT_CMPINT64 (bson_get_monotonic_time () - start, <, 1000 * 1000);
+   }
+
+   mongoc_socket_destroy (sock);
+   refused->ai_next = NULL;
+
+   /* every address fails. */
+   sock = mongoc_socket_connect_any (
+      refused, 10 * 1000, bson_get_monotonic_time () + TIMEOUT * 1000);
+   BSON_ASSERT (!sock);
+
+   freeaddrinfo (refused);
+   freeaddrinfo (listening);
+   mongoc_socket_destroy (refuser);
+   mock_server_destroy (server);
+}
+
 void
 test_happy_eyeballs_retirement ()
 {
@@ -591,4 +750,13 @@ test_happy_eyeballs_install (TestSuite *suite)
                                 "/TOPOLOGY/happy_eyeballs/dns_cache/",
                                 test_happy_eyeballs_dns_cache,
                                 test_framework_skip_if_no_dual_ip_hostname);
+   TestSuite_AddMockServerTest (suite,
+                                "/TOPOLOGY/happy_eyeballs/dns_cache/shared",
+                                test_happy_eyeballs_dns_cache_shared);
+   TestSuite_Add (suite,
+                  "/TOPOLOGY/happy_eyeballs/dns_cache/bounded",
+                  test_happy_eyeballs_dns_cache_bounded);
+   TestSuite_AddMockServerTest (suite,
+                                "/TOPOLOGY/happy_eyeballs/connect_any",
+                                test_happy_eyeballs_connect_any);
 }
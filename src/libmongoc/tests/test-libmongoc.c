@@ -163,6 +163,8 @@ test_read_write_concern_install (TestSuite *suite);
 extern void
 test_read_prefs_install (TestSuite *suite);
 extern void
+test_reactor_install (TestSuite *suite);
+extern void
 test_retryable_writes_install (TestSuite *suite);
 extern void
 test_retryable_reads_install (TestSuite *suite);
@@ -2626,6 +2628,7 @@ main (int argc, char *argv[])
    test_read_concern_install (&suite);
    test_read_write_concern_install (&suite);
    test_read_prefs_install (&suite);
+   test_reactor_install (&suite);
    test_retryable_writes_install (&suite);
    test_retryable_reads_install (&suite);
    test_rpc_install (&suite);
@@ -178,6 +178,9 @@ typedef struct _debug_stream_stats_t {
    mongoc_client_t *client;
    int n_destroyed;
    int n_failed;
+   int n_writev;
+   /* fail this many of the next writes */
+   int n_writev_fail;
 } debug_stream_stats_t;
 
 void
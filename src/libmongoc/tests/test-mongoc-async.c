@@ -8,7 +8,9 @@
 #include "mock_server/mock-server.h"
 #include "mock_server/future-functions.h"
 #include "mongoc/mongoc-errno-private.h"
+#include "mongoc/mongoc-socket-private.h"
 #include "test-libmongoc.h"
+#include "test-conveniences.h"
 
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "async-test"
@@ -362,6 +364,148 @@ test_ismaster_delay ()
    mock_server_destroy (server);
 }
 
+static bool
+auto_ping_with_server_id (request_t *request, void *data)
+{
+   char *reply;
+
+   if (!request->is_command || strcmp (request->command_name, "ping") != 0) {
+      return false;
+   }
+
+   ASSERT_CMPINT (request->opcode, ==, MONGOC_OPCODE_MSG);
+   reply = bson_strdup_printf ("{'ok': 1, 'serverId': %d}", *(int *) data);
+   mock_server_replies_simple (request, reply);
+   request_destroy (request);
+   bson_free (reply);
+
+   return true;
+}
+
+
+static void
+test_opmsg_external_loop (void)
+{
+   mock_server_t *servers[NSERVERS];
+   int server_ids[NSERVERS];
+   mongoc_stream_t *sock_streams[NSERVERS];
+   struct result results[NSERVERS];
+   mongoc_async_t *async;
+   bson_t *ping = tmp_bson ("{'ping': 1}");
+   size_t nstreams;
+   int64_t timeout_msec;
+   ssize_t nactive;
+   int i;
+
+   for (i = 0; i < NSERVERS; i++) {
+      servers[i] = mock_server_new ();
+      server_ids[i] = i;
+      mock_server_autoresponds (
+         servers[i], auto_ping_with_server_id, &server_ids[i], NULL);
+      mock_server_run (servers[i]);
+   }
+
+   async = mongoc_async_new ();
+
+   for (i = 0; i < NSERVERS; i++) {
+      sock_streams[i] =
+         get_localhost_stream (mock_server_get_port (servers[i]));
+      results[i].finished = false;
+      mongoc_async_cmd_new_opmsg (async,
+                                  sock_streams[i],
+                                  "admin",
+                                  ping,
+                                  &test_ismaster_helper,
+                                  (void *) &results[i],
+                                  TIMEOUT);
+   }
+
+   /* drive the commands from the caller's own poll loop, as an application
+    * with an event loop would */
+   while (async->ncmds) {
+      nstreams = mongoc_async_prepare (async, &timeout_msec);
+      ASSERT_CMPSIZE_T (nstreams, ==, async->ncmds);
+      ASSERT_CMPINT64 (timeout_msec, <=, (int64_t) TIMEOUT);
+
+#ifndef _WIN32
+      {
+         struct pollfd fds[NSERVERS];
+         size_t j;
+
+         for (j = 0; j < nstreams; j++) {
+            fds[j].fd = mongoc_async_get_socket (async, j)->sd;
+            fds[j].events = async->poller[j].events;
+            fds[j].revents = 0;
+         }
+
+         nactive = poll (fds, (nfds_t) nstreams, (int) timeout_msec);
+         for (j = 0; j < nstreams; j++) {
+            async->poller[j].revents = fds[j].revents;
+         }
+      }
+#else
+      BSON_ASSERT (mongoc_async_get_socket (async, 0));
+      nactive =
+         mongoc_stream_poll (async->poller, nstreams, (int32_t) timeout_msec);
+#endif
+
+      mongoc_async_dispatch (async, nactive);
+   }
+
+   for (i = 0; i < NSERVERS; i++) {
+      BSON_ASSERT (results[i].finished);
+      ASSERT_CMPINT (i, ==, results[i].server_id);
+   }
+
+   mongoc_async_destroy (async);
+
+   for (i = 0; i < NSERVERS; i++) {
+      mongoc_stream_destroy (sock_streams[i]);
+      mock_server_destroy (servers[i]);
+   }
+}
+
+
+static void
+test_opmsg_step (void)
+{
+   mock_server_t *server;
+   int server_id = 42;
+   mongoc_stream_t *stream;
+   struct result result = {0};
+   mongoc_async_t *async;
+   int64_t start;
+
+   server = mock_server_new ();
+   mock_server_autoresponds (
+      server, auto_ping_with_server_id, &server_id, NULL);
+   mock_server_run (server);
+
+   async = mongoc_async_new ();
+   stream = get_localhost_stream (mock_server_get_port (server));
+   mongoc_async_cmd_new_opmsg (async,
+                               stream,
+                               "admin",
+                               tmp_bson ("{'ping': 1}"),
+                               &test_ismaster_helper,
+                               (void *) &result,
+                               TIMEOUT);
+
+   /* each step waits at most max_wait_msec, so the caller keeps control */
+   start = bson_get_monotonic_time ();
+   while (mongoc_async_step (async, 10)) {
+      ASSERT_CMPINT64 (
+         bson_get_monotonic_time () - start, <, (int64_t) TIMEOUT * 1000);
+   }
+
+   BSON_ASSERT (result.finished);
+   ASSERT_CMPINT (result.server_id, ==, 42);
+
+   mongoc_async_destroy (async);
+   mongoc_stream_destroy (stream);
+   mock_server_destroy (server);
+}
+
 void
 test_async_install (TestSuite *suite)
 {
@@ -381,4 +525,7 @@ test_async_install (TestSuite *suite)
                       test_framework_skip_if_windows);
 #endif
    TestSuite_AddMockServerTest (suite, "/Async/delay", test_ismaster_delay);
+   TestSuite_AddMockServerTest (
+      suite, "/Async/opmsg/external_loop", test_opmsg_external_loop);
+   TestSuite_AddMockServerTest (suite, "/Async/opmsg/step", test_opmsg_step);
 }
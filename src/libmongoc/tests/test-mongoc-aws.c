@@ -14,9 +14,12 @@
  * limitations under the License.
  */
 
+#include <mongoc/mongoc.h>
+
 #include "TestSuite.h"
 #include "test-libmongoc.h"
 #include "mongoc/mongoc-cluster-aws-private.h"
+#include "mongoc/mongoc-thread-private.h"
 
 void
 test_obtain_credentials (void *unused)
@@ -266,6 +269,168 @@ test_derive_region (void *unused)
 #undef WITH_LEN
 }
 
+/* A stand-in for the ECS metadata server that answers a fixed number of
+ * requests with the current body. */
+typedef struct {
+   mongoc_socket_t *listen_sock;
+   int max_requests;
+   bson_mutex_t mutex;
+   char *body;
+   int requests;
+} ecs_stand_in_t;
+
+static BSON_THREAD_FUN (ecs_stand_in_run, data)
+{
+   ecs_stand_in_t *stand_in = (ecs_stand_in_t *) data;
+   mongoc_socket_t *conn_sock;
+   mongoc_stream_t *stream;
+   char buf[1024];
+   size_t len;
+   ssize_t r;
+   char *response;
+   int i;
+
+   for (i = 0; i < stand_in->max_requests; i++) {
+      conn_sock = mongoc_socket_accept (stand_in->listen_sock, -1);
+      BSON_ASSERT (conn_sock);
+      stream = mongoc_stream_socket_new (conn_sock);
+
+      /* read the request headers. */
+      len = 0;
+      do {
+         r = mongoc_stream_read (
+            stream, buf + len, sizeof buf - len - 1, 1, 10000);
+         BSON_ASSERT (r > 0);
+         len += (size_t) r;
+         buf[len] = '\0';
+      } while (!strstr (buf, "\r\n\r\n"));
+
+      bson_mutex_lock (&stand_in->mutex);
+      response = bson_strdup_printf ("HTTP/1.0 200 OK\r\n\r\n%s",
+                                     stand_in->body);
+      stand_in->requests++;
+      bson_mutex_unlock (&stand_in->mutex);
+
+      r = mongoc_stream_write (stream, response, strlen (response), 10000);
+      BSON_ASSERT (r == (ssize_t) strlen (response));
+      bson_free (response);
+      mongoc_stream_destroy (stream);
+   }
+
+   BSON_THREAD_RETURN;
+}
+
+static void
+_set_ecs_creds (ecs_stand_in_t *stand_in,
+                const char *access_key_id,
+                int expires_in_sec)
+{
+   time_t expiration = time (NULL) + expires_in_sec;
+   char expiration_str[32];
+
+   strftime (expiration_str,
+             sizeof expiration_str,
+             "%Y-%m-%dT%H:%M:%SZ",
+             gmtime (&expiration));
+
+   bson_mutex_lock (&stand_in->mutex);
+   bson_free (stand_in->body);
+   stand_in->body = bson_strdup_printf ("{\"AccessKeyId\": \"%s\", "
+                                        "\"SecretAccessKey\": \"secret\", "
+                                        "\"Token\": \"token\", "
+                                        "\"Expiration\": \"%s\"}",
+                                        access_key_id,
+                                        expiration_str);
+   bson_mutex_unlock (&stand_in->mutex);
+}
+
+static void
+_assert_obtains (mongoc_uri_t *uri,
+                 ecs_stand_in_t *stand_in,
+                 const char *access_key_id,
+                 int requests)
+{
+   _mongoc_aws_credentials_t creds;
+   bson_error_t error;
+   bool ret;
+
+   ret = _mongoc_aws_credentials_obtain (uri, &creds, &error);
+   ASSERT_OR_PRINT (ret, error);
+   ASSERT_CMPSTR (creds.access_key_id, access_key_id);
+   ASSERT_CMPSTR (creds.session_token, "token");
+   _mongoc_aws_credentials_cleanup (&creds);
+
+   bson_mutex_lock (&stand_in->mutex);
+   ASSERT_CMPINT (stand_in->requests, ==, requests);
+   bson_mutex_unlock (&stand_in->mutex);
+}
+
+void
+test_obtain_credentials_cached (void *unused)
+{
+   ecs_stand_in_t stand_in = {0};
+   struct sockaddr_in server_addr = {0};
+   mongoc_socklen_t sock_len;
+   bson_thread_t thread;
+   mongoc_uri_t *uri;
+   int r;
+
+   test_framework_setenv ("AWS_ACCESS_KEY_ID", "");
+   test_framework_setenv ("AWS_SECRET_ACCESS_KEY", "");
+   test_framework_setenv ("AWS_SESSION_TOKEN", "");
+   test_framework_setenv ("AWS_CONTAINER_CREDENTIALS_RELATIVE_URI", "/creds");
+
+   stand_in.listen_sock = mongoc_socket_new (AF_INET, SOCK_STREAM, 0);
+   BSON_ASSERT (stand_in.listen_sock);
+   server_addr.sin_family = AF_INET;
+   server_addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+   server_addr.sin_port = htons (0);
+   r = mongoc_socket_bind (stand_in.listen_sock,
+                           (struct sockaddr *) &server_addr,
+                           sizeof server_addr);
+   BSON_ASSERT (r == 0);
+   sock_len = sizeof (server_addr);
+   r = mongoc_socket_getsockname (
+      stand_in.listen_sock, (struct sockaddr *) &server_addr, &sock_len);
+   BSON_ASSERT (r == 0);
+   r = mongoc_socket_listen (stand_in.listen_sock, 10);
+   BSON_ASSERT (r == 0);
+
+   bson_mutex_init (&stand_in.mutex);
+   stand_in.max_requests = 3;
+   r = COMMON_PREFIX (thread_create) (&thread, ecs_stand_in_run, &stand_in);
+   BSON_ASSERT (r == 0);
+
+   _mongoc_aws_set_ecs_endpoint ("127.0.0.1", ntohs (server_addr.sin_port));
+   _mongoc_aws_credentials_cache_clear ();
+   uri = mongoc_uri_new ("mongodb://localhost/?authMechanism=MONGODB-AWS");
+
+   /* Temporary credentials are fetched once and reused until they near
+    * their expiration. */
+   _set_ecs_creds (&stand_in, "key1", 3600);
+   _assert_obtains (uri, &stand_in, "key1", 1);
+   _assert_obtains (uri, &stand_in, "key1", 1);
+
+   /* Credentials about to expire are refreshed. */
+   _mongoc_aws_credentials_cache_clear ();
+   _set_ecs_creds (&stand_in, "key2", 60);
+   _assert_obtains (uri, &stand_in, "key2", 2);
+   _set_ecs_creds (&stand_in, "key3", 3600);
+   _assert_obtains (uri, &stand_in, "key3", 3);
+   _assert_obtains (uri, &stand_in, "key3", 3);
+
+   r = COMMON_PREFIX (thread_join) (thread);
+   BSON_ASSERT (r == 0);
+
+   _mongoc_aws_credentials_cache_clear ();
+   _mongoc_aws_set_ecs_endpoint ("169.254.170.2", 80);
+   test_framework_setenv ("AWS_CONTAINER_CREDENTIALS_RELATIVE_URI", "");
+   mongoc_uri_destroy (uri);
+   mongoc_socket_destroy (stand_in.listen_sock);
+   bson_mutex_destroy (&stand_in.mutex);
+   bson_free (stand_in.body);
+}
+
 void
 test_aws_install (TestSuite *suite)
 {
@@ -282,6 +447,13 @@ test_aws_install (TestSuite *suite)
                       NULL /* ctx */,
                       test_framework_skip_if_no_aws,
                       test_framework_skip_if_no_setenv);
+   TestSuite_AddFull (suite,
+                      "/aws/obtain_credentials_cached",
+                      test_obtain_credentials_cached,
+                      NULL /* dtor */,
+                      NULL /* ctx */,
+                      test_framework_skip_if_no_aws,
+                      test_framework_skip_if_no_setenv);
    TestSuite_AddFull (suite,
                       "/aws/derive_region",
                       test_derive_region,
@@ -41,7 +41,8 @@ typedef struct {
 typedef enum {
    TF_FAST_HEARTBEAT = 1 << 0,
    TF_FAST_MIN_HEARTBEAT = 1 << 1,
-   TF_AUTO_RESPOND_POLLING_ISMASTER = 1 << 2
+   TF_AUTO_RESPOND_POLLING_ISMASTER = 1 << 2,
+   TF_SHARED_MONITOR_THREAD = 1 << 3
 } tf_flags_t;
 
 typedef struct {
@@ -209,6 +210,7 @@ test_fixture_t *
 tf_new (tf_flags_t flags)
 {
    mongoc_apm_callbacks_t *callbacks;
+   mongoc_uri_t *uri;
    test_fixture_t *tf;
 
    tf = bson_malloc0 (sizeof (test_fixture_t));
@@ -225,7 +227,12 @@ tf_new (tf_flags_t flags)
    mongoc_apm_set_server_heartbeat_succeeded_cb (callbacks,
                                                  _heartbeat_succeeded);
    mongoc_apm_set_server_heartbeat_failed_cb (callbacks, _heartbeat_failed);
-   tf->pool = mongoc_client_pool_new (mock_server_get_uri (tf->server));
+   uri = mongoc_uri_copy (mock_server_get_uri (tf->server));
+   if (flags & TF_SHARED_MONITOR_THREAD) {
+      mongoc_uri_set_option_as_bool (uri, MONGOC_URI_SHAREDMONITORTHREAD, true);
+   }
+   tf->pool = mongoc_client_pool_new (uri);
+   mongoc_uri_destroy (uri);
    mongoc_client_pool_set_apm_callbacks (tf->pool, callbacks, tf);
    mongoc_apm_callbacks_destroy (callbacks);
 
@@ -255,8 +262,10 @@ void
 tf_destroy (test_fixture_t *tf)
 {
    mock_server_destroy (tf->server);
-   mongoc_client_pool_push (tf->pool, tf->client);
-   mongoc_client_pool_destroy (tf->pool);
+   if (tf->pool) {
+      mongoc_client_pool_push (tf->pool, tf->client);
+      mongoc_client_pool_destroy (tf->pool);
+   }
    bson_string_free (tf->logs, true);
    bson_mutex_destroy (&tf->mutex);
    mongoc_cond_destroy (&tf->cond);
@@ -1123,6 +1132,90 @@ test_moretocome_cancel (void)
    tf_destroy (tf);
 }
 
+static void
+test_shared_monitor_thread_succeeds (void)
+{
+   test_fixture_t *tf;
+   request_t *request;
+
+   tf = tf_new (TF_SHARED_MONITOR_THREAD | TF_FAST_MIN_HEARTBEAT);
+   request = mock_server_receives_ismaster (tf->server);
+   OBSERVE (tf, request);
+   OBSERVE (tf, tf->observations->n_heartbeat_started == 1);
+   mock_server_replies_ok_and_destroys (request);
+   OBSERVE_SOON (tf, tf->observations->n_heartbeat_succeeded == 1);
+   OBSERVE_SOON (tf, tf->observations->sd_type == MONGOC_SERVER_STANDALONE);
+
+   /* No server monitor threads are started. */
+   bson_mutex_lock (&tf->client->topology->mutex);
+   ASSERT_CMPINT (tf->client->topology->server_monitors->items_len, ==, 0);
+   ASSERT_CMPINT (tf->client->topology->rtt_monitors->items_len, ==, 0);
+   bson_mutex_unlock (&tf->client->topology->mutex);
+
+   /* A requested scan runs without waiting for heartbeatFrequencyMS. */
+   _request_scan (tf);
+   request = mock_server_receives_ismaster (tf->server);
+   OBSERVE (tf, request);
+   OBSERVE (tf, tf->observations->n_heartbeat_started == 2);
+   mock_server_replies_ok_and_destroys (request);
+   OBSERVE_SOON (tf, tf->observations->n_heartbeat_succeeded == 2);
+   WAIT_TWO_MIN_HEARTBEAT_MS;
+   OBSERVE (tf, tf->observations->n_heartbeat_started == 2);
+
+   tf_destroy (tf);
+}
+
+static void
+test_shared_monitor_thread_retry (void)
+{
+   test_fixture_t *tf;
+   request_t *request;
+
+   tf = tf_new (TF_SHARED_MONITOR_THREAD | TF_FAST_MIN_HEARTBEAT);
+   request = mock_server_receives_ismaster (tf->server);
+   OBSERVE (tf, request);
+   mock_server_replies_ok_and_destroys (request);
+   OBSERVE_SOON (tf, tf->observations->sd_type == MONGOC_SERVER_STANDALONE);
+
+   _request_scan (tf);
+   request = mock_server_receives_ismaster (tf->server);
+   OBSERVE (tf, request);
+   mock_server_hangs_up (request);
+   request_destroy (request);
+   OBSERVE_SOON (tf, tf->observations->n_heartbeat_failed == 1);
+
+   /* The server is checked again in the same scan. */
+   request = mock_server_receives_ismaster (tf->server);
+   OBSERVE (tf, request);
+   OBSERVE (tf, tf->observations->n_heartbeat_started == 3);
+   mock_server_replies_ok_and_destroys (request);
+   OBSERVE_SOON (tf, tf->observations->n_heartbeat_succeeded == 2);
+   OBSERVE_SOON (tf, tf->observations->sd_type == MONGOC_SERVER_STANDALONE);
+
+   tf_destroy (tf);
+}
+
+static void
+test_shared_monitor_thread_shutdown (void)
+{
+   test_fixture_t *tf;
+   request_t *request;
+
+   tf = tf_new (TF_SHARED_MONITOR_THREAD);
+   request = mock_server_receives_ismaster (tf->server);
+   OBSERVE (tf, request);
+
+   /* Destroying the pool cancels the scan in progress. */
+   mongoc_client_pool_push (tf->pool, tf->client);
+   mongoc_client_pool_destroy (tf->pool);
+   tf->pool = NULL;
+   tf->client = NULL;
+   request_destroy (request);
+   OBSERVE (tf, tf->observations->n_heartbeat_succeeded == 0);
+
+   tf_destroy (tf);
+}
+
 void
 test_monitoring_install (TestSuite *suite)
 {
@@ -1192,4 +1285,15 @@ test_monitoring_install (TestSuite *suite)
 
    TestSuite_AddMockServerTest (
       suite, "/server_monitor_thread/sleep_after_scan", test_sleep_after_scan);
+
+   /* Tests for the sharedMonitorThread option. */
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_thread/shared/succeeds",
+                                test_shared_monitor_thread_succeeds);
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_thread/shared/retry",
+                                test_shared_monitor_thread_retry);
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_thread/shared/shutdown",
+                                test_shared_monitor_thread_shutdown);
 }
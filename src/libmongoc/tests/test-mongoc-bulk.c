@@ -4593,6 +4593,231 @@ test_bulk_collation_w0_wire4 (void)
    _test_bulk_collation (0, WIRE_VERSION_COLLATION - 1, BULK_UPDATE_ONE);
 }
 
+
+typedef struct {
+   debug_stream_stats_t *stats;
+   /* n_writev when each "succeeded" event was published */
+   int n_writev[10];
+   int n_succeeded;
+   int n_failed;
+} w0_apm_t;
+
+
+static void
+w0_succeeded_cb (const mongoc_apm_command_succeeded_t *event)
+{
+   w0_apm_t *apm;
+
+   apm = (w0_apm_t *) mongoc_apm_command_succeeded_get_context (event);
+
+   BSON_ASSERT (apm->n_succeeded < 10);
+   apm->n_writev[apm->n_succeeded++] = apm->stats->n_writev;
+}
+
+
+static void
+w0_failed_cb (const mongoc_apm_command_failed_t *event)
+{
+   w0_apm_t *apm = (w0_apm_t *) mongoc_apm_command_failed_get_context (event);
+
+   apm->n_failed++;
+}
+
+
+static void
+w0_set_apm (mongoc_client_t *client, w0_apm_t *apm)
+{
+   mongoc_apm_callbacks_t *callbacks;
+
+   callbacks = mongoc_apm_callbacks_new ();
+   mongoc_apm_set_command_succeeded_cb (callbacks, w0_succeeded_cb);
+   mongoc_apm_set_command_failed_cb (callbacks, w0_failed_cb);
+   mongoc_client_set_apm_callbacks (client, callbacks, apm);
+   mongoc_apm_callbacks_destroy (callbacks);
+}
+
+
+/* unacknowledged commands in one bulk are coalesced into one socket write */
+static void
+test_bulk_w0_coalesced (void)
+{
+   mock_server_t *mock_server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_bulk_operation_t *bulk;
+   debug_stream_stats_t stats = {0};
+   w0_apm_t apm = {0};
+   bson_error_t error;
+   request_t *request;
+   future_t *future;
+   int n_writev;
+   int i;
+   bool r;
+
+   mock_server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (mock_server);
+
+   client = mongoc_client_new_from_uri (mock_server_get_uri (mock_server));
+   test_framework_set_debug_stream (client, &stats);
+   apm.stats = &stats;
+   w0_set_apm (client, &apm);
+   collection = mongoc_client_get_collection (client, "db", "collection");
+
+   /* connect before counting writes */
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      mock_server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   bulk = mongoc_collection_create_bulk_operation_with_opts (
+      collection, tmp_bson ("{'writeConcern': {'w': 0}}"));
+
+   /* an insert, an update and another insert make three commands */
+   mongoc_bulk_operation_insert (bulk, tmp_bson ("{'_id': 1}"));
+   r = mongoc_bulk_operation_update_one_with_opts (
+      bulk,
+      tmp_bson ("{'_id': 1}"),
+      tmp_bson ("{'$set': {'x': 1}}"),
+      NULL,
+      &error);
+   ASSERT_OR_PRINT (r, error);
+   mongoc_bulk_operation_insert (bulk, tmp_bson ("{'_id': 2}"));
+
+   n_writev = stats.n_writev;
+   apm.n_succeeded = 0;
+   ASSERT_CMPUINT32 (
+      mongoc_bulk_operation_execute (bulk, NULL, &error), !=, (uint32_t) 0);
+   ASSERT_CMPINT (stats.n_writev, ==, n_writev + 1);
+
+   /* each command's "succeeded" event is published once it is written */
+   ASSERT_CMPINT (apm.n_succeeded, ==, 3);
+   for (i = 0; i < 3; i++) {
+      ASSERT_CMPINT (apm.n_writev[i], ==, n_writev + 1);
+   }
+
+   request = mock_server_receives_msg (
+      mock_server,
+      MONGOC_MSG_MORE_TO_COME,
+      tmp_bson ("{'insert': 'collection', 'writeConcern': {'w': 0}}"),
+      tmp_bson ("{'_id': 1}"));
+   request_destroy (request);
+   request = mock_server_receives_msg (
+      mock_server,
+      MONGOC_MSG_MORE_TO_COME,
+      tmp_bson ("{'update': 'collection', 'writeConcern': {'w': 0}}"),
+      tmp_bson ("{'q': {'_id': 1}, 'u': {'$set': {'x': 1}}}"));
+   request_destroy (request);
+   request = mock_server_receives_msg (
+      mock_server,
+      MONGOC_MSG_MORE_TO_COME,
+      tmp_bson ("{'insert': 'collection', 'writeConcern': {'w': 0}}"),
+      tmp_bson ("{'_id': 2}"));
+   request_destroy (request);
+
+   /* acknowledged commands are still written immediately */
+   n_writev = stats.n_writev;
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      mock_server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   ASSERT_CMPINT (stats.n_writev, ==, n_writev + 1);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   mongoc_bulk_operation_destroy (bulk);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (mock_server);
+}
+
+
+/* an unordered w:0 bulk selects a new stream when writing a batch fails */
+static void
+test_bulk_w0_unordered_reselect (void)
+{
+   mock_server_t *mock_server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_bulk_operation_t *bulk;
+   debug_stream_stats_t stats = {0};
+   w0_apm_t apm = {0};
+   bson_error_t error;
+   request_t *request;
+   future_t *future;
+   char *big_string;
+   bool r;
+
+   mock_server = mock_server_new ();
+   /* two of the commands below fill a batch */
+   mock_server_auto_ismaster (mock_server,
+                              "{'ismaster': true,"
+                              " 'maxWireVersion': %d,"
+                              " 'maxMessageSizeBytes': 1000}",
+                              WIRE_VERSION_OP_MSG);
+   mock_server_run (mock_server);
+
+   client = mongoc_client_new_from_uri (mock_server_get_uri (mock_server));
+   test_framework_set_debug_stream (client, &stats);
+   apm.stats = &stats;
+   w0_set_apm (client, &apm);
+   collection = mongoc_client_get_collection (client, "db", "collection");
+
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      mock_server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   bulk = mongoc_collection_create_bulk_operation_with_opts (
+      collection, tmp_bson ("{'ordered': false, 'writeConcern': {'w': 0}}"));
+
+   big_string = bson_malloc (600);
+   memset (big_string, 'a', 599);
+   big_string[599] = '\0';
+   mongoc_bulk_operation_insert (
+      bulk, tmp_bson ("{'_id': 1, 's': '%s'}", big_string));
+   r = mongoc_bulk_operation_update_one_with_opts (
+      bulk,
+      tmp_bson ("{'_id': 1}"),
+      tmp_bson ("{'$set': {'s': '%s'}}", big_string),
+      NULL,
+      &error);
+   ASSERT_OR_PRINT (r, error);
+   mongoc_bulk_operation_insert (bulk, tmp_bson ("{'_id': 2}"));
+
+   /* writing the first two commands fails */
+   stats.n_writev_fail = 1;
+   apm.n_succeeded = 0;
+   ASSERT_CMPUINT32 (
+      mongoc_bulk_operation_execute (bulk, NULL, &error), ==, (uint32_t) 0);
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_STREAM,
+                          MONGOC_ERROR_STREAM_SOCKET,
+                          "Failure during socket delivery");
+   ASSERT_CMPINT (apm.n_failed, ==, 2);
+   ASSERT_CMPINT (apm.n_succeeded, ==, 1);
+
+   /* the last command is sent on a new connection */
+   request = mock_server_receives_msg (
+      mock_server,
+      MONGOC_MSG_MORE_TO_COME,
+      tmp_bson ("{'insert': 'collection', 'writeConcern': {'w': 0}}"),
+      tmp_bson ("{'_id': 2}"));
+   request_destroy (request);
+
+   bson_free (big_string);
+   mongoc_bulk_operation_destroy (bulk);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (mock_server);
+}
+
 static void
 test_bulk_update_one_error_message (void)
 {
@@ -5070,6 +5295,11 @@ test_bulk_install (TestSuite *suite)
    TestSuite_AddMockServerTest (suite,
                                 "/BulkOperation/opts/collation/multi/w1/wire4",
                                 test_bulk_collation_multi_w1_wire4);
+   TestSuite_AddMockServerTest (
+      suite, "/BulkOperation/w0/coalesced", test_bulk_w0_coalesced);
+   TestSuite_AddMockServerTest (suite,
+                                "/BulkOperation/w0/unordered_reselect",
+                                test_bulk_w0_unordered_reselect);
    TestSuite_Add (suite,
                   "/BulkOperation/update_one/error_message",
                   test_bulk_update_one_error_message);
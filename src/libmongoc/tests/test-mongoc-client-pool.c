@@ -1,10 +1,16 @@
 #include <mongoc/mongoc.h>
 #include "mongoc/mongoc-client-pool-private.h"
+#include "mongoc/mongoc-client-private.h"
+#include "mongoc/mongoc-cluster-private.h"
+#include "mongoc/mongoc-connection-pool-private.h"
 #include "mongoc/mongoc-util-private.h"
 
 
 #include "TestSuite.h"
 #include "test-libmongoc.h"
+#include "test-conveniences.h"
+#include "mock_server/future-functions.h"
+#include "mock_server/mock-server.h"
 
 
 static void
@@ -467,6 +473,719 @@ test_client_pool_max_pool_size_exceeded (void)
    bson_free (args);
 }
 
+/* Contention benchmark: many threads pop a client, touch it, and push it
+ * back. Run the test suite with -d to see the throughput. */
+#define CONTENTION_THREADS 16
+#define CONTENTION_ITERATIONS 5000
+
+typedef struct {
+   mongoc_client_pool_t *pool;
+   int64_t n_ops;
+} contention_args_t;
+
+static BSON_THREAD_FUN (contention_worker, arg)
+{
+   contention_args_t *args = arg;
+   mongoc_client_t *client;
+   int i;
+
+   for (i = 0; i < CONTENTION_ITERATIONS; i++) {
+      client = mongoc_client_pool_pop (args->pool);
+      BSON_ASSERT (client);
+      BSON_ASSERT (mongoc_client_get_uri (client));
+      mongoc_client_pool_push (args->pool, client);
+      args->n_ops++;
+   }
+
+   BSON_THREAD_RETURN;
+}
+
+static void
+_test_client_pool_contention (const char *uri_str, uint32_t max_pool_size)
+{
+   mongoc_client_pool_t *pool;
+   mongoc_uri_t *uri;
+   bson_thread_t threads[CONTENTION_THREADS];
+   contention_args_t args[CONTENTION_THREADS];
+   int64_t start;
+   int64_t usec;
+   int64_t n_ops = 0;
+   int i;
+
+   uri = mongoc_uri_new (uri_str);
+   pool = mongoc_client_pool_new (uri);
+
+   start = bson_get_monotonic_time ();
+   for (i = 0; i < CONTENTION_THREADS; i++) {
+      args[i].pool = pool;
+      args[i].n_ops = 0;
+      COMMON_PREFIX (thread_create) (&threads[i], contention_worker, &args[i]);
+   }
+
+   for (i = 0; i < CONTENTION_THREADS; i++) {
+      COMMON_PREFIX (thread_join) (threads[i]);
+      n_ops += args[i].n_ops;
+   }
+   usec = BSON_MAX (bson_get_monotonic_time () - start, 1);
+
+   MONGOC_DEBUG ("%s: %d threads, %" PRId64 " pop/push in %" PRId64
+                 " usec (%.0f ops/sec)",
+                 uri_str,
+                 CONTENTION_THREADS,
+                 n_ops,
+                 usec,
+                 n_ops * 1e6 / usec);
+
+   ASSERT_CMPINT64 (
+      n_ops, ==, (int64_t) CONTENTION_THREADS * CONTENTION_ITERATIONS);
+   /* every client was returned and none leaked or were double-counted */
+   ASSERT_CMPSIZE_T (mongoc_client_pool_get_size (pool), <=, max_pool_size);
+   ASSERT_CMPSIZE_T (mongoc_client_pool_num_pushed (pool),
+                     ==,
+                     mongoc_client_pool_get_size (pool));
+
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+}
+
+static void
+test_client_pool_contention (void)
+{
+   /* enough clients for every thread: checkout should rarely block */
+   _test_client_pool_contention ("mongodb://127.0.0.1/?maxpoolsize=100", 100);
+   /* fewer clients than threads: exercises waiting and direct hand-off */
+   _test_client_pool_contention ("mongodb://127.0.0.1/?maxpoolsize=4", 4);
+}
+
+static size_t
+_count_idle (mongoc_client_pool_t *pool)
+{
+   return mongoc_connection_pool_count_idle (
+      _mongoc_client_pool_get_topology (pool)->connection_pool);
+}
+
+
+/* test that clients of a pool share connections, each checked out only while
+ * an operation uses it */
+static void
+test_client_pool_shared_connections (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client1;
+   mongoc_client_t *client2;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   pool = mongoc_client_pool_new (mock_server_get_uri (server));
+   client1 = mongoc_client_pool_pop (pool);
+   client2 = mongoc_client_pool_pop (pool);
+
+   future = future_client_command_simple (
+      client1, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 0);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   /* client1 returned its connection */
+   ASSERT_CMPINT ((int) client1->cluster.nodes->items_len, ==, 0);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 1);
+
+   /* client2 uses the same connection instead of opening another */
+   future = future_client_command_simple (
+      client2, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 0);
+   ASSERT_CMPINT ((int) client2->cluster.nodes->items_len, ==, 1);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   ASSERT_CMPINT ((int) client2->cluster.nodes->items_len, ==, 0);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 1);
+
+   mongoc_client_pool_push (pool, client1);
+   mongoc_client_pool_push (pool, client2);
+   mongoc_client_pool_destroy (pool);
+   mock_server_destroy (server);
+}
+
+
+/* a network error closes the pool's idle connections to the server */
+static void
+test_client_pool_purge_on_network_error (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client1;
+   mongoc_client_t *client2;
+   future_t *future1;
+   future_t *future2;
+   request_t *request1;
+   request_t *request2;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   pool = mongoc_client_pool_new (mock_server_get_uri (server));
+   client1 = mongoc_client_pool_pop (pool);
+   client2 = mongoc_client_pool_pop (pool);
+
+   /* concurrent commands open two connections */
+   future1 = future_client_command_simple (
+      client1, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request1 = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   future2 = future_client_command_simple (
+      client2, "admin", tmp_bson ("{'ping': 2}"), NULL, NULL, &error);
+   request2 = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 2}"));
+   mock_server_replies_ok_and_destroys (request1);
+   ASSERT_OR_PRINT (future_get_bool (future1), error);
+   mock_server_replies_ok_and_destroys (request2);
+   ASSERT_OR_PRINT (future_get_bool (future2), error);
+   future_destroy (future1);
+   future_destroy (future2);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 2);
+
+   future1 = future_client_command_simple (
+      client1, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request1 = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 1);
+   mock_server_hangs_up (request1);
+   BSON_ASSERT (!future_get_bool (future1));
+   future_destroy (future1);
+   request_destroy (request1);
+
+   /* the other connection to the server is closed, not left idle */
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 0);
+
+   mongoc_client_pool_push (pool, client1);
+   mongoc_client_pool_push (pool, client2);
+   mongoc_client_pool_destroy (pool);
+   mock_server_destroy (server);
+}
+
+
+/* idle connections to a server removed from the topology are closed */
+static void
+test_client_pool_purge_removed_server (void)
+{
+   mock_server_t *primary;
+   mock_server_t *secondary;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+   mongoc_read_prefs_t *prefs;
+   mongoc_connection_pool_t *connection_pool;
+   mongoc_server_description_t *sd;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+   uint32_t secondary_id;
+   int primary_responder;
+
+   primary = mock_server_new ();
+   secondary = mock_server_new ();
+   mock_server_run (primary);
+   mock_server_run (secondary);
+
+   primary_responder = mock_server_auto_ismaster (
+      primary,
+      "{'ok': 1, 'ismaster': true, 'setName': 'rs', 'maxWireVersion': %d,"
+      " 'hosts': ['%s', '%s']}",
+      WIRE_VERSION_OP_MSG,
+      mock_server_get_host_and_port (primary),
+      mock_server_get_host_and_port (secondary));
+   mock_server_auto_ismaster (secondary,
+                              "{'ok': 1, 'ismaster': false, 'secondary': true,"
+                              " 'setName': 'rs', 'maxWireVersion': %d,"
+                              " 'hosts': ['%s', '%s']}",
+                              WIRE_VERSION_OP_MSG,
+                              mock_server_get_host_and_port (primary),
+                              mock_server_get_host_and_port (secondary));
+
+   uri = mongoc_uri_copy (mock_server_get_uri (primary));
+   mongoc_uri_set_option_as_utf8 (uri, MONGOC_URI_REPLICASET, "rs");
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_HEARTBEATFREQUENCYMS, 500);
+   pool = mongoc_client_pool_new (uri);
+   client = mongoc_client_pool_pop (pool);
+   connection_pool = _mongoc_client_pool_get_topology (pool)->connection_pool;
+
+   prefs = mongoc_read_prefs_new (MONGOC_READ_SECONDARY);
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), prefs, NULL, &error);
+   request = mock_server_receives_msg (
+      secondary, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   sd = mongoc_client_select_server (client, false, prefs, &error);
+   ASSERT_OR_PRINT (sd, error);
+   secondary_id = mongoc_server_description_id (sd);
+   mongoc_server_description_destroy (sd);
+   ASSERT_CMPSIZE_T (
+      mongoc_connection_pool_count_idle_for_server (connection_pool,
+                                                    secondary_id),
+      ==,
+      (size_t) 1);
+
+   /* the primary no longer lists the secondary */
+   mock_server_remove_autoresponder (primary, primary_responder);
+   mock_server_auto_ismaster (primary,
+                              "{'ok': 1, 'ismaster': true, 'setName': 'rs',"
+                              " 'maxWireVersion': %d, 'hosts': ['%s']}",
+                              WIRE_VERSION_OP_MSG,
+                              mock_server_get_host_and_port (primary));
+
+   WAIT_UNTIL (mongoc_connection_pool_count_idle_for_server (
+                  connection_pool, secondary_id) == 0);
+
+   mongoc_read_prefs_destroy (prefs);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (secondary);
+   mock_server_destroy (primary);
+}
+
+
+/* test that a client keeps its connection while a reply for it is pending */
+static void
+test_client_pool_connection_pinned (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   pool = mongoc_client_pool_new (mock_server_get_uri (server));
+   client = mongoc_client_pool_pop (pool);
+   collection = mongoc_client_get_collection (client, "db", "coll");
+   cursor = mongoc_collection_find_with_opts (
+      collection, tmp_bson ("{}"), tmp_bson ("{'prefetch': 0}"), NULL);
+
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'find': 'coll'}"));
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '123'},"
+                " 'ns': 'db.coll', 'firstBatch': [{'a': 1}]}}"));
+   ASSERT (future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+
+   /* the prefetched getMore's reply will arrive on this client's connection */
+   request = mock_server_receives_msg (
+      server,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'getMore': {'$numberLong': '123'}, 'collection': 'coll'}"));
+   ASSERT_CMPINT ((int) client->cluster.nodes->items_len, ==, 1);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 0);
+
+   future = future_cursor_next (cursor, &doc);
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '0'},"
+                " 'ns': 'db.coll', 'nextBatch': [{'a': 2}]}}"));
+   ASSERT (future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+
+   /* reply read, the connection is returned */
+   ASSERT_CMPINT ((int) client->cluster.nodes->items_len, ==, 0);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 1);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mock_server_destroy (server);
+}
+
+static mongoc_client_pool_t *
+_pool_with_min_size (mock_server_t *server, int32_t min_pool_size)
+{
+   mongoc_client_pool_t *pool;
+   mongoc_uri_t *uri;
+
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MINPOOLSIZE, min_pool_size);
+   capture_logs (true); /* minPoolSize is deprecated */
+   pool = mongoc_client_pool_new (uri);
+   capture_logs (false);
+   mongoc_uri_destroy (uri);
+
+   return pool;
+}
+
+
+static void
+test_client_pool_warm_up (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   pool = _pool_with_min_size (server, 3);
+
+   ASSERT_OR_PRINT (mongoc_client_pool_warm_up (pool, 10000, &error), error);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 3);
+   mongoc_client_pool_destroy (pool);
+
+   /* without minPoolSize, one connection per server. no background
+    * maintenance replaces it while it is in use */
+   pool = mongoc_client_pool_new (mock_server_get_uri (server));
+   ASSERT_OR_PRINT (mongoc_client_pool_warm_up (pool, 10000, &error), error);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 1);
+
+   /* an operation uses the warm connection instead of opening one */
+   client = mongoc_client_pool_pop (pool);
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 0);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 1);
+
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_client_pool_warm_up_no_servers (void)
+{
+   mongoc_client_pool_t *pool;
+   mongoc_uri_t *uri;
+   bson_error_t error;
+
+   /* nothing listens on port 1 */
+   uri = mongoc_uri_new ("mongodb://127.0.0.1:1/?connectTimeoutMS=100");
+   pool = mongoc_client_pool_new (uri);
+
+   BSON_ASSERT (!mongoc_client_pool_warm_up (pool, 1000, &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_SERVER_SELECTION,
+                          MONGOC_ERROR_SERVER_SELECTION_FAILURE,
+                          "No suitable servers found to warm up");
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 0);
+
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+}
+
+
+/* connections are opened in the background once a server is selectable */
+static void
+test_client_pool_min_size_maintenance (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   pool = _pool_with_min_size (server, 2);
+
+   /* the first client starts monitoring and maintenance */
+   client = mongoc_client_pool_pop (pool);
+   WAIT_UNTIL (_count_idle (pool) == 2);
+
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mock_server_destroy (server);
+}
+
+
+typedef struct {
+   mongoc_connection_pool_t *connection_pool;
+   uint32_t server_id;
+   mongoc_cluster_node_t *node;
+   volatile int32_t done;
+} max_connecting_args_t;
+
+static BSON_THREAD_FUN (max_connecting_worker, arg)
+{
+   max_connecting_args_t *args = arg;
+
+   BSON_ASSERT (mongoc_connection_pool_checkout_or_reserve (
+      args->connection_pool, args->server_id, 1, 10000, &args->node));
+   bson_atomic_int_add (&args->done, 1);
+
+   BSON_THREAD_RETURN;
+}
+
+/* once maxConnecting connections are being established, a thread that needs
+ * another waits for a connection to be checked in */
+static void
+test_client_pool_max_connecting (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_connection_pool_t *connection_pool;
+   mongoc_cluster_node_t *node;
+   max_connecting_args_t args = {0};
+   bson_thread_t thread;
+   bson_error_t error;
+   uint32_t server_id;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   pool = mongoc_client_pool_new (mock_server_get_uri (server));
+   ASSERT_OR_PRINT (mongoc_client_pool_warm_up (pool, 10000, &error), error);
+   connection_pool = _mongoc_client_pool_get_topology (pool)->connection_pool;
+   server_id = 1;
+
+   /* take the idle connection, then reserve the only connecting slot */
+   BSON_ASSERT (mongoc_connection_pool_checkout_or_reserve (
+      connection_pool, server_id, 1, 10000, &node));
+   BSON_ASSERT (node);
+   BSON_ASSERT (mongoc_connection_pool_checkout_or_reserve (
+      connection_pool, server_id, 1, 10000, &args.node));
+   BSON_ASSERT (!args.node);
+
+   /* waiting for the slot times out */
+   BSON_ASSERT (!mongoc_connection_pool_checkout_or_reserve (
+      connection_pool, server_id, 1, 100, &args.node));
+   BSON_ASSERT (!args.node);
+
+   args.connection_pool = connection_pool;
+   args.server_id = server_id;
+   COMMON_PREFIX (thread_create) (&thread, max_connecting_worker, &args);
+
+   _mongoc_usleep (100 * 1000);
+   ASSERT_CMPINT (bson_atomic_int_add (&args.done, 0), ==, 0);
+
+   /* the waiting thread gets the connection that is checked in */
+   mongoc_connection_pool_checkin (connection_pool, server_id, node);
+   COMMON_PREFIX (thread_join) (thread);
+   BSON_ASSERT (args.node == node);
+
+   mongoc_connection_pool_end_connect (connection_pool, server_id);
+   mongoc_connection_pool_checkin (connection_pool, server_id, node);
+   mongoc_client_pool_destroy (pool);
+   mock_server_destroy (server);
+}
+
+
+/* an operation fails instead of waiting forever for maxConnecting */
+static void
+test_client_pool_max_connecting_timeout (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_connection_pool_t *connection_pool;
+   mongoc_cluster_node_t *node;
+   mongoc_cluster_node_t *reserved;
+   bson_error_t error;
+   bool r;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXCONNECTING, 1);
+   mongoc_uri_set_option_as_int32 (
+      uri, MONGOC_URI_SERVERSELECTIONTIMEOUTMS, 200);
+   pool = mongoc_client_pool_new (uri);
+   ASSERT_OR_PRINT (mongoc_client_pool_warm_up (pool, 10000, &error), error);
+   connection_pool = _mongoc_client_pool_get_topology (pool)->connection_pool;
+
+   /* take the idle connection and the only connecting slot */
+   BSON_ASSERT (mongoc_connection_pool_checkout_or_reserve (
+      connection_pool, 1, 1, 10000, &node));
+   BSON_ASSERT (node);
+   BSON_ASSERT (mongoc_connection_pool_checkout_or_reserve (
+      connection_pool, 1, 1, 10000, &reserved));
+   BSON_ASSERT (!reserved);
+
+   client = mongoc_client_pool_pop (pool);
+   r = mongoc_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   BSON_ASSERT (!r);
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_STREAM,
+                          MONGOC_ERROR_STREAM_CONNECT,
+                          "maxConnecting connections are being established");
+
+   mongoc_connection_pool_end_connect (connection_pool, 1);
+   mongoc_connection_pool_checkin (connection_pool, 1, node);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+
+
+/* run a ping on each client at once, so each needs its own connection */
+static void
+_ping_concurrently (mock_server_t *server,
+                    mongoc_client_t **clients,
+                    size_t n_clients)
+{
+   future_t *futures[4];
+   request_t *requests[4];
+   bson_error_t error;
+   size_t i;
+
+   BSON_ASSERT (n_clients <= 4);
+
+   for (i = 0; i < n_clients; i++) {
+      futures[i] = future_client_command_simple (
+         clients[i], "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+      requests[i] = mock_server_receives_msg (
+         server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   }
+
+   for (i = 0; i < n_clients; i++) {
+      mock_server_replies_ok_and_destroys (requests[i]);
+      BSON_ASSERT (future_get_bool (futures[i]));
+      future_destroy (futures[i]);
+   }
+}
+
+
+static void
+test_client_pool_max_idle_time (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_uri_t *uri;
+   mongoc_client_t *clients[2];
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXIDLETIMEMS, 100);
+   pool = mongoc_client_pool_new (uri);
+   clients[0] = mongoc_client_pool_pop (pool);
+   clients[1] = mongoc_client_pool_pop (pool);
+
+   _ping_concurrently (server, clients, 2);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 2);
+
+   /* the reaper closes both connections */
+   WAIT_UNTIL (_count_idle (pool) == 0);
+
+   mongoc_client_pool_push (pool, clients[0]);
+   mongoc_client_pool_push (pool, clients[1]);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+
+/* the time the most recently used idle connection was last used, or 0 */
+static int64_t
+_newest_idle_usec (mongoc_client_pool_t *pool)
+{
+   mongoc_connection_pool_t *connection_pool =
+      _mongoc_client_pool_get_topology (pool)->connection_pool;
+   mongoc_connection_pool_server_t *server;
+   mongoc_cluster_node_t *node;
+   int64_t newest = 0;
+   size_t i;
+
+   bson_mutex_lock (&connection_pool->mutex);
+   for (i = 0; i < connection_pool->servers->items_len; i++) {
+      server = (mongoc_connection_pool_server_t *) mongoc_set_get_item (
+         connection_pool->servers, (int) i);
+      for (node = server->idle; node; node = node->next) {
+         newest = BSON_MAX (newest, node->last_used_usec);
+      }
+   }
+
+   bson_mutex_unlock (&connection_pool->mutex);
+
+   return newest;
+}
+
+
+/* with minPoolSize, connections idle longer than maxIdleTimeMS are replaced
+ * rather than kept, so the next operation finds a usable connection */
+static void
+test_client_pool_max_idle_time_min_pool_size (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_uri_t *uri;
+   mongoc_client_t *client;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+   uint16_t port;
+   int64_t used_usec;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXIDLETIMEMS, 100);
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MINPOOLSIZE, 1);
+   capture_logs (true); /* minPoolSize is deprecated */
+   pool = mongoc_client_pool_new (uri);
+   capture_logs (false);
+   client = mongoc_client_pool_pop (pool);
+
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   port = request_get_client_port (request);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+   used_usec = bson_get_monotonic_time ();
+
+   /* the connection expires and is replaced by one opened later */
+   WAIT_UNTIL (_newest_idle_usec (pool) > used_usec + 100 * 1000);
+   ASSERT_CMPSIZE_T (_count_idle (pool), ==, (size_t) 1);
+
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   ASSERT_CMPINT ((int) request_get_client_port (request), !=, (int) port);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+
 void
 test_client_pool_install (TestSuite *suite)
 {
@@ -505,4 +1224,36 @@ test_client_pool_install (TestSuite *suite)
    TestSuite_AddLive (suite,
                       "/ClientPool/max_pool_size_exceeded",
                       test_client_pool_max_pool_size_exceeded);
+   TestSuite_Add (
+      suite, "/ClientPool/contention", test_client_pool_contention);
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientPool/shared_connections",
+                                test_client_pool_shared_connections);
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientPool/purge/network_error",
+                                test_client_pool_purge_on_network_error);
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientPool/purge/removed_server",
+                                test_client_pool_purge_removed_server);
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientPool/connection_pinned",
+                                test_client_pool_connection_pinned);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientPool/warm_up", test_client_pool_warm_up);
+   TestSuite_Add (suite,
+                  "/ClientPool/warm_up/no_servers",
+                  test_client_pool_warm_up_no_servers);
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientPool/min_size_maintenance",
+                                test_client_pool_min_size_maintenance);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientPool/max_connecting", test_client_pool_max_connecting);
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientPool/max_connecting/timeout",
+                                test_client_pool_max_connecting_timeout);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientPool/max_idle_time", test_client_pool_max_idle_time);
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientPool/max_idle_time/min_pool_size",
+                                test_client_pool_max_idle_time_min_pool_size);
 }
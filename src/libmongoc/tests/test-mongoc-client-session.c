@@ -76,6 +76,23 @@ test_session_no_crypto (void *ctx)
    } while (0)
 
 
+/* the most recently pooled session of the first non-empty shard. tests push
+ * from one thread, so all pooled sessions are in its home shard */
+static mongoc_server_session_t *
+_pooled_session (mongoc_topology_t *topology)
+{
+   int i;
+
+   for (i = 0; i < MONGOC_SERVER_SESSION_POOL_SHARDS; i++) {
+      if (topology->session_pool.shards[i].sessions) {
+         return topology->session_pool.shards[i].sessions;
+      }
+   }
+
+   return NULL;
+}
+
+
 /* "Pool is LIFO" test from Driver Sessions Spec */
 static void
 _test_session_pool_lifo (bool pooled)
@@ -184,7 +201,7 @@ _test_session_pool_timeout (bool pooled)
     * get a session, set last_used_date more than 29 minutes ago and return to
     * the pool. it's timed out & freed.
     */
-   BSON_ASSERT (!client->topology->session_pool);
+   BSON_ASSERT (!_pooled_session (client->topology));
    s = mongoc_client_start_session (client, NULL, &error);
    ASSERT_OR_PRINT (s, error);
    bson_copy_to (mongoc_client_session_get_lsid (s), &lsid);
@@ -193,7 +210,7 @@ _test_session_pool_timeout (bool pooled)
       (bson_get_monotonic_time () - almost_timeout_usec - 100);
 
    mongoc_client_session_destroy (s);
-   BSON_ASSERT (!client->topology->session_pool);
+   BSON_ASSERT (!_pooled_session (client->topology));
 
    /*
     * get a new session, set last_used_date so it has one second left to live,
@@ -209,15 +226,15 @@ _test_session_pool_timeout (bool pooled)
       (bson_get_monotonic_time () + 1000 * 1000 - almost_timeout_usec);
 
    mongoc_client_session_destroy (s);
-   BSON_ASSERT (client->topology->session_pool);
-   ASSERT_SESSIONS_MATCH (&lsid, &client->topology->session_pool->lsid);
+   BSON_ASSERT (_pooled_session (client->topology));
+   ASSERT_SESSIONS_MATCH (&lsid, &_pooled_session (client->topology)->lsid);
 
    _mongoc_usleep (1500 * 1000);
 
    /* getting a new client session must start a new server session */
    s = mongoc_client_start_session (client, NULL, &error);
    ASSERT_SESSIONS_DIFFER (&lsid, mongoc_client_session_get_lsid (s));
-   BSON_ASSERT (!client->topology->session_pool);
+   BSON_ASSERT (!_pooled_session (client->topology));
    mongoc_client_session_destroy (s);
 
    if (pooled) {
@@ -248,8 +265,8 @@ test_session_pool_timeout_pooled (void *ctx)
 }
 
 
-/* test that a session that times out while it's in the pool is reaped when
- * another session is added
+/* test that a session that times out while it's in the pool is reaped by the
+ * pool's maintenance, not when another session is added
  */
 static void
 _test_session_pool_reap (bool pooled)
@@ -293,19 +310,23 @@ _test_session_pool_reap (bool pooled)
       (bson_get_monotonic_time () + 1000 * 1000 - almost_timeout_usec);
 
    mongoc_client_session_destroy (a);
-   BSON_ASSERT (client->topology->session_pool); /* session is pooled */
+   BSON_ASSERT (_pooled_session (client->topology)); /* session is pooled */
 
    _mongoc_usleep (1500 * 1000);
 
-   /*
-    * returning session B causes session A to be reaped
-    */
    b->server_session->last_used_usec = bson_get_monotonic_time ();
    mongoc_client_session_destroy (b);
-   BSON_ASSERT (client->topology->session_pool);
-   ASSERT_SESSIONS_MATCH (&lsid_b, &client->topology->session_pool->lsid);
+   BSON_ASSERT (_pooled_session (client->topology));
+   ASSERT_SESSIONS_MATCH (&lsid_b, &_pooled_session (client->topology)->lsid);
+   ASSERT_CMPINT32 (client->topology->session_pool.n_sessions, ==, 2);
+
+   /*
+    * pruning the pool reaps session A
+    */
+   _mongoc_topology_prune_server_sessions (client->topology);
+   ASSERT_CMPINT32 (client->topology->session_pool.n_sessions, ==, 1);
    /* session B is the only session in the pool */
-   session_pool = client->topology->session_pool;
+   session_pool = _pooled_session (client->topology);
    BSON_ASSERT (session_pool == session_pool->prev);
    BSON_ASSERT (session_pool == session_pool->next);
 
@@ -335,6 +356,53 @@ test_session_pool_reap_pooled (void *ctx)
 }
 
 
+/* prewarmed sessions are handed out before new ones are generated, and
+ * pruning reaps timed-out sessions and replenishes prewarmed ones */
+static void
+test_session_pool_prewarm (void *ctx)
+{
+   mongoc_client_t *client;
+   mongoc_server_session_pool_t *pool;
+   mongoc_server_session_t *a, *b;
+   bson_error_t error;
+
+   client = mongoc_client_new (
+      "mongodb://localhost/?" MONGOC_URI_PREWARMEDSESSIONS "=2");
+   pool = &client->topology->session_pool;
+   ASSERT_CMPINT32 (pool->n_fresh, ==, 2);
+   ASSERT_CMPINT32 (pool->n_sessions, ==, 0);
+
+   a = _mongoc_server_session_pool_pop (pool, 30, &error);
+   ASSERT_OR_PRINT (a, error);
+   b = _mongoc_server_session_pool_pop (pool, 30, &error);
+   ASSERT_OR_PRINT (b, error);
+   ASSERT_CMPINT32 (pool->n_fresh, ==, 0);
+
+   /* a used session is pooled, an unused one is prewarmed again */
+   a->last_used_usec = bson_get_monotonic_time ();
+   _mongoc_server_session_pool_push (pool, a, 30);
+   _mongoc_server_session_pool_push (pool, b, 30);
+   ASSERT_CMPINT32 (pool->n_sessions, ==, 1);
+   ASSERT_CMPINT32 (pool->n_fresh, ==, 1);
+   BSON_ASSERT (_pooled_session (client->topology) == a);
+
+   /* used sessions come first */
+   BSON_ASSERT (_mongoc_server_session_pool_pop (pool, 30, &error) == a);
+
+   /* with two minutes left "a" is pooled. pretend the timeout shrinks, it's
+    * pruned in the background */
+   a->last_used_usec = bson_get_monotonic_time () - 28 * 60 * 1000 * 1000;
+   _mongoc_server_session_pool_push (pool, a, 30);
+   ASSERT_CMPINT32 (pool->n_sessions, ==, 1);
+   _mongoc_server_session_pool_prune (pool, 28);
+   ASSERT_CMPINT32 (pool->n_sessions, ==, 0);
+   _mongoc_server_session_pool_prewarm (pool);
+   ASSERT_CMPINT32 (pool->n_fresh, ==, 2);
+
+   mongoc_client_destroy (client);
+}
+
+
 static void
 test_session_id_bad (void *ctx)
 {
@@ -1227,15 +1295,20 @@ check_session_returned (session_test_t *test, const bson_t *lsid)
    match_ctx_t ctx = {{0}};
    mongoc_server_session_t *ss;
    bool found;
+   int i;
 
    ctx.strict_numeric_types = false;
 
    found = false;
-   CDL_FOREACH (test->session_client->topology->session_pool, ss)
-   {
-      if (match_bson_with_ctx (&ss->lsid, lsid, &ctx)) {
-         found = true;
-         break;
+   ss = NULL;
+   for (i = 0; i < MONGOC_SERVER_SESSION_POOL_SHARDS && !found; i++) {
+      CDL_FOREACH (
+         test->session_client->topology->session_pool.shards[i].sessions, ss)
+      {
+         if (match_bson_with_ctx (&ss->lsid, lsid, &ctx)) {
+            found = true;
+            break;
+         }
       }
    }
 
@@ -1480,9 +1553,9 @@ _test_implicit_session_lsid (session_test_fn_t test_fn)
    test_fn (test);
    check_success (test);
    mongoc_collection_drop_with_opts (test->session_collection, NULL, NULL);
-   BSON_ASSERT (test->client->topology->session_pool);
+   BSON_ASSERT (_pooled_session (test->client->topology));
    ASSERT_CMPINT64 (
-      test->client->topology->session_pool->last_used_usec, >=, start);
+      _pooled_session (test->client->topology)->last_used_usec, >=, start);
    session_test_destroy (test);
 }
 
@@ -2218,13 +2291,10 @@ test_bulk_set_client (session_test_t *test)
 }
 
 
-#define ASSERT_POOL_SIZE(_topology, _expected_size)             \
-   do {                                                         \
-      const mongoc_server_session_t *_tmp;                      \
-      int _n_sessions;                                          \
-      CDL_COUNT ((_topology)->session_pool, _tmp, _n_sessions); \
-      ASSERT_CMPINT (_n_sessions, ==, (int) (_expected_size));  \
-   } while (0)
+#define ASSERT_POOL_SIZE(_topology, _expected_size)          \
+   ASSERT_CMPINT ((int) (_topology)->session_pool.n_sessions, \
+                  ==,                                         \
+                  (int) (_expected_size))
 
 
 static void
@@ -2267,7 +2337,7 @@ test_cursor_implicit_session (void *ctx)
    send_ping (test->client, cs);
    mongoc_client_session_destroy (cs);
    ASSERT_POOL_SIZE (topology, 1);
-   ASSERT_SESSIONS_DIFFER (&find_lsid, &topology->session_pool->lsid);
+   ASSERT_SESSIONS_DIFFER (&find_lsid, &_pooled_session (topology)->lsid);
 
    /* "getMore" uses the same lsid as "find" did */
    bson_reinit (&test->sent_lsid);
@@ -2317,7 +2387,7 @@ test_change_stream_implicit_session (void *ctx)
    send_ping (test->client, cs);
    mongoc_client_session_destroy (cs);
    ASSERT_POOL_SIZE (topology, 1);
-   ASSERT_SESSIONS_DIFFER (&aggregate_lsid, &topology->session_pool->lsid);
+   ASSERT_SESSIONS_DIFFER (&aggregate_lsid, &_pooled_session (topology)->lsid);
 
    /* "getMore" uses the same lsid as "aggregate" did */
    bson_reinit (&test->sent_lsid);
@@ -2613,7 +2683,6 @@ _test_session_dirty_helper (bool retry_succeeds)
    bson_t *failpoint_cmd;
    int pooled_session_count_pre;
    int pooled_session_count_post;
-   mongoc_server_session_t *next;
    int fail_count;
    mongoc_uri_t *uri;
 
@@ -2680,9 +2749,9 @@ _test_session_dirty_helper (bool retry_succeeds)
     * dirty */
    BSON_ASSERT (session->server_session->dirty);
 
-   CDL_COUNT (client->topology->session_pool, next, pooled_session_count_pre);
+   pooled_session_count_pre = client->topology->session_pool.n_sessions;
    mongoc_client_session_destroy (session);
-   CDL_COUNT (client->topology->session_pool, next, pooled_session_count_post);
+   pooled_session_count_post = client->topology->session_pool.n_sessions;
 
    /* Check that destroying in the session did not add it back to the pool. */
    ASSERT_CMPINT (pooled_session_count_pre, ==, pooled_session_count_post);
@@ -2769,6 +2838,12 @@ test_session_install (TestSuite *suite)
                       test_framework_skip_if_no_sessions,
                       test_framework_skip_if_no_crypto,
                       test_framework_skip_if_slow);
+   TestSuite_AddFull (suite,
+                      "/Session/prewarm",
+                      test_session_pool_prewarm,
+                      NULL,
+                      NULL,
+                      test_framework_skip_if_no_crypto);
    TestSuite_AddFull (suite,
                       "/Session/id_bad",
                       test_session_id_bad,
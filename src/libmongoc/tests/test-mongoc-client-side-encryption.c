@@ -17,6 +17,11 @@
 #include "json-test.h"
 #include "test-libmongoc.h"
 
+#include "mongoc/mongoc-crypt-private.h"
+#include "mongoc/mongoc-socket-private.h"
+#include "mongoc/mongoc-stream-private.h"
+#include "mongoc/mongoc-thread-private.h"
+
 static void
 _before_test (json_test_ctx_t *ctx, const bson_t *test)
 {
@@ -2075,6 +2080,128 @@ test_malformed_explicit (void *unused)
    mongoc_client_destroy (client);
 }
 
+static void
+test_explicit_many (void *unused)
+{
+   mongoc_client_t *client;
+   mongoc_collection_t *coll;
+   bson_t *kms_providers;
+   mongoc_client_encryption_t *client_encryption;
+   mongoc_client_encryption_opts_t *client_encryption_opts;
+   mongoc_client_encryption_datakey_opts_t *datakey_opts;
+   mongoc_client_encryption_encrypt_opts_t *det_opts;
+   mongoc_client_encryption_encrypt_opts_t *rand_opts;
+   mongoc_client_encryption_encrypt_opts_t *opts[4];
+   char *altname = "batch_altname";
+   bson_value_t keyid;
+   bson_value_t values[4];
+   bson_value_t ciphertexts[4];
+   bson_value_t decrypted[4];
+   bson_value_t single;
+   bool ret;
+   bson_error_t error;
+   int i;
+
+   /* Create a MongoClient without encryption enabled */
+   client = test_framework_client_new ();
+   coll = mongoc_client_get_collection (client, "keyvault", "datakeys");
+   (void) mongoc_collection_drop (coll, NULL);
+   kms_providers = _make_kms_providers (false /* aws */, true /* local */);
+
+   /* Create a ClientEncryption object */
+   client_encryption_opts = mongoc_client_encryption_opts_new ();
+   mongoc_client_encryption_opts_set_kms_providers (client_encryption_opts,
+                                                    kms_providers);
+   mongoc_client_encryption_opts_set_keyvault_namespace (
+      client_encryption_opts, "keyvault", "datakeys");
+   mongoc_client_encryption_opts_set_keyvault_client (client_encryption_opts,
+                                                      client);
+   client_encryption =
+      mongoc_client_encryption_new (client_encryption_opts, &error);
+   ASSERT_OR_PRINT (client_encryption, error);
+
+   /* Create one key, used by id and by alternate name */
+   datakey_opts = mongoc_client_encryption_datakey_opts_new ();
+   mongoc_client_encryption_datakey_opts_set_keyaltnames (
+      datakey_opts, &altname, 1);
+   ret = mongoc_client_encryption_create_datakey (
+      client_encryption, "local", datakey_opts, &keyid, &error);
+   ASSERT_OR_PRINT (ret, error);
+
+   det_opts = mongoc_client_encryption_encrypt_opts_new ();
+   mongoc_client_encryption_encrypt_opts_set_algorithm (
+      det_opts, MONGOC_AEAD_AES_256_CBC_HMAC_SHA_512_DETERMINISTIC);
+   mongoc_client_encryption_encrypt_opts_set_keyid (det_opts, &keyid);
+   rand_opts = mongoc_client_encryption_encrypt_opts_new ();
+   mongoc_client_encryption_encrypt_opts_set_algorithm (
+      rand_opts, MONGOC_AEAD_AES_256_CBC_HMAC_SHA_512_RANDOM);
+   mongoc_client_encryption_encrypt_opts_set_keyaltname (rand_opts, altname);
+
+   for (i = 0; i < 4; i++) {
+      values[i].value_type = BSON_TYPE_INT32;
+      values[i].value.v_int32 = i;
+      opts[i] = i % 2 ? rand_opts : det_opts;
+   }
+
+   ret = mongoc_client_encryption_encrypt_many (
+      client_encryption, values, opts, 4, ciphertexts, &error);
+   ASSERT_OR_PRINT (ret, error);
+
+   for (i = 0; i < 4; i++) {
+      BSON_ASSERT (ciphertexts[i].value_type == BSON_TYPE_BINARY);
+      BSON_ASSERT (ciphertexts[i].value.v_binary.subtype ==
+                   BSON_SUBTYPE_ENCRYPTED);
+   }
+
+   /* Deterministic encryption matches encrypting the value by itself */
+   ret = mongoc_client_encryption_encrypt (
+      client_encryption, &values[2], det_opts, &single, &error);
+   ASSERT_OR_PRINT (ret, error);
+   BSON_ASSERT (single.value.v_binary.data_len ==
+                ciphertexts[2].value.v_binary.data_len);
+   BSON_ASSERT (0 == memcmp (single.value.v_binary.data,
+                             ciphertexts[2].value.v_binary.data,
+                             single.value.v_binary.data_len));
+   bson_value_destroy (&single);
+
+   ret = mongoc_client_encryption_decrypt_many (
+      client_encryption, ciphertexts, 4, decrypted, &error);
+   ASSERT_OR_PRINT (ret, error);
+
+   for (i = 0; i < 4; i++) {
+      BSON_ASSERT (decrypted[i].value_type == BSON_TYPE_INT32);
+      ASSERT_CMPINT32 (decrypted[i].value.v_int32, ==, i);
+      bson_value_destroy (&decrypted[i]);
+   }
+
+   /* A malformed value fails the whole batch */
+   bson_value_destroy (&ciphertexts[1]);
+   ciphertexts[1].value_type = BSON_TYPE_DOUBLE;
+   ciphertexts[1].value.v_double = 1.23;
+   ret = mongoc_client_encryption_decrypt_many (
+      client_encryption, ciphertexts, 4, decrypted, &error);
+   BSON_ASSERT (!ret);
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_CLIENT,
+                          MONGOC_ERROR_CLIENT_INVALID_ENCRYPTION_ARG,
+                          "ciphertext 1 must be BSON binary subtype 6");
+
+   for (i = 0; i < 4; i++) {
+      bson_value_destroy (&decrypted[i]);
+      bson_value_destroy (&ciphertexts[i]);
+   }
+
+   mongoc_client_encryption_encrypt_opts_destroy (det_opts);
+   mongoc_client_encryption_encrypt_opts_destroy (rand_opts);
+   mongoc_client_encryption_datakey_opts_destroy (datakey_opts);
+   bson_value_destroy (&keyid);
+   mongoc_client_encryption_opts_destroy (client_encryption_opts);
+   mongoc_client_encryption_destroy (client_encryption);
+   bson_destroy (kms_providers);
+   mongoc_collection_destroy (coll);
+   mongoc_client_destroy (client);
+}
+
 static void
 _check_mongocryptd_not_spawned (void)
 {
@@ -2214,6 +2341,425 @@ test_bypass_spawning_via_bypassAutoEncryption (void *unused)
    bson_destroy (kms_providers);
 }
 
+#if defined(MONGOC_ENABLE_CLIENT_SIDE_ENCRYPTION) && defined(MONGOC_ENABLE_SSL)
+/* base64 of the 96 zero bytes that the KMS stand-in "encrypts" and
+ * "decrypts" every key to. */
+#define KMS_KEY_MATERIAL \
+   "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA" \
+   "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+#define KMS_KEY_ARN \
+   "arn:aws:kms:us-east-1:579766882180:key/89fcc2c4-08b0-4bd9-9f25-e30687b580d0"
+
+/* A local stand-in for AWS KMS over TLS. Each connection is served by its own
+ * thread and stays open for more requests, like a real KMS server. */
+typedef struct {
+   mongoc_socket_t *sock;
+   uint16_t port;
+   mongoc_ssl_opt_t ssl_opts;
+   bson_thread_t thread;
+   mongoc_array_t conn_threads;
+   bson_mutex_t mutex;
+   mongoc_cond_t cond;
+   bool stopping;
+   int connections;
+   int replies;
+   /* requests received and not yet replied to. */
+   int pending;
+   int max_pending;
+   /* hold each reply until this many requests are pending. */
+   int hold_until;
+   /* close the next keep-alive connection that gets a request, without
+    * replying. */
+   bool drop_reused;
+} kms_stand_in_t;
+
+typedef struct {
+   kms_stand_in_t *kms;
+   mongoc_stream_t *stream;
+} kms_conn_t;
+
+/* Read one HTTP request into @buf. Returns false once the client closes. */
+static bool
+_kms_read_request (mongoc_stream_t *stream, char *buf, size_t buflen)
+{
+   size_t len = 0;
+   size_t content_length;
+   const char *body;
+   const char *header;
+   ssize_t r;
+
+   for (;;) {
+      buf[len] = '\0';
+      body = strstr (buf, "\r\n\r\n");
+      if (body) {
+         body += 4;
+         content_length = 0;
+         header = strstr (buf, "Content-Length:");
+         if (header) {
+            content_length =
+               strtoul (header + strlen ("Content-Length:"), NULL, 10);
+         }
+
+         if ((size_t) (buf + len - body) >= content_length) {
+            return true;
+         }
+      }
+
+      BSON_ASSERT (len < buflen - 1);
+      r = mongoc_stream_read (stream, buf + len, buflen - 1 - len, 1, 10000);
+      if (r <= 0) {
+         return false;
+      }
+
+      len += (size_t) r;
+   }
+}
+
+/* Reply to an Encrypt or Decrypt request. */
+static bool
+_kms_reply (mongoc_stream_t *stream, const char *request)
+{
+   char *body;
+   char *reply;
+   mongoc_iovec_t iov;
+   bson_error_t error;
+   bool r;
+
+   body = bson_strdup_printf (
+      "{\"%s\": \"%s\", \"KeyId\": \"%s\"}",
+      strstr (request, "TrentService.Decrypt") ? "Plaintext" : "CiphertextBlob",
+      KMS_KEY_MATERIAL,
+      KMS_KEY_ARN);
+   reply = bson_strdup_printf ("HTTP/1.1 200 OK\r\n"
+                               "Content-Type: application/x-amz-json-1.1\r\n"
+                               "Content-Length: %d\r\n"
+                               "\r\n"
+                               "%s",
+                               (int) strlen (body),
+                               body);
+
+   iov.iov_base = reply;
+   iov.iov_len = strlen (reply);
+   r = _mongoc_stream_writev_full (stream, &iov, 1, 10000, &error);
+
+   bson_free (body);
+   bson_free (reply);
+   return r;
+}
+
+static BSON_THREAD_FUN (_kms_conn_thread, data)
+{
+   kms_conn_t *conn = (kms_conn_t *) data;
+   kms_stand_in_t *kms = conn->kms;
+   char request[8192];
+   bson_error_t error;
+   int served = 0;
+   bool drop;
+
+   if (!mongoc_stream_tls_handshake_block (
+          conn->stream, "localhost", 10000, &error)) {
+      goto done;
+   }
+
+   while (_kms_read_request (conn->stream, request, sizeof request)) {
+      bson_mutex_lock (&kms->mutex);
+      drop = served > 0 && kms->drop_reused;
+      if (drop) {
+         kms->drop_reused = false;
+         bson_mutex_unlock (&kms->mutex);
+         break;
+      }
+
+      kms->pending++;
+      kms->max_pending = BSON_MAX (kms->max_pending, kms->pending);
+      if (kms->pending >= kms->hold_until) {
+         kms->hold_until = 0;
+         mongoc_cond_broadcast (&kms->cond);
+      }
+
+      /* a driver that waits for each reply before sending the next request
+       * never releases the hold, the test then sees max_pending of 1. */
+      while (kms->hold_until > 0 && !kms->stopping) {
+         if (mongoc_cond_timedwait (&kms->cond, &kms->mutex, 5000) != 0) {
+            break;
+         }
+      }
+
+      kms->pending--;
+      kms->replies++;
+      bson_mutex_unlock (&kms->mutex);
+
+      if (!_kms_reply (conn->stream, request)) {
+         break;
+      }
+
+      served++;
+   }
+
+done:
+   mongoc_stream_destroy (conn->stream);
+   bson_free (conn);
+   BSON_THREAD_RETURN;
+}
+
+static BSON_THREAD_FUN (_kms_accept_thread, data)
+{
+   kms_stand_in_t *kms = (kms_stand_in_t *) data;
+   mongoc_socket_t *client_sock;
+   mongoc_stream_t *client_stream;
+   kms_conn_t *conn;
+   bson_thread_t thread;
+   uint16_t port;
+   bool stopping;
+   int r;
+
+   for (;;) {
+      client_sock = mongoc_socket_accept_ex (
+         kms->sock, bson_get_monotonic_time () + 100 * 1000, &port);
+
+      bson_mutex_lock (&kms->mutex);
+      stopping = kms->stopping;
+      bson_mutex_unlock (&kms->mutex);
+
+      if (stopping) {
+         mongoc_socket_destroy (client_sock);
+         break;
+      }
+
+      if (!client_sock) {
+         continue;
+      }
+
+      client_stream = mongoc_stream_tls_new_with_hostname (
+         mongoc_stream_socket_new (client_sock), NULL, &kms->ssl_opts, 0);
+      BSON_ASSERT (client_stream);
+
+      conn = bson_malloc0 (sizeof (kms_conn_t));
+      conn->kms = kms;
+      conn->stream = client_stream;
+
+      bson_mutex_lock (&kms->mutex);
+      kms->connections++;
+      r = COMMON_PREFIX (thread_create) (&thread, _kms_conn_thread, conn);
+      BSON_ASSERT (r == 0);
+      _mongoc_array_append_val (&kms->conn_threads, thread);
+      bson_mutex_unlock (&kms->mutex);
+   }
+
+   BSON_THREAD_RETURN;
+}
+
+static kms_stand_in_t *
+_kms_stand_in_new (void)
+{
+   kms_stand_in_t *kms;
+   struct sockaddr_in addr = {0};
+   struct sockaddr_storage bound_addr = {0};
+   mongoc_socklen_t addr_len = (mongoc_socklen_t) sizeof bound_addr;
+   int r;
+
+   kms = bson_malloc0 (sizeof (kms_stand_in_t));
+   kms->ssl_opts.pem_file = CERT_SERVER;
+   kms->ssl_opts.ca_file = CERT_CA;
+   kms->ssl_opts.weak_cert_validation = 1;
+   _mongoc_array_init (&kms->conn_threads, sizeof (bson_thread_t));
+   bson_mutex_init (&kms->mutex);
+   mongoc_cond_init (&kms->cond);
+
+   kms->sock = mongoc_socket_new (AF_INET, SOCK_STREAM, 0);
+   BSON_ASSERT (kms->sock);
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+   addr.sin_port = htons (0);
+   ASSERT_CMPINT (mongoc_socket_bind (kms->sock,
+                                      (struct sockaddr *) &addr,
+                                      sizeof addr),
+                  ==,
+                  0);
+   ASSERT_CMPINT (mongoc_socket_listen (kms->sock, 10), ==, 0);
+   ASSERT_CMPINT (mongoc_socket_getsockname (
+                     kms->sock, (struct sockaddr *) &bound_addr, &addr_len),
+                  ==,
+                  0);
+   kms->port = ntohs (((struct sockaddr_in *) &bound_addr)->sin_port);
+
+   r = COMMON_PREFIX (thread_create) (&kms->thread, _kms_accept_thread, kms);
+   BSON_ASSERT (r == 0);
+
+   return kms;
+}
+
+static void
+_kms_stand_in_destroy (kms_stand_in_t *kms)
+{
+   size_t i;
+
+   bson_mutex_lock (&kms->mutex);
+   kms->stopping = true;
+   mongoc_cond_broadcast (&kms->cond);
+   bson_mutex_unlock (&kms->mutex);
+
+   COMMON_PREFIX (thread_join) (kms->thread);
+   /* the connections end when the driver closes them. */
+   for (i = 0; i < kms->conn_threads.len; i++) {
+      COMMON_PREFIX (thread_join)
+      (_mongoc_array_index (&kms->conn_threads, bson_thread_t, i));
+   }
+
+   mongoc_socket_destroy (kms->sock);
+   _mongoc_array_destroy (&kms->conn_threads);
+   mongoc_cond_destroy (&kms->cond);
+   bson_mutex_destroy (&kms->mutex);
+   bson_free (kms);
+}
+
+static mongoc_client_encryption_t *
+_kms_stand_in_client_encryption (mongoc_client_t *keyvault_client)
+{
+   mongoc_client_encryption_opts_t *opts;
+   mongoc_client_encryption_t *client_encryption;
+   bson_t *kms_providers;
+   bson_error_t error;
+
+   kms_providers = BCON_NEW ("aws",
+                             "{",
+                             "accessKeyId",
+                             BCON_UTF8 ("stand-in"),
+                             "secretAccessKey",
+                             BCON_UTF8 ("stand-in"),
+                             "}");
+   opts = mongoc_client_encryption_opts_new ();
+   mongoc_client_encryption_opts_set_kms_providers (opts, kms_providers);
+   mongoc_client_encryption_opts_set_keyvault_namespace (
+      opts, "keyvault", "datakeys");
+   mongoc_client_encryption_opts_set_keyvault_client (opts, keyvault_client);
+   client_encryption = mongoc_client_encryption_new (opts, &error);
+   ASSERT_OR_PRINT (client_encryption, error);
+
+   mongoc_client_encryption_opts_destroy (opts);
+   bson_destroy (kms_providers);
+   return client_encryption;
+}
+
+static void
+_kms_stand_in_assert (kms_stand_in_t *kms, int connections, int replies)
+{
+   bson_mutex_lock (&kms->mutex);
+   ASSERT_CMPINT (kms->connections, ==, connections);
+   ASSERT_CMPINT (kms->replies, ==, replies);
+   bson_mutex_unlock (&kms->mutex);
+}
+
+/* KMS requests from several contexts are in flight together, and KMS
+ * connections are kept open and reused, or replaced if the server closed
+ * them. */
+static void
+test_kms_concurrent_and_keep_alive (void *unused)
+{
+   kms_stand_in_t *kms;
+   mongoc_ssl_opt_t kms_ssl_opts = {0};
+   mongoc_client_t *client;
+   mongoc_collection_t *coll;
+   mongoc_client_encryption_t *client_encryption;
+   mongoc_client_encryption_datakey_opts_t *datakey_opts;
+   mongoc_client_encryption_encrypt_opts_t *encrypt_opts[3];
+   bson_value_t keyids[4];
+   bson_value_t values[3];
+   bson_value_t ciphertexts[3];
+   char *endpoint;
+   bson_t *masterkey;
+   bson_error_t error;
+   bool ret;
+   int i;
+
+   kms = _kms_stand_in_new ();
+   kms_ssl_opts.ca_file = CERT_CA;
+   _mongoc_crypt_set_kms_ssl_opts (&kms_ssl_opts);
+
+   client = test_framework_client_new ();
+   coll = mongoc_client_get_collection (client, "keyvault", "datakeys");
+   (void) mongoc_collection_drop (coll, NULL);
+
+   endpoint = bson_strdup_printf ("localhost:%hu", kms->port);
+   masterkey = BCON_NEW ("region",
+                         BCON_UTF8 ("us-east-1"),
+                         "key",
+                         BCON_UTF8 (KMS_KEY_ARN),
+                         "endpoint",
+                         BCON_UTF8 (endpoint));
+   datakey_opts = mongoc_client_encryption_datakey_opts_new ();
+   mongoc_client_encryption_datakey_opts_set_masterkey (datakey_opts,
+                                                        masterkey);
+
+   /* Each data key is encrypted by KMS, on the same connection. */
+   client_encryption = _kms_stand_in_client_encryption (client);
+   for (i = 0; i < 3; i++) {
+      ret = mongoc_client_encryption_create_datakey (
+         client_encryption, "aws", datakey_opts, &keyids[i], &error);
+      ASSERT_OR_PRINT (ret, error);
+   }
+
+   _kms_stand_in_assert (kms, 1, 3);
+
+   /* The server closes the idle connection when it is reused, the request is
+    * sent again on a new connection. */
+   bson_mutex_lock (&kms->mutex);
+   kms->drop_reused = true;
+   bson_mutex_unlock (&kms->mutex);
+   ret = mongoc_client_encryption_create_datakey (
+      client_encryption, "aws", datakey_opts, &keyids[3], &error);
+   ASSERT_OR_PRINT (ret, error);
+   _kms_stand_in_assert (kms, 2, 4);
+   bson_mutex_lock (&kms->mutex);
+   BSON_ASSERT (!kms->drop_reused);
+   bson_mutex_unlock (&kms->mutex);
+   mongoc_client_encryption_destroy (client_encryption);
+
+   /* A new handle has no keys cached, each value needs its key decrypted.
+    * The three requests must all reach KMS before it replies to any. */
+   client_encryption = _kms_stand_in_client_encryption (client);
+   bson_mutex_lock (&kms->mutex);
+   kms->hold_until = 3;
+   bson_mutex_unlock (&kms->mutex);
+
+   for (i = 0; i < 3; i++) {
+      values[i].value_type = BSON_TYPE_INT32;
+      values[i].value.v_int32 = i;
+      encrypt_opts[i] = mongoc_client_encryption_encrypt_opts_new ();
+      mongoc_client_encryption_encrypt_opts_set_algorithm (
+         encrypt_opts[i], MONGOC_AEAD_AES_256_CBC_HMAC_SHA_512_DETERMINISTIC);
+      mongoc_client_encryption_encrypt_opts_set_keyid (encrypt_opts[i],
+                                                       &keyids[i]);
+   }
+
+   ret = mongoc_client_encryption_encrypt_many (
+      client_encryption, values, encrypt_opts, 3, ciphertexts, &error);
+   ASSERT_OR_PRINT (ret, error);
+   _kms_stand_in_assert (kms, 5, 7);
+   bson_mutex_lock (&kms->mutex);
+   ASSERT_CMPINT (kms->max_pending, ==, 3);
+   bson_mutex_unlock (&kms->mutex);
+
+   for (i = 0; i < 3; i++) {
+      bson_value_destroy (&ciphertexts[i]);
+      mongoc_client_encryption_encrypt_opts_destroy (encrypt_opts[i]);
+   }
+
+   for (i = 0; i < 4; i++) {
+      bson_value_destroy (&keyids[i]);
+   }
+
+   mongoc_client_encryption_destroy (client_encryption);
+   mongoc_client_encryption_datakey_opts_destroy (datakey_opts);
+   bson_destroy (masterkey);
+   bson_free (endpoint);
+   mongoc_collection_destroy (coll);
+   mongoc_client_destroy (client);
+   _mongoc_crypt_set_kms_ssl_opts (NULL);
+   _kms_stand_in_destroy (kms);
+}
+#endif /* MONGOC_ENABLE_CLIENT_SIDE_ENCRYPTION && MONGOC_ENABLE_SSL */
+
 void
 test_client_side_encryption_install (TestSuite *suite)
 {
@@ -2313,4 +2859,20 @@ test_client_side_encryption_install (TestSuite *suite)
                       NULL,
                       test_framework_skip_if_no_client_side_encryption,
                       test_framework_skip_if_max_wire_version_less_than_8);
+   TestSuite_AddFull (suite,
+                      "/client_side_encryption/explicit_many",
+                      test_explicit_many,
+                      NULL,
+                      NULL,
+                      test_framework_skip_if_no_client_side_encryption,
+                      test_framework_skip_if_max_wire_version_less_than_8);
+#if defined(MONGOC_ENABLE_CLIENT_SIDE_ENCRYPTION) && defined(MONGOC_ENABLE_SSL)
+   TestSuite_AddFull (suite,
+                      "/client_side_encryption/kms/concurrent_and_keep_alive",
+                      test_kms_concurrent_and_keep_alive,
+                      NULL,
+                      NULL,
+                      test_framework_skip_if_no_client_side_encryption,
+                      test_framework_skip_if_max_wire_version_less_than_8);
+#endif
 }
@@ -13,6 +13,10 @@
 #include "mongoc/mongoc-ssl.h"
 #include "mongoc/mongoc-ssl-private.h"
 #endif
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+#include "mongoc/mongoc-openssl-private.h"
+#include "mongoc/mongoc-stream-tls-private.h"
+#endif
 #include "mongoc/mongoc-util-private.h"
 #include "mongoc/mongoc-write-concern-private.h"
 
@@ -1827,8 +1831,13 @@ test_seed_list (bool rs, connection_option_t connection_option, bool pooled)
       }
 
       if (pooled) {
-         /* nodes created on demand when we use servers for actual operations */
-         ASSERT_CMPINT ((int) client->cluster.nodes->items_len, ==, 1);
+         /* connections are created on demand when we use servers for actual
+          * operations, and returned to the pool's connections after */
+         ASSERT_CMPINT ((int) client->cluster.nodes->items_len, ==, 0);
+         ASSERT_CMPSIZE_T (
+            mongoc_connection_pool_count_idle (topology->connection_pool),
+            ==,
+            (size_t) 1);
       }
    }
 
@@ -1859,7 +1868,11 @@ test_seed_list (bool rs, connection_option_t connection_option, bool pooled)
       ASSERT_CMPINT (discovered_nodes_len, ==, (int) td->servers->items_len);
 
       if (pooled) {
-         ASSERT_CMPINT ((int) client->cluster.nodes->items_len, ==, 1);
+         ASSERT_CMPINT ((int) client->cluster.nodes->items_len, ==, 0);
+         ASSERT_CMPSIZE_T (
+            mongoc_connection_pool_count_idle (topology->connection_pool),
+            ==,
+            (size_t) 1);
       }
    }
 
@@ -3040,6 +3053,95 @@ test_ssl_reconnect_pooled (void)
 {
    _test_ssl_reconnect (true);
 }
+
+
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+static void
+test_ssl_kernel_offload (void)
+{
+   mock_server_t *server;
+   mongoc_ssl_opt_t server_opts = {0};
+   mongoc_uri_t *uri;
+   mongoc_client_t *client;
+   mongoc_stream_t *stream;
+   mongoc_stream_t *tls_stream;
+   future_t *future;
+   request_t *request;
+   char *big_string;
+   char *reply_json;
+   bson_t reply;
+   bson_iter_t iter;
+   bson_error_t error;
+   int mode;
+
+   server_opts.ca_file = CERT_CA;
+   server_opts.pem_file = CERT_SERVER;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_MAX);
+   mock_server_set_ssl_opts (server, &server_opts);
+   mock_server_run (server);
+
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_bool (uri, MONGOC_URI_TLS, true);
+   mongoc_uri_set_option_as_utf8 (uri, MONGOC_URI_TLSCAFILE, CERT_CA);
+   mongoc_uri_set_option_as_bool (uri, MONGOC_URI_TLSKERNELOFFLOAD, true);
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_SOCKETTIMEOUTMS, 500);
+   client = mongoc_client_new_from_uri (uri);
+
+   /* a reply that takes many reads */
+   big_string = bson_malloc (1024 * 1024);
+   memset (big_string, 'a', 1024 * 1024 - 1);
+   big_string[1024 * 1024 - 1] = '\0';
+   reply_json = bson_strdup_printf ("{'ok': 1, 'big': '%s'}", big_string);
+
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, &reply, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_simple (request, reply_json);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   BSON_ASSERT (bson_iter_init_find (&iter, &reply, "big"));
+   ASSERT_CMPSTR (bson_iter_utf8 (&iter, NULL), big_string);
+
+   stream =
+      mongoc_topology_scanner_get_node (client->topology->scanner, 1)->stream;
+   tls_stream = mongoc_stream_get_tls_stream (stream);
+   BSON_ASSERT (tls_stream);
+   /* the kernel may not support kTLS, or not in both directions */
+   mode = mongoc_stream_tls_get_kernel_offload (stream);
+   ASSERT_CMPINT (mode & ~(MONGOC_STREAM_TLS_KERNEL_OFFLOAD_SEND |
+                           MONGOC_STREAM_TLS_KERNEL_OFFLOAD_RECV),
+                  ==,
+                  0);
+#ifdef MONGOC_ENABLE_KTLS_OPENSSL
+   BSON_ASSERT (((mongoc_stream_tls_openssl_t *) ((mongoc_stream_tls_t *)
+                                                     tls_stream)
+                    ->ctx)
+                   ->socket_bio);
+#else
+   ASSERT_CMPINT (mode, ==, MONGOC_STREAM_TLS_KERNEL_OFFLOAD_NONE);
+#endif
+
+   /* reads on the socket still time out */
+   future_destroy (future);
+   bson_destroy (&reply);
+   request_destroy (request);
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+   BSON_ASSERT (!future_get_bool (future));
+   ASSERT_CONTAINS (error.message, "socket error or timeout");
+
+   future_destroy (future);
+   request_destroy (request);
+   bson_free (reply_json);
+   bson_free (big_string);
+   mongoc_client_destroy (client);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+#endif
 #endif /* OpenSSL or Secure Transport */
 
 
@@ -4058,6 +4160,10 @@ test_client_install (TestSuite *suite)
       suite, "/Client/ssl/reconnect/single", test_ssl_reconnect_single);
    TestSuite_AddMockServerTest (
       suite, "/Client/ssl/reconnect/pooled", test_ssl_reconnect_pooled);
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+   TestSuite_AddMockServerTest (
+      suite, "/Client/ssl/kernel_offload", test_ssl_kernel_offload);
+#endif
 
 #endif
 #else
@@ -15,13 +15,21 @@
  */
 
 #include <mongoc/mongoc-util-private.h>
+#include "mongoc/mongoc-cluster-private.h"
 #include "mongoc/mongoc-counters-private.h"
+#include "mongoc/mongoc-scram-private.h"
 #include "mock_server/mock-server.h"
 #include "test-conveniences.h"
 #include "test-libmongoc.h"
 #include "TestSuite.h"
 #include "mock_server/future-functions.h"
 
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+#include <openssl/pem.h>
+#include "mongoc/mongoc-openssl-private.h"
+#include "mongoc/mongoc-ocsp-cache-private.h"
+#endif
+
 /* test statistics counters excluding OP_INSERT, OP_UPDATE, and OP_DELETE since
  * those were superseded by write commands in 2.6. */
 #ifdef MONGOC_ENABLE_SHM_COUNTERS
@@ -139,7 +147,7 @@ test_counters_op_msg (void *ctx)
    DIFF_AND_RESET (op_egress_total, ==, 4);
    DIFF_AND_RESET (op_ingress_msg, ==, 4);
    DIFF_AND_RESET (op_ingress_total, ==, 4);
-   /* an exhaust cursor still must use an OP_QUERY find. */
+   /* before 4.2, an exhaust cursor still must use an OP_QUERY find. */
    exhaust_cursor = mongoc_collection_find (coll,
                                             MONGOC_QUERY_EXHAUST,
                                             0 /* skip */,
@@ -151,10 +159,18 @@ test_counters_op_msg (void *ctx)
    while (mongoc_cursor_next (exhaust_cursor, &bson))
       ;
    mongoc_cursor_destroy (exhaust_cursor);
-   DIFF_AND_RESET (op_egress_msg, ==, 0);
-   DIFF_AND_RESET (op_ingress_msg, ==, 0);
-   DIFF_AND_RESET (op_egress_query, ==, 1);
-   DIFF_AND_RESET (op_ingress_reply, >, 0);
+   if (test_framework_max_wire_version_at_least (WIRE_VERSION_4_2)) {
+      /* one find and one getMore, the server streams the other batches. */
+      DIFF_AND_RESET (op_egress_msg, ==, 2);
+      DIFF_AND_RESET (op_ingress_msg, >, 2);
+      DIFF_AND_RESET (op_egress_query, ==, 0);
+      DIFF_AND_RESET (op_ingress_reply, ==, 0);
+   } else {
+      DIFF_AND_RESET (op_egress_msg, ==, 0);
+      DIFF_AND_RESET (op_ingress_msg, ==, 0);
+      DIFF_AND_RESET (op_egress_query, ==, 1);
+      DIFF_AND_RESET (op_ingress_reply, >, 0);
+   }
    DIFF_AND_RESET (op_egress_total, >, 0);
    DIFF_AND_RESET (op_ingress_total, >, 0);
    mongoc_collection_destroy (coll);
@@ -552,6 +568,221 @@ test_counters_streams_timeout ()
    mongoc_client_destroy (client);
    mock_server_destroy (server);
 }
+
+
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+static void
+_mock_ping (mock_server_t *server, mongoc_client_t *client)
+{
+   bson_error_t err;
+   future_t *future;
+   request_t *request;
+
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &err);
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), err);
+   future_destroy (future);
+}
+
+
+static void
+test_counters_tls_resumption (void)
+{
+   mock_server_t *server;
+   mongoc_ssl_opt_t server_opts = {0};
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+
+   server_opts.ca_file = CERT_CA;
+   server_opts.pem_file = CERT_SERVER;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_MAX);
+   mock_server_set_ssl_opts (server, &server_opts);
+   mock_server_run (server);
+
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_bool (uri, MONGOC_URI_TLS, true);
+   mongoc_uri_set_option_as_utf8 (uri, MONGOC_URI_TLSCAFILE, CERT_CA);
+   client = mongoc_client_new_from_uri (uri);
+   mongoc_uri_destroy (uri);
+
+   reset_all_counters ();
+   _mock_ping (server, client);
+   DIFF_AND_RESET (tls_handshakes_full, ==, 1);
+   DIFF_AND_RESET (tls_sessions_resumed, ==, 0);
+
+   /* the next connection resumes the session */
+   mongoc_cluster_disconnect_node (&client->cluster, 1);
+   _mock_ping (server, client);
+   DIFF_AND_RESET (tls_handshakes_full, ==, 0);
+   DIFF_AND_RESET (tls_sessions_resumed, ==, 1);
+
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+#ifdef MONGOC_ENABLE_OCSP_OPENSSL
+static X509 *
+_read_cert (const char *path)
+{
+   BIO *bio;
+   X509 *cert;
+
+   bio = BIO_new_file (path, "r");
+   BSON_ASSERT (bio);
+   cert = PEM_read_bio_X509 (bio, NULL, NULL, NULL);
+   BSON_ASSERT (cert);
+   BIO_free (bio);
+
+   return cert;
+}
+
+
+static void
+_cache_server_cert_status (int cert_status, int next_update_sec)
+{
+   X509 *server_cert;
+   X509 *ca_cert;
+   OCSP_CERTID *id;
+   ASN1_GENERALIZEDTIME *this_update;
+   ASN1_GENERALIZEDTIME *next_update;
+
+   server_cert = _read_cert (CERT_SERVER);
+   ca_cert = _read_cert (CERT_CA);
+   id = OCSP_cert_to_id (NULL, server_cert, ca_cert);
+   BSON_ASSERT (id);
+   this_update = ASN1_GENERALIZEDTIME_set (NULL, time (NULL));
+   next_update =
+      ASN1_GENERALIZEDTIME_set (NULL, time (NULL) + next_update_sec);
+
+   _mongoc_ocsp_cache_set_resp (id, cert_status, 0, this_update, next_update);
+
+   ASN1_GENERALIZEDTIME_free (next_update);
+   ASN1_GENERALIZEDTIME_free (this_update);
+   OCSP_CERTID_free (id);
+   X509_free (ca_cert);
+   X509_free (server_cert);
+}
+
+
+/* a session is not resumed once the OCSP cache says its certificate is
+ * revoked, servers staple no response on resumption */
+static void
+test_counters_tls_resumption_ocsp (void)
+{
+   mock_server_t *server;
+   mongoc_ssl_opt_t server_opts = {0};
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+   bson_error_t error;
+
+   server_opts.ca_file = CERT_CA;
+   server_opts.pem_file = CERT_SERVER;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_MAX);
+   mock_server_set_ssl_opts (server, &server_opts);
+   mock_server_run (server);
+
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_bool (uri, MONGOC_URI_TLS, true);
+   mongoc_uri_set_option_as_utf8 (uri, MONGOC_URI_TLSCAFILE, CERT_CA);
+   client = mongoc_client_new_from_uri (uri);
+   mongoc_uri_destroy (uri);
+
+   reset_all_counters ();
+   _mock_ping (server, client);
+   DIFF_AND_RESET (tls_handshakes_full, ==, 1);
+
+   /* a good status keeps the session resumable */
+   _cache_server_cert_status (V_OCSP_CERTSTATUS_GOOD, 999);
+   mongoc_cluster_disconnect_node (&client->cluster, 1);
+   _mock_ping (server, client);
+   DIFF_AND_RESET (tls_handshakes_full, ==, 0);
+   DIFF_AND_RESET (tls_sessions_resumed, ==, 1);
+
+   /* once it is revoked, the next connection does a full handshake, which
+    * fails OCSP validation */
+   _cache_server_cert_status (V_OCSP_CERTSTATUS_REVOKED, 1999);
+   mongoc_cluster_disconnect_node (&client->cluster, 1);
+   ASSERT (!mongoc_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error));
+   ASSERT_CONTAINS (error.message, "OCSP");
+   DIFF_AND_RESET (tls_sessions_resumed, ==, 0);
+
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+
+   _mongoc_ocsp_cache_cleanup ();
+   _mongoc_ocsp_cache_init ();
+}
+#endif
+#endif
+
+
+#ifdef MONGOC_ENABLE_CRYPTO
+/* run the client's side of step 2 of a SCRAM-SHA-1 conversation, which
+ * derives the keys from the password unless they are cached. */
+static void
+_scram_step2 (mongoc_scram_t *scram, const char *user, const char *pass)
+{
+   uint8_t buf[4096] = {0};
+   uint32_t buflen;
+   bson_error_t error;
+   const char *client_nonce = "YWJjZA==";
+   const char *server_response =
+      "r=YWJjZA==YWJjZA==,s=r6+P1iLmSJvhrRyuFi6Wsg==,i=4096";
+
+   _mongoc_scram_init (scram, MONGOC_CRYPTO_ALGORITHM_SHA_1);
+   _mongoc_scram_set_user (scram, user);
+   _mongoc_scram_set_pass (scram, pass);
+   bson_strncpy (
+      scram->encoded_nonce, client_nonce, sizeof (scram->encoded_nonce));
+   scram->encoded_nonce_len = (int32_t) strlen (client_nonce);
+   scram->auth_message = bson_malloc0 (4096);
+   scram->auth_messagemax = 4096;
+   scram->step = 1;
+   buflen = (uint32_t) strlen (server_response);
+   memcpy (buf, server_response, buflen);
+   ASSERT_OR_PRINT (
+      _mongoc_scram_step (scram, buf, buflen, buf, sizeof buf, &buflen, &error),
+      error);
+}
+
+
+static void
+test_counters_scram_key_cache (void)
+{
+   mongoc_scram_t scram;
+
+   reset_all_counters ();
+   _scram_step2 (&scram, "counters-user", "password");
+   _mongoc_scram_destroy (&scram);
+   DIFF_AND_RESET (auth_scram_derivations, ==, 1);
+
+   /* another client authenticating as the same user reuses the keys */
+   _scram_step2 (&scram, "counters-user", "password");
+   _mongoc_scram_destroy (&scram);
+   DIFF_AND_RESET (auth_scram_derivations, ==, 0);
+
+   _scram_step2 (&scram, "counters-user", "other password");
+   _mongoc_scram_destroy (&scram);
+   DIFF_AND_RESET (auth_scram_derivations, ==, 1);
+
+   /* the keys are derived again after the server rejects them */
+   _scram_step2 (&scram, "counters-user", "password");
+   _mongoc_scram_invalidate_cache (&scram);
+   _mongoc_scram_destroy (&scram);
+   DIFF_AND_RESET (auth_scram_derivations, ==, 0);
+
+   _scram_step2 (&scram, "counters-user", "password");
+   _mongoc_scram_destroy (&scram);
+   DIFF_AND_RESET (auth_scram_derivations, ==, 1);
+}
+#endif
 #endif
 
 void
@@ -611,5 +842,18 @@ test_counters_install (TestSuite *suite)
    TestSuite_AddLive (suite, "/counters/dns", test_counters_dns);
    TestSuite_AddMockServerTest (
       suite, "/counters/streams_timeout", test_counters_streams_timeout);
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+   TestSuite_AddMockServerTest (
+      suite, "/counters/tls_resumption", test_counters_tls_resumption);
+#ifdef MONGOC_ENABLE_OCSP_OPENSSL
+   TestSuite_AddMockServerTest (suite,
+                                "/counters/tls_resumption/ocsp",
+                                test_counters_tls_resumption_ocsp);
+#endif
+#endif
+#ifdef MONGOC_ENABLE_CRYPTO
+   TestSuite_Add (
+      suite, "/counters/scram_key_cache", test_counters_scram_key_cache);
+#endif
 #endif
 }
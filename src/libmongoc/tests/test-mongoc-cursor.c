@@ -2322,6 +2322,457 @@ test_find_error_is_alive (void)
    mongoc_client_destroy (client);
 }
 
+static mongoc_cursor_t *
+_prefetch_cursor_start (mock_server_t *server,
+                        mongoc_collection_t *collection,
+                        request_t **getmore)
+{
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+
+   cursor = mongoc_collection_find_with_opts (
+      collection, tmp_bson ("{}"), NULL, NULL);
+   mongoc_cursor_set_prefetch (cursor, 1);
+
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'find': 'coll'}"));
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '123'},"
+                " 'ns': 'db.coll', 'firstBatch': [{'a': 1}, {'a': 2}]}}"));
+   ASSERT (future_get_bool (future));
+   ASSERT_MATCH (doc, "{'a': 1}");
+   future_destroy (future);
+   request_destroy (request);
+
+   /* one document left in the batch, so the getMore is already sent */
+   *getmore = mock_server_receives_msg (
+      server,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'getMore': {'$numberLong': '123'}, 'collection': 'coll'}"));
+
+   /* the rest of the batch is served without waiting for the server */
+   ASSERT (mongoc_cursor_next (cursor, &doc));
+   ASSERT_MATCH (doc, "{'a': 2}");
+
+   return cursor;
+}
+
+
+static void
+_prefetch_reply_final_batch (request_t *request)
+{
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '0'},"
+                " 'ns': 'db.coll', 'nextBatch': [{'a': 3}]}}"));
+}
+
+
+/* test that mongoc_cursor_set_prefetch sends the getMore before the current
+ * batch is exhausted */
+static void
+test_cursor_prefetch (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   collection = mongoc_client_get_collection (client, "db", "coll");
+   cursor = _prefetch_cursor_start (server, collection, &request);
+
+   future = future_cursor_next (cursor, &doc);
+   _prefetch_reply_final_batch (request);
+   ASSERT (future_get_bool (future));
+   ASSERT_MATCH (doc, "{'a': 3}");
+   future_destroy (future);
+   request_destroy (request);
+
+   ASSERT (!mongoc_cursor_next (cursor, &doc));
+   ASSERT_OR_PRINT (!mongoc_cursor_error (cursor, &error), error);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+/* test that another operation reads the prefetched reply before it uses the
+ * connection, and the cursor returns the stored batch afterwards */
+static void
+test_cursor_prefetch_interleaved (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+   request_t *getmore;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   collection = mongoc_client_get_collection (client, "db", "coll");
+   cursor = _prefetch_cursor_start (server, collection, &getmore);
+
+   future = future_client_command_simple (
+      client, "db", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   _prefetch_reply_final_batch (getmore);
+   request_destroy (getmore);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   ASSERT (mongoc_cursor_next (cursor, &doc));
+   ASSERT_MATCH (doc, "{'a': 3}");
+   ASSERT (!mongoc_cursor_next (cursor, &doc));
+   ASSERT_OR_PRINT (!mongoc_cursor_error (cursor, &error), error);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+/* test that destroying a cursor reads its prefetched reply, and does not send
+ * killCursors if that was the final batch */
+static void
+test_cursor_prefetch_destroy (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   collection = mongoc_client_get_collection (client, "db", "coll");
+   cursor = _prefetch_cursor_start (server, collection, &request);
+
+   future = future_cursor_destroy (cursor);
+   _prefetch_reply_final_batch (request);
+   future_wait (future);
+   future_destroy (future);
+   request_destroy (request);
+
+   /* the next command on the connection is not a killCursors */
+   future = future_client_command_simple (
+      client, "db", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+/* test that "adaptiveBatchSize" doubles the getMore batchSize each batch */
+static void
+test_cursor_adaptive_batch_size (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+   int i;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   collection = mongoc_client_get_collection (client, "db", "coll");
+   cursor = mongoc_collection_find_with_opts (
+      collection, tmp_bson ("{}"), tmp_bson ("{'adaptiveBatchSize': 1}"), NULL);
+
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_msg (
+      server,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'find': 'coll', 'adaptiveBatchSize': {'$exists': false}}"));
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '123'},"
+                " 'ns': 'db.coll', 'firstBatch': [{'a': 1}, {'a': 2}]}}"));
+   ASSERT (future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+   ASSERT (mongoc_cursor_next (cursor, &doc));
+
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_msg (
+      server,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'getMore': {'$numberLong': '123'},"
+                " 'batchSize': {'$numberLong': '4'}}"));
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '123'},"
+                " 'ns': 'db.coll', 'nextBatch': [{}, {}, {}, {}]}}"));
+   ASSERT (future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+
+   for (i = 0; i < 3; i++) {
+      ASSERT (mongoc_cursor_next (cursor, &doc));
+   }
+
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_msg (
+      server,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'getMore': {'$numberLong': '123'},"
+                " 'batchSize': {'$numberLong': '8'}}"));
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '0'},"
+                " 'ns': 'db.coll', 'nextBatch': []}}"));
+   ASSERT (!future_get_bool (future));
+   ASSERT_OR_PRINT (!mongoc_cursor_error (cursor, &error), error);
+   future_destroy (future);
+   request_destroy (request);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+/* test that the adaptive batchSize keeps batches of large documents within
+ * the per-cursor byte target */
+static void
+test_cursor_adaptive_batch_size_cap (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+   size_t len = 3 * 1024 * 1024;
+   char *str;
+   bson_t reply = BSON_INITIALIZER;
+   bson_t child;
+   bson_t batch;
+   bson_t big;
+
+   str = bson_malloc (len + 1);
+   memset (str, 'a', len);
+   str[len] = '\0';
+
+   BSON_APPEND_INT32 (&reply, "ok", 1);
+   BSON_APPEND_DOCUMENT_BEGIN (&reply, "cursor", &child);
+   BSON_APPEND_INT64 (&child, "id", 123);
+   BSON_APPEND_UTF8 (&child, "ns", "db.coll");
+   BSON_APPEND_ARRAY_BEGIN (&child, "firstBatch", &batch);
+   BSON_APPEND_DOCUMENT_BEGIN (&batch, "0", &big);
+   BSON_APPEND_UTF8 (&big, "s", str);
+   bson_append_document_end (&batch, &big);
+   bson_append_array_end (&child, &batch);
+   bson_append_document_end (&reply, &child);
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   collection = mongoc_client_get_collection (client, "db", "coll");
+   cursor = mongoc_collection_find_with_opts (
+      collection, tmp_bson ("{}"), NULL, NULL);
+   mongoc_cursor_set_adaptive_batch_size (cursor, true);
+
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'find': 'coll'}"));
+   mock_server_replies_opmsg (request, MONGOC_MSG_NONE, &reply);
+   ASSERT (future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+
+   /* two more documents this size would exceed the 4MB target */
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_msg (
+      server,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'getMore': {'$numberLong': '123'},"
+                " 'batchSize': {'$numberLong': '1'}}"));
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '0'},"
+                " 'ns': 'db.coll', 'nextBatch': []}}"));
+   ASSERT (!future_get_bool (future));
+   ASSERT_OR_PRINT (!mongoc_cursor_error (cursor, &error), error);
+   future_destroy (future);
+   request_destroy (request);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+   bson_destroy (&reply);
+   bson_free (str);
+}
+
+
+typedef struct {
+   int getmore_started;
+   int getmore_succeeded;
+   int64_t started_request_id;
+   int64_t succeeded_request_id;
+   int64_t duration;
+} prefetch_apm_test_t;
+
+
+static void
+_prefetch_apm_started (const mongoc_apm_command_started_t *event)
+{
+   prefetch_apm_test_t *test =
+      (prefetch_apm_test_t *) mongoc_apm_command_started_get_context (event);
+
+   if (!strcmp (mongoc_apm_command_started_get_command_name (event),
+                "getMore")) {
+      test->getmore_started++;
+      test->started_request_id =
+         mongoc_apm_command_started_get_request_id (event);
+   }
+}
+
+
+static void
+_prefetch_apm_succeeded (const mongoc_apm_command_succeeded_t *event)
+{
+   prefetch_apm_test_t *test =
+      (prefetch_apm_test_t *) mongoc_apm_command_succeeded_get_context (event);
+
+   if (!strcmp (mongoc_apm_command_succeeded_get_command_name (event),
+                "getMore")) {
+      test->getmore_succeeded++;
+      test->succeeded_request_id =
+         mongoc_apm_command_succeeded_get_request_id (event);
+      test->duration = mongoc_apm_command_succeeded_get_duration (event);
+   }
+}
+
+
+/* test that a prefetched getMore's "started" event is published when it is
+ * sent, and its duration includes the wait for the reply */
+static void
+test_cursor_prefetch_apm (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_apm_callbacks_t *callbacks;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   prefetch_apm_test_t test = {0};
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   callbacks = mongoc_apm_callbacks_new ();
+   mongoc_apm_set_command_started_cb (callbacks, _prefetch_apm_started);
+   mongoc_apm_set_command_succeeded_cb (callbacks, _prefetch_apm_succeeded);
+   mongoc_client_set_apm_callbacks (client, callbacks, &test);
+   collection = mongoc_client_get_collection (client, "db", "coll");
+   cursor = _prefetch_cursor_start (server, collection, &request);
+
+   ASSERT_CMPINT (test.getmore_started, ==, 1);
+   ASSERT_CMPINT (test.getmore_succeeded, ==, 0);
+
+   _mongoc_usleep (100 * 1000);
+   future = future_cursor_next (cursor, &doc);
+   _prefetch_reply_final_batch (request);
+   ASSERT (future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+
+   ASSERT_CMPINT (test.getmore_started, ==, 1);
+   ASSERT_CMPINT (test.getmore_succeeded, ==, 1);
+   ASSERT_CMPINT64 (test.succeeded_request_id, ==, test.started_request_id);
+   ASSERT_CMPINT64 (test.duration, >=, (int64_t) 100 * 1000);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_apm_callbacks_destroy (callbacks);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+/* test that the driver-only "prefetch" and "adaptiveBatchSize" options are not
+ * sent as modifiers with an OP_QUERY find */
+static void
+test_cursor_driver_opts_opquery (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_MIN);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   collection = mongoc_client_get_collection (client, "db", "coll");
+   cursor = mongoc_collection_find_with_opts (
+      collection,
+      tmp_bson ("{'a': 1}"),
+      tmp_bson ("{'prefetch': 1, 'adaptiveBatchSize': true}"),
+      NULL);
+
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_query (
+      server, "db.coll", MONGOC_QUERY_SLAVE_OK, 0, 0, "{'a': 1}", NULL);
+   mock_server_replies_simple (request, "{'b': 1}");
+   ASSERT (future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
 
 void
 test_cursor_install (TestSuite *suite)
@@ -2420,4 +2871,20 @@ test_cursor_install (TestSuite *suite)
       suite, "/Cursor/error_document/command", test_error_document_command);
    TestSuite_AddLive (
       suite, "/Cursor/find_error/is_alive", test_find_error_is_alive);
+   TestSuite_AddMockServerTest (
+      suite, "/Cursor/prefetch", test_cursor_prefetch);
+   TestSuite_AddMockServerTest (
+      suite, "/Cursor/prefetch/interleaved", test_cursor_prefetch_interleaved);
+   TestSuite_AddMockServerTest (
+      suite, "/Cursor/prefetch/destroy", test_cursor_prefetch_destroy);
+   TestSuite_AddMockServerTest (
+      suite, "/Cursor/prefetch/apm", test_cursor_prefetch_apm);
+   TestSuite_AddMockServerTest (
+      suite, "/Cursor/driver_opts/opquery", test_cursor_driver_opts_opquery);
+   TestSuite_AddMockServerTest (suite,
+                                "/Cursor/adaptive_batch_size",
+                                test_cursor_adaptive_batch_size);
+   TestSuite_AddMockServerTest (suite,
+                                "/Cursor/adaptive_batch_size/cap",
+                                test_cursor_adaptive_batch_size_cap);
 }
@@ -67,6 +67,29 @@ get_connection_count (mongoc_client_t *client)
    return conns;
 }
 
+/* Read from an exhaust cursor until the server streams its batches. An
+ * OP_QUERY exhaust cursor streams from its first reply, while on 4.2+ the
+ * find command returns the first batch and the first getMore starts the
+ * moreToCome stream. Returns the number of documents read. */
+static int
+_exhaust_cursor_start (mongoc_cursor_t *cursor)
+{
+   const bson_t *doc;
+   bson_error_t error;
+   int n = 0;
+
+   do {
+      if (!mongoc_cursor_next (cursor, &doc)) {
+         ASSERT_OR_PRINT (!mongoc_cursor_error (cursor, &error), error);
+         test_error ("exhaust cursor finished before streaming");
+      }
+      BSON_ASSERT (doc);
+      n++;
+   } while (!cursor->in_exhaust);
+
+   return n;
+}
+
 static void
 test_exhaust_cursor (bool pooled)
 {
@@ -90,8 +113,13 @@ test_exhaust_cursor (bool pooled)
    uint32_t connection_count1;
    mongoc_client_t *audit_client;
    bool can_check_connection_count;
+   uint32_t batch_size;
+   int n;
 
    can_check_connection_count = test_framework_max_wire_version_at_least (5);
+   /* with OP_MSG exhaust, the first batch must not hold every document */
+   batch_size =
+      test_framework_max_wire_version_at_least (WIRE_VERSION_4_2) ? 2 : 0;
    if (pooled) {
       pool = test_framework_client_pool_new ();
       client = mongoc_client_pool_pop (pool);
@@ -138,7 +166,7 @@ test_exhaust_cursor (bool pooled)
    /* create a couple of cursors */
    {
       cursor = mongoc_collection_find (
-         collection, MONGOC_QUERY_EXHAUST, 0, 0, 0, &q, NULL, NULL);
+         collection, MONGOC_QUERY_EXHAUST, 0, 0, batch_size, &q, NULL, NULL);
 
       cursor2 = mongoc_collection_find (
          collection, MONGOC_QUERY_NONE, 0, 0, 0, &q, NULL, NULL);
@@ -148,13 +176,7 @@ test_exhaust_cursor (bool pooled)
     * should be and ensure that an early destroy properly causes a disconnect
     * */
    {
-      r = mongoc_cursor_next (cursor, &doc);
-      if (!r) {
-         mongoc_cursor_error (cursor, &error);
-         fprintf (stderr, "cursor error: %s\n", error.message);
-      }
-      BSON_ASSERT (r);
-      BSON_ASSERT (doc);
+      _exhaust_cursor_start (cursor);
       BSON_ASSERT (cursor->in_exhaust);
       BSON_ASSERT (client->in_exhaust);
 
@@ -173,7 +195,7 @@ test_exhaust_cursor (bool pooled)
     * regular cursor */
    {
       cursor = mongoc_collection_find (
-         collection, MONGOC_QUERY_EXHAUST, 0, 0, 0, &q, NULL, NULL);
+         collection, MONGOC_QUERY_EXHAUST, 0, 0, batch_size, &q, NULL, NULL);
 
       r = mongoc_cursor_next (cursor2, &doc);
       if (!r) {
@@ -199,9 +221,7 @@ test_exhaust_cursor (bool pooled)
          BSON_ASSERT (doc);
       }
 
-      r = mongoc_cursor_next (cursor, &doc);
-      BSON_ASSERT (r);
-      BSON_ASSERT (doc);
+      n = _exhaust_cursor_start (cursor);
 
       doc = NULL;
       r = mongoc_cursor_next (cursor2, &doc);
@@ -246,7 +266,7 @@ test_exhaust_cursor (bool pooled)
       stream =
          (mongoc_stream_t *) mongoc_set_get (client->cluster.nodes, server_id);
 
-      for (i = 1; i < 10; i++) {
+      for (i = n; i < 10; i++) {
          r = mongoc_cursor_next (cursor, &doc);
          BSON_ASSERT (r);
          BSON_ASSERT (doc);
@@ -347,6 +367,62 @@ test_exhaust_cursor_multi_batch (void *context)
    mongoc_client_destroy (client);
 }
 
+static void
+test_exhaust_aggregate (void *context)
+{
+   mongoc_client_t *client;
+   bson_error_t error;
+   mongoc_collection_t *collection;
+   bson_t doc = BSON_INITIALIZER;
+   mongoc_bulk_operation_t *bulk;
+   int i;
+   uint32_t server_id;
+   mongoc_cursor_t *cursor;
+   const bson_t *cursor_doc;
+   bool streamed = false;
+
+   client = test_framework_client_new ();
+   collection = get_test_collection (client, "test_exhaust_aggregate");
+
+   BSON_APPEND_UTF8 (&doc, "key", "value");
+   bulk = mongoc_collection_create_bulk_operation_with_opts (collection, NULL);
+
+   for (i = 0; i < 100; i++) {
+      mongoc_bulk_operation_insert (bulk, &doc);
+   }
+
+   server_id = mongoc_bulk_operation_execute (bulk, NULL, &error);
+   ASSERT_OR_PRINT (server_id, error);
+
+   cursor = mongoc_collection_aggregate (
+      collection,
+      MONGOC_QUERY_NONE,
+      tmp_bson ("{'pipeline': [{'$match': {'key': 'value'}}]}"),
+      tmp_bson ("{'exhaust': true, 'batchSize': 10}"),
+      NULL);
+
+   i = 0;
+   while (mongoc_cursor_next (cursor, &cursor_doc)) {
+      i++;
+      streamed |= cursor->in_exhaust;
+      ASSERT_CMPINT (client->in_exhaust, ==, cursor->in_exhaust);
+   }
+
+   ASSERT_OR_PRINT (!mongoc_cursor_error (cursor, &error), error);
+   ASSERT_CMPINT (i, ==, 100);
+   /* the getMore replies were streamed, and the stream has ended */
+   ASSERT (streamed);
+   ASSERT (!cursor->in_exhaust);
+   ASSERT (!client->in_exhaust);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_bulk_operation_destroy (bulk);
+   ASSERT_OR_PRINT (mongoc_collection_drop (collection, &error), error);
+   mongoc_collection_destroy (collection);
+   bson_destroy (&doc);
+   mongoc_client_destroy (client);
+}
+
 static void
 test_cursor_set_max_await_time_ms (void)
 {
@@ -567,6 +643,291 @@ test_exhaust_server_err_2nd_batch_pooled (void)
    _mock_test_exhaust (true, SECOND_BATCH, SERVER_ERROR);
 }
 
+/* MongoDB 4.2+: the find command runs as usual, the first getMore is sent
+ * with exhaustAllowed, and the server streams the remaining batches. */
+static mongoc_cursor_t *
+_exhaust_opmsg_start (mock_server_t *server,
+                      mongoc_collection_t *collection,
+                      request_t **getmore)
+{
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+
+   cursor = mongoc_collection_find_with_opts (
+      collection, tmp_bson ("{}"), tmp_bson ("{'exhaust': true}"), NULL);
+
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_msg (
+      server,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'find': 'test',"
+                " 'filter': {},"
+                " 'exhaust': {'$exists': false}}"));
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '123'},"
+                " 'ns': 'db.test', 'firstBatch': [{'a': 1}]}}"));
+   ASSERT (future_get_bool (future));
+   ASSERT_MATCH (doc, "{'a': 1}");
+   ASSERT (!cursor->in_exhaust);
+   future_destroy (future);
+   request_destroy (request);
+
+   future = future_cursor_next (cursor, &doc);
+   *getmore = mock_server_receives_msg (
+      server,
+      MONGOC_MSG_EXHAUST_ALLOWED,
+      tmp_bson ("{'getMore': {'$numberLong': '123'}, 'collection': 'test'}"));
+   mock_server_replies_opmsg (
+      *getmore,
+      MONGOC_MSG_MORE_TO_COME,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '123'},"
+                " 'ns': 'db.test', 'nextBatch': [{'a': 2}]}}"));
+   ASSERT (future_get_bool (future));
+   ASSERT_MATCH (doc, "{'a': 2}");
+   ASSERT (cursor->in_exhaust);
+   ASSERT (collection->client->in_exhaust);
+   future_destroy (future);
+
+   return cursor;
+}
+
+static void
+test_exhaust_opmsg_batches (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *getmore;
+   request_t *request;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_4_2);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   collection = mongoc_client_get_collection (client, "db", "test");
+
+   cursor = _exhaust_opmsg_start (server, collection, &getmore);
+
+   /* other operations on the client are blocked while batches stream in */
+   ASSERT (!mongoc_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_CLIENT,
+                          MONGOC_ERROR_CLIENT_IN_EXHAUST,
+                          "in exhaust");
+
+   /* the last batch is pushed without another getMore */
+   future = future_cursor_next (cursor, &doc);
+   mock_server_replies_opmsg (
+      getmore,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '0'},"
+                " 'ns': 'db.test', 'nextBatch': [{'a': 3}]}}"));
+   ASSERT (future_get_bool (future));
+   ASSERT_MATCH (doc, "{'a': 3}");
+   ASSERT (!cursor->in_exhaust);
+   ASSERT (!client->in_exhaust);
+   future_destroy (future);
+
+   ASSERT (!mongoc_cursor_next (cursor, &doc));
+   ASSERT_OR_PRINT (!mongoc_cursor_error (cursor, &error), error);
+   mongoc_cursor_destroy (cursor);
+
+   /* the connection is reusable */
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   request_destroy (getmore);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+static void
+test_exhaust_opmsg_destroy (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   future_t *future;
+   request_t *getmore;
+   request_t *request;
+   uint32_t server_id;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_4_2);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   collection = mongoc_client_get_collection (client, "db", "test");
+
+   cursor = _exhaust_opmsg_start (server, collection, &getmore);
+   server_id = mongoc_cursor_get_hint (cursor);
+
+   /* destroying the cursor mid-stream closes the connection, no killCursors */
+   mongoc_cursor_destroy (cursor);
+   ASSERT (!client->in_exhaust);
+   ASSERT (!mongoc_cluster_stream_for_server (&client->cluster,
+                                              server_id,
+                                              false /* don't reconnect */,
+                                              NULL,
+                                              NULL,
+                                              &error));
+
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   request_destroy (getmore);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+/* a client that has discovered a sharded cluster. both seeds are @server, so
+ * it receives every request */
+static mongoc_client_t *
+_mongos_client_new (mock_server_t *server)
+{
+   mongoc_client_t *client;
+   char *uri_str;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+
+   uri_str = bson_strdup_printf ("mongodb://localhost:%hu,127.0.0.1:%hu",
+                                 mock_server_get_port (server),
+                                 mock_server_get_port (server));
+   client = mongoc_client_new (uri_str);
+   bson_free (uri_str);
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+   BSON_ASSERT (_mongoc_topology_get_type (client->topology) ==
+                MONGOC_TOPOLOGY_SHARDED);
+
+   return client;
+}
+
+/* mongos ignores exhaustAllowed and replies to each getMore as usual */
+static void
+test_exhaust_opmsg_mongos (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+   int i;
+
+   server = mock_mongos_new (WIRE_VERSION_4_2);
+   mock_server_auto_endsessions (server);
+   mock_server_run (server);
+   client = _mongos_client_new (server);
+   collection = mongoc_client_get_collection (client, "db", "test");
+   cursor = mongoc_collection_find_with_opts (
+      collection, tmp_bson ("{}"), tmp_bson ("{'exhaust': true}"), NULL);
+
+   future = future_cursor_next (cursor, &doc);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'find': 'test', 'filter': {}}"));
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '123'},"
+                " 'ns': 'db.test', 'firstBatch': [{'a': 1}]}}"));
+   ASSERT (future_get_bool (future));
+   ASSERT_MATCH (doc, "{'a': 1}");
+   future_destroy (future);
+   request_destroy (request);
+
+   /* each batch takes a getMore, since mongos never sets moreToCome */
+   for (i = 2; i <= 3; i++) {
+      future = future_cursor_next (cursor, &doc);
+      request = mock_server_receives_msg (
+         server,
+         MONGOC_MSG_EXHAUST_ALLOWED,
+         tmp_bson ("{'getMore': {'$numberLong': '123'},"
+                   " 'collection': 'test'}"));
+      mock_server_replies_opmsg (
+         request,
+         MONGOC_MSG_NONE,
+         tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '%s'},"
+                   " 'ns': 'db.test', 'nextBatch': [{'a': %d}]}}",
+                   i == 3 ? "0" : "123",
+                   i));
+      ASSERT (future_get_bool (future));
+      ASSERT_MATCH (doc, "{'a': %d}", i);
+      ASSERT (!cursor->in_exhaust);
+      ASSERT (!client->in_exhaust);
+      future_destroy (future);
+      request_destroy (request);
+   }
+
+   ASSERT (!mongoc_cursor_next (cursor, &doc));
+   ASSERT_OR_PRINT (!mongoc_cursor_error (cursor, &error), error);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+/* before 4.2, exhaust needs OP_QUERY, which mongos does not support */
+static void
+test_exhaust_opquery_mongos (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   bson_error_t error;
+
+   server = mock_mongos_new (WIRE_VERSION_4_0);
+   mock_server_auto_endsessions (server);
+   mock_server_run (server);
+   client = _mongos_client_new (server);
+   collection = mongoc_client_get_collection (client, "db", "test");
+   cursor = mongoc_collection_find_with_opts (
+      collection, tmp_bson ("{}"), tmp_bson ("{'exhaust': true}"), NULL);
+
+   ASSERT (!mongoc_cursor_next (cursor, &doc));
+   ASSERT (mongoc_cursor_error (cursor, &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_CURSOR,
+                          MONGOC_ERROR_CURSOR_INVALID_CURSOR,
+                          "Cannot use exhaust cursor with sharded cluster.");
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
 #ifndef _WIN32
 #include <sys/wait.h>
 /* Test that calling mongoc_client_reset on a client that has an exhaust cursor
@@ -675,6 +1036,13 @@ test_exhaust_install (TestSuite *suite)
                       NULL,
                       NULL,
                       skip_if_mongos);
+   TestSuite_AddFull (suite,
+                      "/Client/exhaust_cursor/aggregate",
+                      test_exhaust_aggregate,
+                      NULL,
+                      NULL,
+                      skip_if_mongos,
+                      test_framework_skip_if_max_wire_version_less_than_8);
    TestSuite_AddLive (suite,
                       "/Client/set_max_await_time_ms",
                       test_cursor_set_max_await_time_ms);
@@ -710,6 +1078,18 @@ test_exhaust_install (TestSuite *suite)
       suite,
       "/Client/exhaust_cursor/err/server/2nd_batch/pooled",
       test_exhaust_server_err_2nd_batch_pooled);
+   TestSuite_AddMockServerTest (suite,
+                                "/Client/exhaust_cursor/opmsg/batches",
+                                test_exhaust_opmsg_batches);
+   TestSuite_AddMockServerTest (suite,
+                                "/Client/exhaust_cursor/opmsg/destroy",
+                                test_exhaust_opmsg_destroy);
+   TestSuite_AddMockServerTest (suite,
+                                "/Client/exhaust_cursor/opmsg/mongos",
+                                test_exhaust_opmsg_mongos);
+   TestSuite_AddMockServerTest (suite,
+                                "/Client/exhaust_cursor/opquery/mongos",
+                                test_exhaust_opquery_mongos);
 #ifndef _WIN32
    /* Skip on Windows, since "fork" is not available and this test is not
     * particularly platform dependent. */
@@ -95,6 +95,8 @@ test_mongoc_cache_insert (void)
       ASSERT_TIME_EQUAL (next_update_in, next_update_out);
       ASSERT_TIME_EQUAL (this_update_in, this_update_out);
 
+      ASN1_GENERALIZEDTIME_free (this_update_out);
+      ASN1_GENERALIZEDTIME_free (next_update_out);
       OCSP_CERTID_free (id);
    }
 
@@ -122,6 +124,7 @@ test_mongoc_cache_update (void)
    BSON_ASSERT (_mongoc_ocsp_cache_get_status (
       id, &status, &reason, &this_update_out, &next_update_out));
    BSON_ASSERT (status == V_OCSP_CERTSTATUS_GOOD);
+   BSON_ASSERT (!this_update_out);
 
    ASN1_GENERALIZEDTIME_free (next_update_in);
    next_update_in = ASN1_GENERALIZEDTIME_set (
@@ -131,9 +134,15 @@ test_mongoc_cache_update (void)
       id, V_OCSP_CERTSTATUS_REVOKED, 0, NULL, next_update_in);
    BSON_ASSERT (_mongoc_ocsp_cache_length () == 1);
 
+   /* the caller's copy outlives the cached response it came from */
+   BSON_ASSERT (ASN1_TIME_compare (next_update_out, next_update_in) < 0);
+   ASN1_GENERALIZEDTIME_free (next_update_out);
+
    BSON_ASSERT (_mongoc_ocsp_cache_get_status (
       id, &status, &reason, &this_update_out, &next_update_out));
    BSON_ASSERT (status == V_OCSP_CERTSTATUS_REVOKED);
+   ASSERT_TIME_EQUAL (next_update_in, next_update_out);
+   ASN1_GENERALIZEDTIME_free (next_update_out);
 
    ASN1_GENERALIZEDTIME_free (next_update_in);
    next_update_in = ASN1_GENERALIZEDTIME_set (
@@ -146,6 +155,7 @@ test_mongoc_cache_update (void)
    BSON_ASSERT (_mongoc_ocsp_cache_get_status (
       id, &status, &reason, &this_update_out, &next_update_out));
    BSON_ASSERT (status == V_OCSP_CERTSTATUS_REVOKED);
+   ASN1_GENERALIZEDTIME_free (next_update_out);
 
    CLEAR_CACHE;
 
@@ -179,6 +189,68 @@ test_mongoc_cache_remove_expired_cert (void)
    CLEAR_CACHE;
 }
 
+static bool
+cache_has (long serial)
+{
+   ASN1_GENERALIZEDTIME *this_update, *next_update;
+   OCSP_CERTID *id;
+   int status, reason;
+   bool ret;
+
+   id = create_cert_id (serial);
+   ret = _mongoc_ocsp_cache_get_status (
+      id, &status, &reason, &this_update, &next_update);
+   if (ret) {
+      ASN1_GENERALIZEDTIME_free (this_update);
+      ASN1_GENERALIZEDTIME_free (next_update);
+   }
+
+   OCSP_CERTID_free (id);
+   return ret;
+}
+
+static void
+test_mongoc_cache_evict (void)
+{
+   ASN1_GENERALIZEDTIME *this_update, *next_update;
+   int i, size = 4 * MONGOC_OCSP_CACHE_MAX_SIZE, length;
+   OCSP_CERTID *id;
+
+   CLEAR_CACHE;
+
+   this_update = ASN1_GENERALIZEDTIME_set (NULL, time (NULL));
+   for (i = 0; i < size; i++) {
+      id = create_cert_id (i);
+      next_update = ASN1_GENERALIZEDTIME_set (NULL, time (NULL) + 999 + i);
+      _mongoc_ocsp_cache_set_resp (
+         id, V_OCSP_CERTSTATUS_GOOD, 0, this_update, next_update);
+
+      BSON_ASSERT (_mongoc_ocsp_cache_length () <= MONGOC_OCSP_CACHE_MAX_SIZE);
+      ASN1_GENERALIZEDTIME_free (next_update);
+      OCSP_CERTID_free (id);
+   }
+
+   /* later responses evicted ones that expire sooner, so the responses that
+    * expire last are all cached, whichever buckets they are in. */
+   for (i = size - MONGOC_OCSP_CACHE_BUCKET_MAX_SIZE; i < size; i++) {
+      BSON_ASSERT (cache_has (i));
+   }
+
+   /* a response that expires before every cached one evicts none of them */
+   length = _mongoc_ocsp_cache_length ();
+   id = create_cert_id (size);
+   next_update = ASN1_GENERALIZEDTIME_set (NULL, time (NULL) + 1);
+   _mongoc_ocsp_cache_set_resp (
+      id, V_OCSP_CERTSTATUS_GOOD, 0, this_update, next_update);
+   ASN1_GENERALIZEDTIME_free (next_update);
+   OCSP_CERTID_free (id);
+   BSON_ASSERT (!cache_has (size));
+   BSON_ASSERT (_mongoc_ocsp_cache_length () == length);
+
+   CLEAR_CACHE;
+   ASN1_GENERALIZEDTIME_free (this_update);
+}
+
 void
 test_ocsp_cache_install (TestSuite *suite)
 {
@@ -187,6 +259,7 @@ test_ocsp_cache_install (TestSuite *suite)
    TestSuite_Add (suite,
                   "/OCSPCache/remove_expired_cert",
                   test_mongoc_cache_remove_expired_cert);
+   TestSuite_Add (suite, "/OCSPCache/evict", test_mongoc_cache_evict);
 }
 #else
 extern int no_mongoc_ocsp;
@@ -0,0 +1,794 @@
+#include <mongoc/mongoc.h>
+#include <mongoc/mongoc-client-private.h>
+
+#include "TestSuite.h"
+#include "mock_server/mock-server.h"
+#include "mock_server/sync-queue.h"
+#include "test-libmongoc.h"
+#include "test-conveniences.h"
+
+#undef MONGOC_LOG_DOMAIN
+#define MONGOC_LOG_DOMAIN "reactor-test"
+
+#define TIMEOUT 10000 /* milliseconds */
+
+
+typedef struct {
+   mock_server_t *server;
+   sync_queue_t *requests;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_reactor_t *reactor;
+   int n_finished;
+} reactor_test_t;
+
+
+typedef struct {
+   reactor_test_t *test;
+   /* the order in which the operation finished, starting with 1 */
+   int finished;
+   bool success;
+   bson_t reply;
+   bson_error_t error;
+   uint32_t server_id;
+} reactor_result_t;
+
+
+/* queue the commands for the test, the mock server answers the ismasters */
+static bool
+enqueue_request (request_t *request, void *data)
+{
+   if (!request->is_command ||
+       !strcasecmp (request->command_name, "ismaster")) {
+      return false;
+   }
+
+   q_put ((sync_queue_t *) data, request);
+
+   return true;
+}
+
+
+static void
+reactor_test_init (reactor_test_t *test, mock_server_t *server)
+{
+   memset (test, 0, sizeof *test);
+   test->server = server;
+   test->requests = q_new ();
+   mock_server_autoresponds (server, enqueue_request, test->requests, NULL);
+   mock_server_run (server);
+
+   test->pool = mongoc_client_pool_new (mock_server_get_uri (server));
+   test->client = mongoc_client_pool_pop (test->pool);
+   test->collection = mongoc_client_get_collection (test->client, "db", "coll");
+   test->reactor = mongoc_reactor_new (test->client);
+   BSON_ASSERT (test->reactor);
+}
+
+
+static void
+reactor_test_cleanup (reactor_test_t *test)
+{
+   request_t *request;
+
+   mongoc_reactor_destroy (test->reactor);
+   mongoc_collection_destroy (test->collection);
+   mongoc_client_pool_push (test->pool, test->client);
+   mongoc_client_pool_destroy (test->pool);
+   mock_server_destroy (test->server);
+
+   while ((request = (request_t *) q_get_nowait (test->requests))) {
+      request_destroy (request);
+   }
+
+   q_destroy (test->requests);
+}
+
+
+static void
+reactor_result_init (reactor_result_t *result, reactor_test_t *test)
+{
+   memset (result, 0, sizeof *result);
+   result->test = test;
+   bson_init (&result->reply);
+}
+
+
+static void
+reactor_result_reset (reactor_result_t *result)
+{
+   bson_destroy (&result->reply);
+   reactor_result_init (result, result->test);
+}
+
+
+static void
+reactor_cb (bool success,
+            const bson_t *reply,
+            const bson_error_t *error,
+            uint32_t server_id,
+            void *ctx)
+{
+   reactor_result_t *result = (reactor_result_t *) ctx;
+
+   BSON_ASSERT (!result->finished);
+   result->finished = ++result->test->n_finished;
+   result->success = success;
+   bson_destroy (&result->reply);
+   bson_copy_to (reply, &result->reply);
+   memcpy (&result->error, error, sizeof (bson_error_t));
+   result->server_id = server_id;
+}
+
+
+/* run the reactor until the mock server receives a command */
+static request_t *
+reactor_test_receives (reactor_test_t *test)
+{
+   int64_t start = bson_get_monotonic_time ();
+   request_t *request;
+
+   while (!(request = (request_t *) q_get_nowait (test->requests))) {
+      (void) mongoc_reactor_perform (test->reactor, 10);
+      ASSERT_CMPINT64 (
+         bson_get_monotonic_time () - start, <, (int64_t) TIMEOUT * 1000);
+   }
+
+   return request;
+}
+
+
+/* run the reactor until its operations are done */
+static void
+reactor_test_run (reactor_test_t *test)
+{
+   int64_t start = bson_get_monotonic_time ();
+
+   while (mongoc_reactor_perform (test->reactor, 10)) {
+      ASSERT_CMPINT64 (
+         bson_get_monotonic_time () - start, <, (int64_t) TIMEOUT * 1000);
+   }
+}
+
+
+static void
+test_reactor_requires_pool (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   capture_logs (true);
+   BSON_ASSERT (!mongoc_reactor_new (client));
+   ASSERT_CAPTURED_LOG ("mongoc_reactor_new",
+                        MONGOC_LOG_LEVEL_ERROR,
+                        "requires a client from a client pool");
+
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+/* a command on a mock server: the command and its document sequence */
+static void
+assert_request_matches (request_t *request, const char *cmd_json, ...)
+{
+   const bson_t *docs[3];
+   va_list args;
+   const char *doc_json;
+   size_t n_docs = 1;
+
+   docs[0] = tmp_bson (cmd_json);
+
+   va_start (args, cmd_json);
+   while ((doc_json = va_arg (args, const char *))) {
+      BSON_ASSERT (n_docs < sizeof docs / sizeof docs[0]);
+      docs[n_docs++] = tmp_bson (doc_json);
+   }
+   va_end (args);
+
+   BSON_ASSERT (request_matches_msg (request, MONGOC_MSG_NONE, docs, n_docs));
+}
+
+
+static void
+test_reactor_command_concurrent (void)
+{
+   reactor_test_t test;
+   reactor_result_t results[2];
+   request_t *requests[2];
+   request_t *request;
+   bson_error_t error;
+   int i;
+
+   reactor_test_init (&test,
+                      mock_server_with_autoismaster (WIRE_VERSION_OP_MSG));
+
+   for (i = 0; i < 2; i++) {
+      reactor_result_init (&results[i], &test);
+      ASSERT_OR_PRINT (mongoc_reactor_command (test.reactor,
+                                               "admin",
+                                               tmp_bson ("{'ping': %d}", i),
+                                               NULL /* read prefs */,
+                                               NULL /* opts */,
+                                               reactor_cb,
+                                               &results[i],
+                                               &error),
+                       error);
+   }
+
+   /* both commands are in flight, each on its own connection */
+   for (i = 0; i < 2; i++) {
+      request = reactor_test_receives (&test);
+      requests[bson_lookup_int32 (request_get_doc (request, 0), "ping")] =
+         request;
+   }
+
+   assert_request_matches (requests[0], "{'ping': 0, '$db': 'admin'}", NULL);
+   assert_request_matches (requests[1], "{'ping': 1, '$db': 'admin'}", NULL);
+   BSON_ASSERT (!results[0].finished && !results[1].finished);
+
+   /* the second command can finish first */
+   mock_server_replies_simple (requests[1], "{'ok': 1, 'n': 1}");
+   while (!results[1].finished) {
+      (void) mongoc_reactor_perform (test.reactor, 10);
+   }
+
+   BSON_ASSERT (!results[0].finished);
+   mock_server_replies_simple (requests[0], "{'ok': 1, 'n': 0}");
+   reactor_test_run (&test);
+
+   for (i = 0; i < 2; i++) {
+      ASSERT_CMPINT (results[i].finished, ==, 2 - i);
+      BSON_ASSERT (results[i].success);
+      ASSERT_MATCH (&results[i].reply, "{'ok': 1, 'n': %d}", i);
+      ASSERT_CMPUINT32 (results[i].server_id, ==, (uint32_t) 1);
+      bson_destroy (&results[i].reply);
+      request_destroy (requests[i]);
+   }
+
+   reactor_test_cleanup (&test);
+}
+
+
+static void
+test_reactor_find_get_more (void)
+{
+   reactor_test_t test;
+   reactor_result_t result;
+   request_t *request;
+   bson_error_t error;
+
+   reactor_test_init (&test,
+                      mock_server_with_autoismaster (WIRE_VERSION_OP_MSG));
+   reactor_result_init (&result, &test);
+
+   ASSERT_OR_PRINT (mongoc_reactor_find (test.reactor,
+                                         test.collection,
+                                         tmp_bson ("{'x': 1}"),
+                                         tmp_bson ("{'batchSize': 1}"),
+                                         NULL /* read prefs */,
+                                         reactor_cb,
+                                         &result,
+                                         &error),
+                    error);
+
+   request = reactor_test_receives (&test);
+   assert_request_matches (request,
+                           "{'find': 'coll', 'filter': {'x': 1},"
+                           " 'batchSize': 1, '$db': 'db'}",
+                           NULL);
+   mock_server_replies_simple (request,
+                               "{'ok': 1, 'cursor': {'id': {'$numberLong': "
+                               "'123'}, 'ns': 'db.coll', 'firstBatch': "
+                               "[{'_id': 1}]}}");
+   request_destroy (request);
+   reactor_test_run (&test);
+
+   BSON_ASSERT (result.success);
+   ASSERT_MATCH (&result.reply, "{'cursor': {'firstBatch': [{'_id': 1}]}}");
+   ASSERT_CMPUINT32 (result.server_id, ==, (uint32_t) 1);
+
+   /* the getMore goes to the server that has the cursor */
+   reactor_result_reset (&result);
+   ASSERT_OR_PRINT (mongoc_reactor_get_more (test.reactor,
+                                             test.collection,
+                                             123,
+                                             1 /* server id */,
+                                             NULL /* opts */,
+                                             reactor_cb,
+                                             &result,
+                                             &error),
+                    error);
+
+   request = reactor_test_receives (&test);
+   assert_request_matches (request,
+                           "{'getMore': {'$numberLong': '123'},"
+                           " 'collection': 'coll', '$db': 'db'}",
+                           NULL);
+   mock_server_replies_simple (request,
+                               "{'ok': 1, 'cursor': {'id': 0, 'ns': "
+                               "'db.coll', 'nextBatch': [{'_id': 2}]}}");
+   request_destroy (request);
+   reactor_test_run (&test);
+
+   BSON_ASSERT (result.success);
+   ASSERT_MATCH (&result.reply,
+                 "{'cursor': {'id': 0, 'nextBatch': [{'_id': 2}]}}");
+
+   BSON_ASSERT (!mongoc_reactor_get_more (test.reactor,
+                                          test.collection,
+                                          123,
+                                          0 /* server id */,
+                                          NULL /* opts */,
+                                          reactor_cb,
+                                          &result,
+                                          &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_COMMAND,
+                          MONGOC_ERROR_COMMAND_INVALID_ARG,
+                          "requires a cursor id and a server id");
+
+   bson_destroy (&result.reply);
+   reactor_test_cleanup (&test);
+}
+
+
+static void
+test_reactor_crud (void)
+{
+   reactor_test_t test;
+   reactor_result_t result;
+   request_t *request;
+   bson_error_t error;
+   const bson_t *docs[2];
+
+   reactor_test_init (&test,
+                      mock_server_with_autoismaster (WIRE_VERSION_OP_MSG));
+   reactor_result_init (&result, &test);
+
+   docs[0] = tmp_bson ("{'_id': 1}");
+   docs[1] = tmp_bson ("{'_id': 2}");
+   ASSERT_OR_PRINT (mongoc_reactor_insert_many (test.reactor,
+                                                test.collection,
+                                                docs,
+                                                2,
+                                                NULL /* opts */,
+                                                reactor_cb,
+                                                &result,
+                                                &error),
+                    error);
+
+   request = reactor_test_receives (&test);
+   assert_request_matches (request,
+                           "{'insert': 'coll', 'ordered': true, '$db': 'db'}",
+                           "{'_id': 1}",
+                           "{'_id': 2}",
+                           NULL);
+   mock_server_replies_simple (request, "{'ok': 1, 'n': 2}");
+   request_destroy (request);
+   reactor_test_run (&test);
+
+   BSON_ASSERT (result.success);
+   ASSERT_MATCH (&result.reply, "{'insertedCount': 2}");
+
+   reactor_result_reset (&result);
+   ASSERT_OR_PRINT (mongoc_reactor_update_one (test.reactor,
+                                               test.collection,
+                                               tmp_bson ("{'_id': 1}"),
+                                               tmp_bson ("{'$set': {'x': 1}}"),
+                                               NULL /* opts */,
+                                               reactor_cb,
+                                               &result,
+                                               &error),
+                    error);
+
+   request = reactor_test_receives (&test);
+   assert_request_matches (request,
+                           "{'update': 'coll', '$db': 'db'}",
+                           "{'q': {'_id': 1}, 'u': {'$set': {'x': 1}}}",
+                           NULL);
+   mock_server_replies_simple (request, "{'ok': 1, 'n': 1, 'nModified': 1}");
+   request_destroy (request);
+   reactor_test_run (&test);
+
+   BSON_ASSERT (result.success);
+   ASSERT_MATCH (&result.reply,
+                 "{'matchedCount': 1, 'modifiedCount': 1, 'upsertedCount': 0}");
+
+   reactor_result_reset (&result);
+   ASSERT_OR_PRINT (mongoc_reactor_delete_many (test.reactor,
+                                                test.collection,
+                                                tmp_bson ("{}"),
+                                                NULL /* opts */,
+                                                reactor_cb,
+                                                &result,
+                                                &error),
+                    error);
+
+   request = reactor_test_receives (&test);
+   assert_request_matches (request,
+                           "{'delete': 'coll', '$db': 'db'}",
+                           "{'q': {}, 'limit': 0}",
+                           NULL);
+   mock_server_replies_simple (request, "{'ok': 1, 'n': 2}");
+   request_destroy (request);
+   reactor_test_run (&test);
+
+   BSON_ASSERT (result.success);
+   ASSERT_MATCH (&result.reply, "{'deletedCount': 2}");
+
+   /* invalid arguments fail right away, without calling back */
+   BSON_ASSERT (!mongoc_reactor_insert_one (test.reactor,
+                                            test.collection,
+                                            tmp_bson ("{'$bad': 1}"),
+                                            NULL /* opts */,
+                                            reactor_cb,
+                                            &result,
+                                            &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_COMMAND,
+                          MONGOC_ERROR_COMMAND_INVALID_ARG,
+                          "invalid document for insert");
+
+   BSON_ASSERT (!mongoc_reactor_insert_one (test.reactor,
+                                            test.collection,
+                                            tmp_bson ("{}"),
+                                            tmp_bson ("{'writeConcern': "
+                                                      "{'w': 0}}"),
+                                            reactor_cb,
+                                            &result,
+                                            &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_COMMAND,
+                          MONGOC_ERROR_COMMAND_INVALID_ARG,
+                          "cannot run unacknowledged writes");
+   ASSERT_CMPSIZE_T (mongoc_reactor_perform (test.reactor, 0), ==, (size_t) 0);
+
+   bson_destroy (&result.reply);
+   reactor_test_cleanup (&test);
+}
+
+
+static void
+test_reactor_insert_batches (void)
+{
+   mock_server_t *server;
+   reactor_test_t test;
+   reactor_result_t result;
+   request_t *request;
+   bson_error_t error;
+   const bson_t *docs[3];
+
+   server = mock_server_new ();
+   mock_server_auto_ismaster (server,
+                              "{'ok': 1, 'ismaster': true,"
+                              " 'minWireVersion': 0, 'maxWireVersion': %d,"
+                              " 'maxWriteBatchSize': 2}",
+                              WIRE_VERSION_OP_MSG);
+   reactor_test_init (&test, server);
+   reactor_result_init (&result, &test);
+
+   docs[0] = tmp_bson ("{'_id': 1}");
+   docs[1] = tmp_bson ("{'_id': 2}");
+   docs[2] = tmp_bson ("{'_id': 3}");
+   ASSERT_OR_PRINT (mongoc_reactor_insert_many (test.reactor,
+                                                test.collection,
+                                                docs,
+                                                3,
+                                                NULL /* opts */,
+                                                reactor_cb,
+                                                &result,
+                                                &error),
+                    error);
+
+   /* the documents are split in batches of maxWriteBatchSize */
+   request = reactor_test_receives (&test);
+   assert_request_matches (
+      request, "{'insert': 'coll'}", "{'_id': 1}", "{'_id': 2}", NULL);
+   mock_server_replies_simple (request, "{'ok': 1, 'n': 2}");
+   request_destroy (request);
+
+   request = reactor_test_receives (&test);
+   assert_request_matches (request, "{'insert': 'coll'}", "{'_id': 3}", NULL);
+   BSON_ASSERT (!result.finished);
+   mock_server_replies_simple (request, "{'ok': 1, 'n': 1}");
+   request_destroy (request);
+   reactor_test_run (&test);
+
+   BSON_ASSERT (result.success);
+   ASSERT_MATCH (&result.reply, "{'insertedCount': 3}");
+
+   bson_destroy (&result.reply);
+   reactor_test_cleanup (&test);
+}
+
+
+static void
+test_reactor_bulk (void)
+{
+   reactor_test_t test;
+   reactor_result_t result;
+   mongoc_bulk_operation_t *bulk;
+   request_t *request;
+   bson_error_t error;
+
+   reactor_test_init (&test,
+                      mock_server_with_autoismaster (WIRE_VERSION_OP_MSG));
+   reactor_result_init (&result, &test);
+
+   bulk = mongoc_collection_create_bulk_operation_with_opts (test.collection,
+                                                             NULL);
+   mongoc_bulk_operation_insert (bulk, tmp_bson ("{'_id': 1}"));
+   mongoc_bulk_operation_update_one (
+      bulk, tmp_bson ("{'_id': 1}"), tmp_bson ("{'$inc': {'x': 1}}"), false);
+
+   ASSERT_OR_PRINT (mongoc_reactor_bulk_operation_execute (
+                       test.reactor, bulk, reactor_cb, &result, &error),
+                    error);
+
+   /* the commands are sent in turn */
+   request = reactor_test_receives (&test);
+   assert_request_matches (request, "{'insert': 'coll'}", "{'_id': 1}", NULL);
+   mock_server_replies_simple (request, "{'ok': 1, 'n': 1}");
+   request_destroy (request);
+
+   request = reactor_test_receives (&test);
+   assert_request_matches (request,
+                           "{'update': 'coll'}",
+                           "{'q': {'_id': 1}, 'u': {'$inc': {'x': 1}}}",
+                           NULL);
+   mock_server_replies_simple (request, "{'ok': 1, 'n': 1, 'nModified': 1}");
+   request_destroy (request);
+   reactor_test_run (&test);
+
+   BSON_ASSERT (result.success);
+   ASSERT_MATCH (&result.reply,
+                 "{'nInserted': 1, 'nMatched': 1, 'nModified': 1}");
+   ASSERT_CMPUINT32 (mongoc_bulk_operation_get_hint (bulk), ==, (uint32_t) 1);
+
+   mongoc_bulk_operation_destroy (bulk);
+   bson_destroy (&result.reply);
+   reactor_test_cleanup (&test);
+}
+
+
+static void
+test_reactor_bulk_ordered_error (void)
+{
+   reactor_test_t test;
+   reactor_result_t result;
+   mongoc_bulk_operation_t *bulk;
+   request_t *request;
+   bson_error_t error;
+
+   reactor_test_init (&test,
+                      mock_server_with_autoismaster (WIRE_VERSION_OP_MSG));
+   reactor_result_init (&result, &test);
+
+   bulk = mongoc_collection_create_bulk_operation_with_opts (test.collection,
+                                                             NULL);
+   mongoc_bulk_operation_insert (bulk, tmp_bson ("{'_id': 1}"));
+   mongoc_bulk_operation_remove_one (bulk, tmp_bson ("{'_id': 1}"));
+
+   ASSERT_OR_PRINT (mongoc_reactor_bulk_operation_execute (
+                       test.reactor, bulk, reactor_cb, &result, &error),
+                    error);
+
+   request = reactor_test_receives (&test);
+   assert_request_matches (request, "{'insert': 'coll'}", "{'_id': 1}", NULL);
+   mock_server_replies_simple (request,
+                               "{'ok': 1, 'n': 0, 'writeErrors': [{'index': "
+                               "0, 'code': 11000, 'errmsg': 'dupe'}]}");
+   request_destroy (request);
+   reactor_test_run (&test);
+
+   /* an ordered bulk stops at the first error, the delete isn't sent */
+   BSON_ASSERT (!result.success);
+   ASSERT_ERROR_CONTAINS (
+      result.error, MONGOC_ERROR_COMMAND, 11000, "dupe");
+   ASSERT_MATCH (&result.reply,
+                 "{'nInserted': 0, 'nRemoved': 0,"
+                 " 'writeErrors': [{'index': 0, 'code': 11000}]}");
+   BSON_ASSERT (!q_get_nowait (test.requests));
+
+   mongoc_bulk_operation_destroy (bulk);
+   bson_destroy (&result.reply);
+   reactor_test_cleanup (&test);
+}
+
+
+static void
+test_reactor_network_error (void)
+{
+   reactor_test_t test;
+   reactor_result_t results[2];
+   request_t *request;
+   bson_error_t error;
+   int i;
+
+   reactor_test_init (&test,
+                      mock_server_with_autoismaster (WIRE_VERSION_OP_MSG));
+
+   for (i = 0; i < 2; i++) {
+      reactor_result_init (&results[i], &test);
+   }
+
+   ASSERT_OR_PRINT (mongoc_reactor_command (test.reactor,
+                                            "admin",
+                                            tmp_bson ("{'ping': 1}"),
+                                            NULL /* read prefs */,
+                                            NULL /* opts */,
+                                            reactor_cb,
+                                            &results[0],
+                                            &error),
+                    error);
+
+   request = reactor_test_receives (&test);
+   mock_server_hangs_up (request);
+   request_destroy (request);
+   reactor_test_run (&test);
+
+   BSON_ASSERT (!results[0].success);
+   ASSERT_CMPUINT32 (results[0].error.domain, ==, (uint32_t) MONGOC_ERROR_STREAM);
+
+   /* the server is rediscovered for the next operation */
+   ASSERT_OR_PRINT (mongoc_reactor_command (test.reactor,
+                                            "admin",
+                                            tmp_bson ("{'ping': 1}"),
+                                            NULL /* read prefs */,
+                                            NULL /* opts */,
+                                            reactor_cb,
+                                            &results[1],
+                                            &error),
+                    error);
+
+   request = reactor_test_receives (&test);
+   mock_server_replies_ok_and_destroys (request);
+   reactor_test_run (&test);
+
+   BSON_ASSERT (results[1].success);
+
+   for (i = 0; i < 2; i++) {
+      bson_destroy (&results[i].reply);
+   }
+
+   reactor_test_cleanup (&test);
+}
+
+
+static void
+test_reactor_destroy_in_progress (void)
+{
+   reactor_test_t test;
+   reactor_result_t result;
+   request_t *request;
+   bson_error_t error;
+
+   reactor_test_init (&test,
+                      mock_server_with_autoismaster (WIRE_VERSION_OP_MSG));
+   reactor_result_init (&result, &test);
+
+   ASSERT_OR_PRINT (mongoc_reactor_insert_one (test.reactor,
+                                               test.collection,
+                                               tmp_bson ("{'_id': 1}"),
+                                               NULL /* opts */,
+                                               reactor_cb,
+                                               &result,
+                                               &error),
+                    error);
+
+   request = reactor_test_receives (&test);
+
+   /* the operation is canceled without calling back */
+   mongoc_reactor_destroy (test.reactor);
+   test.reactor = NULL;
+   BSON_ASSERT (!result.finished);
+
+   request_destroy (request);
+   bson_destroy (&result.reply);
+   reactor_test_cleanup (&test);
+}
+
+
+#ifndef _WIN32
+static void
+test_reactor_external_loop (void)
+{
+   reactor_test_t test;
+   reactor_result_t result;
+   request_t *request = NULL;
+   bson_error_t error;
+   mongoc_reactor_fd_t fds[4];
+   struct pollfd pfds[4];
+   int64_t timeout_msec;
+   int64_t start;
+   size_t n_fds;
+   size_t i;
+
+   reactor_test_init (&test,
+                      mock_server_with_autoismaster (WIRE_VERSION_OP_MSG));
+   reactor_result_init (&result, &test);
+
+   ASSERT_OR_PRINT (mongoc_reactor_command (test.reactor,
+                                            "admin",
+                                            tmp_bson ("{'ping': 1}"),
+                                            NULL /* read prefs */,
+                                            NULL /* opts */,
+                                            reactor_cb,
+                                            &result,
+                                            &error),
+                    error);
+
+   /* wait on the reactor's sockets in the application's own poll loop */
+   start = bson_get_monotonic_time ();
+   while (!result.finished) {
+      n_fds = mongoc_reactor_get_fds (test.reactor, fds, 4, &timeout_msec);
+      ASSERT_CMPSIZE_T (n_fds, ==, (size_t) 1);
+      BSON_ASSERT (fds[0].fd >= 0);
+
+      for (i = 0; i < n_fds; i++) {
+         pfds[i].fd = fds[i].fd;
+         pfds[i].events = (short) fds[i].events;
+         pfds[i].revents = 0;
+      }
+
+      (void) poll (pfds, (nfds_t) n_fds, (int) BSON_MIN (timeout_msec, 10));
+
+      for (i = 0; i < n_fds; i++) {
+         fds[i].revents = pfds[i].revents;
+      }
+
+      mongoc_reactor_dispatch (test.reactor, fds, n_fds);
+
+      if (!request) {
+         request = (request_t *) q_get_nowait (test.requests);
+         if (request) {
+            mock_server_replies_ok_and_destroys (request);
+         }
+      }
+
+      ASSERT_CMPINT64 (
+         bson_get_monotonic_time () - start, <, (int64_t) TIMEOUT * 1000);
+   }
+
+   BSON_ASSERT (result.success);
+   ASSERT_CMPSIZE_T (
+      mongoc_reactor_get_fds (test.reactor, fds, 4, &timeout_msec),
+      ==,
+      (size_t) 0);
+
+   bson_destroy (&result.reply);
+   reactor_test_cleanup (&test);
+}
+#endif
+
+
+void
+test_reactor_install (TestSuite *suite)
+{
+   TestSuite_AddMockServerTest (
+      suite, "/Reactor/requires_pool", test_reactor_requires_pool);
+   TestSuite_AddMockServerTest (
+      suite, "/Reactor/command/concurrent", test_reactor_command_concurrent);
+   TestSuite_AddMockServerTest (
+      suite, "/Reactor/find_get_more", test_reactor_find_get_more);
+   TestSuite_AddMockServerTest (suite, "/Reactor/crud", test_reactor_crud);
+   TestSuite_AddMockServerTest (
+      suite, "/Reactor/insert_batches", test_reactor_insert_batches);
+   TestSuite_AddMockServerTest (suite, "/Reactor/bulk", test_reactor_bulk);
+   TestSuite_AddMockServerTest (
+      suite, "/Reactor/bulk/ordered_error", test_reactor_bulk_ordered_error);
+   TestSuite_AddMockServerTest (
+      suite, "/Reactor/network_error", test_reactor_network_error);
+   TestSuite_AddMockServerTest (
+      suite, "/Reactor/destroy_in_progress", test_reactor_destroy_in_progress);
+#ifndef _WIN32
+   TestSuite_AddMockServerTest (
+      suite, "/Reactor/external_loop", test_reactor_external_loop);
+#endif
+}
@@ -1,5 +1,8 @@
 #include <mongoc/mongoc.h>
+#include <mongoc/mongoc-read-prefs-private.h>
+#include <mongoc/mongoc-thread-private.h>
 #include <mongoc/mongoc-uri-private.h>
+#include <mongoc/mongoc-util-private.h>
 
 #include "TestSuite.h"
 #include "mock_server/future.h"
@@ -842,7 +845,7 @@ test_read_prefs_mongos_max_staleness (void)
 
 /* CDRIVER-3583 - support for server hedged reads */
 static void
-test_read_prefs_mongos_hedged_reads (void)
+_test_read_prefs_mongos_hedged_reads (int32_t max_wire_version)
 {
    mock_server_t *server;
    mongoc_client_t *client;
@@ -854,7 +857,8 @@ test_read_prefs_mongos_hedged_reads (void)
    future_t *future;
    request_t *request;
 
-   server = mock_mongos_new (WIRE_VERSION_HEDGED_READS);
+   server = mock_mongos_new (max_wire_version);
+   mock_server_auto_endsessions (server);
    mock_server_run (server);
    client = mongoc_client_new_from_uri (mock_server_get_uri (server));
    collection = mongoc_client_get_collection (client, "test", "test");
@@ -864,29 +868,46 @@ test_read_prefs_mongos_hedged_reads (void)
 
    mongoc_read_prefs_set_hedge (prefs, &hedge_doc);
 
-   /* exhaust cursor is required so the driver downgrades the OP_QUERY find
-    * command to an OP_QUERY legacy find */
    cursor = mongoc_collection_find_with_opts (
       collection, tmp_bson ("{'a': 1}"), tmp_bson ("{'exhaust': true}"), prefs);
    future = future_cursor_next (cursor, &doc);
-   request = mock_server_receives_query (
-      server,
-      "test.test",
-      MONGOC_QUERY_EXHAUST | MONGOC_QUERY_SLAVE_OK,
-      0,
-      0,
-      "{'$query': {'a': 1},"
-      " '$readPreference': {'mode': 'secondaryPreferred',"
-      "                     'hedge': {'enabled': true}}}",
-      "{}");
 
-   mock_server_replies_to_find (request,
-                                MONGOC_QUERY_EXHAUST | MONGOC_QUERY_SLAVE_OK,
-                                0,
-                                1,
-                                "test.test",
-                                "{}",
-                                false);
+   if (max_wire_version < WIRE_VERSION_4_2) {
+      /* exhaust cursor is required so the driver downgrades the OP_QUERY find
+       * command to an OP_QUERY legacy find */
+      request = mock_server_receives_query (
+         server,
+         "test.test",
+         MONGOC_QUERY_EXHAUST | MONGOC_QUERY_SLAVE_OK,
+         0,
+         0,
+         "{'$query': {'a': 1},"
+         " '$readPreference': {'mode': 'secondaryPreferred',"
+         "                     'hedge': {'enabled': true}}}",
+         "{}");
+
+      mock_server_replies_to_find (request,
+                                   MONGOC_QUERY_EXHAUST | MONGOC_QUERY_SLAVE_OK,
+                                   0,
+                                   1,
+                                   "test.test",
+                                   "{}",
+                                   false);
+   } else {
+      /* an exhaust cursor on MongoDB 4.2+ still uses the find command */
+      request = mock_server_receives_msg (
+         server,
+         MONGOC_MSG_NONE,
+         tmp_bson ("{'find': 'test', 'filter': {'a': 1},"
+                   " '$readPreference': {'mode': 'secondaryPreferred',"
+                   "                     'hedge': {'enabled': true}}}"));
+
+      mock_server_replies_opmsg (
+         request,
+         MONGOC_MSG_NONE,
+         tmp_bson ("{'ok': 1, 'cursor': {'id': {'$numberLong': '0'},"
+                   " 'ns': 'test.test', 'firstBatch': [{}]}}"));
+   }
 
    /* mongoc_cursor_next returned true */
    BSON_ASSERT (future_get_bool (future));
@@ -901,6 +922,391 @@ test_read_prefs_mongos_hedged_reads (void)
    mock_server_destroy (server);
 }
 
+
+static void
+test_read_prefs_mongos_hedged_reads_op_query (void)
+{
+   _test_read_prefs_mongos_hedged_reads (WIRE_VERSION_4_0);
+}
+
+
+static void
+test_read_prefs_mongos_hedged_reads_op_msg (void)
+{
+   _test_read_prefs_mongos_hedged_reads (WIRE_VERSION_HEDGED_READS);
+}
+
+typedef struct {
+   int32_t n;
+   volatile bool slow;
+   volatile int32_t n_counts;
+   volatile int32_t n_finds;
+   volatile int32_t n_slow_finds;
+   volatile int32_t n_get_mores;
+   volatile int32_t n_kill_cursors;
+   /* the connections that ran a find, and whether killCursors came on one
+    * that ran a slow find */
+   bson_mutex_t mutex;
+   uint16_t ports[64];
+   bool slow_ports[64];
+   int n_ports;
+   bool killed_on_other_port;
+} hedge_server_t;
+
+
+static bool
+hedge_server_count (request_t *request, void *data)
+{
+   hedge_server_t *hs = (hedge_server_t *) data;
+   char *reply;
+
+   if (!request->is_command ||
+       strcasecmp (request->command_name, "count") != 0) {
+      return false;
+   }
+
+   bson_atomic_int_add (&hs->n_counts, 1);
+   if (hs->slow) {
+      _mongoc_usleep (500 * 1000);
+   }
+
+   reply = bson_strdup_printf ("{'ok': 1, 'n': %d}", hs->n);
+   mock_server_replies_simple (request, reply);
+   bson_free (reply);
+   request_destroy (request);
+
+   return true;
+}
+
+
+/* the index in @hs->ports of the connection that sent @request */
+static int
+_hedge_server_port (hedge_server_t *hs, request_t *request)
+{
+   int i;
+
+   for (i = 0; i < hs->n_ports; i++) {
+      if (hs->ports[i] == request->client_port) {
+         return i;
+      }
+   }
+
+   ASSERT_CMPINT (hs->n_ports, <, 64);
+   hs->ports[hs->n_ports] = request->client_port;
+   hs->slow_ports[hs->n_ports] = false;
+
+   return hs->n_ports++;
+}
+
+
+static bool
+hedge_server_cursor (request_t *request, void *data)
+{
+   hedge_server_t *hs = (hedge_server_t *) data;
+   char *reply;
+   int port;
+
+   if (!request->is_command) {
+      return false;
+   }
+
+   if (!strcmp (request->command_name, "find")) {
+      bson_mutex_lock (&hs->mutex);
+      port = _hedge_server_port (hs, request);
+      if (hs->slow) {
+         hs->slow_ports[port] = true;
+         hs->n_slow_finds++;
+      }
+
+      bson_mutex_unlock (&hs->mutex);
+      bson_atomic_int_add (&hs->n_finds, 1);
+      if (hs->slow) {
+         _mongoc_usleep (500 * 1000);
+      }
+
+      reply = bson_strdup_printf ("{'ok': 1,"
+                                  " 'cursor': {"
+                                  "    'id': {'$numberLong': '123'},"
+                                  "    'ns': 'db.collection',"
+                                  "    'firstBatch': [{'n': %d}]}}",
+                                  hs->n);
+      mock_server_replies_simple (request, reply);
+      bson_free (reply);
+   } else if (!strcmp (request->command_name, "getMore")) {
+      bson_atomic_int_add (&hs->n_get_mores, 1);
+      mock_server_replies_simple (request,
+                                  "{'ok': 1,"
+                                  " 'cursor': {"
+                                  "    'id': 0,"
+                                  "    'ns': 'db.collection',"
+                                  "    'nextBatch': []}}");
+   } else if (!strcmp (request->command_name, "killCursors")) {
+      ASSERT_MATCH (request_get_doc (request, 0),
+                    "{'killCursors': 'collection',"
+                    " 'cursors': [{'$numberLong': '123'}]}");
+      bson_mutex_lock (&hs->mutex);
+      port = _hedge_server_port (hs, request);
+      if (!hs->slow_ports[port]) {
+         hs->killed_on_other_port = true;
+      }
+
+      bson_mutex_unlock (&hs->mutex);
+      bson_atomic_int_add (&hs->n_kill_cursors, 1);
+      mock_server_replies_simple (
+         request, "{'ok': 1, 'cursorsKilled': [{'$numberLong': '123'}]}");
+   } else {
+      return false;
+   }
+
+   request_destroy (request);
+
+   return true;
+}
+
+
+static size_t
+_count_secondaries (mongoc_client_t *client)
+{
+   mongoc_server_description_t **sds;
+   size_t n;
+   size_t i;
+   size_t n_secondaries = 0;
+
+   sds = mongoc_client_get_server_descriptions (client, &n);
+   for (i = 0; i < n; i++) {
+      if (!strcmp (mongoc_server_description_type (sds[i]), "RSSecondary")) {
+         n_secondaries++;
+      }
+   }
+
+   mongoc_server_descriptions_destroy_all (sds, n);
+
+   return n_secondaries;
+}
+
+
+/* a client pool hedges reads to replica set members itself */
+static void
+test_read_prefs_rssecondary_hedged_reads (void)
+{
+   mock_server_t *servers[2];
+   hedge_server_t hedge_servers[2] = {{0}};
+   char *uri_str;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_read_prefs_t *prefs;
+   mongoc_read_prefs_t *hedged_prefs;
+   bson_t *cmd;
+   bson_t reply;
+   bson_error_t error;
+   int64_t start;
+   int i;
+
+   for (i = 0; i < 2; i++) {
+      servers[i] = mock_server_new ();
+      mock_server_run (servers[i]);
+   }
+
+   for (i = 0; i < 2; i++) {
+      mock_server_auto_ismaster (servers[i],
+                                 "{'ok': 1,"
+                                 " 'maxWireVersion': %d,"
+                                 " 'ismaster': false,"
+                                 " 'secondary': true,"
+                                 " 'setName': 'rs',"
+                                 " 'hosts': ['%s', '%s']}",
+                                 WIRE_VERSION_OP_MSG,
+                                 mock_server_get_host_and_port (servers[0]),
+                                 mock_server_get_host_and_port (servers[1]));
+      hedge_servers[i].n = i;
+      mock_server_autoresponds (
+         servers[i], hedge_server_count, &hedge_servers[i], NULL);
+   }
+
+   uri_str = bson_strdup_printf ("mongodb://%s,%s/?replicaSet=rs",
+                                 mock_server_get_host_and_port (servers[0]),
+                                 mock_server_get_host_and_port (servers[1]));
+   uri = mongoc_uri_new (uri_str);
+   pool = mongoc_client_pool_new (uri);
+   client = mongoc_client_pool_pop (pool);
+   WAIT_UNTIL (_count_secondaries (client) == 2);
+
+   prefs = mongoc_read_prefs_new (MONGOC_READ_SECONDARY);
+   hedged_prefs = mongoc_read_prefs_copy (prefs);
+   mongoc_read_prefs_set_hedge (hedged_prefs, tmp_bson ("{'enabled': true}"));
+   cmd = tmp_bson ("{'count': 'collection'}");
+
+   /* learn both servers' latencies, which set the hedging delay */
+   for (i = 0; i < 20; i++) {
+      ASSERT_OR_PRINT (mongoc_client_read_command_with_opts (
+                          client, "db", cmd, prefs, NULL, NULL, &error),
+                       error);
+   }
+
+   ASSERT_CMPINT32 (hedge_servers[0].n_counts, >, 0);
+   ASSERT_CMPINT32 (hedge_servers[1].n_counts, >, 0);
+
+   /* reads sent first to the slow server are answered by the other */
+   hedge_servers[0].slow = true;
+   hedge_servers[0].n_counts = 0;
+   for (i = 0; i < 20; i++) {
+      start = bson_get_monotonic_time ();
+      ASSERT_OR_PRINT (
+         mongoc_client_read_command_with_opts (
+            client, "db", cmd, hedged_prefs, NULL, &reply, &error),
+         error);
+      ASSERT_CMPINT64 (bson_get_monotonic_time () - start, <, 400 * 1000);
+      ASSERT_MATCH (&reply, "{'n': 1}");
+      bson_destroy (&reply);
+   }
+
+   ASSERT_CMPINT32 (hedge_servers[0].n_counts, >, 0);
+
+   mongoc_read_prefs_destroy (hedged_prefs);
+   mongoc_read_prefs_destroy (prefs);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   bson_free (uri_str);
+   for (i = 0; i < 2; i++) {
+      mock_server_destroy (servers[i]);
+   }
+}
+
+
+/* run a find and read both batches, return the first batch's "n" */
+static int32_t
+_hedged_find (mongoc_collection_t *collection,
+              const mongoc_read_prefs_t *prefs)
+{
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   bson_error_t error;
+   int32_t n;
+
+   cursor = mongoc_collection_find_with_opts (
+      collection, tmp_bson ("{}"), NULL, prefs);
+   ASSERT_CURSOR_NEXT (cursor, &doc);
+   n = bson_lookup_int32 (doc, "n");
+   /* the getMore goes to the server that holds the cursor */
+   ASSERT_CURSOR_DONE (cursor);
+   mongoc_cursor_destroy (cursor);
+
+   return n;
+}
+
+
+/* a hedged find that loses is drained and its cursor killed on the same
+ * connection, which is then reused */
+static void
+test_read_prefs_rssecondary_hedged_find (void)
+{
+   mock_server_t *servers[2];
+   hedge_server_t hedge_servers[2] = {{0}};
+   char *uri_str;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_read_prefs_t *prefs;
+   mongoc_read_prefs_t *hedged_prefs;
+   int32_t n_get_mores;
+   int n_ports;
+   int64_t start;
+   int i;
+
+   for (i = 0; i < 2; i++) {
+      servers[i] = mock_server_new ();
+      mock_server_run (servers[i]);
+   }
+
+   for (i = 0; i < 2; i++) {
+      mock_server_auto_ismaster (servers[i],
+                                 "{'ok': 1,"
+                                 " 'maxWireVersion': %d,"
+                                 " 'ismaster': false,"
+                                 " 'secondary': true,"
+                                 " 'setName': 'rs',"
+                                 " 'hosts': ['%s', '%s']}",
+                                 WIRE_VERSION_OP_MSG,
+                                 mock_server_get_host_and_port (servers[0]),
+                                 mock_server_get_host_and_port (servers[1]));
+      hedge_servers[i].n = i;
+      bson_mutex_init (&hedge_servers[i].mutex);
+      mock_server_autoresponds (
+         servers[i], hedge_server_cursor, &hedge_servers[i], NULL);
+   }
+
+   uri_str = bson_strdup_printf ("mongodb://%s,%s/?replicaSet=rs",
+                                 mock_server_get_host_and_port (servers[0]),
+                                 mock_server_get_host_and_port (servers[1]));
+   uri = mongoc_uri_new (uri_str);
+   pool = mongoc_client_pool_new (uri);
+   client = mongoc_client_pool_pop (pool);
+   collection = mongoc_client_get_collection (client, "db", "collection");
+   WAIT_UNTIL (_count_secondaries (client) == 2);
+
+   prefs = mongoc_read_prefs_new (MONGOC_READ_SECONDARY);
+   hedged_prefs = mongoc_read_prefs_copy (prefs);
+   mongoc_read_prefs_set_hedge (hedged_prefs, tmp_bson ("{'enabled': true}"));
+
+   /* learn both servers' latencies, which set the hedging delay */
+   for (i = 0; i < 20; i++) {
+      (void) _hedged_find (collection, prefs);
+   }
+
+   ASSERT_CMPINT32 (hedge_servers[0].n_finds, >, 0);
+   ASSERT_CMPINT32 (hedge_servers[1].n_finds, >, 0);
+
+   /* finds sent first to the slow server are answered by the other, whose
+    * cursor the getMore then uses */
+   hedge_servers[0].slow = true;
+   n_get_mores = hedge_servers[0].n_get_mores;
+   for (i = 0; i < 50 && hedge_servers[0].n_slow_finds < 3; i++) {
+      start = bson_get_monotonic_time ();
+      ASSERT_CMPINT32 (_hedged_find (collection, hedged_prefs), ==, 1);
+      ASSERT_CMPINT64 (bson_get_monotonic_time () - start, <, 400 * 1000);
+   }
+
+   ASSERT_CMPINT32 (hedge_servers[0].n_slow_finds, >, 0);
+   ASSERT_CMPINT32 (hedge_servers[0].n_get_mores, ==, n_get_mores);
+
+   /* once the discarded replies arrive, reads from the slow server's
+    * connections first kill the cursors the replies opened */
+   hedge_servers[0].slow = false;
+   _mongoc_usleep (600 * 1000);
+   bson_mutex_lock (&hedge_servers[0].mutex);
+   n_ports = hedge_servers[0].n_ports;
+   bson_mutex_unlock (&hedge_servers[0].mutex);
+   for (i = 0; i < 100 && hedge_servers[0].n_kill_cursors <
+                             hedge_servers[0].n_slow_finds;
+        i++) {
+      (void) _hedged_find (collection, prefs);
+   }
+
+   ASSERT_CMPINT32 (
+      hedge_servers[0].n_kill_cursors, ==, hedge_servers[0].n_slow_finds);
+   ASSERT (!hedge_servers[0].killed_on_other_port);
+   /* no connection was closed and replaced */
+   bson_mutex_lock (&hedge_servers[0].mutex);
+   ASSERT_CMPINT (hedge_servers[0].n_ports, ==, n_ports);
+   bson_mutex_unlock (&hedge_servers[0].mutex);
+
+   mongoc_read_prefs_destroy (hedged_prefs);
+   mongoc_read_prefs_destroy (prefs);
+   mongoc_collection_destroy (collection);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   bson_free (uri_str);
+   for (i = 0; i < 2; i++) {
+      mock_server_destroy (servers[i]);
+      bson_mutex_destroy (&hedge_servers[i].mutex);
+   }
+}
+
+
 /* test that we add readConcern only inside $query, not outside it too */
 static void
 test_mongos_read_concern (void)
@@ -1089,6 +1495,41 @@ test_op_msg_direct_mongos ()
 }
 
 
+/* the encoded $readPreference follows each change to the read prefs */
+static void
+test_read_prefs_compiled (void)
+{
+   mongoc_read_prefs_t *prefs;
+   mongoc_read_prefs_t *copy;
+
+   prefs = mongoc_read_prefs_new (MONGOC_READ_SECONDARY);
+   ASSERT_CMPINT (bson_count_keys (_mongoc_read_prefs_get_bson (prefs)), ==, 1);
+   ASSERT_MATCH (_mongoc_read_prefs_get_bson (prefs), "{'mode': 'secondary'}");
+
+   mongoc_read_prefs_set_mode (prefs, MONGOC_READ_NEAREST);
+   mongoc_read_prefs_add_tag (prefs, tmp_bson ("{'dc': 'ny'}"));
+   mongoc_read_prefs_set_max_staleness_seconds (prefs, 120);
+   mongoc_read_prefs_set_hedge (prefs, tmp_bson ("{'enabled': true}"));
+   ASSERT_MATCH (_mongoc_read_prefs_get_bson (prefs),
+                 "{'mode': 'nearest', 'tags': [{'dc': 'ny'}],"
+                 " 'maxStalenessSeconds': {'$numberLong': '120'},"
+                 " 'hedge': {'enabled': true}}");
+
+   copy = mongoc_read_prefs_copy (prefs);
+   mongoc_read_prefs_set_tags (prefs, NULL);
+   mongoc_read_prefs_set_hedge (prefs, NULL);
+   mongoc_read_prefs_set_max_staleness_seconds (prefs,
+                                                MONGOC_NO_MAX_STALENESS);
+   ASSERT_CMPINT (bson_count_keys (_mongoc_read_prefs_get_bson (prefs)), ==, 1);
+   ASSERT_MATCH (_mongoc_read_prefs_get_bson (prefs), "{'mode': 'nearest'}");
+   ASSERT_MATCH (_mongoc_read_prefs_get_bson (copy),
+                 "{'mode': 'nearest', 'tags': [{'dc': 'ny'}]}");
+
+   mongoc_read_prefs_destroy (copy);
+   mongoc_read_prefs_destroy (prefs);
+}
+
+
 void
 test_read_prefs_install (TestSuite *suite)
 {
@@ -1122,12 +1563,22 @@ test_read_prefs_install (TestSuite *suite)
                                 "/ReadPrefs/mongos/maxStaleness",
                                 test_read_prefs_mongos_max_staleness);
    TestSuite_AddMockServerTest (suite,
-                                "/ReadPrefs/mongos/hedgedReads",
-                                test_read_prefs_mongos_hedged_reads);
+                                "/ReadPrefs/mongos/hedgedReads/op_query",
+                                test_read_prefs_mongos_hedged_reads_op_query);
+   TestSuite_AddMockServerTest (suite,
+                                "/ReadPrefs/mongos/hedgedReads/op_msg",
+                                test_read_prefs_mongos_hedged_reads_op_msg);
+   TestSuite_AddMockServerTest (suite,
+                                "/ReadPrefs/rssecondary/hedgedReads",
+                                test_read_prefs_rssecondary_hedged_reads);
+   TestSuite_AddMockServerTest (suite,
+                                "/ReadPrefs/rssecondary/hedgedFind",
+                                test_read_prefs_rssecondary_hedged_find);
    TestSuite_AddMockServerTest (
       suite, "/ReadPrefs/mongos/readConcern", test_mongos_read_concern);
    TestSuite_AddMockServerTest (
       suite, "/ReadPrefs/OP_MSG/secondary", test_op_msg_direct_secondary);
    TestSuite_AddMockServerTest (
       suite, "/ReadPrefs/OP_MSG/mongos", test_op_msg_direct_mongos);
+   TestSuite_Add (suite, "/ReadPrefs/compiled", test_read_prefs_compiled);
 }
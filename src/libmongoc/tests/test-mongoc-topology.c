@@ -599,11 +599,11 @@ test_invalid_cluster_node (void *ctx)
       &client->cluster, NULL, NULL, NULL, &error);
    ASSERT_OR_PRINT (server_stream, error);
    id = server_stream->sd->id;
-   mongoc_server_stream_cleanup (server_stream);
 
    cluster_node = (mongoc_cluster_node_t *) mongoc_set_get (cluster->nodes, id);
    BSON_ASSERT (cluster_node);
    BSON_ASSERT (cluster_node->stream);
+   ASSERT_CMPINT (cluster_node->in_use, ==, 1);
 
    bson_mutex_lock (&client->topology->mutex);
    sd = mongoc_topology_description_server_by_id (
@@ -617,12 +617,24 @@ test_invalid_cluster_node (void *ctx)
    sd->generation++;
    bson_mutex_unlock (&client->topology->mutex);
 
+   /* the node goes to the pool's idle connections */
+   mongoc_server_stream_cleanup (server_stream);
+   BSON_ASSERT (!mongoc_set_get (cluster->nodes, id));
+   ASSERT_CMPSIZE_T (
+      mongoc_connection_pool_count_idle (client->topology->connection_pool),
+      ==,
+      (size_t) 1);
+
    /* cluster discards node and creates new one with the current generation */
    server_stream = mongoc_cluster_stream_for_server (
       &client->cluster, id, true, NULL, NULL, &error);
    ASSERT_OR_PRINT (server_stream, error);
    cluster_node = (mongoc_cluster_node_t *) mongoc_set_get (cluster->nodes, id);
    ASSERT_CMPINT64 (cluster_node->generation, ==, 1);
+   ASSERT_CMPSIZE_T (
+      mongoc_connection_pool_count_idle (client->topology->connection_pool),
+      ==,
+      (size_t) 0);
 
    mongoc_server_stream_cleanup (server_stream);
    mongoc_client_pool_push (pool, client);
@@ -1149,8 +1161,17 @@ _test_server_removed_during_handshake (bool pooled)
                               " 'hosts': ['%s']}",
                               mock_server_get_host_and_port (server));
 
-   /* pretend to close a connection. does NOT affect server description yet */
+   /* pretend to close a connection. does NOT affect server description yet.
+    * a pooled client had returned the connection to the pool, which closes
+    * idle connections to the server too */
    mongoc_cluster_disconnect_node (&client->cluster, 1);
+   if (pooled) {
+      ASSERT_CMPSIZE_T (mongoc_connection_pool_count_idle_for_server (
+                           client->topology->connection_pool, 1),
+                        ==,
+                        (size_t) 0);
+   }
+
    sd = mongoc_client_get_server_description (client, 1);
    /* still primary */
    ASSERT_CMPINT ((int) MONGOC_SERVER_RS_PRIMARY, ==, sd->type);
@@ -2202,6 +2223,242 @@ test_slow_server_pooled (void)
    mock_server_destroy (primary);
    checks_cleanup (&checks);
 }
+
+/* Application threads of a pool select servers and build server streams from
+ * published snapshots of the topology description, without locking the
+ * topology. Server streams keep their snapshot alive. */
+static void
+test_snapshot_pooled (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_topology_t *topology;
+   mongoc_topology_snapshot_t *snapshot;
+   mongoc_server_stream_t *server_stream;
+   mongoc_server_description_t *sd;
+   uint32_t server_id;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   pool = mongoc_client_pool_new (mock_server_get_uri (server));
+   client = mongoc_client_pool_pop (pool);
+   topology = client->topology;
+
+   server_id = mongoc_topology_select_server_id (
+      topology, MONGOC_SS_READ, NULL, &error);
+   ASSERT_OR_PRINT (server_id, error);
+
+   /* the monitor published the server it discovered */
+   snapshot = _mongoc_topology_snapshot_acquire (topology, NULL);
+   BSON_ASSERT (snapshot);
+   sd = mongoc_topology_description_server_by_id (
+      &snapshot->description, server_id, &error);
+   ASSERT_OR_PRINT (sd, error);
+   BSON_ASSERT (sd->type == MONGOC_SERVER_STANDALONE);
+   _mongoc_topology_snapshot_release (snapshot);
+
+   /* selecting a known server does not take the topology mutex. if it did,
+    * this would deadlock */
+   bson_mutex_lock (&topology->mutex);
+   ASSERT_CMPUINT32 (
+      server_id,
+      ==,
+      mongoc_topology_select_server_id (
+         topology, MONGOC_SS_WRITE, NULL, &error));
+   bson_mutex_unlock (&topology->mutex);
+
+   /* the stream shares the snapshot published by the handshake, instead of
+    * copying the server description */
+   server_stream = mongoc_cluster_stream_for_reads (
+      &client->cluster, NULL, NULL, NULL, &error);
+   ASSERT_OR_PRINT (server_stream, error);
+   BSON_ASSERT (server_stream->snapshot);
+   BSON_ASSERT (server_stream->sd ==
+                mongoc_topology_description_server_by_id (
+                   &server_stream->snapshot->description, server_id, NULL));
+
+   /* a change to the topology publishes a new snapshot, but the stream's
+    * server description is unchanged */
+   bson_set_error (
+      &error, MONGOC_ERROR_STREAM, MONGOC_ERROR_STREAM_SOCKET, "socket error");
+   mongoc_topology_invalidate_server (topology, server_id, &error);
+   snapshot = _mongoc_topology_snapshot_acquire (topology, NULL);
+   BSON_ASSERT (snapshot != server_stream->snapshot);
+   sd = mongoc_topology_description_server_by_id (
+      &snapshot->description, server_id, &error);
+   ASSERT_OR_PRINT (sd, error);
+   BSON_ASSERT (sd->type == MONGOC_SERVER_UNKNOWN);
+   BSON_ASSERT (server_stream->sd->type == MONGOC_SERVER_STANDALONE);
+   _mongoc_topology_snapshot_release (snapshot);
+
+   mongoc_server_stream_cleanup (server_stream);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mock_server_destroy (server);
+}
+
+
+/* Snapshots precompute the suitable servers for each read preference that
+ * server selection has seen. */
+static void
+test_snapshot_suitable_cached (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_topology_t *topology;
+   mongoc_topology_snapshot_t *snapshot;
+   mongoc_read_prefs_t *prefs;
+   mongoc_read_prefs_t *prefs_copy;
+   uint32_t server_id;
+   bson_error_t error;
+
+   server = mock_mongos_new (WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   /* discover a sharded topology, not a single server */
+   mongoc_uri_set_option_as_bool (uri, MONGOC_URI_DIRECTCONNECTION, false);
+   pool = mongoc_client_pool_new (uri);
+   client = mongoc_client_pool_pop (pool);
+   topology = client->topology;
+
+   prefs = mongoc_read_prefs_new (MONGOC_READ_SECONDARY_PREFERRED);
+   mongoc_read_prefs_set_tags (prefs, tmp_bson ("[{'dc': 'ny'}, {}]"));
+
+   server_id = mongoc_topology_select_server_id (
+      topology, MONGOC_SS_READ, prefs, &error);
+   ASSERT_OR_PRINT (server_id, error);
+   ASSERT_CMPSIZE_T (topology->n_selection_keys, ==, (size_t) 1);
+
+   /* an equal read preference uses the same precomputed servers */
+   prefs_copy = mongoc_read_prefs_copy (prefs);
+   ASSERT_CMPUINT32 (server_id,
+                     ==,
+                     mongoc_topology_select_server_id (
+                        topology, MONGOC_SS_READ, prefs_copy, &error));
+   ASSERT_CMPSIZE_T (topology->n_selection_keys, ==, (size_t) 1);
+
+   snapshot = _mongoc_topology_snapshot_acquire (topology, NULL);
+   ASSERT_CMPSIZE_T (snapshot->n_suitable, ==, (size_t) 1);
+   ASSERT_CMPSIZE_T (snapshot->suitable[0].len, ==, (size_t) 1);
+   ASSERT_CMPUINT32 (
+      server_id,
+      ==,
+      _mongoc_array_index (
+         &snapshot->suitable[0], mongoc_server_description_t *, 0)
+         ->id);
+   _mongoc_topology_snapshot_release (snapshot);
+
+   /* writes and other read preferences are cached separately */
+   ASSERT_OR_PRINT (mongoc_topology_select_server_id (
+                       topology, MONGOC_SS_WRITE, NULL, &error),
+                    error);
+   ASSERT_OR_PRINT (mongoc_topology_select_server_id (
+                       topology, MONGOC_SS_READ, NULL, &error),
+                    error);
+   ASSERT_CMPSIZE_T (topology->n_selection_keys, ==, (size_t) 3);
+
+   mongoc_read_prefs_destroy (prefs_copy);
+   mongoc_read_prefs_destroy (prefs);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+
+static size_t
+_count_mongoses (mongoc_client_t *client)
+{
+   mongoc_server_description_t **sds;
+   size_t n;
+   size_t i;
+   size_t n_mongoses = 0;
+
+   sds = mongoc_client_get_server_descriptions (client, &n);
+   for (i = 0; i < n; i++) {
+      if (!strcmp (mongoc_server_description_type (sds[i]), "Mongos")) {
+         n_mongoses++;
+      }
+   }
+
+   mongoc_server_descriptions_destroy_all (sds, n);
+
+   return n_mongoses;
+}
+
+
+/* With serverSelectionLoadAware, a pool prefers the suitable server with
+ * fewer operations in progress, and server descriptions report the load. */
+static void
+test_select_load_aware (void)
+{
+   mock_server_t *servers[2];
+   char *uri_str;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_server_stream_t *server_stream;
+   mongoc_server_description_t *sd;
+   size_t i;
+   uint32_t busy_id;
+   bson_error_t error;
+
+   for (i = 0; i < 2; i++) {
+      servers[i] = mock_mongos_new (WIRE_VERSION_OP_MSG);
+      mock_server_run (servers[i]);
+   }
+
+   uri_str = bson_strdup_printf ("mongodb://%s,%s/?%s=true",
+                                 mock_server_get_host_and_port (servers[0]),
+                                 mock_server_get_host_and_port (servers[1]),
+                                 MONGOC_URI_SERVERSELECTIONLOADAWARE);
+   uri = mongoc_uri_new (uri_str);
+   pool = mongoc_client_pool_new (uri);
+   client = mongoc_client_pool_pop (pool);
+
+   /* wait for both mongoses to be discovered */
+   WAIT_UNTIL (_count_mongoses (client) == 2);
+
+   /* an operation is in progress on one mongos */
+   server_stream = mongoc_cluster_stream_for_writes (
+      &client->cluster, NULL, NULL, &error);
+   ASSERT_OR_PRINT (server_stream, error);
+   busy_id = server_stream->sd->id;
+
+   sd = mongoc_client_get_server_description (client, busy_id);
+   ASSERT_CMPINT32 (mongoc_server_description_operations_in_progress (sd),
+                    ==,
+                    1);
+   ASSERT_CMPINT64 (mongoc_server_description_operation_latency (sd), ==, -1);
+
+   /* the other is always chosen */
+   for (i = 0; i < 100; i++) {
+      ASSERT_CMPUINT32 (busy_id,
+                        !=,
+                        mongoc_topology_select_server_id (
+                           client->topology, MONGOC_SS_READ, NULL, &error));
+   }
+
+   mongoc_server_stream_cleanup (server_stream);
+   ASSERT_CMPINT32 (mongoc_server_description_operations_in_progress (sd),
+                    ==,
+                    0);
+   ASSERT_CMPINT64 (mongoc_server_description_operation_latency (sd), >=, 0);
+
+   mongoc_server_description_destroy (sd);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   bson_free (uri_str);
+   for (i = 0; i < 2; i++) {
+      mock_server_destroy (servers[i]);
+   }
+}
+
 void
 test_topology_install (TestSuite *suite)
 {
@@ -2356,4 +2613,11 @@ test_topology_install (TestSuite *suite)
                                 test_last_server_removed_warning);
    TestSuite_AddMockServerTest (
       suite, "/Topology/slow_server/pooled", test_slow_server_pooled);
+   TestSuite_AddMockServerTest (
+      suite, "/Topology/snapshot/pooled", test_snapshot_pooled);
+   TestSuite_AddMockServerTest (suite,
+                                "/Topology/snapshot/suitable_cached",
+                                test_snapshot_suitable_cached);
+   TestSuite_AddMockServerTest (
+      suite, "/Topology/select/load_aware", test_select_load_aware);
 }